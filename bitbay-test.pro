@@ -95,6 +95,9 @@ INCLUDEPATH += src/leveldb/include src/leveldb/helpers
 LIBS += $$PWD/src/leveldb/out-static/libleveldb.a $$PWD/src/leveldb/out-static/libmemenv.a
 HEADERS += src/txdb-leveldb.h
 SOURCES += src/txdb-leveldb.cpp
+HEADERS += src/addrindexcache.h
+HEADERS += src/dbchanges.h
+SOURCES += src/addrindexcache.cpp
 !win32 {
     # we use QMAKE_CXXFLAGS_RELEASE even without RELEASE=1 because we use RELEASE to indicate linking preferences not -O preferences
     macx:LEVELDB_CXXFLAGS=-mmacosx-version-min=10.9
@@ -146,7 +149,19 @@ SOURCES += \
 	src/test/uint160_tests.cpp \
 	src/test/uint256_tests.cpp \
 	src/test/cfractions_tests.cpp \
+	src/test/pegcache_tests.cpp \
+	src/test/pegcycle_tests.cpp \
+	src/test/bridgeburn_tests.cpp \
+	src/test/sigcache_tests.cpp \
+	src/test/addrindexcache_tests.cpp \
+	src/test/addrindexkeys_tests.cpp \
+	src/test/skiplist_tests.cpp \
+	src/test/blockindexmap_tests.cpp \
+	src/test/kernel_tests.cpp \
+	src/test/mempool_tests.cpp \
 	src/test/mintser_tests.cpp \
+	src/test/walletbalances_tests.cpp \
+	src/test/txindex_tests.cpp \
 
 # disabled tests
 #SOURCES += \
@@ -0,0 +1,159 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addrindexcache.h"
+#include "serialize.h"
+#include "util.h"
+#include "version.h"
+
+CAddrIndexCache::CAddrIndexCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn) {}
+
+const std::string& CAddrIndexCache::DirtyKey() {
+	static const std::string sKey = [] {
+		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+		ssKey << std::string("utxoDbDirty");
+		return ssKey.str();
+	}();
+	return sKey;
+}
+
+// memory of entry with map node overhead
+size_t CAddrIndexCache::EntryBytes(const std::string& rawkey, const CDbChange& change) {
+	return sizeof(DbChanges::value_type) + 4 * sizeof(void*) + rawkey.size() +
+	       change.value.size();
+}
+
+void CAddrIndexCache::SetMaxBytes(size_t nMaxBytesIn) {
+	LOCK(cs);
+	nMaxBytes = nMaxBytesIn;
+}
+
+bool CAddrIndexCache::Get(const std::string& rawkey, CDbChange& change) {
+	LOCK(cs);
+	auto it = mapChanges.find(rawkey);
+	if (it == mapChanges.end()) {
+		nMisses++;
+		return false;
+	}
+	nHits++;
+	change = it->second;
+	return true;
+}
+
+void CAddrIndexCache::GetRange(const std::string&        fromkey,
+                               const std::string&        tokey,
+                               DbChanges&                changes,
+                               leveldb::DB*              pdb,
+                               const leveldb::Snapshot** ppSnapshot) const {
+	LOCK(cs);
+	// no flush moves changes between the copy and the snapshot
+	if (pdb)
+		*ppSnapshot = pdb->GetSnapshot();
+	auto it = mapChanges.lower_bound(fromkey);
+	for (; it != mapChanges.end() && it->first <= tokey; it++)
+		changes[it->first] = it->second;
+}
+
+bool CAddrIndexCache::NeedFlush() const {
+	if (mapChanges.empty())
+		return false;
+	return nBytes > nMaxBytes || GetTime() - nDirtySince >= ADDRINDEX_FLUSH_INTERVAL;
+}
+
+bool CAddrIndexCache::Commit(leveldb::DB*         pdb,
+                             DbChanges&           changes,
+                             leveldb::DB*         pdbBatch,
+                             leveldb::WriteBatch* batch) {
+	LOCK(cs);
+	// the marker is on disk before the first change it covers
+	if (!changes.empty() && mapChanges.empty()) {
+		CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+		ssValue << true;
+		leveldb::Status status = pdb->Put(leveldb::WriteOptions(), DirtyKey(), ssValue.str());
+		if (!status.ok()) {
+			LogPrintf("LevelDB address index marker failure: %s\n", status.ToString());
+			return false;
+		}
+		nDirtySince = GetTime();
+	}
+	if (batch) {
+		leveldb::Status status = pdbBatch->Write(leveldb::WriteOptions(), batch);
+		if (!status.ok()) {
+			LogPrintf("LevelDB batch commit failure: %s\n", status.ToString());
+			return false;
+		}
+	}
+
+	for (auto& it : changes) {
+		auto res = mapChanges.insert(DbChanges::value_type(it.first, CDbChange()));
+		if (!res.second)
+			nBytes -= EntryBytes(res.first->first, res.first->second);
+		res.first->second.fErased = it.second.fErased;
+		res.first->second.value.swap(it.second.value);
+		nBytes += EntryBytes(res.first->first, res.first->second);
+	}
+	changes.clear();
+
+	// changes are committed, a failed flush is retried on next commit
+	if (NeedFlush())
+		FlushLocked(pdb);
+	return true;
+}
+
+bool CAddrIndexCache::Flush(leveldb::DB* pdb, bool fForce) {
+	LOCK(cs);
+	if (!fForce && !NeedFlush())
+		return true;
+	return FlushLocked(pdb);
+}
+
+bool CAddrIndexCache::FlushLocked(leveldb::DB* pdb) {
+	leveldb::WriteBatch batch;
+	for (const auto& it : mapChanges) {
+		if (it.second.fErased)
+			batch.Delete(it.first);
+		else
+			batch.Put(it.first, it.second.value);
+	}
+	batch.Delete(DirtyKey());
+	leveldb::Status status = pdb->Write(leveldb::WriteOptions(), &batch);
+	if (!status.ok()) {
+		LogPrintf("LevelDB address index flush failure: %s\n", status.ToString());
+		return false;
+	}
+	LogPrint("addrindex", "address index flush: %d records, %d bytes\n", mapChanges.size(),
+	         nBytes);
+	nFlushes++;
+	nFlushedWrites += mapChanges.size();
+	mapChanges.clear();
+	nBytes      = 0;
+	nDirtySince = 0;
+	return true;
+}
+
+void CAddrIndexCache::Clear() {
+	LOCK(cs);
+	mapChanges.clear();
+	nBytes      = 0;
+	nDirtySince = 0;
+}
+
+CAddrIndexCacheStats CAddrIndexCache::Stats() const {
+	LOCK(cs);
+	CAddrIndexCacheStats stats;
+	stats.nHits          = nHits;
+	stats.nMisses        = nMisses;
+	stats.nFlushes       = nFlushes;
+	stats.nFlushedWrites = nFlushedWrites;
+	stats.nEntries       = mapChanges.size();
+	stats.nBytes         = nBytes;
+	stats.nMaxBytes      = nMaxBytes;
+	stats.nDirtySince    = nDirtySince;
+	return stats;
+}
+
+CAddrIndexCache& AddrIndexCache() {
+	static CAddrIndexCache cache;
+	return cache;
+}
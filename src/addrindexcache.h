@@ -0,0 +1,92 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITBAY_ADDRINDEXCACHE_H
+#define BITBAY_ADDRINDEXCACHE_H
+
+#include "dbchanges.h"
+#include "sync.h"
+
+#include <string>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+/** -addrindexcache default (megabytes) */
+static const int64_t DEFAULT_ADDRINDEX_CACHE_SIZE = 64;
+/** -addrdbcache default, block cache of the address index db (megabytes) */
+static const int64_t DEFAULT_ADDRDB_CACHE_SIZE = 16;
+/** Cached changes older than this (seconds) are flushed */
+static const int64_t ADDRINDEX_FLUSH_INTERVAL = 600;
+
+struct CAddrIndexCacheStats {
+	uint64_t nHits          = 0;
+	uint64_t nMisses        = 0;
+	uint64_t nFlushes       = 0;
+	uint64_t nFlushedWrites = 0;
+	size_t   nEntries       = 0;
+	size_t   nBytes         = 0;
+	size_t   nMaxBytes      = 0;
+	int64_t  nDirtySince    = 0;
+};
+
+/** Write-back cache of the address index records (unspent, frozen,
+ *  balance history, frozen queue and peg balances). Changes of committed
+ *  txdb batches are coalesced in memory and written to the address index
+ *  db in one batch when the memory or time budget is exceeded, or on
+ *  shutdown.
+ *
+ *  While the cache holds changes the address index db carries a dirty
+ *  marker, written before the txdb batch of the first cached change and
+ *  erased by the flush, so the address index of an interrupted node is
+ *  rebuilt on start.
+ *  Commit and flush are done under the cache lock, readers consult the
+ *  cache before disk.
+ */
+class CAddrIndexCache {
+public:
+	CAddrIndexCache(size_t nMaxBytes = DEFAULT_ADDRINDEX_CACHE_SIZE * 1048576);
+
+	void SetMaxBytes(size_t nMaxBytes);
+	bool Get(const std::string& rawkey, CDbChange& change);
+	// Copies cached changes of keys in [fromkey, tokey], with pdb also takes a
+	// snapshot of pdb matching the copy, it is released by the caller
+	void GetRange(const std::string&        fromkey,
+	              const std::string&        tokey,
+	              DbChanges&                changes,
+	              leveldb::DB*              pdb        = nullptr,
+	              const leveldb::Snapshot** ppSnapshot = nullptr) const;
+	// Writes the batch (may be NULL) to pdbBatch and takes changes into the
+	// cache of pdb, flushes when the budget is exceeded
+	bool Commit(leveldb::DB*         pdb,
+	            DbChanges&           changes,
+	            leveldb::DB*         pdbBatch = nullptr,
+	            leveldb::WriteBatch* batch    = nullptr);
+	// Writes cached changes to disk, with fForce also when in budget
+	bool Flush(leveldb::DB* pdb, bool fForce = true);
+	// Drops cached changes without writing them
+	void Clear();
+	CAddrIndexCacheStats Stats() const;
+
+	static const std::string& DirtyKey();
+
+private:
+	static size_t EntryBytes(const std::string& rawkey, const CDbChange& change);
+	bool          NeedFlush() const;
+	bool          FlushLocked(leveldb::DB* pdb);
+
+	mutable CCriticalSection cs;
+	DbChanges                mapChanges;
+	size_t                   nBytes         = 0;
+	size_t                   nMaxBytes      = 0;
+	int64_t                  nDirtySince    = 0;
+	uint64_t                 nHits          = 0;
+	uint64_t                 nMisses        = 0;
+	uint64_t                 nFlushes       = 0;
+	uint64_t                 nFlushedWrites = 0;
+};
+
+CAddrIndexCache& AddrIndexCache();
+
+#endif
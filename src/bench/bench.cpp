@@ -0,0 +1,78 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include <sys/time.h>
+#include <iostream>
+
+using namespace benchmark;
+
+std::map<std::string, BenchFunction> BenchRunner::benchmarks;
+
+static double gettimedouble(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_usec * 0.000001 + tv.tv_sec;
+}
+
+BenchRunner::BenchRunner(std::string name, BenchFunction func) {
+	benchmarks.insert(std::make_pair(name, func));
+}
+
+void BenchRunner::RunAll(double elapsedTimeForOne, std::string filter) {
+	std::cout << "Benchmark"
+	          << "," << "count"
+	          << "," << "min"
+	          << "," << "max"
+	          << "," << "average" << "\n";
+
+	for (std::map<std::string, BenchFunction>::iterator it = benchmarks.begin();
+	     it != benchmarks.end(); ++it) {
+		if (!filter.empty() && it->first.find(filter) == std::string::npos)
+			continue;
+		State state(it->first, elapsedTimeForOne);
+		BenchFunction& func = it->second;
+		func(state);
+	}
+}
+
+bool State::KeepRunning() {
+	double now;
+	if (count == 0) {
+		beginTime = now = gettimedouble();
+	} else {
+		// timeCheckCount is used to avoid calling gettime most of the time,
+		// so benchmarks that run very quickly get consistent results.
+		if ((count + 1) % timeCheckCount != 0) {
+			++count;
+			return true;  // keep going
+		}
+		now               = gettimedouble();
+		double elapsed    = now - lastTime;
+		double elapsedOne = elapsed / timeCheckCount;
+		if (elapsedOne < minTime)
+			minTime = elapsedOne;
+		if (elapsedOne > maxTime)
+			maxTime = elapsedOne;
+		if (elapsed * timeCheckCount < maxElapsed / 16) {
+			timeCheckCount *= 2;
+		}
+	}
+	lastTime = now;
+	++count;
+
+	if (now - beginTime < maxElapsed)
+		return true;  // Keep going
+
+	--count;
+
+	// Output results
+	double average = (now - beginTime) / count;
+	std::cout << name << "," << count << "," << minTime << "," << maxTime << "," << average
+	          << "\n";
+
+	return false;
+}
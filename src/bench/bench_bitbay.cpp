@@ -0,0 +1,39 @@
+// Copyright (c) 2015-2016 The Bitcoin Core developers
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "util.h"
+#include "wallet.h"
+
+CWallet*           pwalletMain;
+CClientUIInterface uiInterface;
+bool               fConfChange   = false;
+unsigned int       nNodeLifespan = 7;
+unsigned int       nMinerSleep   = 500;
+bool               fUseFastIndex = true;
+
+extern void noui_connect();
+
+void Shutdown(void* parg) {
+	exit(0);
+}
+
+void StartShutdown() {
+	exit(0);
+}
+
+int main(int argc, char** argv) {
+	ParseParameters(argc, argv);
+	fPrintToConsole = true;  // don't want to write to debug.log file
+	noui_connect();
+	InitParamsOnStart();
+
+	double elapsed = atof(GetArg("-elapsed", "1").c_str());
+	benchmark::BenchRunner::RunAll(elapsed, GetArg("-filter", ""));
+	return 0;
+}
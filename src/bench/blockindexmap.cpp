@@ -0,0 +1,171 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "blockindexmap.h"
+#include "main.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+// The block index of a long chain: BLOCK_COUNT random hashes, each with its
+// block index. Every run inserts all of them, looks all of them up in a
+// different order, or walks the whole map. CBlockIndexMap is compared to the
+// node based map with one allocation per block index it replaced. Reported
+// is the time per entry.
+
+static const size_t BLOCK_COUNT = 3000000;
+
+// Keeps the lookups and walks from being optimized away
+static volatile int nHeightSink;
+
+static const std::vector<uint256>& BlockHashes() {
+	static std::vector<uint256> vHashes = [] {
+		std::vector<uint256> v(BLOCK_COUNT);
+		std::mt19937_64      rng(1);
+		for (uint256& hash : v)
+			for (unsigned char* p = hash.begin(); p != hash.end(); p += sizeof(uint64_t)) {
+				uint64_t n = rng();
+				memcpy(p, &n, sizeof(n));
+			}
+		return v;
+	}();
+	return vHashes;
+}
+
+static std::vector<size_t> LookupOrder() {
+	std::vector<size_t> vOrder(BLOCK_COUNT);
+	for (size_t i = 0; i < BLOCK_COUNT; i++)
+		vOrder[i] = i;
+	std::shuffle(vOrder.begin(), vOrder.end(), std::mt19937_64(2));
+	return vOrder;
+}
+
+class CTimePerEntry {
+	const char*                           name;
+	uint64_t                              nEntries = 0;
+	std::chrono::steady_clock::time_point start    = std::chrono::steady_clock::now();
+
+public:
+	CTimePerEntry(const char* nameIn) : name(nameIn) {}
+	void Add(uint64_t n) { nEntries += n; }
+	~CTimePerEntry() {
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+		                .count();
+		std::cerr << name << ": " << ns / nEntries << " ns/entry" << std::endl;
+	}
+};
+
+// The map used before CBlockIndexMap, block indexes allocated one by one
+struct CNodeMap {
+	std::unordered_map<uint256, CBlockIndex*> map;
+	std::vector<std::unique_ptr<CBlockIndex>> vIndexes;
+
+	CNodeMap() { map.reserve(262144); }
+	void Add(const uint256& hash) {
+		CBlockIndex* pindex = new CBlockIndex();
+		vIndexes.emplace_back(pindex);
+		pindex->phashBlock = &map.insert(std::make_pair(hash, pindex)).first->first;
+	}
+	CBlockIndex* Find(const uint256& hash) {
+		std::unordered_map<uint256, CBlockIndex*>::iterator mi = map.find(hash);
+		return mi == map.end() ? NULL : mi->second;
+	}
+	const std::unordered_map<uint256, CBlockIndex*>& Items() const { return map; }
+};
+
+struct CFlatMap {
+	CBlockIndexMap map;
+
+	void Add(const uint256& hash) {
+		CBlockIndex* pindex = map.allocate();
+		pindex->phashBlock  = &map.insert(hash, pindex).first->first;
+	}
+	CBlockIndex*          Find(const uint256& hash) { return map.ref(hash); }
+	const CBlockIndexMap& Items() const { return map; }
+};
+
+template <typename TMap>
+static void BlockIndexInsert(benchmark::State& state, const char* name) {
+	const std::vector<uint256>& vHashes = BlockHashes();
+	CTimePerEntry               time(name);
+	while (state.KeepRunning()) {
+		TMap map;
+		for (const uint256& hash : vHashes)
+			map.Add(hash);
+		time.Add(BLOCK_COUNT);
+	}
+}
+
+template <typename TMap>
+static void BlockIndexLookup(benchmark::State& state, const char* name) {
+	const std::vector<uint256>& vHashes = BlockHashes();
+	std::vector<size_t>         vOrder  = LookupOrder();
+	TMap                        map;
+	for (const uint256& hash : vHashes)
+		map.Add(hash);
+
+	int           nHeight = 0;
+	CTimePerEntry time(name);
+	while (state.KeepRunning()) {
+		for (size_t i : vOrder)
+			nHeight += map.Find(vHashes[i])->nHeight;
+		time.Add(BLOCK_COUNT);
+	}
+	nHeightSink = nHeight;
+}
+
+template <typename TMap>
+static void BlockIndexIterate(benchmark::State& state, const char* name) {
+	const std::vector<uint256>& vHashes = BlockHashes();
+	TMap                        map;
+	for (const uint256& hash : vHashes)
+		map.Add(hash);
+
+	int           nHeight = 0;
+	CTimePerEntry time(name);
+	while (state.KeepRunning()) {
+		for (const auto& item : map.Items())
+			nHeight += item.second->nHeight;
+		time.Add(BLOCK_COUNT);
+	}
+	nHeightSink = nHeight;
+}
+
+static void BlockIndexMapInsert(benchmark::State& state) {
+	BlockIndexInsert<CFlatMap>(state, "BlockIndexMapInsert");
+}
+
+static void BlockIndexMapLookup(benchmark::State& state) {
+	BlockIndexLookup<CFlatMap>(state, "BlockIndexMapLookup");
+}
+
+static void BlockIndexMapIterate(benchmark::State& state) {
+	BlockIndexIterate<CFlatMap>(state, "BlockIndexMapIterate");
+}
+
+static void BlockIndexNodeMapInsert(benchmark::State& state) {
+	BlockIndexInsert<CNodeMap>(state, "BlockIndexNodeMapInsert");
+}
+
+static void BlockIndexNodeMapLookup(benchmark::State& state) {
+	BlockIndexLookup<CNodeMap>(state, "BlockIndexNodeMapLookup");
+}
+
+static void BlockIndexNodeMapIterate(benchmark::State& state) {
+	BlockIndexIterate<CNodeMap>(state, "BlockIndexNodeMapIterate");
+}
+
+BENCHMARK(BlockIndexMapInsert);
+BENCHMARK(BlockIndexMapLookup);
+BENCHMARK(BlockIndexMapIterate);
+BENCHMARK(BlockIndexNodeMapInsert);
+BENCHMARK(BlockIndexNodeMapLookup);
+BENCHMARK(BlockIndexNodeMapIterate);
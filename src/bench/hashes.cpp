@@ -0,0 +1,189 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+
+// A regtest chain in a temporary data dir: mined blocks up to a mature
+// coinbase, a block splitting it to BLOCK_TXS outputs, and on top of them a
+// block of BLOCK_TXS signed transactions spending one each. Every run takes
+// a copy of that block, as received, through CheckBlock and ConnectBlock,
+// the db changes are aborted after. Copies start without memoized hashes:
+// they are taken as they are, and through ProcessBlock's CacheHashes first.
+// Reported are transaction and block hashes computed per block.
+
+static const int BLOCK_TXS = 500;
+
+class CConnectBench {
+	boost::filesystem::path path;
+	CBasicKeyStore          keystore;
+	CScript                 scriptPubKey;
+
+	// Mines a proof-of-work block of vtx on the best chain and connects it
+	bool ConnectNew(const std::vector<CTransaction>& vtx) {
+		CBlock blockNew;
+		MakeBlock(blockNew, vtx);
+		uint32_t nFile;
+		uint32_t nBlockPos;
+		if (!blockNew.WriteToDisk(nFile, nBlockPos))
+			return false;
+		return blockNew.AddToBlockIndex(nFile, nBlockPos, blockNew.GetPoWHash());
+	}
+
+	// Transactions are signed with the time of the block
+	int64_t NextBlockTime() const { return pindexBest->GetBlockTime() + 64; }
+
+	void MakeBlock(CBlock& blockNew, const std::vector<CTransaction>& vtx) {
+		int nHeight = pindexBest->nHeight + 1;
+
+		blockNew.nVersion      = CBlock::CURRENT_VERSION;
+		blockNew.hashPrevBlock = pindexBest->GetBlockHash();
+		blockNew.nTime         = NextBlockTime();
+		blockNew.nBits         = Params().ProofOfWorkLimit().GetCompact();
+
+		CTransaction coinbase;
+		coinbase.nTime = blockNew.nTime;
+		coinbase.vin.resize(1);
+		coinbase.vin[0].prevout.SetNull();
+		coinbase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+		// subsidy is only paid at height 2, fees are 0
+		coinbase.vout.push_back(CTxOut(nHeight == 2 ? GetProofOfWorkReward(0) : 0, scriptPubKey));
+		blockNew.vtx.push_back(coinbase);
+		blockNew.vtx.insert(blockNew.vtx.end(), vtx.begin(), vtx.end());
+		blockNew.hashMerkleRoot = blockNew.BuildMerkleTree();
+		CBigNum bnTarget;
+		bnTarget.SetCompact(blockNew.nBits);
+		while (CBigNum(blockNew.GetPoWHash()) > bnTarget)
+			blockNew.nNonce++;
+	}
+
+	// A transaction of one input from txFrom, signed, and nOutputs outputs
+	CTransaction Spend(const CTransaction& txFrom, uint32_t n, int nOutputs) {
+		CTransaction tx;
+		tx.vin.push_back(CTxIn(COutPoint(txFrom.GetHash(), n)));
+		int64_t nValue = txFrom.vout[n].nValue / nOutputs;
+		for (int i = 0; i < nOutputs; i++)
+			tx.vout.push_back(CTxOut(nValue, scriptPubKey));
+		tx.nTime = NextBlockTime();
+		if (!SignSignature(keystore, txFrom, tx, 0))
+			throw std::runtime_error("CConnectBench : SignSignature failed");
+		return tx;
+	}
+
+public:
+	CBlock       block;
+	CBlockIndex* pindex = nullptr;
+
+	CConnectBench() {
+		path = boost::filesystem::temp_directory_path() /
+		       boost::filesystem::unique_path("bitbay-bench-%%%%-%%%%");
+		boost::filesystem::create_directories(path);
+		mapArgs["-datadir"] = path.string();
+		SelectParams(CChainParams::REGTEST);
+
+		CKey key;
+		key.MakeNewKey(true);
+		keystore.AddKey(key);
+		scriptPubKey.SetDestination(key.GetPubKey().GetID());
+
+		LOCK(cs_main);
+		if (!LoadBlockIndex([](const std::string&) {}))
+			throw std::runtime_error("CConnectBench : LoadBlockIndex failed");
+		// the subsidy of height 2 and blocks up to its maturity
+		while (nBestHeight < 2 + Params().CoinbaseMaturity()) {
+			if (!ConnectNew({}))
+				throw std::runtime_error("CConnectBench : mined block not connected");
+		}
+		CBlock block2;
+		if (!block2.ReadFromDisk(pindexBest->GetAncestor(2)))
+			throw std::runtime_error("CConnectBench : ReadFromDisk failed");
+		CTransaction txSplit = Spend(block2.vtx[0], 0, BLOCK_TXS);
+		if (!ConnectNew({txSplit}))
+			throw std::runtime_error("CConnectBench : split block not connected");
+
+		std::vector<CTransaction> vtx;
+		for (int i = 0; i < BLOCK_TXS; i++)
+			vtx.push_back(Spend(txSplit, i, 1));
+		MakeBlock(block, vtx);
+		uint32_t nFile;
+		uint32_t nBlockPos;
+		if (!block.WriteToDisk(nFile, nBlockPos))
+			throw std::runtime_error("CConnectBench : WriteToDisk failed");
+		// indexed as by AddToBlockIndex, but not connected
+		pindex                      = mapBlockIndex.allocate(nFile, nBlockPos, block);
+		CBlockIndexMap::iterator mi = mapBlockIndex.insert(block.GetHash(), pindex).first;
+		pindex->phashBlock          = &((*mi).first);
+		pindex->SetPrev(pindexBest);
+		pindex->nHeight = pindexBest->nHeight + 1;
+		pindex->SetPeg(pindex->nHeight >= nPegStartHeight);
+		SelectParams(CChainParams::MAIN);
+	}
+
+	~CConnectBench() {
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(path, ec);
+	}
+
+	bool Connect(bool fCacheHashes) {
+		SelectParams(CChainParams::REGTEST);
+		CBlock blockReceived = block;
+		if (fCacheHashes)
+			blockReceived.CacheHashes();
+		LOCK(cs_main);
+		CTxDB  txdb;
+		CPegDB pegdb;
+		txdb.TxnBegin();
+		pegdb.TxnBegin();
+		bool fOk = blockReceived.CheckBlock() && blockReceived.ConnectBlock(txdb, pegdb, pindex);
+		txdb.TxnAbort();
+		pegdb.TxnAbort();
+		SelectParams(CChainParams::MAIN);
+		return fOk;
+	}
+};
+
+static CConnectBench& ConnectBench() {
+	static CConnectBench bench;
+	return bench;
+}
+
+static void ConnectBlockHashes(benchmark::State& state, bool fCacheHashes, const char* name) {
+	CConnectBench& bench = ConnectBench();
+	uint64_t nTxStart    = nTxHashesComputed;
+	uint64_t nBlockStart = nBlockHashesComputed;
+	uint64_t nRuns       = 0;
+	while (state.KeepRunning()) {
+		if (!bench.Connect(fCacheHashes)) {
+			std::cerr << name << ": ConnectBlock failed" << std::endl;
+			break;
+		}
+		nRuns++;
+	}
+	if (!nRuns)
+		return;
+	std::cerr << name << ": " << (nTxHashesComputed - nTxStart) / nRuns << " tx hashes, "
+	          << (nBlockHashesComputed - nBlockStart) / nRuns << " block hashes per block of "
+	          << bench.block.vtx.size() << " txs" << std::endl;
+}
+
+static void BlockHashesUncached(benchmark::State& state) {
+	ConnectBlockHashes(state, false, "BlockHashesUncached");
+}
+
+static void BlockHashesCached(benchmark::State& state) {
+	ConnectBlockHashes(state, true, "BlockHashesCached");
+}
+
+BENCHMARK(BlockHashesUncached);
+BENCHMARK(BlockHashesCached);
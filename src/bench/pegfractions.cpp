@@ -0,0 +1,175 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "pegdata.h"
+#include "pegkernels.h"
+
+#include <random>
+
+// Each kernel is measured for the scalar version and for the one selected
+// by cpu detection, over a full window of PEG_SIZE slots.
+
+static void FillSlots(int64_t* a, int64_t seed) {
+	std::mt19937_64 rng(seed);
+	for (int i = 0; i < PEG_SIZE; i++)
+		a[i] = int64_t(rng() % 2000000) - 500000;
+}
+
+template <bool fScalar>
+static const CPegKernels& Kernels() {
+	return fScalar ? PegKernelsScalar() : PegKernels();
+}
+
+template <bool fScalar>
+static void KernelSum(benchmark::State& state) {
+	int64_t a[PEG_SIZE];
+	FillSlots(a, 1);
+	int64_t r = 0;
+	while (state.KeepRunning())
+		r += Kernels<fScalar>().sum(a, PEG_SIZE);
+	(void)r;
+}
+
+template <bool fScalar>
+static void KernelAddSub(benchmark::State& state) {
+	int64_t a[PEG_SIZE], b[PEG_SIZE];
+	FillSlots(a, 1);
+	FillSlots(b, 2);
+	while (state.KeepRunning()) {
+		Kernels<fScalar>().add(a, b, PEG_SIZE);
+		Kernels<fScalar>().sub(a, b, PEG_SIZE);
+	}
+}
+
+template <bool fScalar>
+static void KernelIntersect(benchmark::State& state) {
+	int64_t a[PEG_SIZE], b[PEG_SIZE], c[PEG_SIZE];
+	FillSlots(a, 1);
+	FillSlots(b, 2);
+	while (state.KeepRunning()) {
+		std::copy(a, a + PEG_SIZE, c);
+		Kernels<fScalar>().intersect(c, b, PEG_SIZE);
+	}
+}
+
+template <bool fScalar>
+static void KernelPositive(benchmark::State& state) {
+	int64_t a[PEG_SIZE], c[PEG_SIZE];
+	FillSlots(a, 1);
+	int64_t r = 0;
+	while (state.KeepRunning()) {
+		std::copy(a, a + PEG_SIZE, c);
+		r += Kernels<fScalar>().keep_positive(c, PEG_SIZE);
+	}
+	(void)r;
+}
+
+template <bool fScalar>
+static void KernelDistortion(benchmark::State& state) {
+	int64_t a[PEG_SIZE], b[PEG_SIZE];
+	FillSlots(a, 1);
+	FillSlots(b, 2);
+	int64_t r = 0;
+	while (state.KeepRunning())
+		r += Kernels<fScalar>().diff_positive(a, b, PEG_SIZE);
+	(void)r;
+}
+
+template <bool fScalar>
+static void KernelIsPositive(benchmark::State& state) {
+	int64_t a[PEG_SIZE];
+	for (int i = 0; i < PEG_SIZE; i++)
+		a[i] = i;
+	bool r = true;
+	while (state.KeepRunning())
+		r &= Kernels<fScalar>().no_negative(a, PEG_SIZE);
+	(void)r;
+}
+
+static void FractionsToDeltas(benchmark::State& state) {
+	CFractions fr(int64_t(100000) * 1000000, CFractions::STD);
+	int64_t    deltas[PEG_SIZE];
+	while (state.KeepRunning())
+		fr.ToDeltas(deltas);
+}
+
+static void FractionsFromDeltas(benchmark::State& state) {
+	CFractions fr(int64_t(100000) * 1000000, CFractions::STD);
+	int64_t    deltas[PEG_SIZE];
+	fr.ToDeltas(deltas);
+	while (state.KeepRunning())
+		fr.FromDeltas(deltas);
+}
+
+static void FractionsLowHigh(benchmark::State& state) {
+	CFractions fr(int64_t(100000) * 1000000, CFractions::STD);
+	int64_t    r = 0;
+	int        supply = 0;
+	while (state.KeepRunning()) {
+		r += fr.Low(supply) + fr.High(supply);
+		supply = (supply + 1) % PEG_SIZE;
+	}
+	(void)r;
+}
+
+static void FractionsLowHighValue(benchmark::State& state) {
+	CFractions fr(int64_t(100000) * 1000000, CFractions::VALUE);
+	int64_t    r      = 0;
+	int        supply = 0;
+	while (state.KeepRunning()) {
+		r += fr.Low(supply) + fr.High(supply);
+		supply = (supply + 1) % PEG_SIZE;
+	}
+	(void)r;
+}
+
+static void FractionsCopyValue(benchmark::State& state) {
+	CFractions fr(int64_t(100000) * 1000000, CFractions::VALUE);
+	while (state.KeepRunning()) {
+		CFractions copy(fr);
+		(void)copy;
+	}
+}
+
+static void FractionsCopyLowPart(benchmark::State& state) {
+	CFractions fr = CFractions(int64_t(100000) * 1000000, CFractions::STD).LowPart(300, nullptr);
+	while (state.KeepRunning()) {
+		CFractions copy(fr);
+		(void)copy;
+	}
+}
+
+static void KernelSumScalar(benchmark::State& state) { KernelSum<true>(state); }
+static void KernelSumDetected(benchmark::State& state) { KernelSum<false>(state); }
+static void KernelAddSubScalar(benchmark::State& state) { KernelAddSub<true>(state); }
+static void KernelAddSubDetected(benchmark::State& state) { KernelAddSub<false>(state); }
+static void KernelIntersectScalar(benchmark::State& state) { KernelIntersect<true>(state); }
+static void KernelIntersectDetected(benchmark::State& state) { KernelIntersect<false>(state); }
+static void KernelPositiveScalar(benchmark::State& state) { KernelPositive<true>(state); }
+static void KernelPositiveDetected(benchmark::State& state) { KernelPositive<false>(state); }
+static void KernelDistortionScalar(benchmark::State& state) { KernelDistortion<true>(state); }
+static void KernelDistortionDetected(benchmark::State& state) { KernelDistortion<false>(state); }
+static void KernelIsPositiveScalar(benchmark::State& state) { KernelIsPositive<true>(state); }
+static void KernelIsPositiveDetected(benchmark::State& state) { KernelIsPositive<false>(state); }
+
+BENCHMARK(KernelSumScalar);
+BENCHMARK(KernelSumDetected);
+BENCHMARK(KernelAddSubScalar);
+BENCHMARK(KernelAddSubDetected);
+BENCHMARK(KernelIntersectScalar);
+BENCHMARK(KernelIntersectDetected);
+BENCHMARK(KernelPositiveScalar);
+BENCHMARK(KernelPositiveDetected);
+BENCHMARK(KernelDistortionScalar);
+BENCHMARK(KernelDistortionDetected);
+BENCHMARK(KernelIsPositiveScalar);
+BENCHMARK(KernelIsPositiveDetected);
+BENCHMARK(FractionsToDeltas);
+BENCHMARK(FractionsFromDeltas);
+BENCHMARK(FractionsLowHigh);
+BENCHMARK(FractionsLowHighValue);
+BENCHMARK(FractionsCopyValue);
+BENCHMARK(FractionsCopyLowPart);
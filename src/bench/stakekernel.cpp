@@ -0,0 +1,133 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "crypto/kernelhash.h"
+#include "kernel.h"
+
+#include <boost/thread.hpp>
+
+#include <chrono>
+#include <iostream>
+
+// A run searches STAKE_COINS coins over STAKE_SPAN seconds with a target
+// no attempt meets, as the coinstake search does for most of the time.
+// Reported are kernel attempts per second for the per attempt check of
+// CheckStakeKernelHash, and for the batch search with the detected lanes
+// in one thread and in all cores.
+
+static const int      STAKE_COINS = 256;
+static const uint32_t STAKE_SPAN  = 16;
+static const uint32_t STAKE_TIME  = 1600000000;
+static const uint32_t STAKE_BITS  = 0x03000001;
+
+static CBlockIndex StakeTip() {
+	CBlockIndex index;
+	index.nHeight           = 1000000;
+	index.nStakeModifier    = 0x0123456789abcdefULL;
+	index.bnStakeModifierV2 = uint256(12345);
+	return index;
+}
+
+static std::vector<CStakeCandidate> StakeCandidates() {
+	std::vector<CStakeCandidate> vCandidates;
+	for (int i = 0; i < STAKE_COINS; i++) {
+		CStakeCandidate coin;
+		coin.prevout        = COutPoint(uint256(i + 1), i % 2);
+		coin.nValue         = 1000 * COIN;
+		coin.nTimeTxPrev    = STAKE_TIME - 100000;
+		coin.nTimeBlockFrom = coin.nTimeTxPrev;
+		coin.nHeight        = 1000;
+		vCandidates.push_back(coin);
+	}
+	return vCandidates;
+}
+
+class CAttemptsPerSecond {
+	const char*                           name;
+	uint64_t                              nAttempts = 0;
+	std::chrono::steady_clock::time_point start     = std::chrono::steady_clock::now();
+
+public:
+	CAttemptsPerSecond(const char* nameIn) : name(nameIn) {}
+	void Add(uint64_t n) { nAttempts += n; }
+	~CAttemptsPerSecond() {
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cerr << name << ": " << uint64_t(nAttempts / s) << " kernels/s" << std::endl;
+	}
+};
+
+static void StakeKernelHashV2(benchmark::State& state) {
+	CBlockIndex                  indexPrev   = StakeTip();
+	std::vector<CStakeCandidate> vCandidates = StakeCandidates();
+	CBlock                       blockFrom;
+	blockFrom.nTime = vCandidates[0].nTimeBlockFrom;
+	std::vector<CTransaction> vTxPrev(STAKE_COINS);
+	for (int i = 0; i < STAKE_COINS; i++) {
+		vTxPrev[i].nTime = vCandidates[i].nTimeTxPrev;
+		vTxPrev[i].vout.resize(2);
+		vTxPrev[i].vout[vCandidates[i].prevout.n].nValue = vCandidates[i].nValue;
+	}
+
+	CAttemptsPerSecond rate("StakeKernelHashV2");
+	while (state.KeepRunning()) {
+		for (int i = 0; i < STAKE_COINS; i++) {
+			for (uint32_t n = 0; n < STAKE_SPAN; n++) {
+				uint256 hashProofOfStake, targetProofOfStake;
+				CheckStakeKernelHash(&indexPrev, STAKE_BITS, blockFrom, 0, vTxPrev[i],
+				                     vCandidates[i].prevout, STAKE_TIME - n, hashProofOfStake,
+				                     targetProofOfStake);
+			}
+		}
+		rate.Add(STAKE_COINS * STAKE_SPAN);
+	}
+}
+
+static void StakeKernelSearch(benchmark::State& state, const char* name, int nThreads) {
+	CBlockIndex                  indexPrev   = StakeTip();
+	std::vector<CStakeCandidate> vCandidates = StakeCandidates();
+	CStakeKernelContext          context(&indexPrev, STAKE_BITS);
+
+	CAttemptsPerSecond rate(name);
+	while (state.KeepRunning()) {
+		std::map<COutPoint, uint32_t> mapKernels;
+		SearchStakeKernels(context, vCandidates, STAKE_TIME, STAKE_SPAN, mapKernels, nThreads);
+		rate.Add(STAKE_COINS * STAKE_SPAN);
+	}
+}
+
+static void StakeKernelSearchOneThread(benchmark::State& state) {
+	StakeKernelSearch(state, "StakeKernelSearchOneThread", 1);
+}
+
+static void StakeKernelSearchAllCores(benchmark::State& state) {
+	StakeKernelSearch(state, "StakeKernelSearchAllCores", boost::thread::hardware_concurrency());
+}
+
+static void KernelHasherLanes(benchmark::State& state, const CKernelHasher& hasher) {
+	std::vector<uint32_t>      vMidstates(STAKE_COINS * 8, 1);
+	std::vector<unsigned char> vTails(STAKE_COINS * 12, 2);
+	std::vector<unsigned char> vHashes(STAKE_COINS * 32);
+
+	CAttemptsPerSecond rate(hasher.name);
+	while (state.KeepRunning()) {
+		hasher.hash(vMidstates.data(), vTails.data(), STAKE_COINS, vHashes.data());
+		rate.Add(STAKE_COINS);
+	}
+}
+
+static void KernelHasherScalarLanes(benchmark::State& state) {
+	KernelHasherLanes(state, KernelHasherScalar());
+}
+
+static void KernelHasherDetectedLanes(benchmark::State& state) {
+	KernelHasherLanes(state, KernelHasher());
+}
+
+BENCHMARK(StakeKernelHashV2);
+BENCHMARK(StakeKernelSearchOneThread);
+BENCHMARK(StakeKernelSearchAllCores);
+BENCHMARK(KernelHasherScalarLanes);
+BENCHMARK(KernelHasherDetectedLanes);
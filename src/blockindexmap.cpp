@@ -3,49 +3,141 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "blockindexmap.h"
+#include "main.h"
+
+CBlockIndexMap::CBlockIndexMap() {
+	rehash(16);
+	reserve(262144);
+}
+
+CBlockIndexMap::~CBlockIndexMap() {}
+
+CBlockIndex* CBlockIndexMap::allocate() {
+	return vIndexes.construct();
+}
+
+CBlockIndex* CBlockIndexMap::allocate(uint32_t nFile, uint32_t nBlockPos, CBlock& block) {
+	return vIndexes.construct(nFile, nBlockPos, block);
+}
+
+size_t CBlockIndexMap::findSlot(const uint256& hashBlock) const {
+	uint64_t nKey  = hashBlock.GetLow64();
+	size_t   nMask = vSlots.size() - 1;
+	for (size_t i = homeSlot(nKey);; i = (i + 1) & nMask) {
+		const Slot& slot = vSlots[i];
+		if (slot.nItem == NO_ITEM || (slot.nKey == nKey && vItems[slot.nItem].first == hashBlock))
+			return i;
+	}
+}
+
+uint32_t CBlockIndexMap::nextItem(uint32_t nItem) const {
+	while (nItem < vItems.size() && vItems[nItem].second == NULL)
+		nItem++;
+	return nItem;
+}
+
+void CBlockIndexMap::rehash(size_t nSlots) {
+	std::vector<Slot> vOld(nSlots, Slot{0, NO_ITEM});
+	vOld.swap(vSlots);
+	nShift = 64;
+	for (size_t n = nSlots; n > 1; n >>= 1)
+		nShift--;
+	size_t nMask = nSlots - 1;
+	for (const Slot& slot : vOld) {
+		if (slot.nItem == NO_ITEM)
+			continue;
+		size_t i = homeSlot(slot.nKey);
+		while (vSlots[i].nItem != NO_ITEM)
+			i = (i + 1) & nMask;
+		vSlots[i] = slot;
+	}
+}
+
+void CBlockIndexMap::reserve(size_t nCount) {
+	size_t nSlots = vSlots.size();
+	while (nCount * 4 > nSlots * 3)
+		nSlots *= 2;
+	if (nSlots != vSlots.size())
+		rehash(nSlots);
+}
 
 bool CBlockIndexMap::empty() const {
-	return mapBlockIndex.empty();
+	return nSize == 0;
 }
 
 size_t CBlockIndexMap::size() const {
-	return mapBlockIndex.size();
+	return nSize;
 }
 
 size_t CBlockIndexMap::count(const uint256& hashBlock) const {
-	return mapBlockIndex.count(hashBlock);
+	return vSlots[findSlot(hashBlock)].nItem != NO_ITEM;
+}
+
+CBlockIndexMap::iterator CBlockIndexMap::find(const uint256& hashBlock) {
+	uint32_t nItem = vSlots[findSlot(hashBlock)].nItem;
+	return nItem == NO_ITEM ? end() : iterator(this, nItem);
 }
 
-std::unordered_map<uint256, CBlockIndex*>::iterator CBlockIndexMap::find(const uint256& hashBlock) {
-	return mapBlockIndex.find(hashBlock);
+CBlockIndexMap::const_iterator CBlockIndexMap::find(const uint256& hashBlock) const {
+	uint32_t nItem = vSlots[findSlot(hashBlock)].nItem;
+	return nItem == NO_ITEM ? end() : const_iterator(this, nItem);
 }
 
-CBlockIndex* CBlockIndexMap::ref(const uint256& hashBlock) {
-	return mapBlockIndex[hashBlock];
+CBlockIndex* CBlockIndexMap::ref(const uint256& hashBlock) const {
+	uint32_t nItem = vSlots[findSlot(hashBlock)].nItem;
+	return nItem == NO_ITEM ? NULL : vItems[nItem].second;
 }
 
-std::unordered_map<uint256, CBlockIndex*>::const_iterator CBlockIndexMap::begin() const {
-	return mapBlockIndex.begin();
+CBlockIndexMap::const_iterator CBlockIndexMap::begin() const {
+	return const_iterator(this, nextItem(0));
 }
 
-std::unordered_map<uint256, CBlockIndex*>::const_iterator CBlockIndexMap::end() const {
-	return mapBlockIndex.end();
+CBlockIndexMap::const_iterator CBlockIndexMap::end() const {
+	return const_iterator(this, vItems.size());
 }
 
-std::unordered_map<uint256, CBlockIndex*>::iterator CBlockIndexMap::begin() {
-	return mapBlockIndex.begin();
+CBlockIndexMap::iterator CBlockIndexMap::begin() {
+	return iterator(this, nextItem(0));
 }
 
-std::unordered_map<uint256, CBlockIndex*>::iterator CBlockIndexMap::end() {
-	return mapBlockIndex.end();
+CBlockIndexMap::iterator CBlockIndexMap::end() {
+	return iterator(this, vItems.size());
 }
 
-std::pair<std::unordered_map<uint256, CBlockIndex*>::iterator, bool> CBlockIndexMap::insert(
-    const uint256& hashBlock,
-    CBlockIndex*   pindex) {
-	return mapBlockIndex.insert(std::make_pair(hashBlock, pindex));
+std::pair<CBlockIndexMap::iterator, bool> CBlockIndexMap::insert(const uint256& hashBlock,
+                                                                 CBlockIndex*   pindex) {
+	assert(pindex != NULL);
+	size_t i = findSlot(hashBlock);
+	if (vSlots[i].nItem != NO_ITEM)
+		return std::make_pair(iterator(this, vSlots[i].nItem), false);
+	if ((nSize + 1) * 4 > vSlots.size() * 3) {
+		rehash(vSlots.size() * 2);
+		i = findSlot(hashBlock);
+	}
+	uint32_t nItem = vItems.size();
+	vItems.construct(hashBlock, pindex);
+	vSlots[i] = Slot{hashBlock.GetLow64(), nItem};
+	nSize++;
+	return std::make_pair(iterator(this, nItem), true);
 }
 
 bool CBlockIndexMap::remove(const uint256& hashBlock) {
-	return mapBlockIndex.erase(hashBlock) > 0;
+	size_t i = findSlot(hashBlock);
+	if (vSlots[i].nItem == NO_ITEM)
+		return false;
+	vItems[vSlots[i].nItem].second = NULL;
+	nSize--;
+
+	// Shift back the following slots of the run which may not stay behind
+	// the hole, so that probing never stops early
+	size_t nMask = vSlots.size() - 1;
+	for (size_t j = (i + 1) & nMask; vSlots[j].nItem != NO_ITEM; j = (j + 1) & nMask) {
+		size_t nHome = homeSlot(vSlots[j].nKey);
+		if (((j - nHome) & nMask) >= ((j - i) & nMask)) {
+			vSlots[i] = vSlots[j];
+			i         = j;
+		}
+	}
+	vSlots[i].nItem = NO_ITEM;
+	return true;
 }
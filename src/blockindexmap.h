@@ -9,30 +9,138 @@
 #include "uint256.h"
 #include "util.h"
 
-#include <unordered_map>
+#include <iterator>
+#include <new>
+#include <utility>
 #include <vector>
 
+class CBlock;
 class CBlockIndex;
 
+// Objects constructed in place in slabs of SLAB_SIZE, addressed by the
+// order of construction and destroyed only with the whole slab set
+template <typename T>
+class CSlab {
+private:
+    static const size_t SLAB_SIZE = 16384;
+    std::vector<T*>     vSlabs;
+    size_t              nCount = 0;
+
+public:
+    CSlab() {}
+    CSlab(const CSlab&) = delete;
+    CSlab& operator=(const CSlab&) = delete;
+    ~CSlab() {
+        for (size_t i = 0; i < nCount; i++)
+            (*this)[i].~T();
+        for (T* pslab : vSlabs)
+            ::operator delete(pslab);
+    }
+
+    size_t size() const { return nCount; }
+    size_t capacity() const { return vSlabs.size() * SLAB_SIZE; }
+    T&     operator[](size_t n) const { return vSlabs[n / SLAB_SIZE][n % SLAB_SIZE]; }
+
+    template <typename... Args>
+    T* construct(Args&&... args) {
+        if (nCount == capacity())
+            vSlabs.push_back(static_cast<T*>(::operator new(sizeof(T) * SLAB_SIZE)));
+        T* p = new (vSlabs.back() + nCount % SLAB_SIZE) T(std::forward<Args>(args)...);
+        nCount++;
+        return p;
+    }
+};
+
+// Block hash to block index map. Entries live in a slab in the order of
+// insertion, which keeps phashBlock pointers stable and makes iteration a
+// linear walk. Lookups go through an open addressing table (linear probing)
+// of the low 64 bits of the hash and the entry number.
 class CBlockIndexMap {
+public:
+    typedef std::pair<const uint256, CBlockIndex*> value_type;
+
+    template <typename TMap, typename TValue>
+    class basic_iterator {
+    private:
+        TMap*    pmap;
+        uint32_t nItem;
+        friend class CBlockIndexMap;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef TValue                    value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef TValue*                   pointer;
+        typedef TValue&                   reference;
+
+        basic_iterator() : pmap(nullptr), nItem(0) {}
+        basic_iterator(TMap* pmapIn, uint32_t nItemIn) : pmap(pmapIn), nItem(nItemIn) {}
+        // iterator to const_iterator
+        template <typename TOtherMap, typename TOtherValue>
+        basic_iterator(const basic_iterator<TOtherMap, TOtherValue>& it)
+            : pmap(it.pmap), nItem(it.nItem) {}
+        template <typename TOtherMap, typename TOtherValue>
+        friend class basic_iterator;
+
+        TValue& operator*() const { return pmap->vItems[nItem]; }
+        TValue* operator->() const { return &pmap->vItems[nItem]; }
+        basic_iterator& operator++() {
+            nItem = pmap->nextItem(nItem + 1);
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator it = *this;
+            ++(*this);
+            return it;
+        }
+        bool operator==(const basic_iterator& it) const { return nItem == it.nItem; }
+        bool operator!=(const basic_iterator& it) const { return nItem != it.nItem; }
+    };
+    typedef basic_iterator<CBlockIndexMap, value_type>             iterator;
+    typedef basic_iterator<const CBlockIndexMap, const value_type> const_iterator;
+
 private:
-    std::unordered_map<uint256, CBlockIndex*> mapBlockIndex;
+    static const uint32_t NO_ITEM = 0xffffffff;
+
+    struct Slot {
+        uint64_t nKey;   // low 64 bits of the block hash
+        uint32_t nItem;  // NO_ITEM for a free slot
+    };
+    std::vector<Slot> vSlots;  // power of two, at most 3/4 used
+    int               nShift;  // 64 - log2 of the table size
+    size_t            nSize = 0;
+
+    // Removed entries stay in place with a NULL block index and are skipped
+    CSlab<value_type>  vItems;
+    CSlab<CBlockIndex> vIndexes;
+
+    size_t   homeSlot(uint64_t nKey) const { return (nKey * 0x9e3779b97f4a7c15ULL) >> nShift; }
+    size_t   findSlot(const uint256& hashBlock) const;
+    uint32_t nextItem(uint32_t nItem) const;
+    void     rehash(size_t nSlots);
 
 public:
-    CBlockIndexMap() { mapBlockIndex.reserve(262144); }
-    bool                                                      empty() const;
-    size_t                                                    size() const;
-    size_t                                                    count(const uint256& hashBlock) const;
-    std::unordered_map<uint256, CBlockIndex*>::const_iterator begin() const;
-    std::unordered_map<uint256, CBlockIndex*>::const_iterator end() const;
-    std::unordered_map<uint256, CBlockIndex*>::iterator       begin();
-    std::unordered_map<uint256, CBlockIndex*>::iterator       end();
-    std::unordered_map<uint256, CBlockIndex*>::iterator       find(const uint256& hashBlock);
-    CBlockIndex*                                              ref(const uint256& hashBlock);
-    std::pair<std::unordered_map<uint256, CBlockIndex*>::iterator, bool> insert(
-        const uint256& hashBlock,
-        CBlockIndex*   pindex);
-    bool remove(const uint256& hashBlock);
+    CBlockIndexMap();
+    ~CBlockIndexMap();
+
+    // A new block index, taken from a slab instead of one allocation per block
+    CBlockIndex* allocate();
+    CBlockIndex* allocate(uint32_t nFile, uint32_t nBlockPos, CBlock& block);
+
+    void                      reserve(size_t nCount);
+    bool                      empty() const;
+    size_t                    size() const;
+    size_t                    count(const uint256& hashBlock) const;
+    const_iterator            begin() const;
+    const_iterator            end() const;
+    iterator                  begin();
+    iterator                  end();
+    iterator                  find(const uint256& hashBlock);
+    const_iterator            find(const uint256& hashBlock) const;
+    // The block index of the hash, NULL if there is none
+    CBlockIndex*              ref(const uint256& hashBlock) const;
+    std::pair<iterator, bool> insert(const uint256& hashBlock, CBlockIndex* pindex);
+    bool                      remove(const uint256& hashBlock);
 };
 
 #endif
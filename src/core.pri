@@ -9,6 +9,7 @@ HEADERS += \
     $$PWD/chainparams.h \
     $$PWD/chainparamsseeds.h \
     $$PWD/checkpoints.h \
+    $$PWD/checkqueue.h \
     $$PWD/compat.h \
     $$PWD/coincontrol.h \
     $$PWD/sync.h \
@@ -25,6 +26,7 @@ HEADERS += \
     $$PWD/txdb.h \
     $$PWD/txmempool.h \
     $$PWD/script.h \
+    $$PWD/sigcache.h \
     $$PWD/init.h \
     $$PWD/mruset.h \
     $$PWD/keystore.h \
@@ -53,6 +55,7 @@ SOURCES += \
     $$PWD/netbase.cpp \
     $$PWD/key.cpp \
     $$PWD/script.cpp \
+    $$PWD/sigcache.cpp \
     $$PWD/core.cpp \
     $$PWD/main.cpp \
     $$PWD/net.cpp \
@@ -70,10 +73,12 @@ SOURCES += \
 HEADERS += \
     $$PWD/crypto/pbkdf2.h \
     $$PWD/crypto/scrypt.h \
+    $$PWD/crypto/kernelhash.h \
 
 SOURCES += \
     $$PWD/crypto/pbkdf2.cpp \
     $$PWD/crypto/scrypt.cpp \
+    $$PWD/crypto/kernelhash.cpp \
 
 INCLUDEPATH += $$PWD/rpc
 
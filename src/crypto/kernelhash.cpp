@@ -0,0 +1,219 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/kernelhash.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_HASH_X86 1
+#endif
+
+// One body serves all versions: a lane type is either uint32_t or a gcc
+// vector of uint32_t, both have the same operators. Lanes are transposed
+// on load and store, so message words of lane l are element l of a vector.
+
+#define KH_INLINE inline __attribute__((always_inline))
+
+#if defined(__GNUC__) && !defined(__clang__)
+// helpers are always inlined into the target functions, no vector crosses an ABI boundary
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+template <typename V>
+KH_INLINE V Rotr(V x, int n) {
+	return (x >> n) | (x << (32 - n));
+}
+
+template <typename V>
+KH_INLINE V Splat(uint32_t x) {
+	V v = V{};
+	return v + x;
+}
+
+template <typename V>
+KH_INLINE void Transform(V* s, V* w) {
+	V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+	for (int i = 0; i < 64; i++) {
+		if (i >= 16) {
+			V w1  = w[(i + 1) & 15];
+			V w14 = w[(i + 14) & 15];
+			w[i & 15] += (Rotr(w14, 17) ^ Rotr(w14, 19) ^ (w14 >> 10)) + w[(i + 9) & 15] +
+			             (Rotr(w1, 7) ^ Rotr(w1, 18) ^ (w1 >> 3));
+		}
+		V t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + (g ^ (e & (f ^ g))) + K[i] +
+		       w[i & 15];
+		V t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) | (c & (a | b)));
+		h    = g;
+		g    = f;
+		f    = e;
+		e    = d + t1;
+		d    = c;
+		c    = b;
+		b    = a;
+		a    = t1 + t2;
+	}
+	s[0] += a;
+	s[1] += b;
+	s[2] += c;
+	s[3] += d;
+	s[4] += e;
+	s[5] += f;
+	s[6] += g;
+	s[7] += h;
+}
+
+static inline void WriteBE32(unsigned char* p, uint32_t x) {
+	p[0] = x >> 24;
+	p[1] = x >> 16;
+	p[2] = x >> 8;
+	p[3] = x;
+}
+
+static inline uint32_t ReadBE32(const unsigned char* p) {
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+template <typename V, int N>
+KH_INLINE V Load(const uint32_t* p, int stride) {
+	uint32_t lanes[N];
+	for (int l = 0; l < N; l++)
+		lanes[l] = p[l * stride];
+	V v;
+	memcpy(&v, lanes, sizeof(v));
+	return v;
+}
+
+template <typename V, int N>
+KH_INLINE V LoadBE(const unsigned char* p, int stride) {
+	uint32_t lanes[N];
+	for (int l = 0; l < N; l++)
+		lanes[l] = ReadBE32(p + l * stride);
+	V v;
+	memcpy(&v, lanes, sizeof(v));
+	return v;
+}
+
+// N messages from their midstates and tails
+template <typename V, int N>
+KH_INLINE void HashLanes(const uint32_t*      midstates,
+                         const unsigned char* tails,
+                         unsigned char*       out) {
+	V s[8], w[16];
+	for (int i = 0; i < 8; i++)
+		s[i] = Load<V, N>(midstates + i, 8);
+	for (int i = 0; i < 3; i++)
+		w[i] = LoadBE<V, N>(tails + i * 4, 12);
+	w[3] = Splat<V>(0x80000000);
+	for (int i = 4; i < 15; i++)
+		w[i] = Splat<V>(0);
+	w[15] = Splat<V>(76 * 8);
+	Transform(s, w);
+
+	// second hash of the 32 byte digest, one padded block
+	for (int i = 0; i < 8; i++) {
+		w[i] = s[i];
+		s[i] = Splat<V>(IV[i]);
+	}
+	w[8] = Splat<V>(0x80000000);
+	for (int i = 9; i < 15; i++)
+		w[i] = Splat<V>(0);
+	w[15] = Splat<V>(32 * 8);
+	Transform(s, w);
+
+	for (int i = 0; i < 8; i++) {
+		uint32_t lanes[N];
+		memcpy(lanes, &s[i], sizeof(lanes));
+		for (int l = 0; l < N; l++)
+			WriteBE32(out + l * 32 + i * 4, lanes[l]);
+	}
+}
+
+void KernelHashMidstate(const unsigned char* block, uint32_t* midstate) {
+	uint32_t w[16];
+	for (int i = 0; i < 16; i++)
+		w[i] = ReadBE32(block + i * 4);
+	memcpy(midstate, IV, sizeof(IV));
+	Transform(midstate, w);
+}
+
+static void scalar_hash(const uint32_t*      midstates,
+                        const unsigned char* tails,
+                        int                  n,
+                        unsigned char*       out) {
+	for (int i = 0; i < n; i++)
+		HashLanes<uint32_t, 1>(midstates + i * 8, tails + i * 12, out + i * 32);
+}
+
+static const CKernelHasher hasher_scalar = {"scalar", 1, scalar_hash};
+
+#if defined(KERNEL_HASH_X86)
+
+typedef uint32_t v4u __attribute__((vector_size(16)));
+typedef uint32_t v8u __attribute__((vector_size(32)));
+
+#define KH_AVX2 __attribute__((target("avx2")))
+#define KH_SSE2 __attribute__((target("sse2")))
+
+KH_AVX2 static void avx2_hash(const uint32_t*      midstates,
+                              const unsigned char* tails,
+                              int                  n,
+                              unsigned char*       out) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		HashLanes<v8u, 8>(midstates + i * 8, tails + i * 12, out + i * 32);
+	scalar_hash(midstates + i * 8, tails + i * 12, n - i, out + i * 32);
+}
+
+KH_SSE2 static void sse2_hash(const uint32_t*      midstates,
+                              const unsigned char* tails,
+                              int                  n,
+                              unsigned char*       out) {
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		HashLanes<v4u, 4>(midstates + i * 8, tails + i * 12, out + i * 32);
+	scalar_hash(midstates + i * 8, tails + i * 12, n - i, out + i * 32);
+}
+
+static const CKernelHasher hasher_avx2 = {"avx2", 8, avx2_hash};
+static const CKernelHasher hasher_sse2 = {"sse2", 4, sse2_hash};
+
+#endif  // KERNEL_HASH_X86
+
+std::vector<const CKernelHasher*> KernelHashersAvailable() {
+	std::vector<const CKernelHasher*> hashers;
+#if defined(KERNEL_HASH_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		hashers.push_back(&hasher_avx2);
+	if (__builtin_cpu_supports("sse2"))
+		hashers.push_back(&hasher_sse2);
+#endif
+	hashers.push_back(&hasher_scalar);
+	return hashers;
+}
+
+const CKernelHasher& KernelHasher() {
+	static const CKernelHasher* hasher = KernelHashersAvailable().front();
+	return *hasher;
+}
+
+const CKernelHasher& KernelHasherScalar() {
+	return hasher_scalar;
+}
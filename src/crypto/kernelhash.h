@@ -0,0 +1,32 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITBAY_CRYPTO_KERNELHASH_H
+#define BITBAY_CRYPTO_KERNELHASH_H
+
+#include <cstdint>
+#include <vector>
+
+/** Double sha256 of 76 byte messages whose first 64 bytes are known in
+ *  advance, as the stake kernel preimage of protocol v3. The first block
+ *  is compressed once into a midstate, a hash takes the midstate and the
+ *  last 12 bytes. Multi-lane versions (AVX2 8 lanes, SSE2 4 lanes) are
+ *  selected at runtime by cpu features, all of them give the same hashes
+ *  as the scalar one.
+ */
+struct CKernelHasher {
+	const char* name;
+	int         nLanes;
+	// n messages: midstates of 8 words and tails of 12 bytes each, 32 bytes out each
+	void (*hash)(const uint32_t* midstates, const unsigned char* tails, int n, unsigned char* out);
+};
+
+// Midstate after the first 64 bytes of a message
+void KernelHashMidstate(const unsigned char* block, uint32_t* midstate);
+
+const CKernelHasher&              KernelHasher();
+const CKernelHasher&              KernelHasherScalar();
+std::vector<const CKernelHasher*> KernelHashersAvailable();
+
+#endif
@@ -0,0 +1,21 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITBAY_DBCHANGES_H
+#define BITBAY_DBCHANGES_H
+
+#include <map>
+#include <string>
+
+// Change of one db record: new serialized value or erase
+struct CDbChange {
+	bool        fErased = false;
+	std::string value;
+};
+
+// Changes keyed by serialized db key. std::string compares bytes as
+// unsigned, so the order is the order of leveldb keys.
+typedef std::map<std::string, CDbChange> DbChanges;
+
+#endif
@@ -478,7 +478,7 @@ Value prepareliquidwithdraw(const Array& params, bool fHelp) {
 			                   strprintf("Mismatch on nPartialLiquid %d", nPartialLiquid));
 		}
 
-		frBalanceLiquid.f[nSupplyEffective - 1] = nPartialLiquid;
+		frBalanceLiquid.f.Set(nSupplyEffective - 1, nPartialLiquid);
 	}
 
 	if (frBalanceLiquid.Total() < nAmountWithFee) {
@@ -963,7 +963,7 @@ Value preparereservewithdraw(const Array& params, bool fHelp) {
 			                   strprintf("Mismatch on nPartialReserve %d", nPartialReserve));
 		}
 
-		frBalanceReserve.f[nSupplyEffective] = nPartialReserve;
+		frBalanceReserve.f.Set(nSupplyEffective, nPartialReserve);
 	}
 
 	CFractions frAmount    = frBalanceReserve.RatioPart(nAmountWithFee);
@@ -102,6 +102,31 @@ uint256 SerializeHash(const T& obj, int nType = SER_GETHASH, int nVersion = PROT
 	return ss.GetHash();
 }
 
+/** Memoized hash of an object. Copies and assignments of the object start
+ *  without it, so the hash is kept only by the instance which computed it.
+ */
+class CCachedHash {
+public:
+	CCachedHash() {}
+	CCachedHash(const CCachedHash&) {}
+	CCachedHash& operator=(const CCachedHash&) {
+		fValid = false;
+		return *this;
+	}
+
+	bool           IsValid() const { return fValid; }
+	const uint256& Get() const { return hash; }
+	void           Set(const uint256& h) {
+		hash   = h;
+		fValid = true;
+	}
+	void Reset() { fValid = false; }
+
+private:
+	uint256 hash;
+	bool    fValid = false;
+};
+
 template <typename T1>
 inline uint160 Hash160(const T1 pbegin, const T1 pend) {
 	static unsigned char pblank[1];
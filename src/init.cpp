@@ -5,9 +5,11 @@
 
 #include "init.h"
 #include "chainparams.h"
+#include "kernel.h"
 #include "main.h"
 #include "net.h"
 #include "rpcserver.h"
+#include "sigcache.h"
 #include "txdb.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -102,6 +104,9 @@ void Shutdown() {
 		if (pwalletMain)
 			pwalletMain->SetBestChain(CBlockLocator(pindexBest));
 #endif
+		// write back cached address index, it is rebuilt on start otherwise
+		if (txdb)
+			CTxDB().FlushAddrIndex();
 	}
 #ifdef ENABLE_WALLET
 	if (pwalletMain)
@@ -160,7 +165,52 @@ std::string HelpMessage() {
 	strUsage +=
 		"  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n";
 	strUsage += "  -dbcache=<n>           " +
-				_("Set database cache size in megabytes (default: 50)") + "\n";
+				strprintf(_("Set database cache size in megabytes (default: %d)"),
+						  DEFAULT_DB_CACHE_SIZE) +
+				"\n";
+	strUsage += "  -pegcachesize=<n>      " +
+				_("Set decoded peg fractions cache size in megabytes (default: 64)") + "\n";
+	strUsage += "  -addrindexcache=<n>    " +
+				strprintf(_("Set address index write-back cache size in megabytes (default: %d)"),
+						  DEFAULT_ADDRINDEX_CACHE_SIZE) +
+				"\n";
+	strUsage += "  -addrdbcache=<n>       " +
+				strprintf(_("Set address index database cache size in megabytes (default: %d)"),
+						  DEFAULT_ADDRDB_CACHE_SIZE) +
+				"\n";
+	strUsage += "  -<db>dbcache=<n>       " +
+				_("Set block cache of a database in megabytes, <db> is tx, peg or addr "
+				  "(default: -dbcache, -addrdbcache)") +
+				"\n";
+	strUsage += "  -<db>dbwritebuffer=<n> " +
+				strprintf(_("Set write buffer of a database in megabytes (default: %d)"),
+						  DEFAULT_DB_WRITE_BUFFER) +
+				"\n";
+	strUsage += "  -<db>dbbloombits=<n>   " +
+				strprintf(_("Set bloom filter bits per key of a database, 0 to disable "
+							"(default: %d)"),
+						  DEFAULT_DB_BLOOM_BITS) +
+				"\n";
+	strUsage += "  -<db>dbcompression     " +
+				_("Compress database blocks when LevelDB has Snappy (default: 1)") + "\n";
+	strUsage += "  -<db>dbmaxopenfiles=<n> " +
+				strprintf(_("Limit open files of a database (default: %d)"),
+						  DEFAULT_DB_MAX_OPEN_FILES) +
+				"\n";
+	strUsage += "  -maxsigcachesize=<n>   " +
+				strprintf(_("Limit size of signature cache to <n> entries (default: %d)"),
+						  DEFAULT_MAX_SIG_CACHE_SIZE) +
+				"\n";
+	strUsage += "  -par=<n>               " +
+				strprintf(_("Set the number of script verification threads (up to %d, 0 = auto, "
+							"<0 = leave that many cores free, default: %d)"),
+						  MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS) +
+				"\n";
+	strUsage += "  -stakethreads=<n>      " +
+				strprintf(_("Set the number of kernel search threads for staking (0 = auto, "
+							"<0 = leave that many cores free, default: %d)"),
+						  DEFAULT_STAKE_SEARCH_THREADS) +
+				"\n";
 	strUsage += "  -dblogsize=<n>         " +
 				_("Set database disk log size in megabytes (default: 100)") + "\n";
 	strUsage += "  -timeout=<n>           " +
@@ -504,6 +554,27 @@ bool AppInit2(boost::thread_group& threadGroup) {
 
 	fConfChange = GetBoolArg("-confchange", false);
 
+	// DoS prevention: limit signature cache size, as there are a maximum of
+	// 20,000 signature operations per block 50,000 is a reasonable default
+	int64_t nMaxSigCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE);
+	SignatureCache().SetMaxEntries(nMaxSigCacheSize > 0 ? nMaxSigCacheSize : 0);
+
+	// -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
+	nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+	if (nScriptCheckThreads <= 0)
+		nScriptCheckThreads += boost::thread::hardware_concurrency();
+	if (nScriptCheckThreads <= 1)
+		nScriptCheckThreads = 0;
+	else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
+		nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+
+	// -stakethreads=0 means autodetect
+	nStakeSearchThreads = GetArg("-stakethreads", DEFAULT_STAKE_SEARCH_THREADS);
+	if (nStakeSearchThreads <= 0)
+		nStakeSearchThreads += boost::thread::hardware_concurrency();
+	if (nStakeSearchThreads < 1)
+		nStakeSearchThreads = 1;
+
 #ifdef ENABLE_WALLET
 	if (mapArgs.count("-mininput")) {
 		if (!ParseMoney(mapArgs["-mininput"], nMinimumInputValue))
@@ -552,6 +623,14 @@ bool AppInit2(boost::thread_group& threadGroup) {
 	LogPrintf("Used data directory %s\n", strDataDir);
 	std::ostringstream strErrors;
 
+	if (nScriptCheckThreads) {
+		LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+		for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+			threadGroup.create_thread(&ThreadScriptCheck);
+			threadGroup.create_thread(&ThreadPegReviewCheck);
+		}
+	}
+
 	if (fDaemon)
 		fprintf(stdout, "BitBay server starting\n");
 
@@ -740,8 +819,8 @@ bool AppInit2(boost::thread_group& threadGroup) {
 	if (mapArgs.count("-printblock")) {
 		string strMatch = mapArgs["-printblock"];
 		int    nFound   = 0;
-        for (unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin();
-			 mi != mapBlockIndex.end(); ++mi) {
+		for (CBlockIndexMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end();
+		     ++mi) {
 			uint256 hash = (*mi).first;
 			if (strncmp(hash.ToString().c_str(), strMatch.c_str(), strMatch.size()) == 0) {
 				CBlockIndex* pindex = (*mi).second;
@@ -840,7 +919,9 @@ bool AppInit2(boost::thread_group& threadGroup) {
 			LogPrintf("Rescanning last %i blocks (from block %i)...\n",
 					  pindexBest->nHeight - pindexRescan->nHeight, pindexRescan->nHeight);
 			nStart = GetTimeMillis();
-			pwalletMain->ScanForWalletTransactions(pindexRescan, true);
+			pwalletMain->ScanForWalletTransactions(pindexRescan, true, [](const std::string& txt) {
+				uiInterface.InitMessage(_("Rescanning...") + txt);
+			});
 			LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
 			pwalletMain->SetBestChain(CBlockLocator(pindexBest));
 			nWalletDBUpdated++;
@@ -899,6 +980,10 @@ bool AppInit2(boost::thread_group& threadGroup) {
 #endif
 
 	StartNode(threadGroup);
+
+	// Rewrite peg fractions stored with older codec, in background
+	threadGroup.create_thread(
+		boost::bind(&TraceThread<void (*)()>, "pegupgrade", &ThreadPegDBUpgrade));
 #ifdef ENABLE_WALLET
 	// InitRPCMining is needed here so getwork/getblocktemplate in the GUI debug console works
 	// properly.
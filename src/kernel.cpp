@@ -6,8 +6,11 @@
 #include <boost/assign/list_of.hpp>
 
 #include "kernel.h"
+#include "crypto/kernelhash.h"
 #include "txdb.h"
 
+#include <atomic>
+
 using namespace std;
 
 // Get time weight
@@ -355,6 +358,21 @@ static bool CheckStakeKernelHashV1(uint32_t            nBits,
 //   quantities so as to generate blocks faster, degrading the system back into
 //   a proof-of-work situation.
 //
+static uint256 StakeKernelHashV2(uint64_t         nStakeModifier,
+                                 const uint256&   bnStakeModifierV2,
+                                 uint32_t         nTimeBlockFrom,
+                                 uint32_t         nTimeTxPrev,
+                                 const COutPoint& prevout,
+                                 uint32_t         nTimeStakeTx) {
+	CDataStream ss(SER_GETHASH, 0);
+	if (IsProtocolV3(nTimeStakeTx))
+		ss << bnStakeModifierV2;
+	else
+		ss << nStakeModifier << nTimeBlockFrom;
+	ss << nTimeTxPrev << prevout.hash << prevout.n << nTimeStakeTx;
+	return Hash(ss.begin(), ss.end());
+}
+
 static bool CheckStakeKernelHashV2(CBlockIndex*        pindexPrev,
                                    uint32_t            nBits,
                                    uint32_t            nTimeBlockFrom,
@@ -384,13 +402,8 @@ static bool CheckStakeKernelHashV2(CBlockIndex*        pindexPrev,
 	int64_t  nStakeModifierTime   = pindexPrev->nTime;
 
 	// Calculate hash
-	CDataStream ss(SER_GETHASH, 0);
-	if (IsProtocolV3(nTimeStakeTx))
-		ss << bnStakeModifierV2;
-	else
-		ss << nStakeModifier << nTimeBlockFrom;
-	ss << txPrev.nTime << prevout.hash << prevout.n << nTimeStakeTx;
-	hashProofOfStake = Hash(ss.begin(), ss.end());
+	hashProofOfStake = StakeKernelHashV2(nStakeModifier, bnStakeModifierV2, nTimeBlockFrom,
+	                                     txPrev.nTime, prevout, nTimeStakeTx);
 
 	if (fPrintProofOfStake) {
 		LogPrintf(
@@ -549,3 +562,187 @@ bool CheckKernel(CBlockIndex*     pindexPrev,
 	                            txindex.pos.nTxPos - txindex.pos.nBlockPos, txPrev, prevout,
 	                            nStakeTime, hashProofOfStake, targetProofOfStake);
 }
+
+CStakeKernelContext::CStakeKernelContext(const CBlockIndex* pindexPrev, uint32_t nBitsIn) {
+	nHeightPrev       = pindexPrev->nHeight;
+	nBits             = nBitsIn;
+	nStakeModifier    = pindexPrev->nStakeModifier;
+	bnStakeModifierV2 = pindexPrev->bnStakeModifierV2;
+	nMaxDepth         = Params().MinStakeConfirmations(pindexPrev->nHeight) - 1;
+}
+
+uint256 GetStakeKernelTarget(uint32_t nBits, int64_t nValue) {
+	CBigNum bnTarget;
+	bnTarget.SetCompact(nBits);
+	bnTarget *= CBigNum(nValue);
+	// any hash meets a target beyond 256 bits
+	if (bnTarget.bitSize() > 256)
+		return ~uint256(0);
+	return bnTarget.getuint256();
+}
+
+// Min age requirement, as in CheckKernel()
+static bool IsStakeCandidateMature(const CStakeKernelContext& context,
+                                   const CStakeCandidate&     coin,
+                                   uint32_t                   nTimeStakeTx) {
+	if (nTimeStakeTx < coin.nTimeTxPrev)
+		return false;
+	if (IsProtocolV3(nTimeStakeTx))
+		return context.nHeightPrev - coin.nHeight >= context.nMaxDepth;
+	return coin.nTimeBlockFrom + nStakeMinAge <= nTimeStakeTx;
+}
+
+bool CheckStakeCandidate(const CStakeKernelContext& context,
+                         const CStakeCandidate&     coin,
+                         const uint256&             targetProofOfStake,
+                         uint32_t                   nTimeStakeTx,
+                         uint256&                   hashProofOfStake) {
+	if (!IsStakeCandidateMature(context, coin, nTimeStakeTx))
+		return false;
+
+	hashProofOfStake =
+	    StakeKernelHashV2(context.nStakeModifier, context.bnStakeModifierV2, coin.nTimeBlockFrom,
+	                      coin.nTimeTxPrev, coin.prevout, nTimeStakeTx);
+	return !(hashProofOfStake > targetProofOfStake);
+}
+
+int nStakeSearchThreads = 1;
+
+// Attempts hashed per call of the kernel hasher
+static const int STAKE_SEARCH_BATCH = 256;
+// Attempts a search thread is started for at least
+static const size_t STAKE_SEARCH_PER_THREAD = 4096;
+
+// Searches candidates [nBegin, nEnd), offsets of found kernels go to vOffsets
+static void SearchStakeKernelsRange(const CStakeKernelContext&     context,
+                                    const vector<CStakeCandidate>& vCandidates,
+                                    size_t                         nBegin,
+                                    size_t                         nEnd,
+                                    uint32_t                       nTimeStakeTx,
+                                    uint32_t                       nSearchSpan,
+                                    vector<int>&                   vOffsets,
+                                    const atomic<bool>&            fStop) {
+	// before v3 the preimage has no constant first block, check one by one
+	if (!IsProtocolV3(nTimeStakeTx - nSearchSpan + 1)) {
+		for (size_t i = nBegin; i < nEnd && !fStop; i++) {
+			uint256 targetProofOfStake = GetStakeKernelTarget(context.nBits, vCandidates[i].nValue);
+			for (uint32_t n = 0; n < nSearchSpan; n++) {
+				uint256 hashProofOfStake;
+				if (CheckStakeCandidate(context, vCandidates[i], targetProofOfStake,
+				                        nTimeStakeTx - n, hashProofOfStake)) {
+					vOffsets[i] = n;
+					break;
+				}
+			}
+		}
+		return;
+	}
+
+	const CKernelHasher&  hasher = KernelHasher();
+	vector<uint32_t>      vMidstates(STAKE_SEARCH_BATCH * 8);
+	vector<unsigned char> vTails(STAKE_SEARCH_BATCH * 12);
+	vector<unsigned char> vHashes(STAKE_SEARCH_BATCH * 32);
+	vector<size_t>        vAttemptCoin(STAKE_SEARCH_BATCH);
+	vector<uint32_t>      vAttemptOffset(STAKE_SEARCH_BATCH);
+	vector<uint256>       vTargets(nEnd - nBegin);
+	int                   nAttempts = 0;
+
+	// attempts of a coin are queued by growing offset, the first hit is kept
+	auto fnHashAttempts = [&]() {
+		hasher.hash(vMidstates.data(), vTails.data(), nAttempts, vHashes.data());
+		for (int j = 0; j < nAttempts; j++) {
+			size_t i = vAttemptCoin[j];
+			if (vOffsets[i] >= 0)
+				continue;
+			uint256 hashProofOfStake;
+			memcpy(hashProofOfStake.begin(), &vHashes[j * 32], 32);
+			if (!(hashProofOfStake > vTargets[i - nBegin]))
+				vOffsets[i] = vAttemptOffset[j];
+		}
+		nAttempts = 0;
+	};
+
+	// preimage: modifier, txPrev time, prevout hash, prevout n, stake time
+	unsigned char preimage[76];
+	memcpy(preimage, &context.bnStakeModifierV2, 32);
+	for (size_t i = nBegin; i < nEnd && !fStop; i++) {
+		const CStakeCandidate& coin = vCandidates[i];
+		if (!IsStakeCandidateMature(context, coin, nTimeStakeTx - nSearchSpan + 1) ||
+		    !IsStakeCandidateMature(context, coin, nTimeStakeTx)) {
+			// maturity changes within the window, check one by one
+			uint256 targetProofOfStake = GetStakeKernelTarget(context.nBits, coin.nValue);
+			for (uint32_t n = 0; n < nSearchSpan; n++) {
+				uint256 hashProofOfStake;
+				if (CheckStakeCandidate(context, coin, targetProofOfStake, nTimeStakeTx - n,
+				                        hashProofOfStake)) {
+					vOffsets[i] = n;
+					break;
+				}
+			}
+			continue;
+		}
+
+		vTargets[i - nBegin] = GetStakeKernelTarget(context.nBits, coin.nValue);
+		memcpy(preimage + 32, &coin.nTimeTxPrev, 4);
+		memcpy(preimage + 36, &coin.prevout.hash, 32);
+		memcpy(preimage + 68, &coin.prevout.n, 4);
+		uint32_t midstate[8];
+		KernelHashMidstate(preimage, midstate);
+
+		for (uint32_t n = 0; n < nSearchSpan; n++) {
+			uint32_t nTime = nTimeStakeTx - n;
+			memcpy(preimage + 72, &nTime, 4);
+			memcpy(&vMidstates[nAttempts * 8], midstate, sizeof(midstate));
+			memcpy(&vTails[nAttempts * 12], preimage + 64, 12);
+			vAttemptCoin[nAttempts]   = i;
+			vAttemptOffset[nAttempts] = n;
+			if (++nAttempts == STAKE_SEARCH_BATCH) {
+				boost::this_thread::interruption_point();
+				fnHashAttempts();
+			}
+		}
+	}
+	if (nAttempts)
+		fnHashAttempts();
+}
+
+void SearchStakeKernels(const CStakeKernelContext&     context,
+                        const vector<CStakeCandidate>& vCandidates,
+                        uint32_t                       nTimeStakeTx,
+                        uint32_t                       nSearchSpan,
+                        map<COutPoint, uint32_t>&      mapKernels,
+                        int                            nThreads) {
+	if (vCandidates.empty() || nSearchSpan == 0)
+		return;
+
+	vector<int>  vOffsets(vCandidates.size(), -1);
+	atomic<bool> fStop(false);
+	size_t       nWork    = vCandidates.size() * nSearchSpan / STAKE_SEARCH_PER_THREAD;
+	size_t       nWorkers = max<size_t>(1, min<size_t>(max(nThreads, 1), nWork));
+	size_t       nSlice   = (vCandidates.size() + nWorkers - 1) / nWorkers;
+
+	boost::thread_group threads;
+	for (size_t t = 1; t < nWorkers; t++) {
+		size_t nBegin = min(vCandidates.size(), t * nSlice);
+		size_t nEnd   = min(vCandidates.size(), nBegin + nSlice);
+		threads.create_thread([&, nBegin, nEnd]() {
+			SearchStakeKernelsRange(context, vCandidates, nBegin, nEnd, nTimeStakeTx, nSearchSpan,
+			                        vOffsets, fStop);
+		});
+	}
+	try {
+		SearchStakeKernelsRange(context, vCandidates, 0, min(vCandidates.size(), nSlice),
+		                        nTimeStakeTx, nSearchSpan, vOffsets, fStop);
+	} catch (...) {
+		// workers use our stack, stop them before leaving
+		fStop = true;
+		threads.join_all();
+		throw;
+	}
+	threads.join_all();
+
+	for (size_t i = 0; i < vCandidates.size(); i++) {
+		if (vOffsets[i] >= 0)
+			mapKernels[vCandidates[i].prevout] = vOffsets[i];
+	}
+}
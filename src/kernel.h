@@ -59,4 +59,54 @@ bool CheckKernel(CBlockIndex*     pindexPrev,
                  const COutPoint& prevout,
                  int64_t*         pBlockTime = NULL);
 
+// Kernel input of a staking coin, taken from wallet and block index
+// so that the kernel search needs no disk reads
+struct CStakeCandidate {
+	COutPoint          prevout;
+	int64_t            nValue         = 0;
+	uint32_t           nTimeTxPrev    = 0;
+	uint32_t           nTimeBlockFrom = 0;
+	int                nHeight        = 0;  // height of the confirming block
+	const CBlockIndex* pindexFrom     = nullptr;
+};
+
+// Tip state of a kernel search, copied under cs_main so that candidates
+// can be checked without holding locks (protocol v2 kernels only)
+struct CStakeKernelContext {
+	int      nHeightPrev    = 0;
+	uint32_t nBits          = 0;
+	uint64_t nStakeModifier = 0;
+	uint256  bnStakeModifierV2;
+	int      nMaxDepth      = 0;  // coins confirmed within are too young
+
+	CStakeKernelContext() {}
+	CStakeKernelContext(const CBlockIndex* pindexPrev, uint32_t nBits);
+};
+
+// Weighted kernel target of a coin value, saturated at 2^256-1
+uint256 GetStakeKernelTarget(uint32_t nBits, int64_t nValue);
+
+// Same result as CheckKernel() for a protocol v2 tip, with the weighted
+// target precomputed by GetStakeKernelTarget()
+bool CheckStakeCandidate(const CStakeKernelContext& context,
+                         const CStakeCandidate&     coin,
+                         const uint256&             targetProofOfStake,
+                         uint32_t                   nTimeStakeTx,
+                         uint256&                   hashProofOfStake);
+
+// Kernel search threads (-stakethreads)
+static const int DEFAULT_STAKE_SEARCH_THREADS = 1;
+extern int       nStakeSearchThreads;
+
+// Checks each candidate over nSearchSpan seconds back from nTimeStakeTx and
+// sets the time offset of the first kernel of each coin having one.
+// Protocol v3 attempts are hashed in cpu lanes from per coin midstates,
+// large searches are split over nThreads threads.
+void SearchStakeKernels(const CStakeKernelContext&          context,
+                        const std::vector<CStakeCandidate>& vCandidates,
+                        uint32_t                            nTimeStakeTx,
+                        uint32_t                            nSearchSpan,
+                        std::map<COutPoint, uint32_t>&      mapKernels,
+                        int                                 nThreads = 1);
+
 #endif  // PPCOIN_KERNEL_H
@@ -13,11 +13,13 @@
 #include "blockindexmap.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "db.h"
 #include "init.h"
 #include "kernel.h"
 #include "net.h"
 #include "peg.h"
+#include "pegcycle.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -52,6 +54,12 @@ CCriticalSection cs_main;
 
 CTxMemPool mempool;
 
+std::atomic<uint64_t> nTxHashesComputed(0);
+std::atomic<uint64_t> nBlockHashesComputed(0);
+
+int                              nScriptCheckThreads = 0;
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
 CBlockIndexMap                 mapBlockIndex;
 set<pair<COutPoint, uint32_t>> setStakeSeen;
 
@@ -255,6 +263,25 @@ uint32_t LimitOrphanTxSize(uint32_t nMaxOrphans) {
 // CTransaction and CTxIndex
 //
 
+uint256 CTransaction::ComputeHash() const {
+	nTxHashesComputed++;
+	return SerializeHash(*this);
+}
+
+bool CScriptCheck::operator()() const {
+	const CTransaction& txTo = *ptxTo;
+	set<vchtype>        sSignedPubks;
+	if (!VerifySignature(txoutFrom, txTo, nIn, nFlags, 0, sSignedPubks))
+		return error("CScriptCheck() : %s VerifySignature failed on input %u",
+		             txTo.GetHash().ToString(), nIn);
+	return true;
+}
+
+void ThreadScriptCheck() {
+	RenameThread("bitbay-scriptch");
+	scriptcheckqueue.Thread();
+}
+
 bool CTransaction::ReadFromDisk(CTxDB& txdb, COutPoint prevout, CTxIndex& txindexRet) {
 	SetNull();
 	if (!txdb.ReadTxIndex(prevout.hash, txindexRet))
@@ -510,7 +537,7 @@ int CMerkleTx::SetMerkleBranch(const CBlock* pblock) {
 	vMerkleBranch = pblock->GetMerkleBranch(nIndex);
 
 	// Is the tx in a block that's in the main chain
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 	if (mi == mapBlockIndex.end())
 		return 0;
 	CBlockIndex* pindex = (*mi).second;
@@ -667,6 +694,7 @@ bool AcceptToMemoryPool(CTxMemPool&   pool,
 	MapPrevOut             mapPrevOuts;
 	MapFractions           mapOutputsFractions;
 	CFractions             feesFractions;
+	CTxMemPoolEntry        entry;
 	int                    nBridgePoolNout        = pindexBest->nHeight;
 	bool                   fBridgePoolFromChanges = false;  // read from disk
 	int64_t                nVirtBlockTime         = GetAdjustedTime();
@@ -675,16 +703,15 @@ bool AcceptToMemoryPool(CTxMemPool&   pool,
 		CTxDB  txdb("r");
 		CPegDB pegdb("r");
 
-		map<string, CBridgeInfo> bridges;
-		if (!pindexBest->ReadBridges(pegdb, bridges))
+		CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindexBest);
+		if (!cycle->fBridges)
 			return error("AcceptToMemoryPool : bridges read error");
-		auto fnMerkleIn = [&](string hash) {
-			CMerkleInfo m = pindexBest->ReadMerkleIn(pegdb, hash);
-			return m;
-		};
-		set<string> timelockpasses;
-		if (!pindexBest->ReadTimeLockPasses(pegdb, timelockpasses))
+		if (!cycle->fTimeLockPasses)
 			return error("AcceptToMemoryPool : timelockpasses read error");
+		const map<string, CBridgeInfo>& bridges        = cycle->bridges;
+		const set<string>&              timelockpasses = cycle->timelockpasses;
+
+		auto fnMerkleIn = [&](string hash) { return cycle->MerkleIn(pegdb, hash); };
 
 		// do we already have it?
 		if (txdb.ContainsTx(hash))
@@ -802,10 +829,31 @@ bool AcceptToMemoryPool(CTxMemPool&   pool,
 			    "MANDATORY but not STANDARD flags %s",
 			    hash.ToString());
 		}
+
+		// Inputs taken for priority now, block assembly does not read them
+		entry = CTxMemPoolEntry(nFees, nSize);
+		for (const CTxIn& txin : tx.vin) {
+			if (tx.IsCoinMint()) {
+				// for CoinMint nTime is set as merkle height +1
+				if (txin.prevout.hash != 0)
+					entry.AddChainInput(tx.vout[0].nValue + MINT_TX_FEE, tx.nTime + 1);
+				continue;
+			}
+			const CTxIndex&     txindex = mapInputs[txin.prevout.hash].first;
+			const CTransaction& txPrev  = mapInputs[txin.prevout.hash].second;
+			if (txindex.pos.IsNull() || txindex.pos == CDiskTxPos(1, 1, 1))
+				continue;
+			// indexes of older versions were written without the height
+			int64_t nHeight = txindex.nHeight;
+			if (nHeight <= 0)
+				nHeight = txindex.GetHeightInMainChain();
+			if (nHeight > 0)
+				entry.AddChainInput(txPrev.vout[txin.prevout.n].nValue, nHeight);
+		}
 	}
 
 	// Store transaction in memory
-	pool.addUnchecked(hash, tx, mapPrevOuts, mapOutputsFractions);
+	pool.addUnchecked(hash, tx, mapPrevOuts, mapOutputsFractions, entry);
 
 	SyncWithWallets(tx, NULL, true, mapOutputsFractions);
 
@@ -826,7 +874,7 @@ int CMerkleTx::GetBlockNumInMainChainINTERNAL(CBlockIndex*& pindexRet) const {
 	AssertLockHeld(cs_main);
 
 	// Find the block it claims to be in
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 	if (mi == mapBlockIndex.end())
 		return 0;
 	CBlockIndex* pindex = (*mi).second;
@@ -850,7 +898,7 @@ int CMerkleTx::GetDepthInMainChainINTERNAL(CBlockIndex*& pindexRet) const {
 	AssertLockHeld(cs_main);
 
 	// Find the block it claims to be in
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 	if (mi == mapBlockIndex.end())
 		return 0;
 	CBlockIndex* pindex = (*mi).second;
@@ -922,7 +970,7 @@ int CTxIndex::GetDepthInMainChain() const {
 	if (!block.ReadFromDisk(pos.nFile, pos.nBlockPos, false))
 		return 0;
 	// Find the block in the index
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(block.GetHash());
 	if (mi == mapBlockIndex.end())
 		return 0;
 	CBlockIndex* pindex = (*mi).second;
@@ -946,7 +994,7 @@ int CTxIndex::GetHeightInMainChain(uint32_t* vtxidx, uint256 txhash, uint256* bl
 	uint256 bhash = block.GetHash();
 	if (blockhash)
 		*blockhash = bhash;
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(bhash);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(bhash);
 	if (mi == mapBlockIndex.end())
 		return 0;
 	CBlockIndex* pindex = (*mi).second;
@@ -982,24 +1030,74 @@ bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock) {
 // CBlock and CBlockIndex
 //
 
-static CBlockIndex* pblockindexFBBHLast;
-CBlockIndex*        FindBlockByHeight(int nHeight) {
-    CBlockIndex* pblockindex;
-    if (nHeight > nBestHeight)
-        return NULL;
-    if (nHeight < nBestHeight / 2)
-        pblockindex = pindexGenesisBlock;
-    else
-        pblockindex = pindexBest;
-    if (pblockindexFBBHLast &&
-        abs(nHeight - pblockindex->nHeight) > abs(nHeight - pblockindexFBBHLast->nHeight))
-        pblockindex = pblockindexFBBHLast;
-    while (pblockindex->nHeight > nHeight)
-        pblockindex = pblockindex->Prev();
-    while (pblockindex->nHeight < nHeight)
-        pblockindex = pblockindex->Next();
-    pblockindexFBBHLast = pblockindex;
-    return pblockindex;
+CChain chainActive;
+
+void CChain::SetTip(CBlockIndex* pindex) {
+	if (pindex == NULL) {
+		vChain.clear();
+		return;
+	}
+	vChain.resize(pindex->nHeight + 1);
+	while (pindex && vChain[pindex->nHeight] != pindex) {
+		vChain[pindex->nHeight] = pindex;
+		pindex                  = pindex->Prev();
+	}
+}
+
+CBlockIndex* FindBlockByHeight(int nHeight) {
+	if (nHeight > nBestHeight)
+		return NULL;
+	return chainActive[nHeight];
+}
+
+// Turn the lowest '1' bit in the binary representation of a number into a '0'.
+static inline int InvertLowestOne(int n) {
+	return n & (n - 1);
+}
+
+// Compute what height to jump back to with the skip pointer. Any number
+// strictly lower than height is acceptable, but the following expression
+// performs well in simulations (max 110 steps to go back up to 2**18 blocks).
+static inline int GetSkipHeight(int height) {
+	if (height < 2)
+		return 0;
+	return (height & 1) ? InvertLowestOne(InvertLowestOne(height - 1)) + 1
+	                    : InvertLowestOne(height);
+}
+
+CBlockIndex* CBlockIndex::GetAncestor(int nAncestorHeight) {
+	if (nAncestorHeight > nHeight || nAncestorHeight < 0)
+		return NULL;
+
+	CBlockIndex* pindexWalk = this;
+	int          heightWalk = nHeight;
+	while (heightWalk > nAncestorHeight) {
+		int heightSkip     = GetSkipHeight(heightWalk);
+		int heightSkipPrev = GetSkipHeight(heightWalk - 1);
+		if (pindexWalk->pSkip != NULL &&
+		    (heightSkip == nAncestorHeight ||
+		     (heightSkip > nAncestorHeight &&
+		      !(heightSkipPrev < heightSkip - 2 && heightSkipPrev >= nAncestorHeight)))) {
+			// Only follow pSkip if Prev()->pSkip isn't better than pSkip->Prev().
+			pindexWalk = pindexWalk->pSkip;
+			heightWalk = heightSkip;
+		} else {
+			if (!pindexWalk->Prev())
+				return NULL;
+			pindexWalk = pindexWalk->Prev();
+			heightWalk--;
+		}
+	}
+	return pindexWalk;
+}
+
+const CBlockIndex* CBlockIndex::GetAncestor(int nAncestorHeight) const {
+	return const_cast<CBlockIndex*>(this)->GetAncestor(nAncestorHeight);
+}
+
+void CBlockIndex::BuildSkip() {
+	if (pPrev)
+		pSkip = pPrev->GetAncestor(GetSkipHeight(nHeight));
 }
 
 bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions) {
@@ -1009,6 +1107,7 @@ bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions) {
 	}
 	if (!ReadFromDisk(pindex->nFile, pindex->nBlockPos, fReadTransactions))
 		return false;
+	CacheHashes();
 	if (GetHash() != pindex->GetBlockHash())
 		return error("CBlock::ReadFromDisk() : GetHash() doesn't match index");
 	return true;
@@ -1459,7 +1558,7 @@ bool CTransaction::FetchInputs(CTxDB&                                  txdb,
                                CPegDB&                                 pegdb,
                                int                                     nBridgePoolNout,
                                bool                                    fBridgePoolMustInTestPool,
-                               const map<string, CBridgeInfo>          bridges,
+                               const map<string, CBridgeInfo>&         bridges,
                                std::function<CMerkleInfo(std::string)> fnMerkleIn,
                                const map<uint256, CTxIndex>&           mapTestPool,
                                const MapFractions&                     mapTestFractionsPool,
@@ -1469,7 +1568,8 @@ bool CTransaction::FetchInputs(CTxDB&                                  txdb,
                                bool                                    fSkipPruned,
                                MapPrevTx&                              inputsRet,
                                MapFractions&                           finputsRet,
-                               bool&                                   fInvalid) {
+                               bool&                                   fInvalid,
+                               const CPrefetchedInputs*                pPrefetched) {
 	// FetchInputs can return false either because we just haven't seen some inputs
 	// (in which case the transaction should be stored as an orphan)
 	// or because the transaction is malformed (in which case the transaction should
@@ -1653,6 +1753,9 @@ bool CTransaction::FetchInputs(CTxDB&                                  txdb,
 		if ((fBlock || fMiner) && mapTestPool.count(prevout.hash)) {
 			// Get txindex from current proposed changes
 			txindex = mapTestPool.find(prevout.hash)->second;
+		} else if (pPrefetched && pPrefetched->mapPrevTx.count(prevout.hash)) {
+			// Get txindex read ahead for the block
+			txindex = pPrefetched->mapPrevTx.find(prevout.hash)->second.first;
 		} else {
 			// Read txindex from txdb
 			fFound = txdb.ReadTxIndex(prevout.hash, txindex);
@@ -1681,6 +1784,9 @@ bool CTransaction::FetchInputs(CTxDB&                                  txdb,
 				// the prev is in same block as the current tx
 				txPrev.nTimeFetched = nBlockTime;
 			}
+		} else if (pPrefetched && pPrefetched->mapPrevTx.count(prevout.hash)) {
+			// Get prev tx read ahead for the block, nTimeFetched is known
+			txPrev = pPrefetched->mapPrevTx.find(prevout.hash)->second.second;
 		} else {
 			// Get prev tx from disk
 			if (!txPrev.ReadFromDisk(txindex.pos))
@@ -1726,6 +1832,9 @@ bool CTransaction::FetchInputs(CTxDB&                                  txdb,
 		if ((fBlock || fMiner) && mapTestFractionsPool.count(fkey)) {
 			// Get fractions from current proposed changes
 			fractions = mapTestFractionsPool.find(fkey)->second;
+		} else if (pPrefetched && pPrefetched->mapFractions.count(fkey)) {
+			// Get fractions read ahead for the block
+			fractions = pPrefetched->mapFractions.find(fkey)->second;
 		} else {
 			// Know the height
 			bool fMustHaveFractions = false;
@@ -1792,15 +1901,16 @@ bool CTransaction::ConnectInputs(MapPrevTx                          inputs,
                                  map<uint256, CTxIndex>&            mapTestPool,
                                  MapFractions&                      mapTestFractionsPool,
                                  int                                nBridgePoolNout,
-                                 const map<string, CBridgeInfo>     bridges,
+                                 const map<string, CBridgeInfo>&    bridges,
                                  std::function<CMerkleInfo(string)> fnMerkleIn,
-                                 const set<string>                  timelockpasses,
+                                 const set<string>&                 timelockpasses,
                                  CFractions&                        feesFractions,
                                  const CDiskTxPos&                  posThisTx,
                                  const CBlockIndex*                 pindexBlock,
                                  bool                               fBlock,
                                  bool                               fMiner,
-                                 uint32_t                           flags) {
+                                 uint32_t                           flags,
+                                 std::vector<CScriptCheck>*         pvChecks) {
 	// Take over previous transactions' spent pointers
 	// fBlock is true when this is called from AcceptBlock when a new best-block is added to the
 	// blockchain fMiner is true when called from the internal bitcoin miner
@@ -1870,6 +1980,24 @@ bool CTransaction::ConnectInputs(MapPrevTx                          inputs,
 		}
 	}
 
+	// Pubkeys of timelock passes, as signed pubkeys of the inputs using them
+	// are needed for fractions calculation and these can not be deferred
+	vector<vchtype> vTimeLockPassPubks;
+	if (pvChecks) {
+		for (const string& pubkey_txt : timelockpasses) {
+			vTimeLockPassPubks.push_back(ParseHex(pubkey_txt));
+		}
+	}
+	auto fnUsesTimeLockPass = [&](const CScript& script) {
+		for (const vchtype& pubkey : vTimeLockPassPubks) {
+			if (!pubkey.empty() &&
+			    std::search(script.begin(), script.end(), pubkey.begin(), pubkey.end()) !=
+			        script.end())
+				return true;
+		}
+		return false;
+	};
+
 	// Collect used pubkeys per inputs
 	CPegDB                      pegdb("r");
 	map<uint32_t, set<vchtype>> mInputSignedPubks;
@@ -1897,8 +2025,17 @@ bool CTransaction::ConnectInputs(MapPrevTx                          inputs,
 			// before the last blockchain checkpoint. This is safe because block merkle hashes are
 			// still computed and checked, and any change will be caught at the next checkpoint.
 			if (!(fBlock && (nBestHeight < Checkpoints::GetTotalBlocksEstimate()))) {
+				const CTxOut& txoutPrev = txPrev.vout[prevout.n];
+				if (pvChecks && !fnUsesTimeLockPass(vin[i].scriptSig) &&
+				    !fnUsesTimeLockPass(txoutPrev.scriptPubKey)) {
+					// Signed pubkeys are not used, verify later in parallel
+					if (prevout.hash != txPrev.GetHash())
+						return DoS(100, error("ConnectInputs() : %s VerifySignature failed",
+						                      GetHash().ToString()));
+					pvChecks->push_back(CScriptCheck(txoutPrev, *this, i, flags));
+				}
 				// Verify signature
-				if (!VerifySignature(txPrev, *this, i, flags, 0, sSignedPubks)) {
+				else if (!VerifySignature(txPrev, *this, i, flags, 0, sSignedPubks)) {
 					if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
 						// Check whether the failure was caused by a
 						// non-mandatory script verification check, such as
@@ -1981,20 +2118,55 @@ bool CTransaction::ConnectInputs(MapPrevTx                          inputs,
 	return true;
 }
 
-static void CreateUtxoHistoryRecord(CTxDB&                        txdb,
-                                    string                        sAddress,
-                                    uint64_t                      nTime,
-                                    uint64_t                      nHeight,
-                                    int64_t                       nIndex,
-                                    uint256                       txhash,
-                                    map<string, CAddressBalance>& mapAddressesBalances,
-                                    map<string, int64_t>&         mapAddressesBalancesIdxs) {
-	if (mapAddressesBalances.count(sAddress))
+bool CAddressKey::Set(const CTxDestination& dest) {
+	if (const CKeyID* id = boost::get<CKeyID>(&dest)) {
+		nVersion = Params().Base58Prefix(CChainParams::PUBKEY_ADDRESS)[0];
+		hash     = *id;
+		return true;
+	}
+	if (const CScriptID* id = boost::get<CScriptID>(&dest)) {
+		nVersion = Params().Base58Prefix(CChainParams::SCRIPT_ADDRESS)[0];
+		hash     = *id;
+		return true;
+	}
+	return false;
+}
+
+bool CAddressKey::SetString(const std::string& sAddress) {
+	CBitcoinAddress address(sAddress);
+	return address.IsValid() && Set(address.Get());
+}
+
+std::string CAddressKey::ToString() const {
+	if (nVersion == Params().Base58Prefix(CChainParams::PUBKEY_ADDRESS)[0])
+		return CBitcoinAddress(CKeyID(hash)).ToString();
+	return CBitcoinAddress(CScriptID(hash)).ToString();
+}
+
+void CAddressKey::Append(std::string& key) const {
+	key.push_back(char(nVersion));
+	key.append((const char*)&hash, 20);
+}
+
+void CAddressKey::Read(const char* p) {
+	nVersion = (unsigned char)p[0];
+	memcpy(&hash, p + 1, 20);
+}
+
+static void CreateUtxoHistoryRecord(CTxDB&                             txdb,
+                                    const CAddressKey&                 address,
+                                    uint64_t                           nTime,
+                                    uint64_t                           nHeight,
+                                    int64_t                            nIndex,
+                                    uint256                            txhash,
+                                    map<CAddressKey, CAddressBalance>& mapAddressesBalances,
+                                    map<CAddressKey, int64_t>&         mapAddressesBalancesIdxs) {
+	if (mapAddressesBalances.count(address))
 		return;  // already present
 	int64_t          nLastIndex = -1;
-	CAddressBalance& balance    = mapAddressesBalances[sAddress];
-	txdb.ReadAddressLastBalance(sAddress, balance, nLastIndex);
-	mapAddressesBalancesIdxs[sAddress] = nLastIndex + 1;
+	CAddressBalance& balance    = mapAddressesBalances[address];
+	txdb.ReadAddressLastBalance(address, balance, nLastIndex);
+	mapAddressesBalancesIdxs[address] = nLastIndex + 1;
 	balance.nTime                      = nTime;
 	balance.nHeight                    = nHeight;
 	balance.nIndex                     = nIndex;
@@ -2009,9 +2181,9 @@ bool CTransaction::ConnectUtxo(CTxDB&             txdb,
                                MapPrevTx&         mapInputs,
                                MapFractions&      mapInputsFractions,
                                MapFractions&      mapOutputsFractions) const {
-	auto                         txhash = GetHash();
-	map<string, int64_t>         mapAddressesBalancesIdxs;
-	map<string, CAddressBalance> mapAddressesBalances;
+	auto                              txhash = GetHash();
+	map<CAddressKey, int64_t>         mapAddressesBalancesIdxs;
+	map<CAddressKey, CAddressBalance> mapAddressesBalances;
 
 	bool isStakeFrozen = false;
 
@@ -2030,8 +2202,8 @@ bool CTransaction::ConnectUtxo(CTxDB&             txdb,
 		CTxDestination dst;
 		if (!ExtractDestination(txout.scriptPubKey, dst))
 			continue;
-		string sAddress = CBitcoinAddress(dst).ToString();
-		if (sAddress.size() != 34)
+		CAddressKey address;
+		if (!address.Set(dst))
 			continue;
 
 		auto        txoutid = uint320(prevout.hash, prevout.n);
@@ -2056,20 +2228,20 @@ bool CTransaction::ConnectUtxo(CTxDB&             txdb,
 		}
 		// remove spent or frozen
 		CAddressUnspent unspent;
-		if (txdb.ReadUnspent(sAddress, txoutid, unspent)) {
-			if (!txdb.DeductSpent(sAddress, fractions, unspent.nHeight >= nPegStartHeight))
+		if (txdb.ReadUnspent(address, txoutid, unspent)) {
+			if (!txdb.DeductSpent(address, fractions, unspent.nHeight >= nPegStartHeight))
 				return error("ConnectUtxo() : DeductSpent");
-			if (!txdb.EraseUnspent(sAddress, txoutid))
+			if (!txdb.EraseUnspent(address, txoutid))
 				return error("ConnectUtxo() : EraseUnspent");
 		} else {
-			if (!txdb.EraseFrozen(sAddress, txoutid))
+			if (!txdb.EraseFrozen(address, txoutid))
 				return error("ConnectUtxo() : EraseFrozen");
 		}
 		// make a record if not ready
-		CreateUtxoHistoryRecord(txdb, sAddress, pindex->nTime, pindex->nHeight, nTxIdx, txhash,
+		CreateUtxoHistoryRecord(txdb, address, pindex->nTime, pindex->nHeight, nTxIdx, txhash,
 		                        mapAddressesBalances, mapAddressesBalancesIdxs);
 		// credit record
-		CAddressBalance& balance = mapAddressesBalances[sAddress];
+		CAddressBalance& balance = mapAddressesBalances[address];
 		balance.nCredit += txout.nValue;
 		if (frozen)
 			balance.nFrozen -= txout.nValue;
@@ -2080,8 +2252,8 @@ bool CTransaction::ConnectUtxo(CTxDB&             txdb,
 		CTxDestination dst;
 		if (!ExtractDestination(txout.scriptPubKey, dst))
 			continue;
-		string sAddress = CBitcoinAddress(dst).ToString();
-		if (sAddress.size() != 34)
+		CAddressKey address;
+		if (!address.Set(dst))
 			continue;
 
 		// add new utxo
@@ -2107,33 +2279,33 @@ bool CTransaction::ConnectUtxo(CTxDB&             txdb,
 			}
 		}
 		if (frozen) {
-			if (!txdb.AddFrozen(sAddress, txoutid, unspent))
+			if (!txdb.AddFrozen(address, txoutid, unspent))
 				return error("ConnectUtxo() : AddFrozen");
 			if (!txdb.AddToFrozenQueue(unspent.nLockTime, txoutid,
-			                           CFrozenQueued(sAddress, unspent.nAmount)))
+			                           CFrozenQueued(address.ToString(), unspent.nAmount)))
 				return error("ConnectUtxo() : AddToFrozenQueue");
 		} else {
-			if (!txdb.AddUnspent(sAddress, txoutid, unspent))
+			if (!txdb.AddUnspent(address, txoutid, unspent))
 				return error("ConnectUtxo() : AddUnspent");
-			if (!txdb.AppendUnspent(sAddress, fractions, unspent.nHeight >= nPegStartHeight))
+			if (!txdb.AppendUnspent(address, fractions, unspent.nHeight >= nPegStartHeight))
 				return error("ConnectUtxo() : AppendSpent");
 		}
 		// make a record if not ready
-		CreateUtxoHistoryRecord(txdb, sAddress, pindex->nTime, pindex->nHeight, nTxIdx, txhash,
+		CreateUtxoHistoryRecord(txdb, address, pindex->nTime, pindex->nHeight, nTxIdx, txhash,
 		                        mapAddressesBalances, mapAddressesBalancesIdxs);
 		// debit record
-		CAddressBalance& balance = mapAddressesBalances[sAddress];
+		CAddressBalance& balance = mapAddressesBalances[address];
 		balance.nDebit += txout.nValue;
 		// frozen change
 		if (frozen)
 			balance.nFrozen += txout.nValue;
 	}
 	// write history records
-	for (pair<const string, CAddressBalance>& item : mapAddressesBalances) {
-		const string&    sAddress = item.first;
-		CAddressBalance& balance  = item.second;
-		int64_t          nIdx     = mapAddressesBalancesIdxs[sAddress];
-		int64_t          nDiff    = balance.nDebit - balance.nCredit;
+	for (pair<const CAddressKey, CAddressBalance>& item : mapAddressesBalances) {
+		const CAddressKey& address = item.first;
+		CAddressBalance&   balance = item.second;
+		int64_t            nIdx    = mapAddressesBalancesIdxs[address];
+		int64_t            nDiff   = balance.nDebit - balance.nCredit;
 		if (nDiff < 0) {
 			balance.nDebit  = 0;
 			balance.nCredit = -nDiff;
@@ -2145,7 +2317,7 @@ bool CTransaction::ConnectUtxo(CTxDB&             txdb,
 			balance.nCredit = 0;
 		}
 		balance.nBalance = balance.nBalance + nDiff;
-		if (!txdb.AddBalance(sAddress, nIdx, balance))
+		if (!txdb.AddBalance(address, nIdx, balance))
 			return error("ConnectUtxo() : AddBalance");
 	}
 
@@ -2165,10 +2337,13 @@ bool CBlock::ProcessFrozenQueue(CTxDB&             txdb,
 		// 1. remove from queue
 		if (!txdb.EraseFromFrozenQueue(record.nLockTime, record.txoutid))
 			return error("ProcessFrozenQueue() : EraseFromFrozenQueue");
+		CAddressKey address;
+		if (!address.SetString(record.sAddress))
+			return error("ProcessFrozenQueue() : bad address %s", record.sAddress);
 		// 2. unfreezing balance record
 		int64_t         nLastIndex = -1;
 		CAddressBalance balance;
-		if (!txdb.ReadAddressLastBalance(record.sAddress, balance, nLastIndex))
+		if (!txdb.ReadAddressLastBalance(address, balance, nLastIndex))
 			return error("ProcessFrozenQueue() : ReadAddressLastBalance");
 		nLastIndex        = nLastIndex + 1;
 		balance.nTime     = nTime;                    /*blocktime*/
@@ -2179,15 +2354,15 @@ bool CBlock::ProcessFrozenQueue(CTxDB&             txdb,
 		balance.nDebit    = record.nAmount;
 		balance.nLockTime = record.nLockTime;
 		balance.nFrozen -= record.nAmount;
-		if (!txdb.AddBalance(record.sAddress, nLastIndex, balance))
+		if (!txdb.AddBalance(address, nLastIndex, balance))
 			return error("ConnectUtxo() : AddBalance");
 		// 3. move from ftxo to utxo
 		CAddressUnspent frozen;
-		if (!txdb.ReadFrozen(record.sAddress, record.txoutid, frozen))
+		if (!txdb.ReadFrozen(address, record.txoutid, frozen))
 			return error("ProcessFrozenQueue() : ReadFrozen");
-		if (!txdb.EraseFrozen(record.sAddress, record.txoutid))
+		if (!txdb.EraseFrozen(address, record.txoutid))
 			return error("ProcessFrozenQueue() : EraseFrozen");
-		if (!txdb.AddUnspent(record.sAddress, record.txoutid, frozen))
+		if (!txdb.AddUnspent(address, record.txoutid, frozen))
 			return error("ProcessFrozenQueue() : AddUnspent");
 		if (balance.nHeight >= uint64_t(nPegStartHeight)) {
 			CFractions fractions(frozen.nAmount, CFractions::VALUE);
@@ -2195,7 +2370,7 @@ bool CBlock::ProcessFrozenQueue(CTxDB&             txdb,
 				fractions = mapFractions[record.txoutid];
 			else if (!pegdb.ReadFractions(record.txoutid, fractions, !fLoading /*must_have*/))
 				return error("ProcessFrozenQueue() : ReadFractions: %s", record.txoutid.GetHex());
-			if (!txdb.AppendUnspent(record.sAddress, fractions, true /*peg_on*/))
+			if (!txdb.AppendUnspent(address, fractions, true /*peg_on*/))
 				return error("ProcessFrozenQueue() : AppendSpent");
 		}
 	}
@@ -2207,8 +2382,8 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
                                   MapPrevTx&    mapInputs,
                                   MapFractions& mapInputsFractions,
                                   MapFractions& mapOutputsFractions) const {
-	auto        txhash = GetHash();
-	set<string> setAddresses;
+	auto             txhash = GetHash();
+	set<CAddressKey> setAddresses;
 
 	// collect addresses
 	for (size_t j = 0; j < vout.size(); j++) {
@@ -2216,11 +2391,11 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
 		CTxDestination dst;
 		if (!ExtractDestination(txout.scriptPubKey, dst))
 			continue;
-		string sAddress = CBitcoinAddress(dst).ToString();
-		if (sAddress.size() != 34)
+		CAddressKey address;
+		if (!address.Set(dst))
 			continue;
 
-		setAddresses.insert(sAddress);
+		setAddresses.insert(address);
 	}
 	// collect addresses
 	for (size_t j = 0; j < vin.size(); j++) {
@@ -2236,50 +2411,50 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
 		CTxDestination dst;
 		if (!ExtractDestination(txout.scriptPubKey, dst))
 			continue;
-		string sAddress = CBitcoinAddress(dst).ToString();
-		if (sAddress.size() != 34)
+		CAddressKey address;
+		if (!address.Set(dst))
 			continue;
 
-		setAddresses.insert(sAddress);
+		setAddresses.insert(address);
 	}
 
 	// before disconnecting utxos move frozen back to pool
 	// and remove unfreezing balance history records (they are top)
 	// and add them back as frozen queue records,
 	// so it affects only intersecting addresses
-	for (string sAddress : setAddresses) {
+	for (const CAddressKey& address : setAddresses) {
 		bool done = false;
 		do {
 			int64_t         nLastIndex = -1;
 			CAddressBalance balance;
-			if (!txdb.ReadAddressLastBalance(sAddress, balance, nLastIndex))
+			if (!txdb.ReadAddressLastBalance(address, balance, nLastIndex))
 				return error(
 				    "DisconnectUtxo() : frozen queue: ReadAddressLastBalance not found last record "
 				    "for %s",
-				    sAddress);
+				    address.ToString());
 			if (balance.nIndex < 0) {
-				if (!txdb.EraseBalance(sAddress, nLastIndex))
+				if (!txdb.EraseBalance(address, nLastIndex))
 					return error("DisconnectUtxo() : frozen queue: EraseBalance (unfreezing)");
 				// back to freeze queue
 				uint64_t nLockTime = balance.nLockTime;
 				uint320  txoutid(balance.txhash, -balance.nIndex - 1);
 				if (!txdb.AddToFrozenQueue(nLockTime, txoutid,
-				                           CFrozenQueued(sAddress, balance.nDebit)))
+				                           CFrozenQueued(address.ToString(), balance.nDebit)))
 					return error("DisconnectUtxo() : frozen queue: AddToFrozenQueue");
 				// move from utxo to ftxo
 				CAddressUnspent unspent;
-				if (!txdb.ReadUnspent(sAddress, txoutid, unspent))
+				if (!txdb.ReadUnspent(address, txoutid, unspent))
 					return error("DisconnectUtxo() : frozen queue: ReadUnspent");
 				if (balance.nHeight >= uint64_t(nPegStartHeight)) {
 					CFractions fractions(unspent.nAmount, CFractions::VALUE);
 					if (!pegdb.ReadFractions(txoutid, fractions, true /*must_have*/))
 						return error("DisconnectUtxo() : frozen queue: ReadFractions");
-					if (!txdb.DeductSpent(sAddress, fractions, true /*peg_on*/))
+					if (!txdb.DeductSpent(address, fractions, true /*peg_on*/))
 						return error("DisconnectUtxo() : DeductSpent");
 				}
-				if (!txdb.EraseUnspent(sAddress, txoutid))
+				if (!txdb.EraseUnspent(address, txoutid))
 					return error("DisconnectUtxo() : frozen queue: EraseFrozen");
-				if (!txdb.AddFrozen(sAddress, txoutid, unspent))
+				if (!txdb.AddFrozen(address, txoutid, unspent))
 					return error("DisconnectUtxo() : frozen queue: AddUnspent");
 			} else {
 				done = true;
@@ -2295,8 +2470,8 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
 		CTxDestination dst;
 		if (!ExtractDestination(txout.scriptPubKey, dst))
 			continue;
-		string sAddress = CBitcoinAddress(dst).ToString();
-		if (sAddress.size() != 34)
+		CAddressKey address;
+		if (!address.Set(dst))
 			continue;
 
 		auto        txoutid = uint320(txhash, j);
@@ -2315,13 +2490,13 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
 			}
 		}
 		CAddressUnspent unspent;
-		if (txdb.ReadUnspent(sAddress, txoutid, unspent)) {
-			if (!txdb.DeductSpent(sAddress, fractions, unspent.nHeight >= nPegStartHeight))
+		if (txdb.ReadUnspent(address, txoutid, unspent)) {
+			if (!txdb.DeductSpent(address, fractions, unspent.nHeight >= nPegStartHeight))
 				return error("DisconnectUtxo() : DeductSpent");
-			if (!txdb.EraseUnspent(sAddress, txoutid))
+			if (!txdb.EraseUnspent(address, txoutid))
 				return error("DisconnectUtxo() : EraseUnspent");
 		} else {
-			if (!txdb.EraseFrozen(sAddress, txoutid))
+			if (!txdb.EraseFrozen(address, txoutid))
 				return error("DisconnectUtxo() : EraseFrozen");
 		}
 	}
@@ -2340,8 +2515,8 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
 		CTxDestination dst;
 		if (!ExtractDestination(txout.scriptPubKey, dst))
 			continue;
-		string sAddress = CBitcoinAddress(dst).ToString();
-		if (sAddress.size() != 34)
+		CAddressKey address;
+		if (!address.Set(dst))
 			continue;
 
 		CAddressUnspent unspent;
@@ -2366,30 +2541,30 @@ bool CTransaction::DisconnectUtxo(CTxDB&        txdb,
 			}
 		}
 		if (frozen) {
-			if (!txdb.AddFrozen(sAddress, txoutid, unspent))
+			if (!txdb.AddFrozen(address, txoutid, unspent))
 				return error("DisconnectUtxo() : AddFrozen");
 			if (!txdb.AddToFrozenQueue(unspent.nLockTime, txoutid,
-			                           CFrozenQueued(sAddress, unspent.nAmount)))
+			                           CFrozenQueued(address.ToString(), unspent.nAmount)))
 				return error("DisconnectUtxo() : AddToFrozenQueue");
 		} else {
-			if (!txdb.AddUnspent(sAddress, txoutid, unspent))
+			if (!txdb.AddUnspent(address, txoutid, unspent))
 				return error("DisconnectUtxo() : AddUnspent");
-			if (!txdb.AppendUnspent(sAddress, fractions, unspent.nHeight >= nPegStartHeight))
+			if (!txdb.AppendUnspent(address, fractions, unspent.nHeight >= nPegStartHeight))
 				return error("DisconnectUtxo() : AppendSpent");
 		}
 	}
 	// remove balance history records
-	for (string sAddress : setAddresses) {
+	for (const CAddressKey& address : setAddresses) {
 		int64_t         nLastIndex = -1;
 		CAddressBalance balance;
-		if (!txdb.ReadAddressLastBalance(sAddress, balance, nLastIndex))
+		if (!txdb.ReadAddressLastBalance(address, balance, nLastIndex))
 			return error("DisconnectUtxo() : ReadAddressLastBalance not found last record for %s",
-			             sAddress);
+			             address.ToString());
 		if (balance.txhash != txhash)
 			return error(
 			    "DisconnectUtxo() : ReadAddressLastBalance has invalid txhash %s, expected %s",
 			    balance.txhash.GetHex(), txhash.GetHex());
-		if (!txdb.EraseBalance(sAddress, nLastIndex))
+		if (!txdb.EraseBalance(address, nLastIndex))
 			return error("DisconnectUtxo() : EraseBalance");
 	}
 	return true;
@@ -2404,7 +2579,7 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex) {
 		uint256 txhash = vtx[i].GetHash();
 		for (uint32_t j = vtx[i].vout.size(); j-- > 0;) {
 			auto fkey = uint320(txhash, j);
-			pegdb.Erase(fkey);
+			pegdb.EraseFractions(fkey);
 		}
 	}
 
@@ -2437,7 +2612,121 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex) {
 	return true;
 }
 
+// Read ahead the inputs of block transactions which are not in the block itself:
+// txindexes and fractions are read with sorted keys, previous transactions and
+// headers of their blocks are read ordered by position in the block files, so
+// every block file is opened once and read forward. It is a best effort, what
+// is not prefetched is left for FetchInputs to read and to report.
+bool CBlock::PrefetchInputs(CTxDB& txdb, CPegDB& pegdb, CPrefetchedInputs& prefetched) const {
+	set<uint256> setBlockTxs;
+	for (const CTransaction& tx : vtx)
+		setBlockTxs.insert(tx.GetHash());
+
+	set<uint256> setPrevTxs;
+	set<uint320> setPrevOuts;
+	for (const CTransaction& tx : vtx) {
+		if (tx.IsCoinBase() || tx.IsCoinMint())
+			continue;
+		for (const CTxIn& txin : tx.vin) {
+			if (setBlockTxs.count(txin.prevout.hash))
+				continue;
+			setPrevTxs.insert(txin.prevout.hash);
+			setPrevOuts.insert(uint320(txin.prevout.hash, txin.prevout.n));
+		}
+	}
+	if (setPrevTxs.empty())
+		return true;
+
+	map<uint256, CTxIndex> mapTxIndex;
+	if (!txdb.ReadTxIndexes(vector<uint256>(setPrevTxs.begin(), setPrevTxs.end()), mapTxIndex))
+		return error("PrefetchInputs() : txindexes read failed");
+
+	// (nFile, nTxPos) -> txid, previous transactions ordered by position on disk
+	map<pair<uint32_t, uint32_t>, uint256> mapTxPos;
+	for (const auto& item : mapTxIndex) {
+		const CDiskTxPos& pos = item.second.pos;
+		if (pos.IsNull() || pos == CDiskTxPos(1, 1, 1))
+			continue;
+		mapTxPos[make_pair(pos.nFile, pos.nTxPos)] = item.first;
+	}
+
+	uint32_t  nFileOpen = 0;
+	CAutoFile filein(NULL, SER_DISK, CLIENT_VERSION);
+
+	auto fnSeek = [&](uint32_t nFile, uint32_t nPos) {
+		if (!filein || nFile != nFileOpen) {
+			filein.fclose();
+			filein    = OpenBlockFile(nFile, 0, "rb");
+			nFileOpen = nFile;
+			if (!filein)
+				return false;
+		}
+		return fseek(filein, nPos, SEEK_SET) == 0;
+	};
+
+	// (nFile, nBlockPos) of previous transactions without own time
+	map<pair<uint32_t, uint32_t>, vector<uint256>> mapBlockPos;
+	for (const auto& item : mapTxPos) {
+		if (!fnSeek(item.first.first, item.first.second))
+			continue;
+		CTransaction txPrev;
+		try {
+			filein >> txPrev;
+		} catch (std::exception& e) {
+			continue;
+		}
+		const CTxIndex& txindex = mapTxIndex[item.second];
+		if (txPrev.nTime != 0)
+			txPrev.nTimeFetched = txPrev.nTime;
+		else
+			mapBlockPos[make_pair(item.first.first, txindex.pos.nBlockPos)].push_back(
+			    item.second);
+		prefetched.mapPrevTx[item.second] = make_pair(txindex, txPrev);
+	}
+
+	// Prev tx has nTime as zero, block time is used
+	for (const auto& item : mapBlockPos) {
+		CBlock block;
+		bool   fRead = fnSeek(item.first.first, item.first.second);
+		if (fRead) {
+			try {
+				filein.nType |= SER_BLOCKHEADERONLY;
+				filein >> block;
+			} catch (std::exception& e) {
+				fRead = false;
+			}
+			filein.nType &= ~SER_BLOCKHEADERONLY;
+		}
+		for (const uint256& txid : item.second) {
+			if (fRead)
+				prefetched.mapPrevTx[txid].second.nTimeFetched = block.nTime;
+			else
+				prefetched.mapPrevTx.erase(txid);
+		}
+	}
+	filein.fclose();
+
+	// Fractions expected in pegdb, as for FetchInputs
+	vector<uint320> vFractionKeys;
+	for (const uint320& fkey : setPrevOuts) {
+		auto mi = prefetched.mapPrevTx.find(fkey.b1());
+		if (mi == prefetched.mapPrevTx.end())
+			continue;
+		if (mi->second.first.nHeight >= nPegStartHeight)
+			vFractionKeys.push_back(fkey);
+	}
+	if (!pegdb.ReadFractions(vFractionKeys, prefetched.mapFractions))
+		return error("PrefetchInputs() : fractions read failed");
+
+	return true;
+}
+
 bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool fJustCheck) {
+	// Block to check only can be changed after by the miner, do not memoize its hashes
+	if (!fJustCheck)
+		CacheHashes();
+	uint64_t nTxHashesStart = nTxHashesComputed;
+
 	// Check it again in case a previous version let a bad block in, but skip BlockSig checking
 	if (!CheckBlock(!fJustCheck, !fJustCheck, false))
 		return false;
@@ -2465,16 +2754,15 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 		return error("ConnectBlock() : fail to calculate block peg index");
 	if (!ConnectConsensusStates(pegdb, pindex))
 		return error("ConnectBlock() : fail to connect consensus states");
-	map<string, CBridgeInfo> bridges;
-	if (!pindex->ReadBridges(pegdb, bridges))
+	CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindex);
+	if (!cycle->fBridges)
 		return error("ConnectBlock() : bridges read error");
-	auto fnMerkleIn = [&](string hash) {
-		CMerkleInfo m = pindex->ReadMerkleIn(pegdb, hash);
-		return m;
-	};
-	set<string> timelockpasses;
-	if (!pindex->ReadTimeLockPasses(pegdb, timelockpasses))
+	if (!cycle->fTimeLockPasses)
 		return error("ConnectBlock() : timelockpasses read error");
+	const map<string, CBridgeInfo>& bridges        = cycle->bridges;
+	const set<string>&              timelockpasses = cycle->timelockpasses;
+
+	auto fnMerkleIn = [&](string hash) { return cycle->MerkleIn(pegdb, hash); };
 
 	map<size_t, MapPrevTx>    mapInputs;
 	map<size_t, MapFractions> mapInputsFractions;
@@ -2497,6 +2785,12 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 	int  nBridgePoolNout        = pindex->nHeight;
 	bool fBridgePoolFromChanges = true;
 
+	CPrefetchedInputs prefetched;
+	if (!PrefetchInputs(txdb, pegdb, prefetched))
+		LogPrint("bench", "ConnectBlock() : inputs prefetch incomplete\n");
+
+	CCheckQueueControl<CScriptCheck> control(nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+
 	for (size_t i = 0; i < vtx.size(); i++) {
 		CTransaction& tx      = vtx[i];
 		uint256       tx_hash = tx.GetHash();
@@ -2540,7 +2834,7 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 			if (!tx.FetchInputs(txdb, pegdb, nBridgePoolNout, fBridgePoolFromChanges, bridges,
 			                    fnMerkleIn, mapQueuedChanges, mapQueuedFractionsChanges,
 			                    true /*is block*/, false /*is miner*/, nTime, false /*skip pruned*/,
-			                    mapInputs[i], mapInputsFractions[i], fInvalid))
+			                    mapInputs[i], mapInputsFractions[i], fInvalid, &prefetched))
 				return false;
 
 			// Add in sigops done by pay-to-script-hash inputs;
@@ -2564,11 +2858,14 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 			if (tx.IsCoinMint())
 				nValueMint = nTxValueOut;  // TODO: log/use
 
+			vector<CScriptCheck> vChecks;
 			if (!tx.ConnectInputs(mapInputs[i], mapInputsFractions[i], mapQueuedChanges,
 			                      mapQueuedFractionsChanges, nBridgePoolNout, bridges, fnMerkleIn,
 			                      timelockpasses, feesFractions, posThisTx, pindex,
-			                      true /*is ConnectBlock*/, false /*is CreateNewBlock*/, flags))
+			                      true /*is ConnectBlock*/, false /*is CreateNewBlock*/, flags,
+			                      nScriptCheckThreads ? &vChecks : nullptr))
 				return false;
+			control.Add(vChecks);
 		}
 
 		mapQueuedChanges[tx_hash] = CTxIndex(posThisTx, tx.vout.size(), pindex->nHeight, i);
@@ -2592,7 +2889,7 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 		if (!vtx[1].FetchInputs(txdb, pegdb, 0, true, bridges, fnMerkleIn, mapQueuedChanges,
 		                        mapQueuedFractionsChanges, true /*is block*/, false /*is miner*/,
 		                        nTime, false /*skip pruned*/, mapInputs[1], mapInputsFractions[1],
-		                        fInvalid))
+		                        fInvalid, &prefetched))
 			return false;
 
 		auto fkey = uint320(prevout.hash, prevout.n);
@@ -2631,6 +2928,9 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 		}
 	}
 
+	if (!control.Wait())
+		return DoS(100, error("ConnectBlock() : script verification failed"));
+
 	// ppcoin: track money supply and mint amount info
 	pindex->nMint = nValueOut - nValueIn + nFees;
 	pindex->nMoneySupply =
@@ -2768,6 +3068,8 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool
 			return error("ConnectBlock() : peg txid write failed");
 	}
 
+	LogPrint("bench", "ConnectBlock() : %u txs, %u tx hashes computed\n", vtx.size(),
+	         nTxHashesComputed - nTxHashesStart);
 	return true;
 }
 
@@ -2824,6 +3126,9 @@ bool static Reorganize(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindexNew) {
 			}
 		}
 	}
+	// Peg cycle snapshots of the shorter branch are not used anymore, the
+	// connects of the longer branch rewrite the states of its cycle blocks
+	PegCycleStates().Invalidate();
 
 	// Connect longer branch
 	vector<CTransaction> vDelete;
@@ -2973,12 +3278,12 @@ bool CBlock::SetBestChain(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindexNew) {
 	}
 
 	// New best block
-	hashBestChain       = hash;
-	pindexBest          = pindexNew;
-	pblockindexFBBHLast = NULL;
-	nBestHeight         = pindexBest->nHeight;
-	nBestChainTrust     = pindexNew->nChainTrust;
-	nTimeBestReceived   = GetTime();
+	hashBestChain     = hash;
+	pindexBest        = pindexNew;
+	nBestHeight       = pindexBest->nHeight;
+	nBestChainTrust   = pindexNew->nChainTrust;
+	nTimeBestReceived = GetTime();
+	chainActive.SetTip(pindexBest);
 	mempool.AddTransactionsUpdated(1);
 
 	uint256 nBestBlockTrust = pindexBest->nHeight != 0
@@ -3033,14 +3338,15 @@ bool CBlock::AddToBlockIndex(uint32_t nFile, uint32_t nBlockPos, const uint256&
 		return error("AddToBlockIndex() : %s already exists", hash.ToString());
 
 	// Construct new block index object
-	CBlockIndex* pindexNew = new CBlockIndex(nFile, nBlockPos, *this);
+	CBlockIndex* pindexNew = mapBlockIndex.allocate(nFile, nBlockPos, *this);
 	if (!pindexNew)
 		return error("AddToBlockIndex() : new CBlockIndex failed");
-	pindexNew->phashBlock                                 = &hash;
-	unordered_map<uint256, CBlockIndex*>::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
+	pindexNew->phashBlock           = &hash;
+	CBlockIndexMap::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
 	if (miPrev != mapBlockIndex.end()) {
 		pindexNew->SetPrev((*miPrev).second);
 		pindexNew->nHeight = pindexNew->Prev()->nHeight + 1;
+		pindexNew->BuildSkip();
 	}
 
 	// ppcoin: compute chain trust score
@@ -3065,7 +3371,7 @@ bool CBlock::AddToBlockIndex(uint32_t nFile, uint32_t nBlockPos, const uint256&
 	    pindexNew->Prev(), IsProofOfWork() ? hash : vtx[1].vin[0].prevout.hash);
 
 	// Add to mapBlockIndex
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.insert(hash, pindexNew).first;
+	CBlockIndexMap::iterator mi = mapBlockIndex.insert(hash, pindexNew).first;
 	if (pindexNew->IsProofOfStake())
 		setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
 	pindexNew->phashBlock = &((*mi).first);
@@ -3130,9 +3436,8 @@ bool CBlock::AddToBlockIndex(uint32_t nFile, uint32_t nBlockPos, const uint256&
 								if (vAddresses.size() == 1) {
 									string sAddress =
 									    CBitcoinAddress(vAddresses.front()).ToString();
-									set<string> sTrustedStakers1;
-									pindexNew->ReadTrustedStakers1(pegdb, sTrustedStakers1);
-									if (sTrustedStakers1.count(sAddress)) {
+									CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindexNew);
+									if (cycle->trustedstakers1.count(sAddress)) {
 										hasBetterStakerTrust = true;
 										break;
 									}
@@ -3250,7 +3555,7 @@ bool CBlock::AcceptBlock() {
 		return error("AcceptBlock() : block already in mapBlockIndex");
 
 	// Get prev block index
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashPrevBlock);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(hashPrevBlock);
 	if (mi == mapBlockIndex.end())
 		return DoS(10, error("AcceptBlock() : prev block not found"));
 	CBlockIndex* pindexPrev = (*mi).second;
@@ -3414,6 +3719,9 @@ bool static IsCanonicalBlockSignature(CBlock* pblock) {
 bool ProcessBlock(CNode* pfrom, CBlock* pblock) {
 	AssertLockHeld(cs_main);
 
+	// Block is complete (received or signed), memoize its hashes
+	pblock->CacheHashes();
+
 	// Check for duplicate
 	uint256 hash = pblock->GetHash();
 	if (mapBlockIndex.count(hash))
@@ -3763,8 +4071,8 @@ void PrintBlockTree() {
 	AssertLockHeld(cs_main);
 	// pre-compute tree structure
 	map<CBlockIndex*, vector<CBlockIndex*>> mapNext;
-	for (unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin();
-	     mi != mapBlockIndex.end(); ++mi) {
+	for (CBlockIndexMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end();
+	     ++mi) {
 		CBlockIndex* pindex = (*mi).second;
 		mapNext[pindex->Prev()].push_back(pindex);
 		// test
@@ -3997,7 +4305,7 @@ void static ProcessGetData(CNode* pfrom) {
 
 			if (inv.type == MSG_BLOCK) {
 				// Send block from disk
-				unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(inv.hash);
+				CBlockIndexMap::iterator mi = mapBlockIndex.find(inv.hash);
 				if (mi != mapBlockIndex.end()) {
 					CBlock block;
 					block.ReadFromDisk((*mi).second);
@@ -4363,7 +4671,7 @@ bool static ProcessMessage(CNode*       pfrom,
 		CBlockIndex* pindex = NULL;
 		if (locator.IsNull()) {
 			// If locator is null, return the hashStop block
-			unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashStop);
+			CBlockIndexMap::iterator mi = mapBlockIndex.find(hashStop);
 			if (mi == mapBlockIndex.end())
 				return true;
 			pindex = (*mi).second;
@@ -16,6 +16,7 @@
 #include "txmempool.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <atomic>
 #include <functional>
 #include <list>
 
@@ -53,6 +54,10 @@ static const int64_t MIN_TX_FEE = 10000;
 static const int64_t MINT_TX_FEE = 100000;
 /** Fees smaller than this (in satoshi) are considered zero fee (for relaying) */
 static const int64_t MIN_RELAY_TX_FEE = MIN_TX_FEE;
+/** Maximum number of script-checking threads allowed */
+static const int MAX_SCRIPTCHECK_THREADS = 16;
+/** -par default (number of script-checking threads, 0 = auto) */
+static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** No amount larger than this (in satoshi) is valid */
 static const int64_t MAX_MONEY = 2000000000 * COIN;
 inline bool          MoneyRange(int64_t nValue) {
@@ -115,6 +120,8 @@ extern CBlockIndex*                             pindexBest;
 extern uint64_t                                 nLastBlockTx;
 extern uint64_t                                 nLastBlockSize;
 extern int64_t                                  nLastCoinStakeSearchInterval;
+extern uint64_t                                 nStakeTemplateRebuilds;
+extern uint64_t                                 nStakeTemplateReuses;
 extern const std::string                        strMessageMagic;
 extern int64_t                                  nTimeBestReceived;
 extern bool                                     fImporting;
@@ -126,6 +133,11 @@ extern bool                             fAboutToSendGUI;
 
 // Settings
 extern bool fUseFastIndex;
+extern int  nScriptCheckThreads;
+
+// Counters of computed (not memoized) hashes, for benchmarking
+extern std::atomic<uint64_t> nTxHashesComputed;
+extern std::atomic<uint64_t> nBlockHashesComputed;
 
 // Minimum disk space required - used in CheckDiskSpace()
 static const uint64_t nMinDiskSpace = 52428800;
@@ -135,6 +147,8 @@ class CTxDB;
 class CTxIndex;
 class CWalletInterface;
 class CPegDB;
+class CScriptCheck;
+struct CPrefetchedInputs;
 
 // functors for messagings
 typedef std::function<void(const std::string&)> LoadMsg;
@@ -170,6 +184,8 @@ CBlockIndex* FindBlockByHeight(int nHeight);
 bool         ProcessMessages(CNode* pfrom);
 bool         SendMessages(CNode* pto, bool fSendTrickle);
 void         ThreadImport(std::vector<boost::filesystem::path> vImportFiles);
+/** Run an instance of the script checking thread */
+void ThreadScriptCheck();
 
 bool               CheckProofOfWork(uint256 hash, uint32_t nBits);
 uint32_t           GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake);
@@ -290,7 +306,8 @@ public:
 	IMPLEMENT_SERIALIZE(READWRITE(this->nVersion); nVersion = this->nVersion; READWRITE(nTime);
 	                    READWRITE(vin);
 	                    READWRITE(vout);
-	                    READWRITE(nLockTime);)
+	                    READWRITE(nLockTime);
+	                    if (fRead) hashCached.Reset();)
 
 	void SetNull() {
 		nVersion     = CTransaction::CURRENT_VERSION;
@@ -300,11 +317,23 @@ public:
 		vout.clear();
 		nLockTime = 0;
 		nDoS      = 0;  // Denial-of-service prevention
+		hashCached.Reset();
 	}
 
 	bool IsNull() const { return (vin.empty() && vout.empty()); }
 
-	uint256 GetHash() const { return SerializeHash(*this); }
+	uint256 GetHash() const {
+		if (hashCached.IsValid())
+			return hashCached.Get();
+		return ComputeHash();
+	}
+
+	// Memoize the hash, the transaction must not be changed after that
+	// (it is in a received or connected block, or in the mempool)
+	void CacheHash() const {
+		if (!hashCached.IsValid())
+			hashCached.Set(ComputeHash());
+	}
 
 	bool IsCoinBase() const {
 		return (vin.size() == 1 && vin[0].prevout.IsNull() && vout.size() >= 1);
@@ -451,23 +480,25 @@ public:
 	 @param[in] fMiner	True if being called by CreateNewBlock
 	 @param[out] inputsRet	Pointers to this transaction's inputs
 	 @param[out] fInvalid	returns true if transaction is invalid
+	 @param[in] pPrefetched	Inputs read ahead for the block, used in place of txdb and pegdb
 	 @return	Returns true if all inputs are in txdb or mapTestPool
 	 */
-	bool FetchInputs(CTxDB&                                   txdb,
-	                 CPegDB&                                  pegdb,
-	                 int                                      nBridgePoolNout,
-	                 bool                                     fBridgePoolMustInTestPool,
-	                 const std::map<std::string, CBridgeInfo> bridges,
-	                 std::function<CMerkleInfo(std::string)>  fnMerkleIn,
-	                 const std::map<uint256, CTxIndex>&       mapTestPool,
-	                 const MapFractions&                      mapTestFractionsPool,
-	                 bool                                     fBlock,
-	                 bool                                     fMiner,
-	                 uint32_t                                 nBlockTime,
-	                 bool                                     fSkipPruned,
-	                 MapPrevTx&                               inputsRet,
-	                 MapFractions&                            finputsRet,
-	                 bool&                                    fInvalid);
+	bool FetchInputs(CTxDB&                                    txdb,
+	                 CPegDB&                                   pegdb,
+	                 int                                       nBridgePoolNout,
+	                 bool                                      fBridgePoolMustInTestPool,
+	                 const std::map<std::string, CBridgeInfo>& bridges,
+	                 std::function<CMerkleInfo(std::string)>   fnMerkleIn,
+	                 const std::map<uint256, CTxIndex>&        mapTestPool,
+	                 const MapFractions&                       mapTestFractionsPool,
+	                 bool                                      fBlock,
+	                 bool                                      fMiner,
+	                 uint32_t                                  nBlockTime,
+	                 bool                                      fSkipPruned,
+	                 MapPrevTx&                                inputsRet,
+	                 MapFractions&                             finputsRet,
+	                 bool&                                     fInvalid,
+	                 const CPrefetchedInputs*                  pPrefetched = nullptr);
 
 	/** Sanity check previous transactions, then, if all checks succeed,
 	    mark them as spent by this transaction.
@@ -478,22 +509,25 @@ public:
 	    @param[in] pindexBlock
 	    @param[in] fBlock	true if called from ConnectBlock
 	    @param[in] fMiner	true if called from CreateNewBlock
+	    @param[out] pvChecks	if not NULL, signature checks which do not affect
+	                        	the fractions are pushed onto it instead of being run
 	    @return Returns true if all checks succeed
 	 */
-	bool ConnectInputs(MapPrevTx                                inputs,
-	                   MapFractions&                            finputs,
-	                   std::map<uint256, CTxIndex>&             mapTestPool,
-	                   MapFractions&                            mapTestFractionsPool,
-	                   int                                      nBridgePoolNout,
-	                   const std::map<std::string, CBridgeInfo> bridges,
-	                   std::function<CMerkleInfo(std::string)>  fnMerkleIn,
-	                   const set<string>                        timelockpasses,
-	                   CFractions&                              feesFractions,
-	                   const CDiskTxPos&                        posThisTx,
-	                   const CBlockIndex*                       pindexBlock,
-	                   bool                                     fBlock,
-	                   bool                                     fMiner,
-	                   uint32_t flags = STANDARD_SCRIPT_VERIFY_FLAGS);
+	bool ConnectInputs(MapPrevTx                                 inputs,
+	                   MapFractions&                             finputs,
+	                   std::map<uint256, CTxIndex>&              mapTestPool,
+	                   MapFractions&                             mapTestFractionsPool,
+	                   int                                       nBridgePoolNout,
+	                   const std::map<std::string, CBridgeInfo>& bridges,
+	                   std::function<CMerkleInfo(std::string)>   fnMerkleIn,
+	                   const set<string>&                        timelockpasses,
+	                   CFractions&                               feesFractions,
+	                   const CDiskTxPos&                         posThisTx,
+	                   const CBlockIndex*                        pindexBlock,
+	                   bool                                      fBlock,
+	                   bool                                      fMiner,
+	                   uint32_t                   flags = STANDARD_SCRIPT_VERIFY_FLAGS,
+	                   std::vector<CScriptCheck>* pvChecks = nullptr);
 	bool CheckTransaction() const;
 
 	void GetOutputFor(const CTxIn& input, const MapPrevTx& inputs, CTxOut& txout) const;
@@ -511,6 +545,44 @@ public:
 	                    MapPrevTx&    mapInputs,
 	                    MapFractions& mapInputsFractions,
 	                    MapFractions& mapOutputsFractions) const;
+
+private:
+	uint256             ComputeHash() const;
+	mutable CCachedHash hashCached;
+};
+
+/** Inputs of block transactions read ahead from disk in one ordered pass,
+ *  see CBlock::PrefetchInputs. Previous transactions have nTimeFetched set.
+ */
+struct CPrefetchedInputs {
+	MapPrevTx    mapPrevTx;
+	MapFractions mapFractions;
+};
+
+/** Closure representing one script verification.
+ *  Note that this stores a reference to the spending transaction.
+ */
+class CScriptCheck {
+private:
+	CTxOut              txoutFrom;
+	const CTransaction* ptxTo;
+	uint32_t            nIn;
+	uint32_t            nFlags;
+
+public:
+	CScriptCheck() : ptxTo(nullptr), nIn(0), nFlags(0) {}
+	CScriptCheck(const CTxOut& txoutFromIn, const CTransaction& txToIn, uint32_t nInIn,
+	             uint32_t nFlagsIn)
+	    : txoutFrom(txoutFromIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn) {}
+
+	bool operator()() const;
+
+	void swap(CScriptCheck& check) {
+		std::swap(txoutFrom, check.txoutFrom);
+		std::swap(ptxTo, check.ptxTo);
+		std::swap(nIn, check.nIn);
+		std::swap(nFlags, check.nFlags);
+	}
 };
 
 /** wrapper for CTxOut that provides a more compact serialization */
@@ -627,10 +699,12 @@ public:
 
 	CTxIndex() { SetNull(); }
 
-	CTxIndex(const CDiskTxPos& posIn, uint32_t nOutputs, int64_t nHeight, uint16_t nTxIndex) {
+	CTxIndex(const CDiskTxPos& posIn, uint32_t nOutputs, int64_t nHeightIn, uint16_t nTxIndex) {
 		SetNull();
 		pos = posIn;
 		vSpent.resize(nOutputs);
+		nHeight = nHeightIn;
+		nIndex  = nTxIndex;
 	}
 
 	IMPLEMENT_SERIALIZE(
@@ -667,6 +741,34 @@ public:
 	                         uint256*  blockhash = nullptr) const;
 };
 
+/**  Address of the address index records: the base58 version byte and the
+ *   hash160 of a pay to pubkey hash or script hash destination
+ */
+class CAddressKey {
+public:
+	static const size_t SIZE = 21;
+
+	unsigned char nVersion;
+	uint160       hash;
+
+	CAddressKey() : nVersion(0) {}
+
+	// false for destinations without an indexed address
+	bool        Set(const CTxDestination& dest);
+	bool        SetString(const std::string& sAddress);
+	std::string ToString() const;
+	// the SIZE bytes of index keys
+	void Append(std::string& key) const;
+	void Read(const char* p);
+
+	friend bool operator<(const CAddressKey& a, const CAddressKey& b) {
+		return a.nVersion < b.nVersion || (a.nVersion == b.nVersion && a.hash < b.hash);
+	}
+	friend bool operator==(const CAddressKey& a, const CAddressKey& b) {
+		return a.nVersion == b.nVersion && a.hash == b.hash;
+	}
+};
+
 /**  A txdb record that contains the balance change per address
  */
 class CAddressBalance {
@@ -806,7 +908,8 @@ public:
 	    } else if (fRead) {
 		    const_cast<CBlock*>(this)->vtx.clear();
 		    const_cast<CBlock*>(this)->vchBlockSig.clear();
-	    })
+	    }
+	    if (fRead) hashCached.Reset();)
 
 	void SetNull() {
 		nVersion       = CBlock::CURRENT_VERSION;
@@ -819,17 +922,31 @@ public:
 		vchBlockSig.clear();
 		vMerkleTree.clear();
 		nDoS = 0;
+		hashCached.Reset();
 	}
 
 	bool IsNull() const { return (nBits == 0); }
 
 	uint256 GetHash() const {
+		if (hashCached.IsValid())
+			return hashCached.Get();
+		nBlockHashesComputed++;
 		if (nVersion > 6)
 			return Hash(BEGIN(nVersion), END(nNonce));
 		else
 			return GetPoWHash();
 	}
 
+	// Memoize hashes of the block and its transactions, the block must not
+	// be changed after that (it is received, signed or read from disk)
+	void CacheHashes() const {
+		if (!hashCached.IsValid())
+			hashCached.Set(GetHash());
+		for (const CTransaction& tx : vtx) {
+			tx.CacheHash();
+		}
+	}
+
 	uint256 GetPoWHash() const {
 		uint256 thash;
 		scrypt_1024_1_1_256(BEGIN(nVersion), BEGIN(thash));
@@ -984,6 +1101,7 @@ public:
 	}
 
 	bool DisconnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex);
+	bool PrefetchInputs(CTxDB& txdb, CPegDB& pegdb, CPrefetchedInputs& prefetched) const;
 	bool ConnectBlock(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindex, bool fJustCheck = false);
 	bool ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions = true);
 	bool SetBestChain(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindexNew);
@@ -1001,6 +1119,8 @@ public:
 	                        bool               fLoading);
 
 private:
+	mutable CCachedHash hashCached;
+
 	bool SetBestChainInner(CTxDB& txdb, CPegDB& pegdb, CBlockIndex* pindexNew);
 };
 
@@ -1027,9 +1147,17 @@ public:
 	CBlockIndex* BridgeCycleBlock() const;
 	CBlockIndex* PrevBridgeCycleBlock() const;
 
+	// Ancestor at the given height walking skip pointers, NULL if height is
+	// out of [0, nHeight]. Needs BuildSkip() on the blocks of the path.
+	CBlockIndex*       GetAncestor(int nAncestorHeight);
+	const CBlockIndex* GetAncestor(int nAncestorHeight) const;
+	// Sets skip pointer once Prev() and nHeight are known
+	void BuildSkip();
+
 private:
 	CBlockIndex* pPrev;
 	CBlockIndex* pNext;
+	CBlockIndex* pSkip;  // pointer to an ancestor further back, see BuildSkip()
 
 public:
 	uint32_t nFile;
@@ -1073,6 +1201,7 @@ public:
 		phashBlock        = NULL;
 		pPrev             = NULL;
 		pNext             = NULL;
+		pSkip             = NULL;
 		nFile             = 0;
 		nBlockPos         = 0;
 		nHeight           = 0;
@@ -1102,6 +1231,7 @@ public:
 		phashBlock        = NULL;
 		pPrev             = NULL;
 		pNext             = NULL;
+		pSkip             = NULL;
 		nFile             = nFileIn;
 		nBlockPos         = nBlockPosIn;
 		nHeight           = 0;
@@ -1266,6 +1396,31 @@ public:
 	bool        ReadBridgesPause(CPegDB& pegdb, bool& pause) const;
 };
 
+/** Blocks of the best chain indexed by height. It follows pindexBest, on
+ *  a tip change only the blocks above the fork are replaced.
+ */
+class CChain {
+public:
+	CBlockIndex* Genesis() const { return vChain.empty() ? NULL : vChain[0]; }
+	CBlockIndex* Tip() const { return vChain.empty() ? NULL : vChain.back(); }
+	int          Height() const { return (int)vChain.size() - 1; }
+
+	CBlockIndex* operator[](int nHeight) const {
+		if (nHeight < 0 || nHeight >= (int)vChain.size())
+			return NULL;
+		return vChain[nHeight];
+	}
+
+	bool Contains(const CBlockIndex* pindex) const { return (*this)[pindex->nHeight] == pindex; }
+
+	void SetTip(CBlockIndex* pindex);
+
+private:
+	std::vector<CBlockIndex*> vChain;
+};
+
+extern CChain chainActive;
+
 /** Used to marshal pointers into hashes for db storage. */
 class CDiskBlockIndex : public CBlockIndex {
 private:
@@ -1365,7 +1520,7 @@ public:
 	explicit CBlockLocator(const CBlockIndex* pindex) { Set(pindex); }
 
 	explicit CBlockLocator(uint256 hashBlock) {
-		std::unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+		CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 		if (mi != mapBlockIndex.end())
 			Set((*mi).second);
 	}
@@ -1398,7 +1553,7 @@ public:
 		int nDistance = 0;
 		int nStep     = 1;
 		for (const uint256& hash : vHave) {
-			std::unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+			CBlockIndexMap::iterator mi = mapBlockIndex.find(hash);
 			if (mi != mapBlockIndex.end()) {
 				CBlockIndex* pindex = (*mi).second;
 				if (pindex->IsInMainChain())
@@ -1414,7 +1569,7 @@ public:
 	CBlockIndex* GetBlockIndex() {
 		// Find the first block the caller has in the main chain
 		for (const uint256& hash : vHave) {
-			std::unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+			CBlockIndexMap::iterator mi = mapBlockIndex.find(hash);
 			if (mi != mapBlockIndex.end()) {
 				CBlockIndex* pindex = (*mi).second;
 				if (pindex->IsInMainChain())
@@ -1427,7 +1582,7 @@ public:
 	uint256 GetBlockHash() {
 		// Find the first block the caller has in the main chain
 		for (const uint256& hash : vHave) {
-			std::unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+			CBlockIndexMap::iterator mi = mapBlockIndex.find(hash);
 			if (mi != mapBlockIndex.end()) {
 				CBlockIndex* pindex = (*mi).second;
 				if (pindex->IsInMainChain())
@@ -50,33 +50,10 @@ bool fPegIsActivatedViaTx = false;
 
 static string sBurnAddress = "bJnV8J5v74MGctMyVSVPfGu1mGQ9nMTiB3";
 
-extern leveldb::DB* txdb;  // global pointer for LevelDB object instance
-
 bool SetBlocksIndexesReadyForPeg(CTxDB& ctxdb, LoadMsg load_msg) {
-	leveldb::Iterator* iterator = txdb->NewIterator(leveldb::ReadOptions());
-	// Seek to start key.
-	CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
-	ssStartKey << make_pair(string("blockindex"), uint256(0));
-	iterator->Seek(ssStartKey.str());
-	// Now read each entry.
-	int indexCount = 0;
-	while (iterator->Valid()) {
-		boost::this_thread::interruption_point();
-		// Unpack keys and values.
-		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-		ssKey.write(iterator->key().data(), iterator->key().size());
-		CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-		ssValue.write(iterator->value().data(), iterator->value().size());
-		string strType;
-		ssKey >> strType;
-		// Did we reach the end of the data to read?
-		if (strType != "blockindex")
-			break;
-		CDiskBlockIndex diskindex;
-		ssValue >> diskindex;
-
-		uint256                              blockHash = diskindex.GetBlockHash();
-        unordered_map<uint256, CBlockIndex*>::iterator mi        = mapBlockIndex.find(blockHash);
+	int  indexCount = 0;
+	auto fnEntry    = [&](CDiskBlockIndex& diskindex, const uint256& blockHash) {
+		CBlockIndexMap::iterator mi = mapBlockIndex.find(blockHash);
 		if (mi == mapBlockIndex.end()) {
 			return error("SetBlocksIndexesReadyForPeg() : mapBlockIndex failed");
 		}
@@ -86,14 +63,14 @@ bool SetBlocksIndexesReadyForPeg(CTxDB& ctxdb, LoadMsg load_msg) {
 		diskindex.SetPeg(pindexNew->nHeight >= nPegStartHeight);
 		ctxdb.WriteBlockIndex(diskindex);
 
-		iterator->Next();
-
 		indexCount++;
 		if (indexCount % 10000 == 0) {
 			load_msg(std::string(" update block indexes for peg: ") + std::to_string(indexCount));
 		}
-	}
-	delete iterator;
+		return true;
+	};
+	if (!ctxdb.ScanBlockIndex(fnEntry))
+		return false;
 
 	if (!ctxdb.WriteBlockIndexIsPegReady(true))
 		return error("SetBlocksIndexesReadyForPeg() : flag write failed");
@@ -107,26 +84,15 @@ int CBlockIndex::PegCycle() const {
 }
 
 CBlockIndex* CBlockIndex::PegCycleBlock() const {
-	int          nPegInterval = Params().PegInterval();
-	int          n            = nHeight % nPegInterval;
-	CBlockIndex* cycle_pindex = const_cast<CBlockIndex*>(this);
-	while (n > 0) {
-		cycle_pindex = cycle_pindex->Prev();
-		n--;
-	}
-	return cycle_pindex;
+	int nPegInterval = Params().PegInterval();
+	return const_cast<CBlockIndex*>(this)->GetAncestor(nHeight - nHeight % nPegInterval);
 }
 
 CBlockIndex* CBlockIndex::PrevPegCycleBlock() const {
 	int nPegInterval = Params().PegInterval();
-	int n            = nPegInterval;
-	// get current cycle block and roll cycle
-	CBlockIndex* cycle_pindex = PegCycleBlock();
-	while (n > 0) {
-		cycle_pindex = cycle_pindex->Prev();
-		n--;
-	}
-	return cycle_pindex;
+	// current cycle block rolled back by one cycle
+	return const_cast<CBlockIndex*>(this)->GetAncestor(nHeight - nHeight % nPegInterval -
+	                                                   nPegInterval);
 }
 
 bool CalculateBlockPegIndex(CPegDB& pegdb, CBlockIndex* pindex) {
@@ -152,14 +118,10 @@ int CBlockIndex::GetNextBlockPegSupplyIndex() const {
 
 	// back to 2 intervals and -1 to count voice of back-third interval, as votes sum at
 	// nPegInterval-1
-	auto usevotesindex = this;
-	while (usevotesindex->nHeight > (nNextHeight - nPegInterval * 2 - 1))
-		usevotesindex = usevotesindex->Prev();
+	auto usevotesindex = GetAncestor(std::min(nHeight, nNextHeight - nPegInterval * 2 - 1));
 
 	// back to 3 intervals and -1 for votes calculations of 2x and 3x
-	auto prevvotesindex = this;
-	while (prevvotesindex->nHeight > (nNextHeight - nPegInterval * 3 - 1))
-		prevvotesindex = prevvotesindex->Prev();
+	auto prevvotesindex = GetAncestor(std::min(nHeight, nNextHeight - nPegInterval * 3 - 1));
 
 	return ComputeNextPegSupplyIndex(nPegSupplyIndex, usevotesindex, prevvotesindex);
 }
@@ -175,14 +137,12 @@ int CBlockIndex::GetNextIntervalPegSupplyIndex() const {
 
 	// back to 2 intervals and -1 to count voice of back-third interval, as votes sum at
 	// nPegInterval-1
-	auto usevotesindex = this;
-	while (usevotesindex->nHeight > (nCurrentIntervalStart - nPegInterval * 1 - 1))
-		usevotesindex = usevotesindex->Prev();
+	auto usevotesindex =
+	    GetAncestor(std::min(nHeight, nCurrentIntervalStart - nPegInterval * 1 - 1));
 
 	// back to 3 intervals and -1 for votes calculations of 2x and 3x
-	auto prevvotesindex = this;
-	while (prevvotesindex->nHeight > (nCurrentIntervalStart - nPegInterval * 2 - 1))
-		prevvotesindex = prevvotesindex->Prev();
+	auto prevvotesindex =
+	    GetAncestor(std::min(nHeight, nCurrentIntervalStart - nPegInterval * 2 - 1));
 
 	return CBlockIndex::ComputeNextPegSupplyIndex(nPegSupplyIndex, usevotesindex, prevvotesindex);
 }
@@ -198,14 +158,12 @@ int CBlockIndex::GetNextNextIntervalPegSupplyIndex() const {
 
 	// back to 2 intervals and -1 to count voice of back-third interval, as votes sum at
 	// nPegInterval-1
-	auto usevotesindex = this;
-	while (usevotesindex->nHeight > (nCurrentIntervalStart - nPegInterval * 0 - 1))
-		usevotesindex = usevotesindex->Prev();
+	auto usevotesindex =
+	    GetAncestor(std::min(nHeight, nCurrentIntervalStart - nPegInterval * 0 - 1));
 
 	// back to 3 intervals and -1 for votes calculations of 2x and 3x
-	auto prevvotesindex = this;
-	while (prevvotesindex->nHeight > (nCurrentIntervalStart - nPegInterval * 1 - 1))
-		prevvotesindex = prevvotesindex->Prev();
+	auto prevvotesindex =
+	    GetAncestor(std::min(nHeight, nCurrentIntervalStart - nPegInterval * 1 - 1));
 
 	return CBlockIndex::ComputeNextPegSupplyIndex(GetNextIntervalPegSupplyIndex(), usevotesindex,
 	                                              prevvotesindex);
@@ -255,11 +213,8 @@ int CBlockIndex::ComputeNextPegSupplyIndex(int                nPegBase,
 int CalculatePegVotes(const CFractions& fractions, int nPegSupplyIndex) {
 	int nVotes = 1;
 
-	int64_t nReserveWeight = 0;
-	int64_t nLiquidWeight  = 0;
-
-	fractions.LowPart(nPegSupplyIndex, &nReserveWeight);
-	fractions.HighPart(nPegSupplyIndex, &nLiquidWeight);
+	int64_t nReserveWeight = fractions.Low(nPegSupplyIndex);
+	int64_t nLiquidWeight  = fractions.High(nPegSupplyIndex);
 
 	if (nLiquidWeight > INT_LEAST64_MAX / (nPegSupplyIndex + 2)) {
 		// check for rare extreme case when user stake more than about 100M coins
@@ -418,7 +373,7 @@ bool CalculateStandardFractions(const CTransaction& tx,
 bool CalculateCoinMintFractions(const CTransaction&                tx,
 								int                                nSupply,
 								uint32_t                           nTime,
-								const map<string, CBridgeInfo>     bridges,
+								const map<string, CBridgeInfo>&    bridges,
 								std::function<CMerkleInfo(string)> fnMerkleIn,
 								int                                nBridgePoolNout,
 								MapPrevOut&                        mapInputs,
@@ -623,7 +578,7 @@ bool CalculateCoinMintFractions(const CTransaction&                tx,
 bool CalculateCoinMintFractions(const CTransaction&                tx,
 								int                                nSupply,
 								uint32_t                           nTime,
-								const map<string, CBridgeInfo>     bridges,
+								const map<string, CBridgeInfo>&    bridges,
 								std::function<CMerkleInfo(string)> fnMerkleIn,
 								int                                nBridgePoolNout,
 								MapPrevTx&                         mapTxInputs,
@@ -891,7 +846,7 @@ void PrunePegForBlock(const CBlock& blockprune, CPegDB& pegdb) {
 		for (size_t j = 0; j < tx.vin.size(); j++) {
 			COutPoint prevout = tx.vin[j].prevout;
 			auto      fkey    = uint320(prevout.hash, prevout.n);
-			pegdb.Erase(fkey);
+			pegdb.EraseFractions(fkey);
 		}
 		if (!tx.IsCoinStake())
 			continue;
@@ -903,7 +858,7 @@ void PrunePegForBlock(const CBlock& blockprune, CPegDB& pegdb) {
 			CTxOut out = tx.vout[j];
 
 			if (out.nValue == 0) {
-				pegdb.Erase(fkey);
+				pegdb.EraseFractions(fkey);
 				continue;
 			}
 
@@ -915,7 +870,7 @@ void PrunePegForBlock(const CBlock& blockprune, CPegDB& pegdb) {
 			if (!ExtractDestinations(scriptPubKey, type, addresses, nRequired)) {
 				string notary;
 				if (scriptPubKey.ToNotary(notary)) {
-					pegdb.Erase(fkey);
+					pegdb.EraseFractions(fkey);
 					continue;
 				}
 				continue;
@@ -933,7 +888,7 @@ void PrunePegForBlock(const CBlock& blockprune, CPegDB& pegdb) {
 				}
 			}
 			if (voted) {
-				pegdb.Erase(fkey);
+				pegdb.EraseFractions(fkey);
 			}
 		}
 	}
@@ -53,17 +53,17 @@ bool CalculateStandardFractions(const CTransaction& tx,
                                 CFractions&         feesFractions,
                                 std::string&        sPegFailCause);
 
-bool CalculateCoinMintFractions(const CTransaction&                      tx,
-                                int                                      nSupply,
-                                uint32_t                                 nTime,
-                                const std::map<std::string, CBridgeInfo> bridges,
-                                std::function<CMerkleInfo(std::string)>  fnMerkleIn,
-                                int                                      nBridgePoolNout,
-                                MapPrevTx&                               inputs,
-                                MapFractions&                            finputs,
-                                MapFractions&                            mapTestFractionsPool,
-                                CFractions&                              feesFractions,
-                                std::string&                             sPegFailCause);
+bool CalculateCoinMintFractions(const CTransaction&                       tx,
+                                int                                       nSupply,
+                                uint32_t                                  nTime,
+                                const std::map<std::string, CBridgeInfo>& bridges,
+                                std::function<CMerkleInfo(std::string)>   fnMerkleIn,
+                                int                                       nBridgePoolNout,
+                                MapPrevTx&                                inputs,
+                                MapFractions&                             finputs,
+                                MapFractions&                             mapTestFractionsPool,
+                                CFractions&                               feesFractions,
+                                std::string&                              sPegFailCause);
 
 bool CalculateStakingFractions(const CTransaction&          tx,
                                const CBlockIndex*           pindexBlock,
@@ -93,6 +93,10 @@ bool FetchBridgePoolsFractions(CPegDB&       pegdb,
 bool ConnectBridgeCycleBurns(CPegDB&       pegdb,
                              CBlockIndex*  pindex,
                              MapFractions& mapQueuedFractionsChanges);
+bool ComputeBridgeBurnLeaf(const std::string&          address,
+                           const CCompressedFractions& fc,
+                           const std::string&          txoutid,
+                           CBridgeBurn::Hash&          leaf);
 
 bool ComputeMintMerkleLeaf(const std::string&   dest_addr_str,
                            std::vector<int64_t> sections,
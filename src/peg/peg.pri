@@ -8,3 +8,7 @@ SOURCES += $$PWD/peg.cpp
 SOURCES += $$PWD/peg_bridge.cpp
 HEADERS += $$PWD/pegdb-leveldb.h
 SOURCES += $$PWD/pegdb-leveldb.cpp
+HEADERS += $$PWD/pegcache.h
+SOURCES += $$PWD/pegcache.cpp
+HEADERS += $$PWD/pegcycle.h
+SOURCES += $$PWD/pegcycle.cpp
@@ -30,6 +30,7 @@
 #include "base58.h"
 #include "main.h"
 #include "peg.h"
+#include "pegcycle.h"
 #include "pegdb-leveldb.h"
 #include "proposals.h"
 #include "txdb-leveldb.h"
@@ -85,28 +86,15 @@ int CBlockIndex::BridgeCycle() const {
 }
 
 CBlockIndex* CBlockIndex::BridgeCycleBlock() const {
-	int          nBridgeInterval = Params().BridgeInterval();
-	int          n               = nHeight % nBridgeInterval;
-	CBlockIndex* cycle_pindex    = const_cast<CBlockIndex*>(this);
-	while (n > 0) {
-		cycle_pindex = cycle_pindex->Prev();
-		n--;
-	}
-	return cycle_pindex;
+	int nBridgeInterval = Params().BridgeInterval();
+	return const_cast<CBlockIndex*>(this)->GetAncestor(nHeight - nHeight % nBridgeInterval);
 }
 
 CBlockIndex* CBlockIndex::PrevBridgeCycleBlock() const {
 	int nBridgeInterval = Params().BridgeInterval();
-	int n               = nBridgeInterval;
-	// get current cycle block and roll cycle
-	CBlockIndex* cycle_pindex = BridgeCycleBlock();
-	while (n > 0) {
-		if (!cycle_pindex)
-			return cycle_pindex;
-		cycle_pindex = cycle_pindex->Prev();
-		n--;
-	}
-	return cycle_pindex;
+	// current cycle block rolled back by one cycle, NULL before genesis
+	return const_cast<CBlockIndex*>(this)->GetAncestor(nHeight - nHeight % nBridgeInterval -
+	                                                   nBridgeInterval);
 }
 
 bool ConnectConsensusStates(CPegDB& pegdb, CBlockIndex* pindex) {
@@ -564,14 +552,15 @@ bool CalculateBlockBridgeVotes(const CBlock& cblock,
 		CBlockIndex* cycle_pindex = pindex->PegCycleBlock();
 		uint256      chash        = cycle_pindex->GetBlockHash();
 
-		const CTransaction& tx = cblock.vtx[1];
+		const CTransaction& tx    = cblock.vtx[1];
+		CPegCycleStateRef   cycle = GetPegCycleState(pegdb, pindex);
 
 		for (size_t i = 0; i < tx.vout.size(); i++) {
 			string notary;
 			if (tx.vout[i].scriptPubKey.ToNotary(notary)) {
-				map<string, vector<string>> bridges;
-				if (!pindex->ReadBridgesMap(pegdb, bridges))
+				if (!cycle->fBridgesMap)
 					return false;
+				const map<string, vector<string>>& bridges = cycle->bridgesMap;
 
 				// notary is ready, count votes
 				string         address_voter = staker_addr;
@@ -649,7 +638,8 @@ bool CalculateBlockBridgeVotes(const CBlock& cblock,
 		}
 	}
 
-	// pickup Z bridge burns
+	// pickup Z bridge burns, one update of block burns per bridge
+	map<string, set<string>> block_burns;
 	for (size_t i = 0; i < cblock.vtx.size(); i++) {
 		const CTransaction& tx = cblock.vtx[i];
 		for (size_t j = 0; j < tx.vout.size(); j++) {
@@ -662,32 +652,26 @@ bool CalculateBlockBridgeVotes(const CBlock& cblock,
 						string br_hash  = brdata.substr(0, 64);
 						string dst_addr = brdata.substr(64, 42);
 						if (boost::starts_with(dst_addr, "0x") && IsHex(dst_addr.substr(2))) {
-							bool   to_add = true;
 							string txoutid =
 							    tx.GetHash().ToString() + ":" + std::to_string(j) + ":" + dst_addr;
-							set<string> txoutids;
-							set<string> txoutids_new;
-							pegdb.ReadBlockBurnsToBridge(bhash, br_hash, txoutids);
-							for (const string& id : txoutids) {
-								if (id == "")
-									continue;
-								if (id == txoutid) {
-									to_add = false;
-									continue;
-								}
-								txoutids_new.insert(id);
-							}
-							if (to_add) {
-								txoutids_new.insert(txoutid);
-								if (!pegdb.WriteBlockBurnsToBridge(bhash, br_hash, txoutids_new))
-									return false;
-							}
+							block_burns[br_hash].insert(txoutid);
 						}
 					}
 				}
 			}
 		}
 	}
+	for (const auto& it : block_burns) {
+		const string& br_hash = it.first;
+		set<string>   txoutids;
+		pegdb.ReadBlockBurnsToBridge(bhash, br_hash, txoutids);
+		size_t nBurns = txoutids.size();
+		txoutids.insert(it.second.begin(), it.second.end());
+		if (txoutids.size() == nBurns)
+			continue;  // all recorded
+		if (!pegdb.WriteBlockBurnsToBridge(bhash, br_hash, txoutids))
+			return false;
+	}
 
 	return true;
 }
@@ -713,10 +697,8 @@ bool FetchBridgePoolsFractions(CPegDB&       pegdb,
 	int bridge_block_nout     = pindex->nHeight;
 	int bridge_block_nout_pre = bridge_block_nout - 1;
 
-	map<string, vector<string>> bridges;
-	CBlockIndex*                pindex_pegcycle = pindex->PegCycleBlock();
-	pindex_pegcycle->ReadBridgesMap(pegdb, bridges);
-	for (const auto& it : bridges) {
+	CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindex);
+	for (const auto& it : cycle->bridgesMap) {
 		string brname = it.first;
 		string brhash_txt;
 		{
@@ -762,8 +744,8 @@ bool ConnectBridgeCycleBurns(CPegDB&       pegdb,
 	set<string>                 bridge_hashes;
 
 	// get fractions of pools
-	map<string, CFractions>  bridges_burn_fractions;
-	map<string, set<string>> bridge_cycle_burn_txouts;
+	map<string, CFractions>          bridges_burn_fractions;
+	map<string, vector<CBridgeBurn>> bridge_cycle_burns;
 
 	// get list of Z burns over bridge interval
 	CBlockIndex* pindex_in_bridge_cycle = bridge_cycle_block;
@@ -840,67 +822,23 @@ bool ConnectBridgeCycleBurns(CPegDB&       pegdb,
 				// can calculate the leaf
 				CCompressedFractions fc1(fractions, section, pegsteps, microsteps);
 
-				char* addr_cstr = new char[dstaddr_str.length() + 1];
-				strcpy(addr_cstr, dstaddr_str.c_str());
-				char* txid_cstr = new char[txoutid_str.length() + 1];
-				strcpy(txid_cstr, txoutid_str.c_str());
-				size_t txid_len     = txoutid_str.length();
-				char*  abi_hex_cstr = NULL;
-				size_t abi_hexlen;
-
-				// abi start
-				struct eth_abi abi;
-				eth_abi_init(&abi, ETH_ABI_ENCODE);
-				eth_abi_address(&abi, &addr_cstr);
-				for (int i = 0; i < fc1.nPegSteps; i++) {
-					uint64_t psv = fc1.fps[i];
-					eth_abi_uint64(&abi, &psv);
-				}
-				for (int i = 0; i < fc1.nMicroSteps; i++) {
-					uint64_t msv = fc1.fms[i];
-					eth_abi_uint64(&abi, &msv);
-				}
-				eth_abi_bytes(&abi, (uint8_t**)(&txid_cstr), &txid_len);
-				eth_abi_to_hex(&abi, &abi_hex_cstr, &abi_hexlen);
-				eth_abi_free(&abi);
-				// abi end
-
-				uint8_t* abi_bin_data;
-				int      len_abi_bin = eth_hex_to_bytes(&abi_bin_data, abi_hex_cstr, abi_hexlen);
-				if (len_abi_bin <= 0) {
-					return false;
-				}
-				uint8_t keccak[32];
-				int     keccak_ok = eth_keccak256(keccak, (uint8_t*)abi_bin_data, len_abi_bin);
-				if (keccak_ok <= 0) {
-					return false;
-				}
-				char* leaf_hex_cstr;
-				int   leaf_hex_len = eth_hex_from_bytes(&leaf_hex_cstr, keccak, 32);
-				if (leaf_hex_len < 0) {
+				CBridgeBurn burn;
+				burn.txhash  = txhash;
+				burn.nout    = nout;
+				burn.address = dstaddr_str;
+				if (!ComputeBridgeBurnLeaf(dstaddr_str, fc1, txoutid_str, burn.leaf)) {
 					return false;
 				}
-				string leaf_hex        = string(leaf_hex_cstr);
-				string txout_addr_leaf = txout_to_addr + ":" + leaf_hex + ":" +
-				                         std::to_string(fc1.nPegSteps + fc1.nMicroSteps);
+				burn.reserve.reserve(fc1.nPegSteps + fc1.nMicroSteps);
 				for (int i = 0; i < fc1.nPegSteps; i++) {
-					uint64_t psv = fc1.fps[i];
-					txout_addr_leaf += ":" + std::to_string(psv);
+					burn.reserve.push_back(uint64_t(fc1.fps[i]));
 				}
 				for (int i = 0; i < fc1.nMicroSteps; i++) {
-					uint64_t msv = fc1.fms[i];
-					txout_addr_leaf += ":" + std::to_string(msv);
+					burn.reserve.push_back(uint64_t(fc1.fms[i]));
 				}
 
 				// collect in cycle burns with leaves
-				set<string>& bridge_cycle_burn_txouts_per_bridge = bridge_cycle_burn_txouts[brhash];
-				bridge_cycle_burn_txouts_per_bridge.insert(txout_addr_leaf);
-
-				delete[] addr_cstr;
-				delete[] txid_cstr;
-				free(abi_hex_cstr);
-				free(abi_bin_data);
-				free(leaf_hex_cstr);
+				bridge_cycle_burns[brhash].push_back(burn);
 			}
 		}
 
@@ -912,28 +850,19 @@ bool ConnectBridgeCycleBurns(CPegDB&       pegdb,
 	if (!pegdb.WriteBridgeCycleBridgeHashes(bhash_bridge_cycle, bridge_hashes))
 		return false;
 
-	// write bridge cycle burns txouts
-	for (const auto& it : bridge_cycle_burn_txouts) {
-		string             br_hash                             = it.first;
-		const set<string>& bridge_cycle_burn_txouts_per_bridge = it.second;
-		set<string>        bridge_cycle_burn_txouts_per_bridge_with_receipt;
+	// write bridge cycle burns with receipts
+	for (auto& it : bridge_cycle_burns) {
+		const string&        br_hash = it.first;
+		vector<CBridgeBurn>& burns   = it.second;
+		// burns sorted by leaves, index of a burn is the index of its leaf
+		auto leaf_lt = [](const CBridgeBurn& a, const CBridgeBurn& b) { return a.leaf < b.leaf; };
+		auto leaf_eq = [](const CBridgeBurn& a, const CBridgeBurn& b) { return a.leaf == b.leaf; };
+		sort(burns.begin(), burns.end(), leaf_lt);
+		burns.erase(unique(burns.begin(), burns.end(), leaf_eq), burns.end());
 		// build merkle tree
 		merkle::TreeT<32, sha256_keccak> tree;
-		set<string>                      leaves_sorted;
-		for (const string& txout_addr_leaf : bridge_cycle_burn_txouts_per_bridge) {
-			vector<string> args;
-			boost::split(args, txout_addr_leaf, boost::is_any_of(":"));
-			if (args.size() < 5)
-				return false;
-			string leaf = args[3];
-			leaves_sorted.insert(leaf);
-		}
-		int              idx = 0;
-		map<string, int> leaf_to_merkle_idx;
-		for (const string& leaf : leaves_sorted) {
-			tree.insert(leaf);
-			leaf_to_merkle_idx[leaf] = idx;
-			idx++;
+		for (const CBridgeBurn& burn : burns) {
+			tree.insert(burn.leaf.data());
 		}
 		auto   merkle_root = tree.root();
 		string merkle_str  = merkle_root.to_string();
@@ -943,29 +872,17 @@ bool ConnectBridgeCycleBurns(CPegDB&       pegdb,
 		                                  merkle_str + ":" + std::to_string(section)))
 			return false;
 		// get receipts ready
-		for (string txout_addr_leaf : bridge_cycle_burn_txouts_per_bridge) {
-			vector<string> args;
-			boost::split(args, txout_addr_leaf, boost::is_any_of(":"));
-			string         leaf = args[3];
-			int            idx  = leaf_to_merkle_idx[leaf];
-			vector<string> leaf_path_elms;
-			auto           leaf_path = tree.path(idx);
-			for (size_t i = 0; i < leaf_path->size(); i++) {
-				const auto& leaf_path_elm     = (*leaf_path)[i];
-				string      leaf_path_elm_txt = leaf_path_elm.to_string();
-				leaf_path_elms.push_back(leaf_path_elm_txt);
-			}
-			// +proofs
-			txout_addr_leaf += ":" + std::to_string(leaf_path_elms.size());
-			for (const string& proof_elm : leaf_path_elms) {
-				txout_addr_leaf += ":" + proof_elm;
+		for (size_t idx = 0; idx < burns.size(); idx++) {
+			auto                       leaf_path = tree.path(idx);
+			vector<CBridgeBurn::Hash>& proof     = burns[idx].proof;
+			for (const auto& leaf_path_elm : *leaf_path) {
+				CBridgeBurn::Hash h;
+				std::copy(leaf_path_elm.hash.bytes, leaf_path_elm.hash.bytes + 32, h.begin());
+				proof.push_back(h);
 			}
-			// data ready for bridge cycle
-			bridge_cycle_burn_txouts_per_bridge_with_receipt.insert(txout_addr_leaf);
 		}
 		// write for it for bridge cycle
-		if (!pegdb.WriteBridgeCycleBurnsToBridge(bhash_bridge_cycle, br_hash,
-		                                         bridge_cycle_burn_txouts_per_bridge_with_receipt))
+		if (!pegdb.WriteBridgeCycleBurnsToBridge(bhash_bridge_cycle, br_hash, burns))
 			return false;
 	}
 
@@ -988,6 +905,59 @@ bool ConnectBridgeCycleBurns(CPegDB&       pegdb,
 	return true;
 }
 
+/*!
+ * \brief ComputeBridgeBurnLeaf
+ * Leaf of a burn is keccak256 of abi encoded address, reserve values as
+ * uint64 and txoutid as bytes. The encoding is written straight into one
+ * buffer, it gives the same bytes as eth_abi_address, eth_abi_uint64 and
+ * eth_abi_bytes of libethc (which skips the address if it is not of 42 hex
+ * chars).
+ */
+bool ComputeBridgeBurnLeaf(const string&               address,
+                           const CCompressedFractions& fc,
+                           const string&               txoutid,
+                           CBridgeBurn::Hash&          leaf) {
+	const size_t nWord = 32;
+
+	bool   fAddress = address.size() >= 42;
+	size_t nAddrPos = boost::istarts_with(address, "0x") ? 2 : 0;
+	for (size_t i = nAddrPos; fAddress && i < 42; i++) {
+		fAddress = HexDigit(address[i]) >= 0;
+	}
+
+	size_t nHead = nWord * ((fAddress ? 1 : 0) + fc.nPegSteps + fc.nMicroSteps + 1);
+	size_t nData = (txoutid.size() + nWord - 1) / nWord * nWord;
+
+	vector<uint8_t> abi(nHead + nWord + nData, 0);
+	uint8_t*        word = abi.data();
+
+	auto put_uint = [&](uint64_t v) {
+		for (size_t i = 0; i < 8; i++) {
+			word[nWord - 1 - i] = (v >> (8 * i)) & 0xFF;
+		}
+		word += nWord;
+	};
+
+	if (fAddress) {
+		for (size_t i = 0; i < 20; i++) {
+			const char* hex = &address[nAddrPos + 2 * i];
+			word[12 + i]    = (HexDigit(hex[0]) << 4) | HexDigit(hex[1]);
+		}
+		word += nWord;
+	}
+	for (int i = 0; i < fc.nPegSteps; i++) {
+		put_uint(uint64_t(fc.fps[i]));
+	}
+	for (int i = 0; i < fc.nMicroSteps; i++) {
+		put_uint(uint64_t(fc.fms[i]));
+	}
+	put_uint(nHead);  // offset of txoutid bytes
+	put_uint(txoutid.size());
+	memcpy(word, txoutid.data(), txoutid.size());
+
+	return eth_keccak256(leaf.data(), abi.data(), abi.size()) > 0;
+}
+
 bool ComputeMintMerkleLeaf(const string&   dest_addr_str,
                            vector<int64_t> sections,
                            int             section_peg,
@@ -0,0 +1,119 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pegcache.h"
+
+CPegFractionsCache::CPegFractionsCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn) {}
+
+CPegFractionsCache::Shard& CPegFractionsCache::ShardOf(const uint320& txout) {
+	return shards[TxOutHasher()(txout) % NUM_SHARDS];
+}
+
+const CPegFractionsCache::Shard& CPegFractionsCache::ShardOf(const uint320& txout) const {
+	return shards[TxOutHasher()(txout) % NUM_SHARDS];
+}
+
+// memory of entry with list and map nodes overhead
+size_t CPegFractionsCache::EntryBytes(const CFractions& f) {
+	return sizeof(std::pair<uint320, CFractions>) + 8 * sizeof(void*) + f.f.DynamicUsage() +
+	       f.sReturnAddr.capacity();
+}
+
+void CPegFractionsCache::SetMaxBytes(size_t nMaxBytesIn) {
+	nMaxBytes = nMaxBytesIn;
+	for (Shard& shard : shards) {
+		LOCK(shard.cs);
+		Evict(shard, nMaxBytesIn / NUM_SHARDS);
+	}
+}
+
+bool CPegFractionsCache::Get(const uint320& txout, CFractions& f) {
+	Shard& shard = ShardOf(txout);
+	LOCK(shard.cs);
+	auto it = shard.index.find(txout);
+	if (it == shard.index.end()) {
+		shard.nMisses++;
+		return false;
+	}
+	shard.nHits++;
+	shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+	f = it->second->second;
+	return true;
+}
+
+uint64_t CPegFractionsCache::Generation(const uint320& txout) const {
+	const Shard& shard = ShardOf(txout);
+	LOCK(shard.cs);
+	return shard.nGeneration;
+}
+
+void CPegFractionsCache::Put(const uint320& txout, const CFractions& f, uint64_t nGeneration) {
+	size_t nShardMaxBytes = nMaxBytes / NUM_SHARDS;
+	if (EntryBytes(f) > nShardMaxBytes)
+		return;
+
+	Shard& shard = ShardOf(txout);
+	LOCK(shard.cs);
+	if (shard.nGeneration != nGeneration)
+		return;  // invalidated while reading disk
+	if (shard.index.count(txout))
+		return;
+	shard.lru.emplace_front(txout, f);
+	shard.index[txout] = shard.lru.begin();
+	shard.nBytes += EntryBytes(shard.lru.front().second);
+	Evict(shard, nShardMaxBytes);
+}
+
+void CPegFractionsCache::Invalidate(const uint320& txout) {
+	Shard& shard = ShardOf(txout);
+	LOCK(shard.cs);
+	shard.nGeneration++;
+	auto it = shard.index.find(txout);
+	if (it == shard.index.end())
+		return;
+	shard.nBytes -= EntryBytes(it->second->second);
+	shard.lru.erase(it->second);
+	shard.index.erase(it);
+	shard.nInvalidations++;
+}
+
+void CPegFractionsCache::Clear() {
+	for (Shard& shard : shards) {
+		LOCK(shard.cs);
+		shard.nGeneration++;
+		shard.lru.clear();
+		shard.index.clear();
+		shard.nBytes = 0;
+	}
+}
+
+void CPegFractionsCache::Evict(Shard& shard, size_t nShardMaxBytes) {
+	while (shard.nBytes > nShardMaxBytes && !shard.lru.empty()) {
+		auto& last = shard.lru.back();
+		shard.nBytes -= EntryBytes(last.second);
+		shard.index.erase(last.first);
+		shard.lru.pop_back();
+		shard.nEvictions++;
+	}
+}
+
+CPegCacheStats CPegFractionsCache::Stats() const {
+	CPegCacheStats stats;
+	stats.nMaxBytes = nMaxBytes;
+	for (const Shard& shard : shards) {
+		LOCK(shard.cs);
+		stats.nHits += shard.nHits;
+		stats.nMisses += shard.nMisses;
+		stats.nEvictions += shard.nEvictions;
+		stats.nInvalidations += shard.nInvalidations;
+		stats.nEntries += shard.index.size();
+		stats.nBytes += shard.nBytes;
+	}
+	return stats;
+}
+
+CPegFractionsCache& PegFractionsCache() {
+	static CPegFractionsCache cache;
+	return cache;
+}
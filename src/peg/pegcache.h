@@ -0,0 +1,76 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITBAY_PEGCACHE_H
+#define BITBAY_PEGCACHE_H
+
+#include "pegdata.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+struct CPegCacheStats {
+	uint64_t nHits          = 0;
+	uint64_t nMisses        = 0;
+	uint64_t nEvictions     = 0;
+	uint64_t nInvalidations = 0;
+	size_t   nEntries       = 0;
+	size_t   nBytes         = 0;
+	size_t   nMaxBytes      = 0;
+};
+
+/** Cache of decoded fractions of pegdb keyed by txout. It is split into
+ *  shards with own lock and LRU list, memory budget is divided evenly.
+ *  Only values of committed database are cached: a reader takes shard
+ *  generation before reading disk and Put is ignored when the key was
+ *  invalidated meanwhile.
+ */
+class CPegFractionsCache {
+public:
+	enum { NUM_SHARDS = 16 };
+
+	CPegFractionsCache(size_t nMaxBytes = 64 * 1048576);
+
+	void           SetMaxBytes(size_t nMaxBytes);
+	bool           Get(const uint320& txout, CFractions& f);
+	uint64_t       Generation(const uint320& txout) const;
+	void           Put(const uint320& txout, const CFractions& f, uint64_t nGeneration);
+	void           Invalidate(const uint320& txout);
+	void           Clear();
+	CPegCacheStats Stats() const;
+
+private:
+	struct TxOutHasher {
+		size_t operator()(const uint320& k) const { return k.GetLow64() ^ k.b2(); }
+	};
+	typedef std::list<std::pair<uint320, CFractions>> LruList;
+
+	struct Shard {
+		mutable CCriticalSection                                    cs;
+		LruList                                                     lru;
+		std::unordered_map<uint320, LruList::iterator, TxOutHasher> index;
+		size_t                                                      nBytes         = 0;
+		uint64_t                                                    nGeneration    = 0;
+		uint64_t                                                    nHits          = 0;
+		uint64_t                                                    nMisses        = 0;
+		uint64_t                                                    nEvictions     = 0;
+		uint64_t                                                    nInvalidations = 0;
+	};
+
+
+	Shard&        ShardOf(const uint320& txout);
+	const Shard&  ShardOf(const uint320& txout) const;
+	static size_t EntryBytes(const CFractions& f);
+	void          Evict(Shard& shard, size_t nShardMaxBytes);
+
+	Shard               shards[NUM_SHARDS];
+	std::atomic<size_t> nMaxBytes;
+};
+
+CPegFractionsCache& PegFractionsCache();
+
+#endif
@@ -0,0 +1,132 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pegcycle.h"
+
+#include "main.h"
+#include "pegdb-leveldb.h"
+
+void CPegCycleState::Read(CPegDB& pegdb, const CBlockIndex* pindex) {
+	hashCycleBlock   = pindex->PegCycleBlock()->GetBlockHash();
+	fPrePeg          = pindex->nHeight <= nPegStartHeight;
+	fBridgesMap      = pindex->ReadBridgesMap(pegdb, bridgesMap);
+	fBridges         = pindex->ReadBridges(pegdb, bridges);
+	fBridgesPause    = pindex->ReadBridgesPause(pegdb, fPaused);
+	fTrustedStakers1 = pindex->ReadTrustedStakers1(pegdb, trustedstakers1);
+	fTimeLockPasses  = pindex->ReadTimeLockPasses(pegdb, timelockpasses);
+}
+
+CMerkleInfo CPegCycleState::MerkleIn(CPegDB& pegdb, const std::string& hash) const {
+	CMerkleRecord record;
+	bool          fFound = false;
+	{
+		LOCK(cs);
+		auto it = mapMerkles.find(hash);
+		if (it != mapMerkles.end()) {
+			record = it->second;
+			fFound = true;
+		}
+	}
+	if (!fFound) {
+		record.fBlockHash = pegdb.ReadMapItemBlockHash1("ACCEPTED_MERKLES", hash, record.blockHash);
+		std::string merkle_data;
+		record.fData = pegdb.ReadMapItemData1("ACCEPTED_MERKLES", hash, merkle_data);
+		if (record.fData)
+			record.merkle = CMerkleInfo(merkle_data);
+		LOCK(cs);
+		if (mapMerkles.size() < MAX_MERKLES)
+			mapMerkles[hash] = record;
+	}
+
+	CMerkleInfo skip;
+	if (!record.fBlockHash)
+		return skip;
+	// block_hash to be in mainchain
+	CBlockIndex* pindex = mapBlockIndex.ref(record.blockHash);
+	if (!pindex)
+		return skip;
+	if (!pindex->IsInMainChain())
+		return skip;
+	if (!record.fData)
+		return skip;
+	return record.merkle;
+}
+
+CPegCycleStateRef CPegCycleStates::Find(const uint256& hashCycleBlock, bool fPrePeg) {
+	LOCK(cs);
+	for (auto it = lru.begin(); it != lru.end(); ++it) {
+		const CPegCycleStateRef& state = *it;
+		if (state->hashCycleBlock != hashCycleBlock || state->fPrePeg != fPrePeg)
+			continue;
+		nHits++;
+		lru.splice(lru.begin(), lru, it);
+		return lru.front();
+	}
+	nMisses++;
+	return nullptr;
+}
+
+uint64_t CPegCycleStates::Generation() const {
+	LOCK(cs);
+	return nGeneration;
+}
+
+void CPegCycleStates::Put(const CPegCycleStateRef& state, uint64_t nGenerationIn) {
+	LOCK(cs);
+	if (nGeneration != nGenerationIn)
+		return;  // cycle states written while reading pegdb
+	for (auto it = lru.begin(); it != lru.end(); ++it) {
+		if ((*it)->hashCycleBlock == state->hashCycleBlock && (*it)->fPrePeg == state->fPrePeg) {
+			lru.erase(it);
+			break;
+		}
+	}
+	lru.push_front(state);
+	while (lru.size() > MAX_ENTRIES)
+		lru.pop_back();
+}
+
+void CPegCycleStates::Invalidate() {
+	LOCK(cs);
+	nGeneration++;
+	if (lru.empty())
+		return;
+	lru.clear();
+	nInvalidations++;
+}
+
+CPegCycleCacheStats CPegCycleStates::Stats() const {
+	CPegCycleCacheStats stats;
+	LOCK(cs);
+	stats.nHits          = nHits;
+	stats.nMisses        = nMisses;
+	stats.nInvalidations = nInvalidations;
+	stats.nEntries       = lru.size();
+	for (const CPegCycleStateRef& state : lru) {
+		LOCK(state->cs);
+		stats.nMerkles += state->mapMerkles.size();
+	}
+	return stats;
+}
+
+CPegCycleStates& PegCycleStates() {
+	static CPegCycleStates states;
+	return states;
+}
+
+CPegCycleStateRef GetPegCycleState(CPegDB& pegdb, const CBlockIndex* pindex) {
+	CPegCycleStates& states    = PegCycleStates();
+	uint256          hashCycle = pindex->PegCycleBlock()->GetBlockHash();
+	bool             fPrePeg   = pindex->nHeight <= nPegStartHeight;
+
+	CPegCycleStateRef state = states.Find(hashCycle, fPrePeg);
+	if (state)
+		return state;
+
+	uint64_t                        nGeneration = states.Generation();
+	std::shared_ptr<CPegCycleState> stateNew    = std::make_shared<CPegCycleState>();
+	stateNew->Read(pegdb, pindex);
+	states.Put(stateNew, nGeneration);
+	return stateNew;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITBAY_PEGCYCLE_H
+#define BITBAY_PEGCYCLE_H
+
+#include "pegdata.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class CBlockIndex;
+class CPegDB;
+
+struct CPegCycleCacheStats {
+	uint64_t nHits          = 0;
+	uint64_t nMisses        = 0;
+	uint64_t nInvalidations = 0;
+	size_t   nEntries       = 0;
+	size_t   nMerkles       = 0;
+};
+
+/** Consensus state of a peg cycle: accepted bridges, trusted stakers and
+ *  timelock passes of its cycle block and the accepted merkles looked up so
+ *  far. The state is written by ConnectConsensusStates at cycle blocks only,
+ *  so one snapshot serves all blocks of the cycle. Flags keep the results of
+ *  the reads of CBlockIndex, pre-peg blocks see empty bridges and timelock
+ *  passes. Published snapshots are not changed except for memoized merkles.
+ */
+class CPegCycleState {
+public:
+	uint256                                         hashCycleBlock;
+	bool                                            fPrePeg          = false;
+	bool                                            fBridgesMap      = false;
+	bool                                            fBridges         = false;
+	bool                                            fBridgesPause    = false;
+	bool                                            fTrustedStakers1 = false;
+	bool                                            fTimeLockPasses  = false;
+	bool                                            fPaused          = false;
+	std::map<std::string, std::vector<std::string>> bridgesMap;
+	std::map<std::string, CBridgeInfo>              bridges;
+	std::set<std::string>                           trustedstakers1;
+	std::set<std::string>                           timelockpasses;
+
+	void Read(CPegDB& pegdb, const CBlockIndex* pindex);
+
+	/** Same as CBlockIndex::ReadMerkleIn. Records of pegdb are memoized,
+	 *  the main chain check of the accepting block is done on every call.
+	 */
+	CMerkleInfo MerkleIn(CPegDB& pegdb, const std::string& hash) const;
+
+private:
+	enum { MAX_MERKLES = 10000 };
+
+	struct CMerkleRecord {
+		bool        fBlockHash = false;
+		bool        fData      = false;
+		uint256     blockHash;
+		CMerkleInfo merkle;
+	};
+
+	mutable CCriticalSection                     cs;
+	mutable std::map<std::string, CMerkleRecord> mapMerkles;
+
+	friend class CPegCycleStates;
+};
+
+typedef std::shared_ptr<const CPegCycleState> CPegCycleStateRef;
+
+/** Snapshots of the latest peg cycles keyed by cycle block. Any write of
+ *  cycle states to pegdb drops all of them (the reorganized chains rewrite
+ *  the states of their cycle blocks). A reader takes the generation before
+ *  reading pegdb and Put is ignored when it was invalidated meanwhile.
+ */
+class CPegCycleStates {
+public:
+	enum { MAX_ENTRIES = 4 };
+
+	CPegCycleStateRef   Find(const uint256& hashCycleBlock, bool fPrePeg);
+	uint64_t            Generation() const;
+	void                Put(const CPegCycleStateRef& state, uint64_t nGeneration);
+	void                Invalidate();
+	CPegCycleCacheStats Stats() const;
+
+private:
+	mutable CCriticalSection     cs;
+	std::list<CPegCycleStateRef> lru;
+	uint64_t                     nGeneration    = 0;
+	uint64_t                     nHits          = 0;
+	uint64_t                     nMisses        = 0;
+	uint64_t                     nInvalidations = 0;
+};
+
+CPegCycleStates& PegCycleStates();
+
+/** Snapshot of the cycle of pindex, read from pegdb on first use. */
+CPegCycleStateRef GetPegCycleState(CPegDB& pegdb, const CBlockIndex* pindex);
+
+#endif
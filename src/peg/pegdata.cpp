@@ -176,3 +176,99 @@ CMerkleInfo::CMerkleInfo(std::string data) : amount(0), ntime(0) {
 		ntime  = strtoll(args[4].c_str(), 0, 0);
 	}
 }
+
+std::string CBridgeBurn::TxOutId() const {
+	return txhash.GetHex() + ":" + std::to_string(nout);
+}
+
+std::string CBridgeBurn::LeafHex() const {
+	return HexStr(leaf.begin(), leaf.end());
+}
+
+std::string CBridgeBurn::ToString() const {
+	string data = TxOutId() + ":" + address + ":" + LeafHex();
+	data += ":" + std::to_string(reserve.size());
+	for (uint64_t v : reserve) {
+		data += ":" + std::to_string(v);
+	}
+	data += ":" + std::to_string(proof.size());
+	for (const Hash& h : proof) {
+		data += ":" + HexStr(h.begin(), h.end());
+	}
+	return data;
+}
+
+static bool ParseBridgeHash(const string& hex, CBridgeBurn::Hash& h) {
+	if (hex.size() != 64 || !IsHex(hex))
+		return false;
+	vector<unsigned char> bytes = ParseHex(hex);
+	std::copy(bytes.begin(), bytes.end(), h.begin());
+	return true;
+}
+
+// txhash:nout:address:leaf:N:reserve1..reserveN:P:proof1..proofP
+bool CBridgeBurn::FromString(const std::string& data) {
+	vector<string> args;
+	boost::split(args, data, boost::is_any_of(":"));
+	if (args.size() < 6)
+		return false;
+	size_t nReserve = strtoul(args[4].c_str(), 0, 10);
+	if (args.size() < 5 + nReserve + 1)
+		return false;
+	size_t nProof = strtoul(args[5 + nReserve].c_str(), 0, 10);
+	if (args.size() != 5 + nReserve + 1 + nProof)
+		return false;
+
+	txhash.SetHex(args[0]);
+	nout    = std::atoi(args[1].c_str());
+	address = args[2];
+	if (!ParseBridgeHash(args[3], leaf))
+		return false;
+	reserve.resize(nReserve);
+	for (size_t i = 0; i < nReserve; i++) {
+		reserve[i] = strtoull(args[5 + i].c_str(), 0, 10);
+	}
+	proof.resize(nProof);
+	for (size_t i = 0; i < nProof; i++) {
+		if (!ParseBridgeHash(args[5 + nReserve + 1 + i], proof[i]))
+			return false;
+	}
+	return true;
+}
+
+bool CBridgeBurn::Pack(CDataStream& fout) const {
+	fout << nVersion;
+	fout << txhash;
+	fout << nout;
+	fout << address;
+	fout.write((const char*)leaf.data(), leaf.size());
+	fout << reserve;
+	WriteCompactSize(fout, proof.size());
+	for (const Hash& h : proof) {
+		fout.write((const char*)h.data(), h.size());
+	}
+	return true;
+}
+
+bool CBridgeBurn::Unpack(CDataStream& finp) {
+	try {
+		finp >> nVersion;
+		if (nVersion != 1)
+			return false;
+		finp >> txhash;
+		finp >> nout;
+		finp >> address;
+		finp.read((char*)leaf.data(), leaf.size());
+		finp >> reserve;
+		uint64_t nProof = ReadCompactSize(finp);
+		if (nProof > finp.size() / sizeof(Hash))
+			return false;
+		proof.resize(nProof);
+		for (Hash& h : proof) {
+			finp.read((char*)h.data(), h.size());
+		}
+	} catch (std::exception&) {
+		return false;
+	}
+	return true;
+}
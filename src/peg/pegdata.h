@@ -9,8 +9,11 @@
 #ifndef BITBAY_PEGDATA_H
 #define BITBAY_PEGDATA_H
 
+#include <array>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 #include "bignum.h"
 
 enum {
@@ -79,6 +82,56 @@ private:
 	bool Unpack1(CDataStream&);
 };
 
+/** Slots of CFractions. Only a window [nFrom, nTo) of slots is materialized,
+ *  all slots outside of the window are zeros. A window of one slot (value
+ *  fractions) is kept inline, wider windows are allocated with exact size.
+ *  Copies trim zero slots at both ends of the window. Slots are read by value,
+ *  Set of a slot outside of the window expands the storage to all PEG_SIZE
+ *  slots.
+ */
+class CFractionSlots {
+public:
+	CFractionSlots() {}
+	CFractionSlots(const CFractionSlots&);
+	CFractionSlots(CFractionSlots&&) noexcept;
+	CFractionSlots& operator=(const CFractionSlots&);
+	CFractionSlots& operator=(CFractionSlots&&) noexcept;
+
+	int64_t operator[](int i) const {
+		return (i >= nFrom && i < nTo) ? Data()[i - nFrom] : 0;
+	}
+	void Set(int i, int64_t v) {
+		if (i < nFrom || i >= nTo)
+			Touch(i);
+		Data()[i - nFrom] = v;
+	}
+
+	int            From() const { return nFrom; }
+	int            To() const { return nTo; }
+	bool           IsInline() const { return !p; }
+	const int64_t* Data() const { return p ? p.get() : &nInline; }
+	int64_t*       Data() { return p ? p.get() : &nInline; }
+
+	int64_t* get();
+	void     Clear();
+	void     SetValue(int64_t v);
+	void     Set(const int64_t* src);
+	void     Assign(const CFractionSlots& o, int from, int to);
+	void     Cover(int from, int to);
+	void     CopyTo(int64_t* out) const;
+	int64_t  Sum(int from, int to) const;
+	size_t   DynamicUsage() const;
+
+private:
+	void Touch(int i);
+	void Reset(const int64_t* src, int from, int to);
+
+	int16_t                    nFrom   = 0;
+	int16_t                    nTo     = 1;
+	int64_t                    nInline = 0;
+	std::unique_ptr<int64_t[]> p;
+};
+
 class CFractions {
 public:
 	uint8_t     nVersion  = 1;
@@ -94,15 +147,23 @@ public:
 		NOTARY_C = (1 << 5)
 	};
 	enum MarkAction { MARK_SET = 0, MARK_TRANSFER = 1, MARK_COLD_TO_FROZEN = 2 };
-	enum { SER_MASK = 0xffff, SER_VALUE = (1 << 16), SER_ZDELTA = (1 << 17), SER_RAW = (1 << 18) };
-	std::unique_ptr<int64_t[]> f;
+	enum {
+		SER_MASK   = 0xffff,
+		SER_VALUE  = (1 << 16),
+		SER_ZDELTA = (1 << 17),
+		SER_RAW    = (1 << 18),
+		SER_VDELTA = (1 << 19)  // varint zigzag deltas with runs of zeros
+	};
+	CFractionSlots f;
 
 	CFractions();
 	CFractions(int64_t, uint32_t flags);
 	CFractions(const CFractions&);
+	CFractions(CFractions&&) noexcept = default;
 	CFractions& operator=(const CFractions&);
+	CFractions& operator=(CFractions&&) noexcept = default;
 
-	bool Pack(CDataStream&, unsigned long* len = nullptr, bool compress = true) const;
+	bool Pack(CDataStream&, unsigned long* len = nullptr, uint32_t nSerCodec = SER_ZDELTA) const;
 	bool Unpack(CDataStream&);
 
 	CFractions Std() const;
@@ -134,6 +195,9 @@ public:
 	void ToDeltas(int64_t* deltas) const;
 	void FromDeltas(const int64_t* deltas);
 
+	// totals of the parts without allocating fractions: value fractions walk
+	// the standard distribution in place
+	int64_t Slot(int i) const;
 	int64_t Low(int supply) const;
 	int64_t High(int supply) const;
 	int64_t Low(const CPegLevel&) const;
@@ -225,4 +289,30 @@ public:
 	std::string Serialize() const;
 };
 
+/** Burn of a txout to a bridge over a bridge cycle: the merkle leaf of the
+ *  burn, the reserve (compressed fractions, peg steps then micro steps) and
+ *  the merkle proof of the leaf. Hashes are kept in abi byte order. The
+ *  string form is the colon-joined record of pegdb before the binary one.
+ */
+class CBridgeBurn {
+public:
+	typedef std::array<uint8_t, 32> Hash;
+
+	uint8_t               nVersion = 1;
+	uint256               txhash;
+	int                   nout = 0;
+	std::string           address;
+	Hash                  leaf = {};
+	std::vector<uint64_t> reserve;
+	std::vector<Hash>     proof;
+
+	std::string TxOutId() const;
+	std::string LeafHex() const;
+	std::string ToString() const;
+	bool        FromString(const std::string& data);
+
+	bool Pack(CDataStream& fout) const;
+	bool Unpack(CDataStream& finp);
+};
+
 #endif
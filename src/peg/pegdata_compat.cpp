@@ -39,8 +39,10 @@ bool CFractions::Unpack2(CDataStream& inp)
     inp >> nSerFlags;
     inp >> nLockTime;
     if (nSerFlags & SER_VALUE) {
+        int64_t nValue = 0;
+        inp >> nValue;
+        f.SetValue(nValue);
         nFlags = nSerFlags | VALUE;
-        inp >> f[0];
     }
     else if (nSerFlags & SER_ZDELTA) {
         unsigned long zlen = 0;
@@ -85,8 +87,10 @@ bool CFractions::Unpack1(CDataStream& inp)
     inp >> nSerFlags;
     inp >> nLockTime;
     if (nSerFlags & SER_VALUE) {
+        int64_t nValue = 0;
+        inp >> nValue;
+        f.SetValue(nValue);
         nFlags = nSerFlags | VALUE;
-        inp >> f[0];
     }
     else if (nSerFlags & SER_ZDELTA) {
         unsigned long zlen = 0;
@@ -19,6 +19,8 @@
 #include "chainparams.h"
 #include "kernel.h"
 #include "main.h"
+#include "pegcache.h"
+#include "pegcycle.h"
 #include "txdb.h"
 #include "util.h"
 
@@ -34,14 +36,6 @@ namespace fs = boost::filesystem;
 
 leveldb::DB* pegdb;  // global pointer for LevelDB object instance
 
-static leveldb::Options GetOptions() {
-	leveldb::Options options;
-	int              nCacheSizeMB = GetArg("-dbcache", 50);
-	options.block_cache           = leveldb::NewLRUCache(nCacheSizeMB * 1048576);
-	options.filter_policy         = leveldb::NewBloomFilterPolicy(10);
-	return options;
-}
-
 static void init_blockindex(leveldb::Options& options,
                             bool              fRemoveOld       = false,
                             bool              fCreateBootstrap = false) {
@@ -70,13 +64,14 @@ CPegDB::CPegDB(const char* pszMode) {
 
 	bool fCreate = strchr(pszMode, 'c');
 
-	options                   = GetOptions();
+	options                   = GetDbOptions(GetDbTuning("peg"));
 	options.create_if_missing = fCreate;
-	options.filter_policy     = leveldb::NewBloomFilterPolicy(10);
 
 	init_blockindex(options);  // Init directory
 	pdb = pegdb;
 
+	PegFractionsCache().SetMaxBytes(GetArg("-pegcachesize", 64) * 1048576);
+
 	if (Exists(string("version"))) {
 		ReadVersion(nVersion);
 		LogPrintf("Peg index version is %d\n", nVersion);
@@ -96,12 +91,14 @@ CPegDB::CPegDB(const char* pszMode) {
 			bool fTmp = fReadOnly;
 			fReadOnly = false;
 			WriteVersion(DATABASE_VERSION);  // Save transaction index version
+			WriteFractionsUpgraded(true);
 			fReadOnly = fTmp;
 		}
 	} else if (fCreate) {
 		bool fTmp = fReadOnly;
 		fReadOnly = false;
 		WriteVersion(DATABASE_VERSION);
+		WriteFractionsUpgraded(true);
 		fReadOnly = fTmp;
 	}
 
@@ -109,6 +106,8 @@ CPegDB::CPegDB(const char* pszMode) {
 }
 
 void CPegDB::Close() {
+	PegFractionsCache().Clear();
+	PegCycleStates().Invalidate();
 	delete pegdb;
 	pegdb = pdb = NULL;
 	delete options.filter_policy;
@@ -117,6 +116,7 @@ void CPegDB::Close() {
 	options.block_cache = NULL;
 	delete activeBatch;
 	activeBatch = NULL;
+	mapBatchChanges.clear();
 }
 
 bool CPegDB::TxnBegin() {
@@ -130,6 +130,12 @@ bool CPegDB::TxnCommit() {
 	leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
 	delete activeBatch;
 	activeBatch = NULL;
+	mapBatchChanges.clear();
+	InvalidateBatchFractions();
+	if (fBatchCycleStates) {
+		fBatchCycleStates = false;
+		PegCycleStates().Invalidate();
+	}
 	if (!status.ok()) {
 		LogPrintf("LevelDB batch commit failure: %s\n", status.ToString());
 		return false;
@@ -137,53 +143,62 @@ bool CPegDB::TxnCommit() {
 	return true;
 }
 
-class CPegBatchScanner : public leveldb::WriteBatch::Handler {
-public:
-	std::string  needle;
-	bool*        deleted;
-	std::string* foundValue;
-	bool         foundEntry;
-
-	CPegBatchScanner() : foundEntry(false) {}
-
-	virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value) {
-		if (key.ToString() == needle) {
-			foundEntry  = true;
-			*deleted    = false;
-			*foundValue = value.ToString();
-		}
-	}
-
-	virtual void Delete(const leveldb::Slice& key) {
-		if (key.ToString() == needle) {
-			foundEntry = true;
-			*deleted   = true;
-		}
+bool CPegDB::TxnAbort() {
+	delete activeBatch;
+	activeBatch = NULL;
+	mapBatchChanges.clear();
+	InvalidateBatchFractions();
+	if (fBatchCycleStates) {
+		fBatchCycleStates = false;
+		PegCycleStates().Invalidate();
 	}
-};
+	return true;
+}
 
 // When performing a read, if we have an active batch we need to check it first
 // before reading from the database, as the rest of the code assumes that once
-// a database transaction begins reads are consistent with it. It would be good
-// to change that assumption in future and avoid the performance hit, though in
-// practice it does not appear to be large.
+// a database transaction begins reads are consistent with it. The changes of
+// the batch are mirrored in a sorted map, so this is a lookup, not a scan.
 bool CPegDB::ScanBatch(const CDataStream& key, string* value, bool* deleted) const {
 	assert(activeBatch);
 	*deleted = false;
-	CPegBatchScanner scanner;
-	scanner.needle         = key.str();
-	scanner.deleted        = deleted;
-	scanner.foundValue     = value;
-	leveldb::Status status = activeBatch->Iterate(&scanner);
-	if (!status.ok()) {
-		throw runtime_error(status.ToString());
-	}
-	return scanner.foundEntry;
+	auto it  = mapBatchChanges.find(key.str());
+	if (it == mapBatchChanges.end())
+		return false;
+	if (it->second.fErased)
+		*deleted = true;
+	else
+		*value = it->second.value;
+	return true;
 }
 
 bool CPegDB::ReadFractions(uint320 txout, CFractions& f, bool must_have) {
+	CPegFractionsCache& cache = PegFractionsCache();
+
+	CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+	ssKey << txout;
 	std::string strValue;
-	if (!ReadStr(txout, strValue)) {
+	bool        fInBatch    = false;
+	bool        fFound      = true;
+	uint64_t    nGeneration = 0;
+	if (activeBatch) {
+		// Pending changes of the batch are not cached
+		bool deleted = false;
+		fInBatch     = ScanBatch(ssKey, &strValue, &deleted);
+		fFound       = !deleted;
+	}
+	if (fFound && !fInBatch) {
+		if (cache.Get(txout, f))
+			return true;
+		nGeneration            = cache.Generation(txout);
+		leveldb::Status status = pdb->Get(leveldb::ReadOptions(), ssKey.str(), &strValue);
+		if (!status.ok()) {
+			if (!status.IsNotFound())
+				LogPrintf("LevelDB read failure: %s\n", status.ToString());
+			fFound = false;
+		}
+	}
+	if (!fFound) {
 		if (must_have) {
 			// Have a flag indicating that pegdb should have these
 			// fractions, otherwise it indicates the pegdb fail
@@ -194,12 +209,195 @@ bool CPegDB::ReadFractions(uint320 txout, CFractions& f, bool must_have) {
 		return true;
 	}
 	CDataStream finp(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-	return f.Unpack(finp);
+	if (!f.Unpack(finp))
+		return false;
+	if (!fInBatch)
+		cache.Put(txout, f, nGeneration);
+	return true;
 }
+// Reads fractions of several txouts in one pass: pending changes are taken
+// from the batch changes, then the cache is used and the rest is read
+// with one iterator moving forward over the sorted keys. Only found fractions
+// are returned.
+bool CPegDB::ReadFractions(const std::vector<uint320>& vTxOuts, MapFractions& mapFractionsRet) {
+	CPegFractionsCache& cache = PegFractionsCache();
+
+	std::map<std::string, uint320> mapKeys;
+	for (const uint320& txout : vTxOuts) {
+		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+		ssKey << txout;
+		mapKeys[ssKey.str()] = txout;
+	}
+
+	leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+	for (const auto& item : mapKeys) {
+		const uint320& txout = item.second;
+		std::string    strValue;
+		uint64_t       nGeneration = 0;
+		auto           mi          = mapBatchChanges.find(item.first);
+		bool           fInBatch    = mi != mapBatchChanges.end();
+		if (fInBatch) {
+			if (mi->second.fErased)
+				continue;  // deleted
+			strValue = mi->second.value;
+		} else {
+			CFractions f;
+			if (cache.Get(txout, f)) {
+				mapFractionsRet[txout] = f;
+				continue;
+			}
+			nGeneration = cache.Generation(txout);
+			iterator->Seek(item.first);
+			if (!iterator->Valid() || iterator->key().compare(item.first) != 0)
+				continue;  // not found
+			strValue = iterator->value().ToString();
+		}
+		CDataStream finp(strValue.data(), strValue.data() + strValue.size(), SER_DISK,
+		                 CLIENT_VERSION);
+		CFractions  f;
+		if (!f.Unpack(finp))
+			continue;
+		if (!fInBatch)
+			cache.Put(txout, f, nGeneration);
+		mapFractionsRet[txout] = f;
+	}
+	bool fOk = iterator->status().ok();
+	delete iterator;
+	return fOk;
+}
+
 bool CPegDB::WriteFractions(uint320 txout, const CFractions& f) {
 	CDataStream fout(SER_DISK, CLIENT_VERSION);
-	f.Pack(fout);
-	return Write(txout, fout);
+	f.Pack(fout, nullptr, CFractions::SER_VDELTA);
+	bool ok = Write(txout, fout);
+	InvalidateFractions(txout);
+	return ok;
+}
+
+bool CPegDB::EraseFractions(uint320 txout) {
+	bool ok = Erase(txout);
+	InvalidateFractions(txout);
+	return ok;
+}
+
+// Batched changes invalidate the cache on commit or abort of the batch
+void CPegDB::InvalidateFractions(uint320 txout) {
+	if (activeBatch) {
+		setBatchFractions.insert(txout);
+		return;
+	}
+	PegFractionsCache().Invalidate(txout);
+}
+
+void CPegDB::InvalidateBatchFractions() {
+	for (const uint320& txout : setBatchFractions) {
+		PegFractionsCache().Invalidate(txout);
+	}
+	setBatchFractions.clear();
+}
+
+// Snapshots are dropped right away (reads of this db see the batch) and again
+// on commit or abort of the batch
+void CPegDB::InvalidateCycleStates() {
+	if (activeBatch)
+		fBatchCycleStates = true;
+	PegCycleStates().Invalidate();
+}
+
+bool CPegDB::ReadFractionsUpgraded(bool& fUpgraded) {
+	return Read(string("fractionsUpgraded"), fUpgraded);
+}
+
+bool CPegDB::WriteFractionsUpgraded(bool fUpgraded) {
+	return Write(string("fractionsUpgraded"), fUpgraded);
+}
+
+// Rewrites fractions packed with zlib (SER_ZDELTA) into SER_VDELTA, scanning
+// no more than nMaxKeys keys starting from sKey. On return sKey is the key to
+// continue from, fEnd is set when whole database is scanned.
+bool CPegDB::UpgradeFractions(std::string& sKey, int nMaxKeys, int& nUpgraded, bool& fEnd) {
+	assert(!activeBatch);
+	nUpgraded = 0;
+	fEnd      = false;
+
+	leveldb::WriteBatch batch;
+	leveldb::Iterator*  iterator = pdb->NewIterator(ScanReadOptions());
+	iterator->Seek(sKey);
+	for (int i = 0; i < nMaxKeys && iterator->Valid(); i++, iterator->Next()) {
+		leveldb::Slice key = iterator->key();
+		if (key.size() != sizeof(uint320))
+			continue;
+		leveldb::Slice value = iterator->value();
+		CDataStream    finp(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+		CFractions     f;
+		try {
+			CDataStream fhead(finp);
+			uint8_t     nVersion  = 0;
+			uint32_t    nSerFlags = 0;
+			fhead >> nVersion;
+			fhead >> nSerFlags;
+			if ((nSerFlags & CFractions::SER_ZDELTA) == 0)
+				continue;
+			if (!f.Unpack(finp) || !finp.empty())
+				continue;  // not fractions
+		} catch (std::exception& e) {
+			continue;
+		}
+		CDataStream fout(SER_DISK, CLIENT_VERSION);
+		f.Pack(fout, nullptr, CFractions::SER_VDELTA);
+		batch.Put(key, fout.str());
+		nUpgraded++;
+	}
+	if (iterator->Valid()) {
+		sKey = iterator->key().ToString();
+	} else {
+		fEnd = true;
+	}
+	delete iterator;
+
+	leveldb::Status status = pdb->Write(leveldb::WriteOptions(), &batch);
+	if (!status.ok()) {
+		LogPrintf("LevelDB fractions upgrade failure: %s\n", status.ToString());
+		return false;
+	}
+	return true;
+}
+
+// Upgrade of stored fractions to the faster codec runs in background by
+// small portions under cs_main, so no block connection can rewrite them
+// meanwhile. Both formats are readable, interrupted upgrade restarts.
+void ThreadPegDBUpgrade() {
+	{
+		LOCK(cs_main);
+		CPegDB pegdb("r");
+		bool   fUpgraded = false;
+		if (pegdb.ReadFractionsUpgraded(fUpgraded) && fUpgraded)
+			return;
+	}
+
+	LogPrintf("Peg index fractions upgrade started\n");
+	int64_t     nStart    = GetTimeMillis();
+	int64_t     nTotal    = 0;
+	std::string sKey;
+	while (true) {
+		boost::this_thread::interruption_point();
+		int  nUpgraded = 0;
+		bool fEnd      = false;
+		{
+			LOCK(cs_main);
+			CPegDB pegdb("r+");
+			if (!pegdb.UpgradeFractions(sKey, 10000, nUpgraded, fEnd))
+				return;
+			if (fEnd)
+				pegdb.WriteFractionsUpgraded(true);
+		}
+		nTotal += nUpgraded;
+		if (fEnd)
+			break;
+		MilliSleep(10);
+	}
+	LogPrintf("Peg index fractions upgrade done, %d records  %dms\n", nTotal,
+	          GetTimeMillis() - nStart);
 }
 
 bool CPegDB::ReadPegStartHeight(int& nHeight) {
@@ -546,16 +744,15 @@ bool CPegDB::LoadPegData(CTxDB& txdb, LoadMsg load_msg) {
 				if (!block.ReadFromDisk(pBlockindex, true))
 					return error("ReadFromDisk() : block read failed");
 
-				map<string, CBridgeInfo> bridges;
-				if (!pBlockindex->ReadBridges(*this, bridges))
+				CPegCycleStateRef cycle = GetPegCycleState(*this, pBlockindex);
+				if (!cycle->fBridges)
 					return error("ReadBridges() : bridges read failed");
-				auto fnMerkleIn = [&](string hash) {
-					CMerkleInfo m = pBlockindex->ReadMerkleIn(pegdb, hash);
-					return m;
-				};
-				set<string> sTimeLockPassesPubkeys;
-				if (!pBlockindex->ReadTimeLockPasses(*this, sTimeLockPassesPubkeys))
+				if (!cycle->fTimeLockPasses)
 					return error("ReadTimeLockPasses() : timelockpasses read failed");
+				const map<string, CBridgeInfo>& bridges                = cycle->bridges;
+				const set<string>&              sTimeLockPassesPubkeys = cycle->timelockpasses;
+
+				auto fnMerkleIn = [&](string hash) { return cycle->MerkleIn(pegdb, hash); };
 
 				int64_t      nFees        = 0;
 				int64_t      nStakeReward = 0;
@@ -823,6 +1020,7 @@ bool CPegDB::ReadCycleStateHash(uint256                           bhash_cycle,
 bool CPegDB::WriteCycleStateHash(uint256                           bhash_cycle,
                                  CChainParams::AcceptedStatesTypes typ,
                                  const uint256&                    hash) {
+	InvalidateCycleStates();
 	return Write("intervalStateHash_" + bhash_cycle.ToString() + strprintf("%016x", typ), hash);
 }
 
@@ -963,6 +1161,7 @@ bool CPegDB::AppendCycleStateMapItem1(const uint256&     block_hash,
                                       const std::string& map_item_key,
                                       const std::string& map_item_data,
                                       uint256&           written_hash) {
+	InvalidateCycleStates();
 	int    index = -1;
 	string prev_data;
 	if (Read("intervalStateDataRef_" + map_end.GetHex(), prev_data)) {
@@ -1182,35 +1381,61 @@ bool CPegDB::WriteBridgeCycleBridgeHashes(const uint256&          bcycle_hash,
 	return Write("cycleBridgeHashesToBridge_" + bcycle_hash.GetHex(), data_txt);
 }
 
-// txouts in bridge cycle
-
-bool CPegDB::ReadBridgeCycleBurnsToBridge(const uint256&    bcycle_hash,
-                                          const string&     br_hash,
-                                          std::set<string>& results) {
+// txouts in bridge cycle: binary records with a format version, the
+// records of older versions are colon-joined strings of cycleBurnsToBridge_
+
+static const uint8_t BRIDGE_BURNS_VERSION = 1;
+
+bool CPegDB::ReadBridgeCycleBurnsToBridge(const uint256&            bcycle_hash,
+                                          const string&             br_hash,
+                                          std::vector<CBridgeBurn>& burns) {
+	string data_bin;
+	if (ReadStr("cycleBridgeBurns_" + bcycle_hash.GetHex() + br_hash, data_bin)) {
+		CDataStream finp(data_bin.data(), data_bin.data() + data_bin.size(), SER_DISK,
+		                 CLIENT_VERSION);
+		try {
+			uint8_t nVersion = 0;
+			finp >> nVersion;
+			if (nVersion != BRIDGE_BURNS_VERSION)
+				return false;
+			uint64_t nBurns = ReadCompactSize(finp);
+			burns.reserve(burns.size() + std::min<uint64_t>(nBurns, finp.size()));
+			for (uint64_t i = 0; i < nBurns; i++) {
+				CBridgeBurn burn;
+				if (!burn.Unpack(finp))
+					return false;
+				burns.push_back(burn);
+			}
+		} catch (std::exception&) {
+			return false;
+		}
+		return true;
+	}
 	string data_txt;
 	if (Read("cycleBurnsToBridge_" + bcycle_hash.GetHex() + br_hash, data_txt)) {
 		std::set<std::string> datas;
 		boost::split(datas, data_txt, boost::is_any_of(","));
 		for (const string& data : datas) {
-			if (data.empty())
+			CBridgeBurn burn;
+			if (data.empty() || !burn.FromString(data))
 				continue;
-			results.insert(data);
+			burns.push_back(burn);
 		}
 		return true;
 	}
 	return false;
 }
 
-bool CPegDB::WriteBridgeCycleBurnsToBridge(const uint256&          bcycle_hash,
-                                           const string&           br_hash,
-                                           const std::set<string>& datas) {
-	std::vector<string> datas_sorted;
-	for (const string& addr : datas) {
-		datas_sorted.push_back(addr);
+bool CPegDB::WriteBridgeCycleBurnsToBridge(const uint256&                  bcycle_hash,
+                                           const string&                   br_hash,
+                                           const std::vector<CBridgeBurn>& burns) {
+	CDataStream fout(SER_DISK, CLIENT_VERSION);
+	fout << uint8_t(BRIDGE_BURNS_VERSION);
+	WriteCompactSize(fout, burns.size());
+	for (const CBridgeBurn& burn : burns) {
+		burn.Pack(fout);
 	}
-	sort(datas_sorted.begin(), datas_sorted.end());
-	string data_txt = boost::algorithm::join(datas_sorted, ",");
-	return Write("cycleBurnsToBridge_" + bcycle_hash.GetHex() + br_hash, data_txt);
+	return Write("cycleBridgeBurns_" + bcycle_hash.GetHex() + br_hash, fout);
 }
 
 // merkle
@@ -6,10 +6,12 @@
 #ifndef BITCOIN_PEG_LEVELDB_H
 #define BITCOIN_PEG_LEVELDB_H
 
+#include "dbchanges.h"
 #include "main.h"
 #include "peg.h"
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -29,7 +31,9 @@ public:
 	void Close();
 
 	bool ReadFractions(uint320 txout, CFractions&, bool must_have = false);
+	bool ReadFractions(const std::vector<uint320>& vTxOuts, MapFractions& mapFractions);
 	bool WriteFractions(uint320 txout, const CFractions&);
+	bool EraseFractions(uint320 txout);
 
 private:
 	leveldb::DB* pdb;  // Points to the global instance.
@@ -37,10 +41,22 @@ private:
 	// A batch stores up writes and deletes for atomic application. When this
 	// field is non-NULL, writes/deletes go there instead of directly to disk.
 	leveldb::WriteBatch* activeBatch;
+	// Sorted copy of the changes of activeBatch, reads consult it instead of
+	// scanning the batch.
+	DbChanges            mapBatchChanges;
 	leveldb::Options     options;
 	bool                 fReadOnly;
 	int                  nVersion;
 
+	// Fractions changed by activeBatch, to drop from cache on commit/abort
+	std::set<uint320> setBatchFractions;
+	void              InvalidateFractions(uint320 txout);
+	void              InvalidateBatchFractions();
+
+	// Cycle states changed by activeBatch, to drop snapshots on commit/abort
+	bool fBatchCycleStates = false;
+	void InvalidateCycleStates();
+
 protected:
 	// Returns true and sets (value,false) if activeBatch contains the given key
 	// or leaves value alone and sets deleted = true if activeBatch contains a
@@ -128,6 +144,9 @@ public:
 
 		if (activeBatch) {
 			activeBatch->Put(ssKey.str(), ssValue.str());
+			CDbChange& change = mapBatchChanges[ssKey.str()];
+			change.fErased    = false;
+			change.value      = ssValue.str();
 			return true;
 		}
 		leveldb::Status status = pdb->Put(leveldb::WriteOptions(), ssKey.str(), ssValue.str());
@@ -150,6 +169,9 @@ public:
 		ssKey << key;
 		if (activeBatch) {
 			activeBatch->Delete(ssKey.str());
+			CDbChange& change = mapBatchChanges[ssKey.str()];
+			change.fErased    = true;
+			change.value.clear();
 			return true;
 		}
 		leveldb::Status status = pdb->Delete(leveldb::WriteOptions(), ssKey.str());
@@ -177,11 +199,7 @@ public:
 public:
 	bool TxnBegin();
 	bool TxnCommit();
-	bool TxnAbort() {
-		delete activeBatch;
-		activeBatch = NULL;
-		return true;
-	}
+	bool TxnAbort();
 
 	bool ReadVersion(int& nVersion) {
 		nVersion = 0;
@@ -202,6 +220,10 @@ public:
 	bool ReadPegBayPeakRate(double& dRate);
 	bool WritePegBayPeakRate(double dRate);
 
+	bool ReadFractionsUpgraded(bool& fUpgraded);
+	bool WriteFractionsUpgraded(bool fUpgraded);
+	bool UpgradeFractions(std::string& sKey, int nMaxKeys, int& nUpgraded, bool& fEnd);
+
 	bool ReadPegTxId(uint256 txid, uint256& txhash);
 	bool WritePegTxId(uint256 txid, uint256 txhash);
 	bool RemovePegTxId(uint256 txid);
@@ -282,12 +304,12 @@ public:
 	bool WriteBridgeCycleBridgeHashes(const uint256&               bcycle_hash,
 									  const std::set<std::string>& br_hashes);
 
-	bool ReadBridgeCycleBurnsToBridge(const uint256&         bcycle_hash,
-									  const std::string&     br_hash,
-									  std::set<std::string>& datas);
-	bool WriteBridgeCycleBurnsToBridge(const uint256&               bcycle_hash,
-									   const std::string&           br_hash,
-									   const std::set<std::string>& datas);
+	bool ReadBridgeCycleBurnsToBridge(const uint256&            bcycle_hash,
+									  const std::string&        br_hash,
+									  std::vector<CBridgeBurn>& burns);
+	bool WriteBridgeCycleBurnsToBridge(const uint256&                  bcycle_hash,
+									   const std::string&              br_hash,
+									   const std::vector<CBridgeBurn>& burns);
 
 	bool ReadBridgeCycleMerkle(const uint256&     bcycle_hash,
 							   const std::string& br_hash,
@@ -297,4 +319,8 @@ public:
 								const std::string& merkle_data);
 };
 
+extern leveldb::DB* pegdb;  // global pointer for LevelDB object instance
+
+void ThreadPegDBUpgrade();
+
 #endif  // BITCOIN_PEG_LEVELDB_H
@@ -7,6 +7,7 @@
 // Jelurida Public License (JPL). See https://www.jelurida.com/resources/jpl
 
 #include "pegdata.h"
+#include "pegkernels.h"
 
 #include <algorithm>
 #include <cstdint>
@@ -25,14 +26,163 @@
 using namespace std;
 using namespace boost;
 
-CFractions::CFractions() : nFlags(VALUE), f(new int64_t[PEG_SIZE]) {
-	f[0] = 0;  // fast init first item
+CFractionSlots::CFractionSlots(const CFractionSlots& o) {
+	Reset(o.Data(), o.nFrom, o.nTo);
 }
-CFractions::CFractions(int64_t value, uint32_t flags) : nFlags(flags), f(new int64_t[PEG_SIZE]) {
+
+CFractionSlots::CFractionSlots(CFractionSlots&& o) noexcept
+    : nFrom(o.nFrom), nTo(o.nTo), nInline(o.nInline), p(std::move(o.p)) {
+	o.Clear();
+}
+
+CFractionSlots& CFractionSlots::operator=(const CFractionSlots& o) {
+	if (this != &o)
+		Reset(o.Data(), o.nFrom, o.nTo);
+	return *this;
+}
+
+CFractionSlots& CFractionSlots::operator=(CFractionSlots&& o) noexcept {
+	if (this != &o) {
+		nFrom   = o.nFrom;
+		nTo     = o.nTo;
+		nInline = o.nInline;
+		p       = std::move(o.p);
+		o.Clear();
+	}
+	return *this;
+}
+
+/** Replace the slots with a copy of src (slots [from, to)), zero slots at
+ *  both ends are trimmed so the copy is proportional to the non-zero extent.
+ */
+void CFractionSlots::Reset(const int64_t* src, int from, int to) {
+	while (from < to && src[0] == 0) {
+		src++;
+		from++;
+	}
+	while (to > from && src[to - from - 1] == 0) {
+		to--;
+	}
+	if (to - from <= 1) {
+		int64_t v = (to > from) ? src[0] : 0;
+		p.reset();
+		nFrom   = (to > from) ? from : 0;
+		nTo     = nFrom + 1;
+		nInline = v;
+		return;
+	}
+	std::unique_ptr<int64_t[]> data(new int64_t[to - from]);
+	std::copy(src, src + (to - from), data.get());
+	p     = std::move(data);
+	nFrom = from;
+	nTo   = to;
+}
+
+void CFractionSlots::Clear() {
+	p.reset();
+	nFrom   = 0;
+	nTo     = 1;
+	nInline = 0;
+}
+
+void CFractionSlots::SetValue(int64_t v) {
+	Clear();
+	nInline = v;
+}
+
+/** Copy of all PEG_SIZE slots from src, trimmed to non-zero window. */
+void CFractionSlots::Set(const int64_t* src) {
+	Reset(src, 0, PEG_SIZE);
+}
+
+/** Copy of o slots in range [from, to), all other slots are zeros. */
+void CFractionSlots::Assign(const CFractionSlots& o, int from, int to) {
+	from = std::max(from, int(o.nFrom));
+	to   = std::min(to, int(o.nTo));
+	if (from >= to) {
+		Clear();
+		return;
+	}
+	if (&o == this) {
+		CFractionSlots copy(o);
+		Assign(copy, from, to);
+		return;
+	}
+	Reset(o.Data() + (from - o.nFrom), from, to);
+}
+
+/** Make sure that slots [from, to) are materialized, the window is extended
+ *  only as much as needed to keep storage proportional to used extent.
+ */
+void CFractionSlots::Cover(int from, int to) {
+	from = std::max(from, 0);
+	to   = std::min(to, int(PEG_SIZE));
+	if (from >= to)
+		return;
+	if (from >= nFrom && to <= nTo)
+		return;
+	if (!p && nInline == 0) {
+		nFrom = from;
+		nTo   = from;
+	} else {
+		from = std::min(from, int(nFrom));
+		to   = std::max(to, int(nTo));
+	}
+	if (to - from <= 1) {
+		nFrom = from;
+		nTo   = from + 1;
+		return;
+	}
+	std::unique_ptr<int64_t[]> data(new int64_t[to - from]);
+	std::fill(data.get(), data.get() + (to - from), 0);
+	if (nTo > nFrom) {
+		std::copy(Data(), Data() + (nTo - nFrom), data.get() + (nFrom - from));
+	}
+	p     = std::move(data);
+	nFrom = from;
+	nTo   = to;
+}
+
+void CFractionSlots::Touch(int i) {
+	assert(i >= 0 && i < PEG_SIZE);
+	if (!p && nInline == 0) {
+		// all zeros, just move the inline slot
+		nFrom = i;
+		nTo   = i + 1;
+		return;
+	}
+	Cover(0, PEG_SIZE);
+}
+
+/** All PEG_SIZE slots are materialized, returns pointer to first one. */
+int64_t* CFractionSlots::get() {
+	Cover(0, PEG_SIZE);
+	return Data();
+}
+
+void CFractionSlots::CopyTo(int64_t* out) const {
+	std::fill(out, out + PEG_SIZE, 0);
+	std::copy(Data(), Data() + (nTo - nFrom), out + nFrom);
+}
+
+int64_t CFractionSlots::Sum(int from, int to) const {
+	from = std::max(from, int(nFrom));
+	to   = std::min(to, int(nTo));
+	if (from >= to)
+		return 0;
+	return PegKernels().sum(Data() + (from - nFrom), to - from);
+}
+
+size_t CFractionSlots::DynamicUsage() const {
+	return p ? (nTo - nFrom) * sizeof(int64_t) : 0;
+}
+
+CFractions::CFractions() : nFlags(VALUE) {}
+CFractions::CFractions(int64_t value, uint32_t flags) : nFlags(flags) {
 	if (flags & VALUE)
-		f[0] = value;  // fast init first item
+		f.SetValue(value);
 	else if (flags & STD) {
-		f[0]   = value;
+		f.SetValue(value);
 		nFlags = VALUE;
 		ToStd();
 		nFlags = flags;
@@ -41,50 +191,131 @@ CFractions::CFractions(int64_t value, uint32_t flags) : nFlags(flags), f(new int
 	}
 }
 CFractions::CFractions(const CFractions& o)
-    : nFlags(o.nFlags),
-      nLockTime(o.nLockTime),
-      sReturnAddr(o.sReturnAddr),
-      f(new int64_t[PEG_SIZE]) {
-	for (int i = 0; i < PEG_SIZE; i++) {
-		f[i] = o.f[i];
-	}
+    : nFlags(o.nFlags), nLockTime(o.nLockTime), sReturnAddr(o.sReturnAddr) {
+	if (o.nFlags & VALUE)
+		f.SetValue(o.f[0]);  // only first slot is used
+	else
+		f = o.f;
 }
 
 CFractions& CFractions::operator=(const CFractions& o) {
 	nFlags      = o.nFlags;
 	nLockTime   = o.nLockTime;
 	sReturnAddr = o.sReturnAddr;
-	for (int i = 0; i < PEG_SIZE; i++) {
-		f[i] = o.f[i];
-	}
+	if (o.nFlags & VALUE)
+		f.SetValue(o.f[0]);  // only first slot is used
+	else
+		f = o.f;
 	return *this;
 }
 
+/** Delta of slot i depends only on slots i and i-1, there is no dependency
+ *  between iterations. Deltas are zero out of [from, to], so only the window
+ *  (and one slot after it with decay of the last one) is computed.
+ */
 void CFractions::ToDeltas(int64_t* deltas) const {
+	std::fill(deltas, deltas + PEG_SIZE, 0);
+	int            from = f.From();
+	int            to   = std::min(f.To() + 1, int(PEG_SIZE));
+	const int64_t* fs   = f.Data() - from;
+	for (int i = from; i < to; i++) {
+		int64_t v  = i < f.To() ? fs[i] : 0;
+		int64_t fp = i > from ? fs[i - 1] : 0;
+		deltas[i]  = v - fp * (PEG_RATE - 1) / PEG_RATE;
+	}
+}
+
+/** Restore is sequential (truncating division of previous slot does not
+ *  allow reassociation), decoded slots are trimmed to non-zero window.
+ */
+void CFractions::FromDeltas(const int64_t* deltas) {
+	int64_t fs[PEG_SIZE];
 	int64_t fp = 0;
 	for (int i = 0; i < PEG_SIZE; i++) {
 		if (i == 0) {
-			fp = deltas[0] = f[0];
+			fp = fs[0] = deltas[0];
 			continue;
 		}
-		deltas[i] = f[i] - fp * (PEG_RATE - 1) / PEG_RATE;
-		fp        = f[i];
+		fs[i] = deltas[i] + fp * (PEG_RATE - 1) / PEG_RATE;
+		fp    = fs[i];
 	}
+	f.Set(fs);
 }
 
-void CFractions::FromDeltas(const int64_t* deltas) {
-	int64_t fp = 0;
-	for (int i = 0; i < PEG_SIZE; i++) {
-		if (i == 0) {
-			fp = f[0] = deltas[0];
+/** Deltas of STD fractions are mostly 0 or 1 (rounding of the decay) with
+ *  long runs of zeros at the ends, they are written as byte tokens:
+ *    0bbbbbbb  next 7 deltas are 0 or 1 (bits from lowest)
+ *    10nnnnnn  next n+1 deltas are zero
+ *    11vvvvvv  next delta is zigzag v, v=63 means that (zigzag - 63)
+ *              follows as varint
+ */
+static void PackVarDeltas(CDataStream& out, const int64_t* deltas) {
+	int i = 0;
+	while (i < PEG_SIZE) {
+		int nZeros = 0;
+		while (i + nZeros < PEG_SIZE && deltas[i + nZeros] == 0)
+			nZeros++;
+		if (nZeros >= 7 || i + nZeros == PEG_SIZE) {
+			nZeros = std::min(nZeros, 64);
+			out << uint8_t(0x80 | (nZeros - 1));
+			i += nZeros;
 			continue;
 		}
-		f[i] = deltas[i] + fp * (PEG_RATE - 1) / PEG_RATE;
-		fp   = f[i];
+		int     n    = std::min(7, PEG_SIZE - i);
+		uint8_t bits = 0;
+		bool    fBin = true;
+		for (int j = 0; j < n && fBin; j++) {
+			fBin = deltas[i + j] == 0 || deltas[i + j] == 1;
+			bits |= uint8_t(deltas[i + j]) << j;
+		}
+		if (fBin) {
+			out << bits;
+			i += n;
+			continue;
+		}
+		uint64_t v = (uint64_t(deltas[i]) << 1) ^ uint64_t(deltas[i] >> 63);
+		if (v < 63) {
+			out << uint8_t(0xC0 | v);
+		} else {
+			out << uint8_t(0xC0 | 63);
+			WriteVarInt<CDataStream, uint64_t>(out, v - 63);
+		}
+		i++;
+	}
+}
+
+static bool UnpackVarDeltas(CDataStream& inp, int64_t* deltas) {
+	int i = 0;
+	while (i < PEG_SIZE) {
+		uint8_t nToken = 0;
+		inp >> nToken;
+		if ((nToken & 0x80) == 0) {
+			int n = std::min(7, PEG_SIZE - i);
+			if (nToken >> n) {
+				// data are broken, bits out of slots
+				return false;
+			}
+			for (int j = 0; j < n; j++)
+				deltas[i++] = (nToken >> j) & 1;
+		} else if ((nToken & 0xC0) == 0x80) {
+			int nZeros = (nToken & 0x3F) + 1;
+			if (nZeros > PEG_SIZE - i) {
+				// data are broken, run is out of slots
+				return false;
+			}
+			std::fill(deltas + i, deltas + i + nZeros, 0);
+			i += nZeros;
+		} else {
+			uint64_t v = nToken & 0x3F;
+			if (v == 63)
+				v += ReadVarInt<CDataStream, uint64_t>(inp);
+			deltas[i++] = int64_t(v >> 1) ^ -int64_t(v & 1);
+		}
 	}
+	return true;
 }
 
-bool CFractions::Pack(CDataStream& out, unsigned long* report_len, bool compress) const {
+bool CFractions::Pack(CDataStream& out, unsigned long* report_len, uint32_t nSerCodec) const {
 	if (nFlags & VALUE) {
 		if (report_len)
 			*report_len = sizeof(int64_t);
@@ -93,7 +324,19 @@ bool CFractions::Pack(CDataStream& out, unsigned long* report_len, bool compress
 		out << nLockTime;
 		out << sReturnAddr;
 		out << f[0];
-	} else if (compress) {
+	} else if (nSerCodec == SER_VDELTA) {
+		int64_t deltas[PEG_SIZE];
+		ToDeltas(deltas);
+
+		out << nVersion;
+		out << uint32_t(nFlags | SER_VDELTA);
+		out << nLockTime;
+		out << sReturnAddr;
+		size_t nStart = out.size();
+		PackVarDeltas(out, deltas);
+		if (report_len)
+			*report_len = out.size() - nStart;
+	} else if (nSerCodec == SER_ZDELTA) {
 		int64_t deltas[PEG_SIZE];
 		ToDeltas(deltas);
 
@@ -114,14 +357,7 @@ bool CFractions::Pack(CDataStream& out, unsigned long* report_len, bool compress
 			out << zlen;
 			out.write(ser, zlen);
 		} else {
-			if (report_len)
-				*report_len = PEG_SIZE * sizeof(int64_t);
-			out << nVersion;
-			out << uint32_t(nFlags | SER_RAW);
-			out << nLockTime;
-			out << sReturnAddr;
-			auto ser = reinterpret_cast<const char*>(f.get());
-			out.write(ser, PEG_SIZE * sizeof(int64_t));
+			return Pack(out, report_len, SER_RAW);
 		}
 	} else {
 		if (report_len)
@@ -130,7 +366,9 @@ bool CFractions::Pack(CDataStream& out, unsigned long* report_len, bool compress
 		out << uint32_t(nFlags | SER_RAW);
 		out << nLockTime;
 		out << sReturnAddr;
-		auto ser = reinterpret_cast<const char*>(f.get());
+		int64_t raw[PEG_SIZE];
+		f.CopyTo(raw);
+		auto ser = reinterpret_cast<const char*>(raw);
 		out.write(ser, PEG_SIZE * sizeof(int64_t));
 	}
 	return true;
@@ -144,8 +382,16 @@ bool CFractions::Unpack(CDataStream& inp) {
 	inp >> sReturnAddr;
 
 	if (nSerFlags & SER_VALUE) {
+		int64_t nValue = 0;
+		inp >> nValue;
+		f.SetValue(nValue);
 		nFlags = nSerFlags | VALUE;
-		inp >> f[0];
+	} else if (nSerFlags & SER_VDELTA) {
+		int64_t deltas[PEG_SIZE];
+		if (!UnpackVarDeltas(inp, deltas))
+			return false;
+		FromDeltas(deltas);
+		nFlags = nSerFlags | STD;
 	} else if (nSerFlags & SER_ZDELTA) {
 		unsigned long zlen = 0;
 		inp >> zlen;
@@ -184,23 +430,8 @@ CFractions CFractions::Std() const {
 	if ((nFlags & VALUE) == 0)
 		return *this;
 
-	CFractions fstd;
-	fstd.sReturnAddr = sReturnAddr;
-	fstd.nLockTime   = nLockTime;
-	fstd.nFlags      = nFlags;
-	fstd.nFlags &= ~uint32_t(VALUE);
-	fstd.nFlags |= STD;
-
-	int64_t v = f[0];
-	for (int i = 0; i < PEG_SIZE; i++) {
-		if (i == PEG_SIZE - 1) {
-			fstd.f[i] = v;
-			break;
-		}
-		int64_t frac = v / PEG_RATE;
-		fstd.f[i]    = frac;
-		v -= frac;
-	}
+	CFractions fstd(*this);
+	fstd.ToStd();
 	return fstd;
 }
 
@@ -208,63 +439,63 @@ bool CFractions::IsPositive() const {
 	if (nFlags & VALUE)
 		return true;
 
-	for (int i = 0; i < PEG_SIZE; i++) {
-		if (f[i] < 0)
-			return false;
-	}
-	return true;
+	return PegKernels().no_negative(f.Data(), f.To() - f.From());
 }
 
 bool CFractions::IsNegative() const {
 	if (nFlags & VALUE)
 		return false;
 
-	for (int i = 0; i < PEG_SIZE; i++) {
-		if (f[i] > 0)
-			return false;
-	}
-	return true;
+	return PegKernels().no_positive(f.Data(), f.To() - f.From());
 }
 
 int64_t CFractions::Total() const {
-	int64_t nValue = 0;
 	if (nFlags & VALUE)
 		return f[0];
 
-	for (int i = 0; i < PEG_SIZE; i++) {
-		nValue += f[i];
+	return f.Sum(0, PEG_SIZE);
+}
+
+/** Sum of the first slots [0, to) of value v distributed as ToStd() does,
+ *  without materializing the slots. If slot is given it receives the value
+ *  of slot to.
+ */
+static int64_t StdLow(int64_t v, int to, int64_t* slot = nullptr) {
+	to           = std::min(std::max(to, 0), int(PEG_SIZE));
+	int64_t rest = v;
+	for (int i = 0; i < to; i++) {
+		if (i == PEG_SIZE - 1) {
+			rest = 0;
+			break;
+		}
+		rest -= rest / PEG_RATE;
 	}
-	return nValue;
+	if (slot) {
+		if (to >= PEG_SIZE)
+			*slot = 0;
+		else
+			*slot = to == PEG_SIZE - 1 ? rest : rest / PEG_RATE;
+	}
+	return v - rest;
 }
 
 int64_t CFractions::Low(int supply) const {
-	int64_t nValue = 0;
 	if (nFlags & VALUE)
-		return Std().Low(supply);
+		return StdLow(f[0], supply);
 
-	for (int i = 0; i < supply; i++) {
-		nValue += f[i];
-	}
-	return nValue;
+	return f.Sum(0, supply);
 }
 
 int64_t CFractions::High(int supply) const {
-	int64_t nValue = 0;
 	if (nFlags & VALUE)
-		return Std().High(supply);
+		return f[0] - StdLow(f[0], supply);
 
-	for (int i = supply; i < PEG_SIZE; i++) {
-		nValue += f[i];
-	}
-	return nValue;
+	return f.Sum(supply, PEG_SIZE);
 }
 
 int64_t CFractions::Low(const CPegLevel& peglevel) const {
 	int64_t nValue = 0;
-	if (nFlags & VALUE)
-		return Std().Low(peglevel);
-
-	int to = peglevel.nSupply + peglevel.nShift;
+	int     to     = peglevel.nSupply + peglevel.nShift;
 	if (to < 0)
 		return 0;
 	if (to >= PEG_SIZE)
@@ -272,26 +503,20 @@ int64_t CFractions::Low(const CPegLevel& peglevel) const {
 
 	if (peglevel.nShiftLastPart > 0 && peglevel.nShiftLastTotal > 0) {
 		// partial value to use
-		int64_t v     = f[to];
+		int64_t v     = Slot(to);
 		int64_t vpart = ::RatioPart(v, peglevel.nShiftLastPart, peglevel.nShiftLastTotal);
 		if (vpart < v)
 			vpart++;  // better rounding
 		nValue += vpart;
 	}
 
-	for (int i = 0; i < to; i++) {
-		nValue += f[i];
-	}
-
+	nValue += Low(to);
 	return nValue;
 }
 
 int64_t CFractions::High(const CPegLevel& peglevel) const {
 	int64_t nValue = 0;
-	if (nFlags & VALUE)
-		return Std().High(peglevel);
-
-	int from = peglevel.nSupply + peglevel.nShift;
+	int     from   = peglevel.nSupply + peglevel.nShift;
 	if (from < 0)
 		return 0;
 	if (from >= PEG_SIZE)
@@ -299,7 +524,7 @@ int64_t CFractions::High(const CPegLevel& peglevel) const {
 
 	if (peglevel.nShiftLastPart > 0 && peglevel.nShiftLastTotal > 0) {
 		// partial value to use
-		int64_t v     = f[from];
+		int64_t v     = Slot(from);
 		int64_t vpart = ::RatioPart(v, peglevel.nShiftLastPart, peglevel.nShiftLastTotal);
 		if (vpart < v)
 			vpart++;  // better rounding
@@ -307,13 +532,21 @@ int64_t CFractions::High(const CPegLevel& peglevel) const {
 		from++;
 	}
 
-	for (int i = from; i < PEG_SIZE; i++) {
-		nValue += f[i];
-	}
-
+	nValue += High(from);
 	return nValue;
 }
 
+int64_t CFractions::Slot(int i) const {
+	if (i < 0 || i >= PEG_SIZE)
+		return 0;
+	if (nFlags & VALUE) {
+		int64_t slot = 0;
+		StdLow(f[0], i, &slot);
+		return slot;
+	}
+	return f[i];
+}
+
 int64_t CFractions::NChange(const CPegLevel& peglevel) const {
 	CPegLevel peglevel_next   = peglevel;
 	peglevel_next.nSupply     = peglevel_next.nSupplyNext;
@@ -339,7 +572,7 @@ int16_t CFractions::HLI() const {
 	if (total == 0) {
 		return 0;
 	}
-	for (int16_t i = 0; i < PEG_SIZE; i++) {
+	for (int16_t i = f.From(); i < f.To(); i++) {
 		half += f[i];
 		if (half > total / 2) {
 			return i;
@@ -356,13 +589,18 @@ void CFractions::ToStd() {
 	nFlags |= STD;
 
 	int64_t v = f[0];
+	if (v == 0) {
+		f.Clear();
+		return;
+	}
+	int64_t* fs = f.get();
 	for (int i = 0; i < PEG_SIZE; i++) {
 		if (i == PEG_SIZE - 1) {
-			f[i] = v;
+			fs[i] = v;
 			break;
 		}
 		int64_t frac = v / PEG_RATE;
-		f[i]         = frac;
+		fs[i]        = frac;
 		v -= frac;
 	}
 }
@@ -372,13 +610,11 @@ CFractions CFractions::Positive(int64_t* total) const {
 		return Std().Positive(total);
 	}
 	CFractions frPositive(0, CFractions::STD);
-	for (int i = 0; i < PEG_SIZE; i++) {
-		if (f[i] <= 0)
-			continue;
-		frPositive.f[i] = f[i];
-		if (total)
-			*total += f[i];
-	}
+	frPositive.f.Assign(f, 0, PEG_SIZE);
+	int64_t nPositive =
+	    PegKernels().keep_positive(frPositive.f.Data(), frPositive.f.To() - frPositive.f.From());
+	if (total)
+		*total += nPositive;
 	return frPositive;
 }
 CFractions CFractions::Negative(int64_t* total) const {
@@ -386,13 +622,11 @@ CFractions CFractions::Negative(int64_t* total) const {
 		return Std().Negative(total);
 	}
 	CFractions frNegative(0, CFractions::STD);
-	for (int i = 0; i < PEG_SIZE; i++) {
-		if (f[i] >= 0)
-			continue;
-		frNegative.f[i] = f[i];
-		if (total)
-			*total += f[i];
-	}
+	frNegative.f.Assign(f, 0, PEG_SIZE);
+	int64_t nNegative =
+	    PegKernels().keep_negative(frNegative.f.Data(), frNegative.f.To() - frNegative.f.From());
+	if (total)
+		*total += nNegative;
 	return frNegative;
 }
 
@@ -401,11 +635,9 @@ CFractions CFractions::LowPart(int supply, int64_t* total) const {
 		return Std().LowPart(supply, total);
 	}
 	CFractions frLowPart(0, CFractions::STD);
-	for (int i = 0; i < supply; i++) {
-		if (total)
-			*total += f[i];
-		frLowPart.f[i] += f[i];
-	}
+	frLowPart.f.Assign(f, 0, supply);
+	if (total)
+		*total += f.Sum(0, supply);
 	return frLowPart;
 }
 CFractions CFractions::HighPart(int supply, int64_t* total) const {
@@ -413,11 +645,9 @@ CFractions CFractions::HighPart(int supply, int64_t* total) const {
 		return Std().HighPart(supply, total);
 	}
 	CFractions frHighPart(0, CFractions::STD);
-	for (int i = supply; i < PEG_SIZE; i++) {
-		if (total)
-			*total += f[i];
-		frHighPart.f[i] += f[i];
-	}
+	frHighPart.f.Assign(f, supply, PEG_SIZE);
+	if (total)
+		*total += f.Sum(supply, PEG_SIZE);
 	return frHighPart;
 }
 
@@ -435,16 +665,17 @@ CFractions CFractions::LowPart(const CPegLevel& peglevel, int64_t* total) const
 		int64_t vpart = ::RatioPart(v, peglevel.nShiftLastPart, peglevel.nShiftLastTotal);
 		if (vpart < v)
 			vpart++;
-		frLowPart.f[to] = vpart;
+		frLowPart.f.Assign(f, 0, to + 1);
+		if (vpart != v)
+			frLowPart.f.Set(to, vpart);
 		if (total)
 			*total += vpart;
+	} else {
+		frLowPart.f.Assign(f, 0, to);
 	}
 
-	for (int i = 0; i < to; i++) {
-		if (total)
-			*total += f[i];
-		frLowPart.f[i] = f[i];
-	}
+	if (total)
+		*total += f.Sum(0, to);
 	return frLowPart;
 }
 CFractions CFractions::HighPart(const CPegLevel& peglevel, int64_t* total) const {
@@ -455,6 +686,7 @@ CFractions CFractions::HighPart(const CPegLevel& peglevel, int64_t* total) const
 	CFractions frHighPart(0, CFractions::STD);
 
 	int from = peglevel.nSupply + peglevel.nShift;
+	frHighPart.f.Assign(f, from, PEG_SIZE);
 	if (from >= 0 && from < PEG_SIZE && peglevel.nShiftLastPart > 0 &&
 	    peglevel.nShiftLastTotal > 0) {
 		// partial value to use
@@ -462,17 +694,15 @@ CFractions CFractions::HighPart(const CPegLevel& peglevel, int64_t* total) const
 		int64_t vpart = ::RatioPart(v, peglevel.nShiftLastPart, peglevel.nShiftLastTotal);
 		if (vpart < v)
 			vpart++;
-		frHighPart.f[from] = (v - vpart);
+		if (vpart != 0)
+			frHighPart.f.Set(from, v - vpart);
 		if (total)
 			*total += (v - vpart);
 		from++;
 	}
 
-	for (int i = from; i < PEG_SIZE; i++) {
-		if (total)
-			*total += f[i];
-		frHighPart.f[i] = f[i];
-	}
+	if (total)
+		*total += f.Sum(from, PEG_SIZE);
 	return frHighPart;
 }
 
@@ -509,7 +739,7 @@ CFractions CFractions::MidPart(const CPegLevel& peglevel_low,
 		v -= (vone - vpart);
 	}
 
-	mid.f[from] = v;
+	mid.f.Set(from, v);
 	return mid;
 }
 
@@ -532,9 +762,14 @@ CFractions CFractions::RatioPart(int64_t nPartValue) const {
 	if (nPartValue > nTotalValue)
 		return Std();
 
-	int adjust_from = PEG_SIZE;
-	for (int i = 0; i < PEG_SIZE; i++) {
-		int64_t v = f[i];
+	// slots out of the window are zeros and stay zeros in the part
+	fPart.f.Assign(f, 0, PEG_SIZE);
+	int      adjust_from = PEG_SIZE;
+	int      from        = fPart.f.From();
+	int      to          = fPart.f.To();
+	int64_t* fs          = fPart.f.Data() - from;
+	for (int i = from; i < to; i++) {
+		int64_t v = fs[i];
 
 		if (v != 0 && i < adjust_from) {
 			adjust_from = i;
@@ -555,12 +790,12 @@ CFractions CFractions::RatioPart(int64_t nPartValue) const {
 			multiprecision::uint128_t v128(v);
 			multiprecision::uint128_t part128(nPartValue);
 			multiprecision::uint128_t f128 = (v128 * part128) / nTotalValue;
-			fPart.f[i]                     = f128.convert_to<int64_t>();
+			fs[i]                          = f128.convert_to<int64_t>();
 		} else {
-			fPart.f[i] = (v * nPartValue) / nTotalValue;
+			fs[i] = (v * nPartValue) / nTotalValue;
 		}
 
-		nPartValueSum += fPart.f[i];
+		nPartValueSum += fs[i];
 	}
 
 	if (nPartValueSum == nPartValue)
@@ -572,12 +807,12 @@ CFractions CFractions::RatioPart(int64_t nPartValue) const {
 	int64_t nAdjustValue = nPartValue - nPartValueSum;
 	while (nAdjustValue > 0) {
 		// todo:peg: review all possible cases if rounding mismatch with adjust_from
-		if (fPart.f[idx] < f[idx]) {
+		if (fs[idx] < f[idx]) {
 			nAdjustValue--;
-			fPart.f[idx]++;
+			fs[idx]++;
 		}
 		idx++;
-		if (idx >= PEG_SIZE) {
+		if (idx >= to) {
 			idx = adjust_from;
 		}
 	}
@@ -607,15 +842,20 @@ int64_t CFractions::MoveRatioPartTo(int64_t nValueToMove, CFractions& b) {
 	if (nPartValue >= nTotalValue) {
 		nPartValue = nTotalValue;
 		b += *this;  // move all
-		for (int i = 0; i < PEG_SIZE; i++)
-			f[i] = 0;  // taken all
+		f.Clear();   // taken all
 		return nValueToMove - nPartValue;
 	}
 
+	int      from = f.From();
+	int      to   = f.To();
+	int64_t* fs   = f.Data() - from;
+	b.f.Cover(from, to);
+	int64_t* bs = b.f.Data() - b.f.From();
+
 	int64_t nPartValueSum = 0;
 	int     adjust_from   = PEG_SIZE;
-	for (int i = 0; i < PEG_SIZE; i++) {
-		int64_t v = f[i];
+	for (int i = from; i < to; i++) {
+		int64_t v = fs[i];
 
 		if (v != 0 && i < adjust_from) {
 			adjust_from = i;
@@ -644,8 +884,8 @@ int64_t CFractions::MoveRatioPartTo(int64_t nValueToMove, CFractions& b) {
 		}
 
 		nPartValueSum += vp;
-		b.f[i] += vp;
-		f[i] -= vp;
+		bs[i] += vp;
+		fs[i] -= vp;
 	}
 
 	if (nPartValueSum == nPartValue)
@@ -656,13 +896,13 @@ int64_t CFractions::MoveRatioPartTo(int64_t nValueToMove, CFractions& b) {
 	int     idx          = adjust_from;
 	int64_t nAdjustValue = nPartValue - nPartValueSum;
 	while (nAdjustValue > 0) {
-		if (f[idx] > 0) {
+		if (fs[idx] > 0) {
 			nAdjustValue--;
-			b.f[idx]++;
-			f[idx]--;
+			bs[idx]++;
+			fs[idx]--;
 		}
 		idx++;
-		if (idx >= PEG_SIZE) {
+		if (idx >= to) {
 			idx = adjust_from;
 		}
 	}
@@ -677,9 +917,9 @@ CFractions& CFractions::operator+=(const CFractions& b) {
 	if ((nFlags & STD) == 0) {
 		ToStd();
 	}
-	for (int i = 0; i < PEG_SIZE; i++) {
-		f[i] += b.f[i];
-	}
+	f.Cover(b.f.From(), b.f.To());
+	int64_t* fs = f.Data() + (b.f.From() - f.From());
+	PegKernels().add(fs, b.f.Data(), b.f.To() - b.f.From());
 	return *this;
 }
 
@@ -690,35 +930,24 @@ CFractions& CFractions::operator-=(const CFractions& b) {
 	if ((nFlags & STD) == 0) {
 		ToStd();
 	}
-	for (int i = 0; i < PEG_SIZE; i++) {
-		f[i] -= b.f[i];
-	}
+	f.Cover(b.f.From(), b.f.To());
+	int64_t* fs = f.Data() + (b.f.From() - f.From());
+	PegKernels().sub(fs, b.f.Data(), b.f.To() - b.f.From());
 	return *this;
 }
 
 CFractions CFractions::operator&(const CFractions& b) const {
+	// slots out of b window are zeros in the result (min/max with zero)
 	CFractions a = *this;
-	for (int i = 0; i < PEG_SIZE; i++) {
-		int64_t va = a.f[i];
-		int64_t vb = b.f[i];
-		if (va >= 0 && vb >= 0)
-			a.f[i] = std::min(va, vb);
-		else if (va >= 0 && vb < 0)
-			a.f[i] = 0;
-		else if (va < 0 && vb >= 0)
-			a.f[i] = 0;
-		else if (va < 0 && vb < 0)
-			a.f[i] = std::max(va, vb);
-	}
+	a.f.Assign(f, b.f.From(), b.f.To());
+	const int64_t* bs = b.f.Data() + (a.f.From() - b.f.From());
+	PegKernels().intersect(a.f.Data(), bs, a.f.To() - a.f.From());
 	return a;
 }
 
 CFractions CFractions::operator-() const {
 	CFractions a = *this;
-	for (int i = 0; i < PEG_SIZE; i++) {
-		int64_t va = a.f[i];
-		a.f[i]     = -va;
-	}
+	PegKernels().neg(a.f.Data(), a.f.To() - a.f.From());
 	return a;
 }
 
@@ -731,17 +960,31 @@ double CFractions::Distortion(const CFractions& b) const {
 			return 0;
 		}
 
-		int64_t nDiff = 0;
-
-		for (int i = 0; i < PEG_SIZE; i++) {
-			int64_t va = f[i];
-			int64_t vb = b.f[i];
-			if (va > vb) {
-				nDiff += (va - vb);
-			}
+		// sum of (va - vb) where va > vb: over common part of windows, plus
+		// positive slots of a out of b window and negative slots of b out of a
+		const CPegKernels& kernels = PegKernels();
+
+		int      fa    = f.From();
+		int      ta    = f.To();
+		int      fb    = b.f.From();
+		int      tb    = b.f.To();
+		uint64_t nDiff = 0;
+		auto     pa    = [&](int i) { return f.Data() + (i - fa); };
+		auto     pb    = [&](int i) { return b.f.Data() + (i - fb); };
+		if (std::max(fa, fb) < std::min(ta, tb)) {
+			int from = std::max(fa, fb);
+			nDiff += kernels.diff_positive(pa(from), pb(from), std::min(ta, tb) - from);
 		}
-
-		return double(nDiff) / double(nTotalA);
+		if (fa < std::min(ta, fb))
+			nDiff += kernels.sum_positive(pa(fa), std::min(ta, fb) - fa);
+		if (std::max(fa, tb) < ta)
+			nDiff += kernels.sum_positive(pa(std::max(fa, tb)), ta - std::max(fa, tb));
+		if (fb < std::min(tb, fa))
+			nDiff -= kernels.sum_negative(pb(fb), std::min(tb, fa) - fb);
+		if (std::max(fb, ta) < tb)
+			nDiff -= kernels.sum_negative(pb(std::max(fb, ta)), tb - std::max(fb, ta));
+
+		return double(int64_t(nDiff)) / double(nTotalA);
 	}
 
 	else if (nTotalA < nTotalB) {
@@ -774,9 +1017,9 @@ CCompressedFractions::CCompressedFractions(CFractions fr,
       nSection(section),
       fps(new int64_t[nPegSteps]),
       fms(new int64_t[nMicroSteps]) {
-	CFractions fr_std          = fr.Std();
-	int        peg_step_size   = PEG_SIZE / nPegSteps;
-	int        micro_step_size = PEG_SIZE / nPegSteps / nMicroSteps;
+	const CFractions fr_std          = fr.Std();
+	int              peg_step_size   = PEG_SIZE / nPegSteps;
+	int              micro_step_size = PEG_SIZE / nPegSteps / nMicroSteps;
 	for (int i = 0; i < nPegSteps; i++) {
 		fps[i] = 0;
 		if (i == nSection) {
@@ -832,10 +1075,10 @@ CFractions CCompressedFractions::Requested() const {
 		int64_t value_left     = peg_step_value % peg_step_size;
 		int64_t value_split    = peg_step_value / peg_step_size;
 		for (int j = 0; j < peg_step_size; j++) {
-			fr.f[i * peg_step_size + j] = value_split;
+			fr.f.Set(i * peg_step_size + j, value_split);
 		}
 		for (int j = 0; j < value_left; j++) {
-			fr.f[i * peg_step_size + j] += 1;
+			fr.f.Set(i * peg_step_size + j, fr.f[i * peg_step_size + j] + 1);
 		}
 	}
 	// rebuild sections of micro steps
@@ -844,10 +1087,12 @@ CFractions CCompressedFractions::Requested() const {
 		int64_t value_left       = micro_step_value % micro_step_size;
 		int64_t value_split      = micro_step_value / micro_step_size;
 		for (int j = 0; j < micro_step_size; j++) {
-			fr.f[nSection * peg_step_size + i * micro_step_size + j] = value_split;
+			int idx = nSection * peg_step_size + i * micro_step_size + j;
+			fr.f.Set(idx, value_split);
 		}
 		for (int j = 0; j < value_left; j++) {
-			fr.f[nSection * peg_step_size + i * micro_step_size + j] += 1;
+			int idx = nSection * peg_step_size + i * micro_step_size + j;
+			fr.f.Set(idx, fr.f[idx] + 1);
 		}
 	}
 	return fr;
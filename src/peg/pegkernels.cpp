@@ -0,0 +1,498 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pegkernels.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PEG_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// Sums are accumulated as uint64_t: wrap-around is the same in any order of
+// additions, so vectorized lanes give exactly the scalar result.
+
+static int64_t scalar_sum(const int64_t* a, int n) {
+	uint64_t s = 0;
+	for (int i = 0; i < n; i++)
+		s += uint64_t(a[i]);
+	return int64_t(s);
+}
+
+static void scalar_add(int64_t* a, const int64_t* b, int n) {
+	for (int i = 0; i < n; i++)
+		a[i] = int64_t(uint64_t(a[i]) + uint64_t(b[i]));
+}
+
+static void scalar_sub(int64_t* a, const int64_t* b, int n) {
+	for (int i = 0; i < n; i++)
+		a[i] = int64_t(uint64_t(a[i]) - uint64_t(b[i]));
+}
+
+static void scalar_neg(int64_t* a, int n) {
+	for (int i = 0; i < n; i++)
+		a[i] = int64_t(0 - uint64_t(a[i]));
+}
+
+static void scalar_intersect(int64_t* a, const int64_t* b, int n) {
+	for (int i = 0; i < n; i++) {
+		int64_t va = a[i];
+		int64_t vb = b[i];
+		if (va >= 0 && vb >= 0)
+			a[i] = std::min(va, vb);
+		else if (va < 0 && vb < 0)
+			a[i] = std::max(va, vb);
+		else
+			a[i] = 0;
+	}
+}
+
+static int64_t scalar_keep_positive(int64_t* a, int n) {
+	uint64_t s = 0;
+	for (int i = 0; i < n; i++) {
+		if (a[i] <= 0) {
+			a[i] = 0;
+			continue;
+		}
+		s += uint64_t(a[i]);
+	}
+	return int64_t(s);
+}
+
+static int64_t scalar_keep_negative(int64_t* a, int n) {
+	uint64_t s = 0;
+	for (int i = 0; i < n; i++) {
+		if (a[i] >= 0) {
+			a[i] = 0;
+			continue;
+		}
+		s += uint64_t(a[i]);
+	}
+	return int64_t(s);
+}
+
+static int64_t scalar_sum_positive(const int64_t* a, int n) {
+	uint64_t s = 0;
+	for (int i = 0; i < n; i++) {
+		if (a[i] > 0)
+			s += uint64_t(a[i]);
+	}
+	return int64_t(s);
+}
+
+static int64_t scalar_sum_negative(const int64_t* a, int n) {
+	uint64_t s = 0;
+	for (int i = 0; i < n; i++) {
+		if (a[i] < 0)
+			s += uint64_t(a[i]);
+	}
+	return int64_t(s);
+}
+
+static int64_t scalar_diff_positive(const int64_t* a, const int64_t* b, int n) {
+	uint64_t s = 0;
+	for (int i = 0; i < n; i++) {
+		if (a[i] > b[i])
+			s += uint64_t(a[i]) - uint64_t(b[i]);
+	}
+	return int64_t(s);
+}
+
+static bool scalar_no_negative(const int64_t* a, int n) {
+	for (int i = 0; i < n; i++) {
+		if (a[i] < 0)
+			return false;
+	}
+	return true;
+}
+
+static bool scalar_no_positive(const int64_t* a, int n) {
+	for (int i = 0; i < n; i++) {
+		if (a[i] > 0)
+			return false;
+	}
+	return true;
+}
+
+static const CPegKernels kernels_scalar = {
+    "scalar",
+    scalar_sum,
+    scalar_add,
+    scalar_sub,
+    scalar_neg,
+    scalar_intersect,
+    scalar_keep_positive,
+    scalar_keep_negative,
+    scalar_sum_positive,
+    scalar_sum_negative,
+    scalar_diff_positive,
+    scalar_no_negative,
+    scalar_no_positive,
+};
+
+#if defined(PEG_KERNELS_X86)
+
+// AVX2, 4 slots per vector
+
+#define PEG_AVX2 __attribute__((target("avx2")))
+
+PEG_AVX2 static inline int64_t avx2_hsum(__m256i v) {
+	alignas(32) uint64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+	return int64_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+PEG_AVX2 static inline __m256i avx2_load(const int64_t* p) {
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+PEG_AVX2 static inline void avx2_store(int64_t* p, __m256i v) {
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+PEG_AVX2 static int64_t avx2_sum(const int64_t* a, int n) {
+	__m256i acc = _mm256_setzero_si256();
+	int     i   = 0;
+	for (; i + 4 <= n; i += 4)
+		acc = _mm256_add_epi64(acc, avx2_load(a + i));
+	return int64_t(uint64_t(avx2_hsum(acc)) + uint64_t(scalar_sum(a + i, n - i)));
+}
+
+PEG_AVX2 static void avx2_add(int64_t* a, const int64_t* b, int n) {
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		avx2_store(a + i, _mm256_add_epi64(avx2_load(a + i), avx2_load(b + i)));
+	scalar_add(a + i, b + i, n - i);
+}
+
+PEG_AVX2 static void avx2_sub(int64_t* a, const int64_t* b, int n) {
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		avx2_store(a + i, _mm256_sub_epi64(avx2_load(a + i), avx2_load(b + i)));
+	scalar_sub(a + i, b + i, n - i);
+}
+
+PEG_AVX2 static void avx2_neg(int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	int           i    = 0;
+	for (; i + 4 <= n; i += 4)
+		avx2_store(a + i, _mm256_sub_epi64(zero, avx2_load(a + i)));
+	scalar_neg(a + i, n - i);
+}
+
+PEG_AVX2 static void avx2_intersect(int64_t* a, const int64_t* b, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	int           i    = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i va  = avx2_load(a + i);
+		__m256i vb  = avx2_load(b + i);
+		__m256i sa  = _mm256_cmpgt_epi64(zero, va);
+		__m256i sb  = _mm256_cmpgt_epi64(zero, vb);
+		__m256i gt  = _mm256_cmpgt_epi64(va, vb);
+		__m256i mn  = _mm256_blendv_epi8(va, vb, gt);
+		__m256i mx  = _mm256_blendv_epi8(vb, va, gt);
+		__m256i sel = _mm256_blendv_epi8(mn, mx, sa);
+		avx2_store(a + i, _mm256_andnot_si256(_mm256_xor_si256(sa, sb), sel));
+	}
+	scalar_intersect(a + i, b + i, n - i);
+}
+
+PEG_AVX2 static int64_t avx2_keep_positive(int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i       acc  = zero;
+	int           i    = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = avx2_load(a + i);
+		v         = _mm256_and_si256(v, _mm256_cmpgt_epi64(v, zero));
+		avx2_store(a + i, v);
+		acc = _mm256_add_epi64(acc, v);
+	}
+	return int64_t(uint64_t(avx2_hsum(acc)) + uint64_t(scalar_keep_positive(a + i, n - i)));
+}
+
+PEG_AVX2 static int64_t avx2_keep_negative(int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i       acc  = zero;
+	int           i    = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = avx2_load(a + i);
+		v         = _mm256_and_si256(v, _mm256_cmpgt_epi64(zero, v));
+		avx2_store(a + i, v);
+		acc = _mm256_add_epi64(acc, v);
+	}
+	return int64_t(uint64_t(avx2_hsum(acc)) + uint64_t(scalar_keep_negative(a + i, n - i)));
+}
+
+PEG_AVX2 static int64_t avx2_sum_positive(const int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i       acc  = zero;
+	int           i    = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = avx2_load(a + i);
+		acc       = _mm256_add_epi64(acc, _mm256_and_si256(v, _mm256_cmpgt_epi64(v, zero)));
+	}
+	return int64_t(uint64_t(avx2_hsum(acc)) + uint64_t(scalar_sum_positive(a + i, n - i)));
+}
+
+PEG_AVX2 static int64_t avx2_sum_negative(const int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i       acc  = zero;
+	int           i    = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i v = avx2_load(a + i);
+		acc       = _mm256_add_epi64(acc, _mm256_and_si256(v, _mm256_cmpgt_epi64(zero, v)));
+	}
+	return int64_t(uint64_t(avx2_hsum(acc)) + uint64_t(scalar_sum_negative(a + i, n - i)));
+}
+
+PEG_AVX2 static int64_t avx2_diff_positive(const int64_t* a, const int64_t* b, int n) {
+	__m256i acc = _mm256_setzero_si256();
+	int     i   = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i va = avx2_load(a + i);
+		__m256i vb = avx2_load(b + i);
+		__m256i d  = _mm256_and_si256(_mm256_sub_epi64(va, vb), _mm256_cmpgt_epi64(va, vb));
+		acc        = _mm256_add_epi64(acc, d);
+	}
+	return int64_t(uint64_t(avx2_hsum(acc)) + uint64_t(scalar_diff_positive(a + i, b + i, n - i)));
+}
+
+PEG_AVX2 static bool avx2_no_negative(const int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	int           i    = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i m = _mm256_cmpgt_epi64(zero, avx2_load(a + i));
+		m         = _mm256_or_si256(m, _mm256_cmpgt_epi64(zero, avx2_load(a + i + 4)));
+		m         = _mm256_or_si256(m, _mm256_cmpgt_epi64(zero, avx2_load(a + i + 8)));
+		m         = _mm256_or_si256(m, _mm256_cmpgt_epi64(zero, avx2_load(a + i + 12)));
+		if (!_mm256_testz_si256(m, m))
+			return false;
+	}
+	return scalar_no_negative(a + i, n - i);
+}
+
+PEG_AVX2 static bool avx2_no_positive(const int64_t* a, int n) {
+	const __m256i zero = _mm256_setzero_si256();
+	int           i    = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i m = _mm256_cmpgt_epi64(avx2_load(a + i), zero);
+		m         = _mm256_or_si256(m, _mm256_cmpgt_epi64(avx2_load(a + i + 4), zero));
+		m         = _mm256_or_si256(m, _mm256_cmpgt_epi64(avx2_load(a + i + 8), zero));
+		m         = _mm256_or_si256(m, _mm256_cmpgt_epi64(avx2_load(a + i + 12), zero));
+		if (!_mm256_testz_si256(m, m))
+			return false;
+	}
+	return scalar_no_positive(a + i, n - i);
+}
+
+static const CPegKernels kernels_avx2 = {
+    "avx2",
+    avx2_sum,
+    avx2_add,
+    avx2_sub,
+    avx2_neg,
+    avx2_intersect,
+    avx2_keep_positive,
+    avx2_keep_negative,
+    avx2_sum_positive,
+    avx2_sum_negative,
+    avx2_diff_positive,
+    avx2_no_negative,
+    avx2_no_positive,
+};
+
+// SSE4.2, 2 slots per vector (pcmpgtq is SSE4.2)
+
+#define PEG_SSE42 __attribute__((target("sse4.2")))
+
+PEG_SSE42 static inline int64_t sse42_hsum(__m128i v) {
+	alignas(16) uint64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+	return int64_t(lanes[0] + lanes[1]);
+}
+
+PEG_SSE42 static inline __m128i sse42_load(const int64_t* p) {
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+PEG_SSE42 static inline void sse42_store(int64_t* p, __m128i v) {
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+PEG_SSE42 static int64_t sse42_sum(const int64_t* a, int n) {
+	__m128i acc = _mm_setzero_si128();
+	int     i   = 0;
+	for (; i + 2 <= n; i += 2)
+		acc = _mm_add_epi64(acc, sse42_load(a + i));
+	return int64_t(uint64_t(sse42_hsum(acc)) + uint64_t(scalar_sum(a + i, n - i)));
+}
+
+PEG_SSE42 static void sse42_add(int64_t* a, const int64_t* b, int n) {
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+		sse42_store(a + i, _mm_add_epi64(sse42_load(a + i), sse42_load(b + i)));
+	scalar_add(a + i, b + i, n - i);
+}
+
+PEG_SSE42 static void sse42_sub(int64_t* a, const int64_t* b, int n) {
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+		sse42_store(a + i, _mm_sub_epi64(sse42_load(a + i), sse42_load(b + i)));
+	scalar_sub(a + i, b + i, n - i);
+}
+
+PEG_SSE42 static void sse42_neg(int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	int           i    = 0;
+	for (; i + 2 <= n; i += 2)
+		sse42_store(a + i, _mm_sub_epi64(zero, sse42_load(a + i)));
+	scalar_neg(a + i, n - i);
+}
+
+PEG_SSE42 static void sse42_intersect(int64_t* a, const int64_t* b, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	int           i    = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i va  = sse42_load(a + i);
+		__m128i vb  = sse42_load(b + i);
+		__m128i sa  = _mm_cmpgt_epi64(zero, va);
+		__m128i sb  = _mm_cmpgt_epi64(zero, vb);
+		__m128i gt  = _mm_cmpgt_epi64(va, vb);
+		__m128i mn  = _mm_blendv_epi8(va, vb, gt);
+		__m128i mx  = _mm_blendv_epi8(vb, va, gt);
+		__m128i sel = _mm_blendv_epi8(mn, mx, sa);
+		sse42_store(a + i, _mm_andnot_si128(_mm_xor_si128(sa, sb), sel));
+	}
+	scalar_intersect(a + i, b + i, n - i);
+}
+
+PEG_SSE42 static int64_t sse42_keep_positive(int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i       acc  = zero;
+	int           i    = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i v = sse42_load(a + i);
+		v         = _mm_and_si128(v, _mm_cmpgt_epi64(v, zero));
+		sse42_store(a + i, v);
+		acc = _mm_add_epi64(acc, v);
+	}
+	return int64_t(uint64_t(sse42_hsum(acc)) + uint64_t(scalar_keep_positive(a + i, n - i)));
+}
+
+PEG_SSE42 static int64_t sse42_keep_negative(int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i       acc  = zero;
+	int           i    = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i v = sse42_load(a + i);
+		v         = _mm_and_si128(v, _mm_cmpgt_epi64(zero, v));
+		sse42_store(a + i, v);
+		acc = _mm_add_epi64(acc, v);
+	}
+	return int64_t(uint64_t(sse42_hsum(acc)) + uint64_t(scalar_keep_negative(a + i, n - i)));
+}
+
+PEG_SSE42 static int64_t sse42_sum_positive(const int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i       acc  = zero;
+	int           i    = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i v = sse42_load(a + i);
+		acc       = _mm_add_epi64(acc, _mm_and_si128(v, _mm_cmpgt_epi64(v, zero)));
+	}
+	return int64_t(uint64_t(sse42_hsum(acc)) + uint64_t(scalar_sum_positive(a + i, n - i)));
+}
+
+PEG_SSE42 static int64_t sse42_sum_negative(const int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i       acc  = zero;
+	int           i    = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i v = sse42_load(a + i);
+		acc       = _mm_add_epi64(acc, _mm_and_si128(v, _mm_cmpgt_epi64(zero, v)));
+	}
+	return int64_t(uint64_t(sse42_hsum(acc)) + uint64_t(scalar_sum_negative(a + i, n - i)));
+}
+
+PEG_SSE42 static int64_t sse42_diff_positive(const int64_t* a, const int64_t* b, int n) {
+	__m128i acc = _mm_setzero_si128();
+	int     i   = 0;
+	for (; i + 2 <= n; i += 2) {
+		__m128i va = sse42_load(a + i);
+		__m128i vb = sse42_load(b + i);
+		__m128i d  = _mm_and_si128(_mm_sub_epi64(va, vb), _mm_cmpgt_epi64(va, vb));
+		acc        = _mm_add_epi64(acc, d);
+	}
+	return int64_t(uint64_t(sse42_hsum(acc)) +
+	               uint64_t(scalar_diff_positive(a + i, b + i, n - i)));
+}
+
+PEG_SSE42 static bool sse42_no_negative(const int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	int           i    = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i m = _mm_cmpgt_epi64(zero, sse42_load(a + i));
+		m         = _mm_or_si128(m, _mm_cmpgt_epi64(zero, sse42_load(a + i + 2)));
+		m         = _mm_or_si128(m, _mm_cmpgt_epi64(zero, sse42_load(a + i + 4)));
+		m         = _mm_or_si128(m, _mm_cmpgt_epi64(zero, sse42_load(a + i + 6)));
+		if (!_mm_testz_si128(m, m))
+			return false;
+	}
+	return scalar_no_negative(a + i, n - i);
+}
+
+PEG_SSE42 static bool sse42_no_positive(const int64_t* a, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	int           i    = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i m = _mm_cmpgt_epi64(sse42_load(a + i), zero);
+		m         = _mm_or_si128(m, _mm_cmpgt_epi64(sse42_load(a + i + 2), zero));
+		m         = _mm_or_si128(m, _mm_cmpgt_epi64(sse42_load(a + i + 4), zero));
+		m         = _mm_or_si128(m, _mm_cmpgt_epi64(sse42_load(a + i + 6), zero));
+		if (!_mm_testz_si128(m, m))
+			return false;
+	}
+	return scalar_no_positive(a + i, n - i);
+}
+
+static const CPegKernels kernels_sse42 = {
+    "sse4.2",
+    sse42_sum,
+    sse42_add,
+    sse42_sub,
+    sse42_neg,
+    sse42_intersect,
+    sse42_keep_positive,
+    sse42_keep_negative,
+    sse42_sum_positive,
+    sse42_sum_negative,
+    sse42_diff_positive,
+    sse42_no_negative,
+    sse42_no_positive,
+};
+
+#endif  // PEG_KERNELS_X86
+
+std::vector<const CPegKernels*> PegKernelsAvailable() {
+	std::vector<const CPegKernels*> kernels;
+#if defined(PEG_KERNELS_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back(&kernels_avx2);
+	if (__builtin_cpu_supports("sse4.2"))
+		kernels.push_back(&kernels_sse42);
+#endif
+	kernels.push_back(&kernels_scalar);
+	return kernels;
+}
+
+const CPegKernels& PegKernels() {
+	static const CPegKernels* kernels = PegKernelsAvailable().front();
+	return *kernels;
+}
+
+const CPegKernels& PegKernelsScalar() {
+	return kernels_scalar;
+}
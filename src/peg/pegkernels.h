@@ -0,0 +1,35 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITBAY_PEGKERNELS_H
+#define BITBAY_PEGKERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+/** Kernels over contiguous ranges of fraction slots used by CFractions.
+ *  Vectorized versions (AVX2, SSE4.2) are selected at runtime by cpu
+ *  features, all of them give bit-identical results with scalar ones.
+ */
+struct CPegKernels {
+	const char* name;
+	int64_t (*sum)(const int64_t* a, int n);
+	void (*add)(int64_t* a, const int64_t* b, int n);
+	void (*sub)(int64_t* a, const int64_t* b, int n);
+	void (*neg)(int64_t* a, int n);
+	void (*intersect)(int64_t* a, const int64_t* b, int n);  // CFractions::operator&
+	int64_t (*keep_positive)(int64_t* a, int n);             // zero others, return sum
+	int64_t (*keep_negative)(int64_t* a, int n);             // zero others, return sum
+	int64_t (*sum_positive)(const int64_t* a, int n);
+	int64_t (*sum_negative)(const int64_t* a, int n);
+	int64_t (*diff_positive)(const int64_t* a, const int64_t* b, int n);  // sum of a-b if a>b
+	bool (*no_negative)(const int64_t* a, int n);
+	bool (*no_positive)(const int64_t* a, int n);
+};
+
+const CPegKernels&              PegKernels();
+const CPegKernels&              PegKernelsScalar();
+std::vector<const CPegKernels*> PegKernelsAvailable();
+
+#endif
@@ -4,6 +4,7 @@ HEADERS += \
     $$PWD/pegops.h \
     $$PWD/pegopsp.h \
     $$PWD/pegdata.h \
+    $$PWD/pegkernels.h \
 
 SOURCES += \
     $$PWD/pegstd.cpp \
@@ -13,4 +14,5 @@ SOURCES += \
     $$PWD/pegdata_compat.cpp \
     $$PWD/peglevel.cpp \
     $$PWD/pegfractions.cpp \
+    $$PWD/pegkernels.cpp \
 
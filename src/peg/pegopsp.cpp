@@ -137,11 +137,11 @@ bool updatepegbalances(CPegData&        pdBalance,
 		nTakeReserve         = std::min(nTakeReserve, pdPegPool.nReserve);
 
 		pdPegPool.nReserve -= nTakeReserve;
-		pdPegPool.fractions.f[nLastIdx] -= nTakeReserve;
+		pdPegPool.fractions.f.Set(nLastIdx, pdPegPool.fractions.f[nLastIdx] - nTakeReserve);
 
 		if (nLastReserve > nTakeReserve) {  // take it from liquid
 			int64_t nDiff = nLastReserve - nTakeReserve;
-			frReserve.f[nLastIdx] -= nDiff;
+			frReserve.f.Set(nLastIdx, frReserve.f[nLastIdx] - nDiff);
 			nReserve -= nDiff;
 		}
 
@@ -156,8 +156,9 @@ bool updatepegbalances(CPegData&        pdBalance,
 		int64_t nTakeLiquid = RatioPart(nLastLiquid, nLiquid, nLiquidPool);
 		nTakeLiquid         = std::min(nTakeLiquid, nLastTotal);
 
-		frLiquid.f[nLastIdx] += nTakeLiquid;
-		pdPegPool.fractions.f[nLastIdx] -= nTakeLiquid;
+		frLiquid.f.Set(nLastIdx, frLiquid.f[nLastIdx] + nTakeLiquid);
+		pdPegPool.fractions.f.Set(nLastIdx,
+		                          pdPegPool.fractions.f[nLastIdx] - nTakeLiquid);
 	}
 
 	// liquid is just normed to pool
@@ -174,19 +175,19 @@ bool updatepegbalances(CPegData&        pdBalance,
 	int64_t nHoldLastPart = 0;
 	if (pdPegPool.nReserve > 0) {
 		nHoldLastPart                   = pdPegPool.fractions.f[nLastIdx];
-		pdPegPool.fractions.f[nLastIdx] = 0;
+		pdPegPool.fractions.f.Set(nLastIdx, 0);
 	}
 
 	nLiquidTodo = pdPegPool.fractions.MoveRatioPartTo(nLiquidTodo, frLiquid);
 
 	if (nLiquidTodo > 0 && nLiquidTodo <= nHoldLastPart) {
-		frLiquid.f[nLastIdx] += nLiquidTodo;
+		frLiquid.f.Set(nLastIdx, frLiquid.f[nLastIdx] + nLiquidTodo);
 		nHoldLastPart -= nLiquidTodo;
 		nLiquidTodo = 0;
 	}
 
 	if (nHoldLastPart > 0) {
-		pdPegPool.fractions.f[nLastIdx] = nHoldLastPart;
+		pdPegPool.fractions.f.Set(nLastIdx, nHoldLastPart);
 		nHoldLastPart                   = 0;
 	}
 
@@ -421,7 +422,7 @@ bool moveliquid(int64_t          nMoveAmount,
 			return false;
 		}
 
-		frLiquid.f[nSupplyEffective - 1] = nPartialLiquid;
+		frLiquid.f.Set(nSupplyEffective - 1, nPartialLiquid);
 	}
 
 	if (frLiquid.Total() < nMoveAmount) {
@@ -537,7 +538,7 @@ bool movereserve(int64_t          nMoveAmount,
 			return false;
 		}
 
-		frReserve.f[nSupplyEffective] = nPartialReserve;
+		frReserve.f.Set(nSupplyEffective, nPartialReserve);
 	}
 
 	CFractions frMove = frReserve.RatioPart(nMoveAmount);
@@ -837,7 +838,7 @@ bool prepareliquidwithdraw(const std::vector<std::tuple<std::string, CPegData, s
 			return false;
 		}
 
-		frBalanceLiquid.f[nSupplyEffective - 1] = nPartialLiquid;
+		frBalanceLiquid.f.Set(nSupplyEffective - 1, nPartialLiquid);
 	}
 
 	if (frBalanceLiquid.Total() < nAmountWithFee) {
@@ -1343,7 +1344,7 @@ bool preparereservewithdraw(
 			return false;
 		}
 
-		frBalanceReserve.f[nSupplyEffective] = nPartialReserve;
+		frBalanceReserve.f.Set(nSupplyEffective, nPartialReserve);
 	}
 
 	if (frBalanceReserve.Total() < nAmountWithFee) {
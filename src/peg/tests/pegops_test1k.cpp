@@ -29,7 +29,7 @@ void TestPegOps::test1k()
         CFractions user(0,CFractions::STD);
         int start = distribution(generator);
         for(int i=start;i<PEG_SIZE;i++) {
-            user.f[i] = distribution(generator) / (i*5/6+1);
+            user.f.Set(i, distribution(generator) / (i*5/6+1));
         }
         users.push_back(user);
         CPegData pdUser;
@@ -51,9 +51,9 @@ void TestPegOps::test1k()
     CFractions pegshift(0,CFractions::STD);
     for(int i=0;i<PEG_SIZE;i++) {
         if (i<PEG_SIZE/2) {
-            pegshift.f[i] = distribution(generator) /10 / (i+1);
+            pegshift.f.Set(i, distribution(generator) /10 / (i+1));
         } else {
-            pegshift.f[i] = -pegshift.f[PEG_SIZE-i-1];
+            pegshift.f.Set(i, -pegshift.f[PEG_SIZE-i-1]);
         }
     }
     
@@ -17,7 +17,7 @@ void TestPegOps::test5()
 {
     CFractions user1(0, CFractions::STD);
     for(int i=0;i<PEG_SIZE;i++) {
-        user1.f[i] = 23;
+        user1.f.Set(i, 23);
     }
     
     CPegData pdPegShift;
@@ -211,7 +211,7 @@ void TestPegOps::test5()
     
     CFractions user2(0,CFractions::STD);
     for(int i=10;i<PEG_SIZE-100;i++) {
-        user2.f[i] = 79;
+        user2.f.Set(i, 79);
     }
     
     CFractions exchange2 = pdUser1.fractions + user2;
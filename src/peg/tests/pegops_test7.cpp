@@ -19,12 +19,12 @@ void TestPegOps::test7()
     
     CFractions user1(0,CFractions::STD);
     for(int i=0;i<PEG_SIZE;i++) {
-        user1.f[i] = 23;
+        user1.f.Set(i, 23);
     }
     
     CFractions user2(0,CFractions::STD);
     for(int i=100;i<PEG_SIZE-100;i++) {
-        user2.f[i] = 79;
+        user2.f.Set(i, 79);
     }
     
     CFractions exchange1 = user1 + user2;
@@ -32,9 +32,9 @@ void TestPegOps::test7()
     CFractions pegshift1(0,CFractions::STD);
     for(int i=0;i<PEG_SIZE;i++) {
         if (i<PEG_SIZE/2) {
-            pegshift1.f[i] = 13;
+            pegshift1.f.Set(i, 13);
         } else {
-            pegshift1.f[i] = -13;
+            pegshift1.f.Set(i, -13);
         }
     }
     
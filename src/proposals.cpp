@@ -570,10 +570,10 @@ string ProposalToNotary(vector<string> datas) {
 	return notary;
 }
 
-vector<string> NotaryToProposal(string                      notary,
-								map<string, vector<string>> bridges,
-								string&                     phash,
-								string&                     address_override) {
+vector<string> NotaryToProposal(string                             notary,
+								const map<string, vector<string>>& bridges,
+								string&                            phash,
+								string&                            address_override) {
 	vector<string> skip;
 	vector<string> pdatas;
 
@@ -22,9 +22,10 @@ json_spirit::Object ProposalToJson(std::vector<std::string>
 
 std::string ProposalToNotary(std::vector<std::string> datas);
 
-std::vector<std::string> NotaryToProposal(std::string                                     notary,
-										  std::map<std::string, std::vector<std::string>> bridges,
-										  std::string&                                    phash,
-										  std::string& address_override);
+std::vector<std::string> NotaryToProposal(
+    std::string                                            notary,
+    const std::map<std::string, std::vector<std::string>>& bridges,
+    std::string&                                           phash,
+    std::string&                                           address_override);
 
 #endif
@@ -541,14 +541,14 @@ void BlockchainPage::openBlock(uint256 hash) {
 			pegdb.ReadBridgeCycleBridgeHashes(bhash_bridge_cycle, bridge_hashes);
 
 			for (const string& brhash : bridge_hashes) {
-				set<string> txouts;
-				pegdb.ReadBridgeCycleBurnsToBridge(hash, brhash, txouts);
+				vector<CBridgeBurn> burns;
+				pegdb.ReadBridgeCycleBurnsToBridge(hash, brhash, burns);
 
 				int idx = 0;
-				for (const string& txout : txouts) {
+				for (const CBridgeBurn& burn : burns) {
 					QString stx = "br-" + QString::fromStdString(brhash.substr(0, 8)) + "-txout" +
 					              QString::number(idx);
-					QString thash = QString::fromStdString(txout);
+					QString thash = QString::fromStdString(burn.ToString());
 					ui->blockValues->addTopLevelItem(
 					    new QTreeWidgetItem(QStringList({stx, thash})));
 					idx++;
@@ -1107,10 +1107,14 @@ void BlockchainPage::openBalanceFromTx(QString addr) {
 	ui->balanceCurrent->clear();
 	ui->balanceValues->clear();
 
+	CAddressKey address;
+	if (!address.SetString(addr.toStdString()))
+		return;
+
 	LOCK(cs_main);
 	CTxDB                   txdb("r");
 	vector<CAddressBalance> records;
-	bool                    ok = txdb.ReadAddressBalanceRecords(addr.toStdString(), records);
+	bool                    ok = txdb.ReadAddressBalanceRecords(address, records);
 	if (!ok)
 		return;
 	int  nIdx           = records.size();
@@ -1118,7 +1122,7 @@ void BlockchainPage::openBalanceFromTx(QString addr) {
 	for (const auto& record : records) {
 		if (isLatestRecord) {
 			CFractions pegbalance;
-			txdb.ReadPegBalance(addr.toStdString(), pegbalance);
+			txdb.ReadPegBalance(address, pegbalance);
 			int64_t nLiquid      = pegbalance.High(pindexBest->nPegSupplyIndex);
 			int64_t nReserve     = pegbalance.Low(pindexBest->nPegSupplyIndex);
 			int     nValueMaxLen = qMax(
@@ -1217,6 +1221,10 @@ void BlockchainPage::openUnspentFromAddress(QString addr) {
 
 	ui->utxoValues->clear();
 
+	CAddressKey address;
+	if (!address.SetString(addr.toStdString()))
+		return;
+
 	LOCK(cs_main);
 	CTxDB  txdb("r");
 	CPegDB pegdb("r");
@@ -1243,7 +1251,7 @@ void BlockchainPage::openUnspentFromAddress(QString addr) {
 		int64_t                 nReserve = 0;
 		int64_t                 nBalance = 0;
 		vector<CAddressUnspent> records;
-		bool                    ok = txdb.ReadAddressUnspent(addr.toStdString(), records);
+		bool                    ok = txdb.ReadAddressUnspent(address, records);
 		if (ok) {
 			int nIdx = records.size();
 			for (const auto& record : records) {
@@ -1308,7 +1316,7 @@ void BlockchainPage::openUnspentFromAddress(QString addr) {
 		int64_t nFrozen = 0;
 
 		vector<CAddressUnspent> records;
-		bool                    ok = txdb.ReadAddressFrozen(addr.toStdString(), records);
+		bool                    ok = txdb.ReadAddressFrozen(address, records);
 		if (ok) {
 			int nIdx = records.size();
 			for (const auto& record : records) {
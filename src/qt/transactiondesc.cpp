@@ -309,39 +309,18 @@ QString TransactionDesc::toHTML(CWallet* wallet, CWalletTx& wtx, TransactionReco
 								LOCK(cs_main);
 								CPegDB pegdb("r");
 
-								bool        is_receipt_ready = false;
-								set<string> burns_data;
+								bool                is_receipt_ready = false;
+								vector<CBridgeBurn> burns;
 								pegdb.ReadBridgeCycleBurnsToBridge(bhash_bridge_cycle, brhash,
-																   burns_data);
-								for (const string& burn_data : burns_data) {
-									vector<string> burn_datas;
-									boost::split(burn_datas, burn_data, boost::is_any_of(":"));
-									if (burn_datas.size() >= 5) {
-										// txout:nout
-										string b_txid = burn_datas[0];
-										string b_nout = burn_datas[1];
-										if (b_txid == txid && b_nout == std::to_string(nout)) {
-											int b_num_reserve = std::atoi(burn_datas[4].c_str());
-											if (burn_datas.size() >=
-												size_t(5 + b_num_reserve + 1)) {
-												for (int i = 0; i < b_num_reserve; i++) {
-													int64_t v = strtoll(burn_datas[5 + i].c_str(),
-																		NULL, 10);
-													reserve.push_back(v);
-													is_receipt_ready = true;
-												}
-												int b_num_proof = std::atoi(
-													burn_datas[5 + b_num_reserve].c_str());
-												if (burn_datas.size() ==
-													size_t(5 + b_num_reserve + 1 + b_num_proof)) {
-													for (int i = 0; i < b_num_proof; i++) {
-														string p =
-															"0x" +
-															burn_datas[5 + b_num_reserve + 1 + i];
-														proof.push_back(p);
-													}
-												}
-											}
+																   burns);
+								for (const CBridgeBurn& burn : burns) {
+									if (burn.txhash == wtx.GetHash() && burn.nout == nout) {
+										for (uint64_t v : burn.reserve) {
+											reserve.push_back(int64_t(v));
+											is_receipt_ready = true;
+										}
+										for (const CBridgeBurn::Hash& h : burn.proof) {
+											proof.push_back("0x" + HexStr(h.begin(), h.end()));
 										}
 									}
 								}
@@ -433,8 +433,8 @@ void TxDetailsWidget::openTx(CTransaction& tx,
 	int64_t nReserveIn   = 0;
 	int64_t nLiquidityIn = 0;
 	for (auto const& inputFractionItem : mapInputsFractions) {
-		inputFractionItem.second.LowPart(nSupply, &nReserveIn);
-		inputFractionItem.second.HighPart(nSupply, &nLiquidityIn);
+		nReserveIn += inputFractionItem.second.Low(nSupply);
+		nLiquidityIn += inputFractionItem.second.High(nSupply);
 	}
 
 	bool peg_ok = false;
@@ -949,7 +949,7 @@ void TxDetailsWidget::openTxMenu(const QPoint& pos) {
 				}
 			}
 
-			unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+			CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 			if (mi != mapBlockIndex.end() && (*mi).second) {
 				CBlockIndex* pindex = (*mi).second;
 				nSupply             = pindex->nPegSupplyIndex;
@@ -1907,7 +1907,7 @@ void TxDetailsWidget::copyPegData(QTreeWidget* table) {
 		bool isIndex = false;
 		int  index   = name.toInt(&isIndex);
 		if (isIndex && index >= 0 && index < PEG_SIZE) {
-			pegdata.fractions.f[index] = value.toLongLong();
+			pegdata.fractions.f.Set(index, value.toLongLong());
 		}
 		qDebug() << pegdata.fractions.Total();
 	}
@@ -464,7 +464,7 @@ Value gettxout(const Array& params, bool fHelp) {
 
 	bool is_in_main_chain = false;
 	if (hashBlock != 0) {
-		unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+		CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 		if (mi != mapBlockIndex.end() && (*mi).second) {
 			CBlockIndex* pindex = (*mi).second;
 			if (pindex->IsInMainChain()) {
@@ -500,8 +500,8 @@ Value createbootstrap(const Array& params, bool fHelp) {
 		return JSONRPCError(RPC_MISC_ERROR, "Open bootstrap failed");
 	}
 
-	uint256                                        blockHash = Params().HashGenesisBlock();
-	unordered_map<uint256, CBlockIndex*>::iterator mi        = mapBlockIndex.find(blockHash);
+	uint256                  blockHash = Params().HashGenesisBlock();
+	CBlockIndexMap::iterator mi        = mapBlockIndex.find(blockHash);
 	if (mi == mapBlockIndex.end()) {
 		throw JSONRPCError(RPC_MISC_ERROR, "Genesis block not found");
 	}
@@ -572,13 +572,9 @@ Value listunspent1(const Array& params, bool fHelp) {
 
 	RPCTypeCheck(params, list_of(str_type)(int_type)(int_type)(int_type));
 
-	CBitcoinAddress address(params[0].get_str());
-	if (!address.IsValid())
-		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-		                   string("Invalid BitBay address: ") + params[0].get_str());
-
-	string sAddress = params[0].get_str();
-	if (sAddress.length() != 34)
+	string      sAddress = params[0].get_str();
+	CAddressKey address;
+	if (!address.SetString(sAddress))
 		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
 		                   string("Invalid BitBay address: ") + params[0].get_str());
 
@@ -610,7 +606,7 @@ Value listunspent1(const Array& params, bool fHelp) {
 		                   string("Balance/unspent database is not ready (may require restart)"));
 
 	vector<CAddressUnspent> records;
-	if (!txdb.ReadAddressUnspent(sAddress, records))
+	if (!txdb.ReadAddressUnspent(address, records))
 		throw JSONRPCError(RPC_MISC_ERROR, strprintf("Failed ReadAddressUnspent"));
 
 	Array results;
@@ -700,13 +696,9 @@ Value listfrozen1(const Array& params, bool fHelp) {
 
 	RPCTypeCheck(params, list_of(str_type)(int_type)(int_type)(int_type));
 
-	CBitcoinAddress address(params[0].get_str());
-	if (!address.IsValid())
-		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-		                   string("Invalid BitBay address: ") + params[0].get_str());
-
-	string sAddress = params[0].get_str();
-	if (sAddress.length() != 34)
+	string      sAddress = params[0].get_str();
+	CAddressKey address;
+	if (!address.SetString(sAddress))
 		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
 		                   string("Invalid BitBay address: ") + params[0].get_str());
 
@@ -738,7 +730,7 @@ Value listfrozen1(const Array& params, bool fHelp) {
 		                   string("Balance/unspent database is not ready (may require restart)"));
 
 	vector<CAddressUnspent> records;
-	if (!txdb.ReadAddressFrozen(sAddress, records))
+	if (!txdb.ReadAddressFrozen(address, records))
 		throw JSONRPCError(RPC_MISC_ERROR, strprintf("Failed ReadAddressFrozen"));
 
 	Array results;
@@ -800,13 +792,9 @@ Value balance(const Array& params, bool fHelp) {
 
 	RPCTypeCheck(params, list_of(str_type)(int_type));
 
-	CBitcoinAddress address(params[0].get_str());
-	if (!address.IsValid())
-		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-		                   string("Invalid BitBay address: ") + params[0].get_str());
-
-	string sAddress = params[0].get_str();
-	if (sAddress.length() != 34)
+	string      sAddress = params[0].get_str();
+	CAddressKey address;
+	if (!address.SetString(sAddress))
 		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
 		                   string("Invalid BitBay address: ") + params[0].get_str());
 
@@ -828,7 +816,7 @@ Value balance(const Array& params, bool fHelp) {
 
 	int64_t         nLastIndex = -1;
 	CAddressBalance balance;
-	bool            fFound = txdb.ReadAddressLastBalance(sAddress, balance, nLastIndex);
+	bool            fFound = txdb.ReadAddressLastBalance(address, balance, nLastIndex);
 
 	Object result;
 
@@ -840,7 +828,7 @@ Value balance(const Array& params, bool fHelp) {
 	int64_t nUnspentReserve = 0;
 	if (fFound) {
 		CFractions fractions(balance.nBalance - balance.nFrozen, CFractions::STD);
-		if (!txdb.ReadPegBalance(sAddress, fractions))
+		if (!txdb.ReadPegBalance(address, fractions))
 			throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, string("ReadPegBalance failed"));
 		nUnspentLiquid  = fractions.High(nSupply);
 		nUnspentReserve = fractions.Low(nSupply);
@@ -859,12 +847,9 @@ Value balancerecords(const Array& params, bool fHelp) {
 		    "\t(blockchain api)\n"
 		    "\tReturns the balance records of the specified address\n");
 	RPCTypeCheck(params, list_of(str_type));
-	CBitcoinAddress address(params[0].get_str());
-	if (!address.IsValid())
-		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-		                   string("Invalid BitBay address: ") + params[0].get_str());
-	string sAddress = params[0].get_str();
-	if (sAddress.length() != 34)
+	string      sAddress = params[0].get_str();
+	CAddressKey address;
+	if (!address.SetString(sAddress))
 		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
 		                   string("Invalid BitBay address: ") + params[0].get_str());
 	CTxDB txdb("r");
@@ -874,7 +859,7 @@ Value balancerecords(const Array& params, bool fHelp) {
 		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
 		                   string("Balance/unspent database is not ready (may require restart)"));
 	vector<CAddressBalance> records;
-	bool                    ok = txdb.ReadAddressBalanceRecords(sAddress, records);
+	bool                    ok = txdb.ReadAddressBalanceRecords(address, records);
 	if (!ok)
 		throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, string("Balance/unspent database error"));
 
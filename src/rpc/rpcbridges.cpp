@@ -17,6 +17,7 @@
 #include "main.h"
 #include "rpcserver.h"
 // #include "checkpoints.h"
+#include "pegcycle.h"
 #include "pegdb-leveldb.h"
 #include "txdb-leveldb.h"
 
@@ -37,13 +38,12 @@ Value bridges(const Array& params, bool fHelp) {
 
 	Object result;
 
-	CPegDB                   pegdb;
-	map<string, CBridgeInfo> bridges;
-	bool                     ok        = pindexBest->ReadBridges(pegdb, bridges);
-	bool                     is_paused = false;
-	ok                                 = pindexBest->ReadBridgesPause(pegdb, is_paused);
+	CPegDB            pegdb;
+	CPegCycleStateRef cycle     = GetPegCycleState(pegdb, pindexBest);
+	bool              ok        = cycle->fBridgesPause;
+	bool              is_paused = cycle->fPaused;
 
-	for (const auto& it : bridges) {
+	for (const auto& it : cycle->bridges) {
 		string      name   = it.first;
 		CBridgeInfo bridge = it.second;
 
@@ -213,11 +213,11 @@ Value timelockpasses(const Array& params, bool fHelp) {
 
 	Array result;
 
-	CPegDB      pegdb;
-	set<string> datas;
-	bool        ok = pindexBest->ReadTimeLockPasses(pegdb, datas);
+	CPegDB            pegdb;
+	CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindexBest);
+	bool              ok    = cycle->fTimeLockPasses;
 
-	for (const string& pubkey_txt : datas) {
+	for (const string& pubkey_txt : cycle->timelockpasses) {
 		result.push_back(pubkey_txt);
 	}
 
@@ -297,9 +297,8 @@ Value bridgereceipt(const Array& params, bool fHelp) {
 								brhash_to_merkle[brhash] = merkle;
 							}
 						}
-						map<string, CBridgeInfo> bridges;
-						pblockindex->ReadBridges(pegdb, bridges);
-						for (const auto& it : bridges) {
+						CPegCycleStateRef cycle = GetPegCycleState(pegdb, pblockindex);
+						for (const auto& it : cycle->bridges) {
 							CBridgeInfo bdatas            = it.second;
 							brhash_to_brname[bdatas.hash] = bdatas.name;
 						}
@@ -336,36 +335,20 @@ Value bridgereceipt(const Array& params, bool fHelp) {
 				LOCK(cs_main);
 				CPegDB pegdb("r");
 
-				bool        is_receipt_ready = false;
-				set<string> burns_data;
-				pegdb.ReadBridgeCycleBurnsToBridge(bhash_bridge_cycle, brhash, burns_data);
-				for (const string& burn_data : burns_data) {
-					vector<string> burn_datas;
-					boost::split(burn_datas, burn_data, boost::is_any_of(":"));
-					if (burn_datas.size() >= 5) {
-						// txout:nout
-						string b_txid = burn_datas[0];
-						string b_nout = burn_datas[1];
-						if (b_txid == txid && b_nout == std::to_string(nout)) {
-							string brname = brhash_to_brname[brhash];
-							result.push_back(Pair("bridge", brname));
-							result.push_back(Pair("brhash", brhash));
-							int b_num_reserve = std::atoi(burn_datas[4].c_str());
-							if (burn_datas.size() >= size_t(5 + b_num_reserve + 1)) {
-								for (int i = 0; i < b_num_reserve; i++) {
-									int64_t v = strtoll(burn_datas[5 + i].c_str(), NULL, 10);
-									reserve.push_back(v);
-									is_receipt_ready = true;
-								}
-								int b_num_proof = std::atoi(burn_datas[5 + b_num_reserve].c_str());
-								if (burn_datas.size() ==
-								    size_t(5 + b_num_reserve + 1 + b_num_proof)) {
-									for (int i = 0; i < b_num_proof; i++) {
-										string p = "0x" + burn_datas[5 + b_num_reserve + 1 + i];
-										proof.push_back(p);
-									}
-								}
-							}
+				bool                is_receipt_ready = false;
+				vector<CBridgeBurn> burns;
+				pegdb.ReadBridgeCycleBurnsToBridge(bhash_bridge_cycle, brhash, burns);
+				for (const CBridgeBurn& burn : burns) {
+					if (burn.txhash == tx.GetHash() && burn.nout == nout) {
+						string brname = brhash_to_brname[brhash];
+						result.push_back(Pair("bridge", brname));
+						result.push_back(Pair("brhash", brhash));
+						for (uint64_t v : burn.reserve) {
+							reserve.push_back(int64_t(v));
+							is_receipt_ready = true;
+						}
+						for (const CBridgeBurn::Hash& h : burn.proof) {
+							proof.push_back("0x" + HexStr(h.begin(), h.end()));
 						}
 					}
 				}
@@ -398,10 +381,9 @@ Value bridgeautomate(const Array& params, bool fHelp) {
 	double max_priority_fee_per_gas_gwei = params[2].get_real();
 	double max_fee_per_gas_gwei          = params[3].get_real();
 
-	CPegDB                   pegdb;
-	map<string, CBridgeInfo> bridges;
-	pindexBest->ReadBridges(pegdb, bridges);
-	for (const auto& it : bridges) {
+	CPegDB            pegdb;
+	CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindexBest);
+	for (const auto& it : cycle->bridges) {
 		CBridgeInfo bridge      = it.second;
 		string      bridge_name = bridge.name;
 		if (bridge_name != name) {
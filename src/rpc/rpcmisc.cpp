@@ -8,8 +8,11 @@
 #include "main.h"
 #include "net.h"
 #include "netbase.h"
+#include "pegcache.h"
+#include "pegcycle.h"
 #include "pegdb-leveldb.h"
 #include "rpcserver.h"
+#include "sigcache.h"
 #include "timedata.h"
 #include "txdb-leveldb.h"
 #include "util.h"
@@ -101,6 +104,120 @@ Value getpeginfo(const Array& params, bool fHelp) {
 	return peg;
 }
 
+Value getpegcacheinfo(const Array& params, bool fHelp) {
+	if (fHelp || params.size() != 0)
+		throw runtime_error(
+		    "getpegcacheinfo\n"
+		    "Returns an object containing statistics of decoded fractions cache.");
+
+	CPegCacheStats stats = PegFractionsCache().Stats();
+
+	Object cache;
+	cache.push_back(Pair("entries", (int64_t)stats.nEntries));
+	cache.push_back(Pair("bytes", (int64_t)stats.nBytes));
+	cache.push_back(Pair("maxbytes", (int64_t)stats.nMaxBytes));
+	cache.push_back(Pair("hits", (int64_t)stats.nHits));
+	cache.push_back(Pair("misses", (int64_t)stats.nMisses));
+	cache.push_back(Pair("evictions", (int64_t)stats.nEvictions));
+	cache.push_back(Pair("invalidations", (int64_t)stats.nInvalidations));
+	return cache;
+}
+
+Value getsigcacheinfo(const Array& params, bool fHelp) {
+	if (fHelp || params.size() != 0)
+		throw runtime_error(
+		    "getsigcacheinfo\n"
+		    "Returns an object containing statistics of valid signatures cache.");
+
+	CSigCacheStats stats    = SignatureCache().Stats();
+	uint64_t       nLookups = stats.nHits + stats.nMisses;
+
+	Object cache;
+	cache.push_back(Pair("entries", (int64_t)stats.nEntries));
+	cache.push_back(Pair("slots", (int64_t)stats.nSlots));
+	cache.push_back(Pair("maxentries", (int64_t)stats.nMaxEntries));
+	cache.push_back(Pair("hits", (int64_t)stats.nHits));
+	cache.push_back(Pair("misses", (int64_t)stats.nMisses));
+	cache.push_back(Pair("hitrate", nLookups ? double(stats.nHits) / nLookups : 0.0));
+	cache.push_back(Pair("inserts", (int64_t)stats.nInserts));
+	cache.push_back(Pair("evictions", (int64_t)stats.nEvictions));
+	return cache;
+}
+
+Value getaddrindexcacheinfo(const Array& params, bool fHelp) {
+	if (fHelp || params.size() != 0)
+		throw runtime_error(
+		    "getaddrindexcacheinfo\n"
+		    "Returns an object containing statistics of address index write-back cache.");
+
+	CAddrIndexCacheStats stats = AddrIndexCache().Stats();
+
+	Object cache;
+	cache.push_back(Pair("entries", (int64_t)stats.nEntries));
+	cache.push_back(Pair("bytes", (int64_t)stats.nBytes));
+	cache.push_back(Pair("maxbytes", (int64_t)stats.nMaxBytes));
+	cache.push_back(Pair("hits", (int64_t)stats.nHits));
+	cache.push_back(Pair("misses", (int64_t)stats.nMisses));
+	cache.push_back(Pair("flushes", (int64_t)stats.nFlushes));
+	cache.push_back(Pair("flushedwrites", (int64_t)stats.nFlushedWrites));
+	cache.push_back(Pair("dirtysince", stats.nDirtySince));
+	return cache;
+}
+
+Value getpegcyclecacheinfo(const Array& params, bool fHelp) {
+	if (fHelp || params.size() != 0)
+		throw runtime_error(
+		    "getpegcyclecacheinfo\n"
+		    "Returns an object containing statistics of peg cycle consensus state snapshots.");
+
+	CPegCycleCacheStats stats = PegCycleStates().Stats();
+
+	Object cache;
+	cache.push_back(Pair("entries", (int64_t)stats.nEntries));
+	cache.push_back(Pair("maxentries", (int64_t)CPegCycleStates::MAX_ENTRIES));
+	cache.push_back(Pair("merkles", (int64_t)stats.nMerkles));
+	cache.push_back(Pair("hits", (int64_t)stats.nHits));
+	cache.push_back(Pair("misses", (int64_t)stats.nMisses));
+	cache.push_back(Pair("invalidations", (int64_t)stats.nInvalidations));
+	return cache;
+}
+
+static Object DbInfo(const std::string& sName, leveldb::DB* pdb) {
+	CDbTuning tuning = GetDbTuning(sName);
+
+	Object db;
+	db.push_back(Pair("cachebytes", tuning.nCacheBytes));
+	db.push_back(Pair("writebuffer", tuning.nWriteBuffer));
+	db.push_back(Pair("bloombits", tuning.nBloomBits));
+	db.push_back(Pair("compression", tuning.fCompression));
+	db.push_back(Pair("maxopenfiles", tuning.nMaxOpenFiles));
+	if (!pdb)
+		return db;
+
+	CDbStats stats = GetDbStats(pdb);
+	Array    files;
+	for (int nFiles : stats.vFilesAtLevel)
+		files.push_back(nFiles);
+	db.push_back(Pair("approximatesize", (int64_t)stats.nApproxSize));
+	db.push_back(Pair("filesatlevel", files));
+	db.push_back(Pair("stats", stats.sStats));
+	return db;
+}
+
+Value getdbinfo(const Array& params, bool fHelp) {
+	if (fHelp || params.size() != 0)
+		throw runtime_error(
+		    "getdbinfo\n"
+		    "Returns an object containing tuning and LevelDB statistics of txdb, pegdb and\n"
+		    "the address index db.");
+
+	Object result;
+	result.push_back(Pair("txdb", DbInfo("tx", txdb)));
+	result.push_back(Pair("pegdb", DbInfo("peg", pegdb)));
+	result.push_back(Pair("addrdb", DbInfo("addr", addrdb)));
+	return result;
+}
+
 Value getfractions(const Array& params, bool fHelp) {
 	if (fHelp || params.size() < 1 || params.size() > 2)
 		throw runtime_error(
@@ -240,7 +357,7 @@ Value getfractionsbase64(const Array& params, bool fHelp) {
 		if (txdb.ReadTxIndex(txhash, txindex)) {
 			CBlock block;
 			if (block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false)) {
-                unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
+                CBlockIndexMap::iterator mi = mapBlockIndex.find(block.GetHash());
 				if (mi != mapBlockIndex.end()) {
 					CBlockIndex* pindex         = (*mi).second;
 					int          nPegInterval   = Params().PegInterval();
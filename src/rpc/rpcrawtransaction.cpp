@@ -120,7 +120,7 @@ void TxToJSON(const CTransaction& tx,
 
 	if (hashBlock != 0) {
 		entry.push_back(Pair("blockhash", hashBlock.GetHex()));
-        unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+        CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 		if (mi != mapBlockIndex.end() && (*mi).second) {
 			CBlockIndex* pindex = (*mi).second;
 			if (pindex->IsInMainChain()) {
@@ -177,7 +177,7 @@ Value getrawtransaction(const Array& params, bool fHelp) {
 			}
 		}
 
-        unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+        CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 		if (mi != mapBlockIndex.end() && (*mi).second) {
 			CBlockIndex* pindex = (*mi).second;
 			nSupply             = pindex->nPegSupplyIndex;
@@ -220,6 +220,11 @@ static const CRPCCommand vRPCCommands[] = {
     {"verifymessage", &verifymessage, false, false, false},
     {"gettxout", &gettxout, false, false, false},
     {"getpeginfo", &getpeginfo, true, false, false},
+    {"getpegcacheinfo", &getpegcacheinfo, true, false, false},
+    {"getsigcacheinfo", &getsigcacheinfo, true, false, false},
+    {"getaddrindexcacheinfo", &getaddrindexcacheinfo, true, false, false},
+    {"getpegcyclecacheinfo", &getpegcyclecacheinfo, true, false, false},
+    {"getdbinfo", &getdbinfo, true, false, false},
     {"getfractions", &getfractions, true, false, false},
     {"getfractionsbase64", &getfractionsbase64, true, false, false},
     {"getliquidityrate", &getliquidityrate, true, false, false},
@@ -199,6 +199,11 @@ extern json_spirit::Value getblockbynumber(const json_spirit::Array& params, boo
 extern json_spirit::Value getcheckpoint(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value getpeginfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getpegcacheinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getsigcacheinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddrindexcacheinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getpegcyclecacheinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getdbinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getfractions(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getfractionsbase64(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getliquidityrate(const json_spirit::Array& params, bool fHelp);
@@ -15,6 +15,7 @@ using namespace boost;
 #include "keystore.h"
 #include "main.h"
 #include "script.h"
+#include "sigcache.h"
 #include "util.h"
 
 #include <boost/algorithm/string.hpp>
@@ -1378,58 +1379,6 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, uint32_t nIn
 	return ss.GetHash();
 }
 
-// Valid signature cache, to avoid doing expensive ECDSA signature checking
-// twice for every transaction (once when accepted into memory pool, and
-// again when accepted into the block chain)
-
-class CSignatureCache {
-private:
-	// sigdata_type is (signature hash, signature, public key):
-	typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-	std::set<sigdata_type>                                             setValid;
-	boost::shared_mutex                                                cs_sigcache;
-
-public:
-	bool Get(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey) {
-		boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-
-		sigdata_type                     k(hash, vchSig, pubKey);
-		std::set<sigdata_type>::iterator mi = setValid.find(k);
-		if (mi != setValid.end())
-			return true;
-		return false;
-	}
-
-	void Set(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey) {
-		// DoS prevention: limit cache size to less than 10MB
-		// (~200 bytes per cache entry times 50,000 entries)
-		// Since there are a maximum of 20,000 signature operations per block
-		// 50,000 is a reasonable default.
-		int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-		if (nMaxCacheSize <= 0)
-			return;
-
-		boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-
-		while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize) {
-			// Evict a random entry. Random because that helps
-			// foil would-be DoS attackers who might try to pre-generate
-			// and re-use a set of valid signatures just-slightly-greater
-			// than our cache size.
-			uint256                          randomHash = GetRandHash();
-			std::vector<unsigned char>       unused;
-			std::set<sigdata_type>::iterator it =
-			    setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-			if (it == setValid.end())
-				it = setValid.begin();
-			setValid.erase(*it);
-		}
-
-		sigdata_type k(hash, vchSig, pubKey);
-		setValid.insert(k);
-	}
-};
-
 bool CheckSig(vector<unsigned char>        vchSig,
               const vector<unsigned char>& vchPubKey,
               const CScript&               scriptCode,
@@ -1437,8 +1386,6 @@ bool CheckSig(vector<unsigned char>        vchSig,
               uint32_t                     nIn,
               int                          nHashType,
               int                          flags) {
-	static CSignatureCache signatureCache;
-
 	CPubKey pubkey(vchPubKey);
 	if (!pubkey.IsValid())
 		return false;
@@ -1454,14 +1401,14 @@ bool CheckSig(vector<unsigned char>        vchSig,
 
 	uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType);
 
-	if (signatureCache.Get(sighash, vchSig, pubkey))
+	if (SignatureCache().Get(sighash, vchSig, pubkey))
 		return true;
 
 	if (!pubkey.Verify(sighash, vchSig))
 		return false;
 
 	if (!(flags & SCRIPT_VERIFY_NOCACHE))
-		signatureCache.Set(sighash, vchSig, pubkey);
+		SignatureCache().Set(sighash, vchSig, pubkey);
 
 	return true;
 }
@@ -2041,7 +1988,22 @@ bool VerifySignature(const CTransaction& txFrom,
 	const CTxIn& txin = txTo.vin[nIn];
 	if (txin.prevout.n >= txFrom.vout.size())
 		return false;
-	CTxOut txout = txFrom.vout[txin.prevout.n];
+	if (txin.prevout.hash != txFrom.GetHash())
+		return false;
+
+	return VerifySignature(txFrom.vout[txin.prevout.n], txTo, nIn, flags, nHashType,
+	                       sSignedPubks);
+}
+
+bool VerifySignature(const CTxOut&       txoutFrom,
+                     const CTransaction& txTo,
+                     uint32_t            nIn,
+                     uint32_t            flags,
+                     int                 nHashType,
+                     std::set<vchtype>&  sSignedPubks) {
+	assert(nIn < txTo.vin.size());
+	const CTxIn& txin         = txTo.vin[nIn];
+	CScript      scriptPubKey = txoutFrom.scriptPubKey;
 
 	// Exception for baLN8KM7q9jizZrXXFLgMkf52bcTyfTieZ p2sh to BS4B3oTqEKw9vZVL45MZGEKsGL9sKPXiyC
 	// p2pkh
@@ -2049,18 +2011,14 @@ bool VerifySignature(const CTransaction& txFrom,
 	                                      0x04, 0x1B, 0x5D, 0xB9, 0xF4, 0x83, 0x2F, 0xA0,
 	                                      0xAF, 0x77, 0x11, 0xE2, 0x16, 0x47, 0x87};
 	CScript       BS4BExceptionScript(BS4BExceptionBytes, BS4BExceptionBytes + 23);
-	if (txout.scriptPubKey == BS4BExceptionScript) {
+	if (scriptPubKey == BS4BExceptionScript) {
 		unsigned char BS4BExceptionP2PKHBytes[] = {
 		    0x76, 0xa9, 0x14, 0xEC, 0xFD, 0xBC, 0x26, 0xA4, 0x93, 0x04, 0x1B, 0x5D, 0xB9,
 		    0xF4, 0x83, 0x2F, 0xA0, 0xAF, 0x77, 0x11, 0xE2, 0x16, 0x47, 0x88, 0xac};
-		txout.scriptPubKey = CScript(BS4BExceptionP2PKHBytes, BS4BExceptionP2PKHBytes + 25);
+		scriptPubKey = CScript(BS4BExceptionP2PKHBytes, BS4BExceptionP2PKHBytes + 25);
 	}
 
-	if (txin.prevout.hash != txFrom.GetHash())
-		return false;
-
-	return VerifyScript(txin.scriptSig, txout.scriptPubKey, txTo, nIn, flags, nHashType,
-	                    sSignedPubks);
+	return VerifyScript(txin.scriptSig, scriptPubKey, txTo, nIn, flags, nHashType, sSignedPubks);
 }
 
 static CScript PushAll(const vector<vchtype>& values) {
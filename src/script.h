@@ -22,6 +22,7 @@ typedef std::vector<unsigned char> vchtype;
 
 class CKeyStore;
 class CTransaction;
+class CTxOut;
 
 CBigNum CastToBigNum(const vchtype& vch, const size_t nMaxNumSize);
 
@@ -728,6 +729,12 @@ bool       VerifySignature(const CTransaction& txFrom,
                            uint32_t            flags,
                            int                 nHashType,
                            std::set<vchtype>&  sSignedPubks);
+bool       VerifySignature(const CTxOut&       txoutFrom,
+                           const CTransaction& txTo,
+                           uint32_t            nIn,
+                           uint32_t            flags,
+                           int                 nHashType,
+                           std::set<vchtype>&  sSignedPubks);
 
 // Given two sets of signatures for scriptPubKey, possibly with OP_0 placeholders,
 // combine them intelligently and return the result.
@@ -0,0 +1,124 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigcache.h"
+#include "util.h"
+
+#include <openssl/sha.h>
+
+CSignatureCache::CSignatureCache(size_t nMaxEntriesIn)
+    : nHits(0), nMisses(0), nInserts(0), nEvictions(0), nEntries(0) {
+	salt = GetRandHash();
+	SetMaxEntries(nMaxEntriesIn);
+}
+
+uint256 CSignatureCache::EntryHash(const uint256&                    sighash,
+                                   const std::vector<unsigned char>& vchSig,
+                                   const CPubKey&                    pubKey) const {
+	uint256    entry;
+	SHA256_CTX ctx;
+	SHA256_Init(&ctx);
+	SHA256_Update(&ctx, &salt, sizeof(salt));
+	SHA256_Update(&ctx, &sighash, sizeof(sighash));
+	SHA256_Update(&ctx, vchSig.data(), vchSig.size());
+	SHA256_Update(&ctx, pubKey.begin(), pubKey.size());
+	SHA256_Final((unsigned char*)&entry, &ctx);
+	// null is the marker of empty slot
+	if (entry.IsNull())
+		entry = 1;
+	return entry;
+}
+
+// the group count is never less than NUM_LOCKS, so a group is guarded by
+// one lock independently of the table size
+boost::mutex& CSignatureCache::LockOf(const uint256& entry) const {
+	return locks[entry.GetLow64() % NUM_LOCKS];
+}
+
+uint256* CSignatureCache::GroupOf(const uint256& entry) {
+	return &vSlots[(entry.GetLow64() & nGroupMask) * WAYS];
+}
+
+void CSignatureCache::SetMaxEntries(size_t nMaxEntriesIn) {
+	size_t nGroups = NUM_LOCKS;
+	while (nGroups * WAYS < nMaxEntriesIn)
+		nGroups *= 2;
+
+	for (boost::mutex& cs : locks)
+		cs.lock();
+	nMaxEntries = nMaxEntriesIn;
+	nGroupMask  = nGroups - 1;
+	vSlots.assign(nMaxEntries ? nGroups * WAYS : 0, uint256());
+	nEntries = 0;
+	for (boost::mutex& cs : locks)
+		cs.unlock();
+}
+
+bool CSignatureCache::Get(const uint256&                    sighash,
+                          const std::vector<unsigned char>& vchSig,
+                          const CPubKey&                    pubKey) {
+	uint256                         entry = EntryHash(sighash, vchSig, pubKey);
+	boost::lock_guard<boost::mutex> lock(LockOf(entry));
+	if (!vSlots.empty()) {
+		const uint256* group = GroupOf(entry);
+		for (int i = 0; i < WAYS; i++) {
+			if (group[i] == entry) {
+				nHits++;
+				return true;
+			}
+		}
+	}
+	nMisses++;
+	return false;
+}
+
+void CSignatureCache::Set(const uint256&                    sighash,
+                          const std::vector<unsigned char>& vchSig,
+                          const CPubKey&                    pubKey) {
+	uint256                         entry = EntryHash(sighash, vchSig, pubKey);
+	boost::lock_guard<boost::mutex> lock(LockOf(entry));
+	if (vSlots.empty())
+		return;
+	uint256* group = GroupOf(entry);
+	uint256* pfree = nullptr;
+	for (int i = 0; i < WAYS; i++) {
+		if (group[i] == entry)
+			return;
+		if (!pfree && group[i].IsNull())
+			pfree = &group[i];
+	}
+	nInserts++;
+	if (pfree) {
+		*pfree = entry;
+		nEntries++;
+		return;
+	}
+	// Evict a random entry of the group. Random because that helps
+	// foil would-be DoS attackers who might try to pre-generate
+	// and re-use a set of valid signatures just-slightly-greater
+	// than our cache size.
+	group[(entry.GetLow64() >> 56) % WAYS] = entry;
+	nEvictions++;
+}
+
+void CSignatureCache::Clear() {
+	SetMaxEntries(nMaxEntries);
+}
+
+CSigCacheStats CSignatureCache::Stats() const {
+	CSigCacheStats stats;
+	stats.nHits       = nHits;
+	stats.nMisses     = nMisses;
+	stats.nInserts    = nInserts;
+	stats.nEvictions  = nEvictions;
+	stats.nEntries    = nEntries;
+	stats.nSlots      = vSlots.size();
+	stats.nMaxEntries = nMaxEntries;
+	return stats;
+}
+
+CSignatureCache& SignatureCache() {
+	static CSignatureCache cache;
+	return cache;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2026 yshurik
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SIGCACHE_H
+#define BITCOIN_SIGCACHE_H
+
+#include "key.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+/** -maxsigcachesize default (number of cached signatures) */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 50000;
+
+struct CSigCacheStats {
+	uint64_t nHits       = 0;
+	uint64_t nMisses     = 0;
+	uint64_t nInserts    = 0;
+	uint64_t nEvictions  = 0;
+	size_t   nEntries    = 0;
+	size_t   nSlots      = 0;
+	size_t   nMaxEntries = 0;
+};
+
+/** Valid signature cache, to avoid doing expensive ECDSA signature checking
+ *  twice for every transaction (once when accepted into memory pool, and
+ *  again when accepted into the block chain).
+ *
+ *  An entry is a salted hash of (signature hash, signature, public key).
+ *  Entries live in a fixed-size open-addressing table split in groups of
+ *  WAYS slots, a key can only be stored in its own group. When the group
+ *  is full a slot chosen by other bits of the salted hash is overwritten,
+ *  so eviction is O(1) and not predictable without the salt. Groups are
+ *  guarded by striped locks.
+ */
+class CSignatureCache {
+public:
+	enum { WAYS = 8, NUM_LOCKS = 64 };
+
+	CSignatureCache(size_t nMaxEntries = DEFAULT_MAX_SIG_CACHE_SIZE);
+
+	// Resize the table to hold at least nMaxEntries, cached entries are dropped.
+	// Zero disables the cache.
+	void           SetMaxEntries(size_t nMaxEntries);
+	bool           Get(const uint256&                    sighash,
+	                   const std::vector<unsigned char>& vchSig,
+	                   const CPubKey&                    pubKey);
+	void           Set(const uint256&                    sighash,
+	                   const std::vector<unsigned char>& vchSig,
+	                   const CPubKey&                    pubKey);
+	void           Clear();
+	CSigCacheStats Stats() const;
+
+private:
+	uint256       EntryHash(const uint256&                    sighash,
+	                        const std::vector<unsigned char>& vchSig,
+	                        const CPubKey&                    pubKey) const;
+	boost::mutex& LockOf(const uint256& entry) const;
+	uint256*      GroupOf(const uint256& entry);
+
+	uint256              salt;
+	std::vector<uint256> vSlots;
+	size_t               nGroupMask  = 0;
+	size_t               nMaxEntries = 0;
+	mutable boost::mutex locks[NUM_LOCKS];
+
+	std::atomic<uint64_t> nHits;
+	std::atomic<uint64_t> nMisses;
+	std::atomic<uint64_t> nInserts;
+	std::atomic<uint64_t> nEvictions;
+	std::atomic<size_t>   nEntries;
+};
+
+CSignatureCache& SignatureCache();
+
+#endif
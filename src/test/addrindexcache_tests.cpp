@@ -0,0 +1,96 @@
+#include <boost/test/unit_test.hpp>
+
+#include "addrindexcache.h"
+
+#include <leveldb/env.h>
+#include <memenv/memenv.h>
+
+BOOST_AUTO_TEST_SUITE(addrindexcache_tests)
+
+static void Change(DbChanges& changes, const std::string& key, const std::string& value)
+{
+    changes[key].value = value;
+}
+
+static void Erase(DbChanges& changes, const std::string& key)
+{
+    changes[key].fErased = true;
+}
+
+BOOST_AUTO_TEST_CASE(addrindexcache_writeback)
+{
+    leveldb::Env* env = leveldb::NewMemEnv(leveldb::Env::Default());
+    leveldb::Options options;
+    options.env = env;
+    options.create_if_missing = true;
+    leveldb::DB* pdb = nullptr;
+    BOOST_CHECK(leveldb::DB::Open(options, "addrindex", &pdb).ok());
+    std::string value;
+
+    CAddrIndexCache cache(1 << 20);
+    DbChanges changes;
+    Change(changes, "a", "1");
+    Change(changes, "b", "2");
+    leveldb::WriteBatch batch;
+    batch.Put("other", "x");
+    BOOST_CHECK(cache.Commit(pdb, changes, pdb, &batch));
+    BOOST_CHECK(changes.empty());
+
+    // batch is on disk with the marker, changes are only cached
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), "other", &value).ok());
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), CAddrIndexCache::DirtyKey(), &value).ok());
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), "a", &value).IsNotFound());
+    CDbChange change;
+    BOOST_CHECK(cache.Get("a", change) && !change.fErased && change.value == "1");
+    BOOST_CHECK(!cache.Get("c", change));
+
+    // later changes coalesce
+    Change(changes, "a", "3");
+    Erase(changes, "b");
+    Change(changes, "c", "4");
+    BOOST_CHECK(cache.Commit(pdb, changes));
+    BOOST_CHECK(cache.Get("a", change) && change.value == "3");
+    BOOST_CHECK(cache.Get("b", change) && change.fErased);
+    DbChanges range;
+    cache.GetRange("b", "c", range);
+    BOOST_CHECK(range.size() == 2 && range.count("b") && range.count("c"));
+    // the snapshot is taken with the copy, a later flush is seen by neither
+    DbChanges snapshotRange;
+    const leveldb::Snapshot* snapshot = nullptr;
+    cache.GetRange("a", "c", snapshotRange, pdb, &snapshot);
+    BOOST_CHECK(snapshot != nullptr && snapshotRange.size() == 3);
+
+    CAddrIndexCacheStats stats = cache.Stats();
+    BOOST_CHECK(stats.nEntries == 3);
+    BOOST_CHECK(stats.nFlushes == 0);
+    BOOST_CHECK(stats.nDirtySince != 0);
+
+    // flush writes changes and clears the marker
+    BOOST_CHECK(cache.Flush(pdb));
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), "a", &value).ok() && value == "3");
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), "b", &value).IsNotFound());
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), CAddrIndexCache::DirtyKey(), &value).IsNotFound());
+    leveldb::ReadOptions snapshotOptions;
+    snapshotOptions.snapshot = snapshot;
+    BOOST_CHECK(pdb->Get(snapshotOptions, "a", &value).IsNotFound());
+    BOOST_CHECK(pdb->Get(snapshotOptions, CAddrIndexCache::DirtyKey(), &value).ok());
+    pdb->ReleaseSnapshot(snapshot);
+    stats = cache.Stats();
+    BOOST_CHECK(stats.nEntries == 0);
+    BOOST_CHECK(stats.nBytes == 0);
+    BOOST_CHECK(stats.nFlushes == 1);
+    BOOST_CHECK(stats.nFlushedWrites == 3);
+
+    // over the budget changes are written back at once
+    cache.SetMaxBytes(0);
+    Change(changes, "d", "5");
+    BOOST_CHECK(cache.Commit(pdb, changes));
+    BOOST_CHECK(!cache.Get("d", change));
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), "d", &value).ok() && value == "5");
+    BOOST_CHECK(pdb->Get(leveldb::ReadOptions(), CAddrIndexCache::DirtyKey(), &value).IsNotFound());
+
+    delete pdb;
+    delete env;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,251 @@
+#include <boost/test/unit_test.hpp>
+
+#include "txdb-leveldb.h"
+#include "base58.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+#include <leveldb/env.h>
+#include <memenv/memenv.h>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(addrindexkeys_tests)
+
+static CAddressKey TestAddress(uint64_t n, bool fScript = false)
+{
+    CAddressKey address;
+    if (fScript)
+        address.Set(CScriptID(uint160(n)));
+    else
+        address.Set(CKeyID(uint160(n)));
+    return address;
+}
+
+static uint320 TestTxoutId(const string& sHead, const string& sTail)
+{
+    string sHex(80, '0');
+    sHex.replace(0, sHead.size(), sHead);
+    sHex.replace(80 - sTail.size(), sTail.size(), sTail);
+    uint320 txoutid;
+    txoutid.SetHex(sHex);
+    return txoutid;
+}
+
+// key of the legacy record as it was in txdb, a serialized string
+static string LegacyRawKey(const string& sKey)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << sKey;
+    return ss.str();
+}
+
+static vector<pair<string, string> > ReadAll(leveldb::DB* pdb)
+{
+    vector<pair<string, string> > records;
+    leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+    for (iterator->SeekToFirst(); iterator->Valid(); iterator->Next())
+        records.push_back(make_pair(iterator->key().ToString(), iterator->value().ToString()));
+    delete iterator;
+    return records;
+}
+
+BOOST_AUTO_TEST_CASE(addrindexkeys_order)
+{
+    CAddressKey address = TestAddress(1);
+
+    // reverse index is big endian, the latest balance comes first
+    string key = AddrIndexBalanceKey(address, 0x0102030405060708ULL);
+    BOOST_CHECK_EQUAL(key.size(), 1 + CAddressKey::SIZE + 8);
+    BOOST_CHECK_EQUAL(key[0], char(ADDRINDEX_BALANCE));
+    BOOST_CHECK(key.substr(1 + CAddressKey::SIZE) == string("\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+    vector<int64_t> vIndexes = {0, 1, 255, 256, 65535, 1LL << 32, 1LL << 40, INT64_MAX - 1};
+    for (size_t i = 1; i < vIndexes.size(); i++) {
+        string keyOlder = AddrIndexBalanceKey(address, INT64_MAX - vIndexes[i - 1]);
+        string keyNewer = AddrIndexBalanceKey(address, INT64_MAX - vIndexes[i]);
+        BOOST_CHECK(keyNewer < keyOlder);
+    }
+
+    // txoutids sort from the most significant byte, as their hex does
+    vector<uint320> vTxoutIds = {
+        TestTxoutId("", ""),      TestTxoutId("", "01"),     TestTxoutId("", "ff"),
+        TestTxoutId("", "0100"),  TestTxoutId("01", ""),     TestTxoutId("01", "ff"),
+        TestTxoutId("ff", "00"),  TestTxoutId("ff", "01"),   uint320_MAX,
+    };
+    for (size_t i = 1; i < vTxoutIds.size(); i++) {
+        BOOST_CHECK(vTxoutIds[i - 1].GetHex() < vTxoutIds[i].GetHex());
+        BOOST_CHECK(AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, vTxoutIds[i - 1]) <
+                    AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, vTxoutIds[i]));
+        BOOST_CHECK(AddrIndexQueueKey(7, vTxoutIds[i - 1]) < AddrIndexQueueKey(7, vTxoutIds[i]));
+    }
+    string keyTxout = AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, TestTxoutId("ab", "cd"));
+    BOOST_CHECK_EQUAL(keyTxout.size(), 1 + CAddressKey::SIZE + 40);
+    BOOST_CHECK_EQUAL((unsigned char)keyTxout[1 + CAddressKey::SIZE], 0xab);
+    BOOST_CHECK_EQUAL((unsigned char)keyTxout[keyTxout.size() - 1], 0xcd);
+
+    // lock time comes before the txoutid in the queue
+    BOOST_CHECK(AddrIndexQueueKey(255, uint320_MAX) < AddrIndexQueueKey(256, uint320()));
+    BOOST_CHECK(AddrIndexQueueKey(0xffffffff, uint320_MAX) <
+                AddrIndexQueueKey(1ULL << 32, uint320()));
+
+    // records of an address are contiguous
+    CAddressKey address2 = TestAddress(2);
+    BOOST_CHECK(AddrIndexBalanceKey(address, 0) < AddrIndexBalanceKey(address, UINT64_MAX));
+    BOOST_CHECK(AddrIndexBalanceKey(address, UINT64_MAX) < AddrIndexBalanceKey(address2, 0) ||
+                AddrIndexBalanceKey(address2, UINT64_MAX) < AddrIndexBalanceKey(address, 0));
+}
+
+BOOST_AUTO_TEST_CASE(addrindexkeys_legacy)
+{
+    vector<CAddressKey> vAddresses = {TestAddress(1), TestAddress(0xabcdef), TestAddress(7, true)};
+    uint320 txoutid = TestTxoutId("0123456789", "abcdef");
+    for (const CAddressKey& address : vAddresses) {
+        string sAddress = address.ToString();
+        BOOST_CHECK_EQUAL(sAddress.size(), 34U);
+        CAddressKey addressRead;
+        BOOST_CHECK(addressRead.SetString(sAddress));
+        BOOST_CHECK(addressRead == address);
+
+        int64_t nIndex = 123456789;
+        string key;
+        string sIndex = strprintf("%016x", INT64_MAX - nIndex);
+        BOOST_CHECK(MigrateAddrIndexKey("addr" + sAddress + sIndex, key));
+        BOOST_CHECK(key == AddrIndexBalanceKey(address, INT64_MAX - nIndex));
+        addressRead = CAddressKey();
+        addressRead.Read(key.data() + 1);
+        BOOST_CHECK_EQUAL(addressRead.ToString(), sAddress);
+
+        BOOST_CHECK(MigrateAddrIndexKey("utxo" + sAddress + txoutid.GetHex(), key));
+        BOOST_CHECK(key == AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, txoutid));
+        BOOST_CHECK(MigrateAddrIndexKey("ftxo" + sAddress + txoutid.GetHex(), key));
+        BOOST_CHECK(key == AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, txoutid));
+        BOOST_CHECK(MigrateAddrIndexKey("pegbalance" + sAddress, key));
+        BOOST_CHECK(key == AddrIndexAddressKey(ADDRINDEX_PEGBALANCE, address));
+    }
+
+    string key;
+    uint64_t nLockTime = 1600000000;
+    string sLockTime = strprintf("%016x", nLockTime);
+    BOOST_CHECK(MigrateAddrIndexKey("fqueue" + sLockTime + txoutid.GetHex(), key));
+    BOOST_CHECK(key == AddrIndexQueueKey(nLockTime, txoutid));
+
+    // malformed records are refused
+    string sAddress = vAddresses[0].ToString();
+    BOOST_CHECK(!MigrateAddrIndexKey("addr" + sAddress + "000000000000000z", key));
+    BOOST_CHECK(!MigrateAddrIndexKey("addr" + sAddress + "00", key));
+    BOOST_CHECK(!MigrateAddrIndexKey("utxo" + string(34, '1') + txoutid.GetHex(), key));
+    BOOST_CHECK(!MigrateAddrIndexKey("ftxo" + sAddress + txoutid.GetHex().substr(2), key));
+    BOOST_CHECK(!MigrateAddrIndexKey("fqueue" + sLockTime, key));
+    BOOST_CHECK(!MigrateAddrIndexKey("other" + sAddress, key));
+}
+
+BOOST_AUTO_TEST_CASE(addrindexkeys_migrate)
+{
+    leveldb::Env* env = leveldb::NewMemEnv(leveldb::Env::Default());
+    leveldb::Options options;
+    options.env = env;
+    options.create_if_missing = true;
+    leveldb::DB* ptxdb = nullptr;
+    leveldb::DB* paddrdb = nullptr;
+    BOOST_CHECK(leveldb::DB::Open(options, "txdb", &ptxdb).ok());
+    BOOST_CHECK(leveldb::DB::Open(options, "addrdb", &paddrdb).ok());
+    auto load_msg = [](const string&) {};
+
+    string sAddress = TestAddress(5).ToString();
+    uint320 txoutid = TestTxoutId("77", "01");
+    vector<string> vLegacyKeys = {
+        "addr" + sAddress + strprintf("%016x", INT64_MAX - 3),
+        "addr" + sAddress + strprintf("%016x", INT64_MAX - 4),
+        "utxo" + sAddress + txoutid.GetHex(),
+        "ftxo" + sAddress + txoutid.GetHex(),
+        "fqueue" + strprintf("%016x", 1600000000) + txoutid.GetHex(),
+        "pegbalance" + sAddress,
+    };
+    for (size_t i = 0; i < vLegacyKeys.size(); i++)
+        ptxdb->Put(leveldb::WriteOptions(), LegacyRawKey(vLegacyKeys[i]), strprintf("value%d", i));
+    ptxdb->Put(leveldb::WriteOptions(), LegacyRawKey("hashBestChain"), "other");
+
+    int n = 0;
+    BOOST_CHECK(MigrateAddrIndexRecords(ptxdb, paddrdb, load_msg, n));
+    BOOST_CHECK_EQUAL(n, (int)vLegacyKeys.size());
+    vector<pair<string, string> > records = ReadAll(paddrdb);
+    BOOST_CHECK_EQUAL(records.size(), vLegacyKeys.size());
+    for (size_t i = 0; i < vLegacyKeys.size(); i++) {
+        string key;
+        BOOST_CHECK(MigrateAddrIndexKey(vLegacyKeys[i], key));
+        string value;
+        BOOST_CHECK(paddrdb->Get(leveldb::ReadOptions(), key, &value).ok());
+        BOOST_CHECK_EQUAL(value, strprintf("value%d", i));
+    }
+
+    // a second run rewrites the same records
+    BOOST_CHECK(MigrateAddrIndexRecords(ptxdb, paddrdb, load_msg, n));
+    BOOST_CHECK_EQUAL(n, (int)vLegacyKeys.size());
+    BOOST_CHECK(ReadAll(paddrdb) == records);
+
+    // migrated keys are not taken for legacy ones
+    BOOST_CHECK(MigrateAddrIndexRecords(paddrdb, ptxdb, load_msg, n));
+    BOOST_CHECK_EQUAL(n, 0);
+    for (const auto& record : records) {
+        string key;
+        BOOST_CHECK(!MigrateAddrIndexKey(record.first, key));
+    }
+
+    // a legacy record which can not be moved stops the migration
+    string sBadKey = "utxo" + string(34, '1') + txoutid.GetHex();
+    ptxdb->Put(leveldb::WriteOptions(), LegacyRawKey(sBadKey), "bad");
+    BOOST_CHECK(!MigrateAddrIndexRecords(ptxdb, paddrdb, load_msg, n));
+
+    delete paddrdb;
+    delete ptxdb;
+    delete env;
+}
+
+BOOST_AUTO_TEST_CASE(addrindexkeys_fresh_txdb)
+{
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() /
+                                   boost::filesystem::unique_path("bitbay-test-%%%%-%%%%");
+    boost::filesystem::create_directories(path);
+    mapArgs["-datadir"] = path.string();
+    ClearDatadirCache();
+
+    CAddressKey address = TestAddress(9);
+    uint320 txoutid = TestTxoutId("09", "01");
+    CAddressUnspent unspent;
+    unspent.nAmount = 1000;
+    bool fReady = false;
+    {
+        CTxDB txdb("cr+");
+        BOOST_CHECK(txdb.WriteUtxoDbIsReady(true));
+        BOOST_CHECK(txdb.AddUnspent(address, txoutid, unspent));
+        txdb.Close();
+    }
+
+    // reopened txdb keeps its address index
+    {
+        CTxDB txdb("cr+");
+        BOOST_CHECK(txdb.ReadUtxoDbIsReady(fReady));
+        BOOST_CHECK(fReady);
+        BOOST_CHECK(txdb.ReadUnspent(address, txoutid, unspent));
+        BOOST_CHECK_EQUAL(unspent.nAmount, 1000);
+        txdb.Close();
+    }
+
+    // txdb removed for a resync, the index of the old one is not ready
+    boost::filesystem::remove_all(GetDataDir() / "txleveldb");
+    {
+        CTxDB txdb("cr+");
+        BOOST_CHECK(txdb.ReadUtxoDbIsReady(fReady));
+        BOOST_CHECK(!fReady);
+        BOOST_CHECK(!txdb.ReadUnspent(address, txoutid, unspent));
+        txdb.Close();
+    }
+
+    mapArgs.erase("-datadir");
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(path, ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
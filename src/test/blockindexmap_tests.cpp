@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+
+#include "blockindexmap.h"
+#include "main.h"
+
+#include <map>
+
+BOOST_AUTO_TEST_SUITE(blockindexmap_tests)
+
+// Hashes with equal low 64 bits share a probe run
+static uint256 CollidingHash(int n)
+{
+    uint256 hash(0x5555);
+    hash |= uint256(n + 1) << 128;
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(blockindexmap_insert_find)
+{
+    CBlockIndexMap map;
+    std::vector<const uint256*> vKeys;
+    for (int i = 0; i < 100000; i++) {
+        CBlockIndex* pindex = map.allocate();
+        pindex->nHeight = i;
+        std::pair<CBlockIndexMap::iterator, bool> ret = map.insert(uint256(i + 1), pindex);
+        BOOST_CHECK(ret.second);
+        pindex->phashBlock = &ret.first->first;
+        vKeys.push_back(pindex->phashBlock);
+    }
+    BOOST_CHECK_EQUAL(map.size(), 100000U);
+    BOOST_CHECK(!map.insert(uint256(1), map.allocate()).second);
+    BOOST_CHECK(map.find(uint256(0)) == map.end());
+    BOOST_CHECK(map.ref(uint256(100001)) == NULL);
+    BOOST_CHECK_EQUAL(map.count(uint256(100001)), 0U);
+
+    // keys stay in place while the table grows, iteration follows insertion
+    int nHeight = 0;
+    for (const CBlockIndexMap::value_type& item : map) {
+        BOOST_CHECK_EQUAL(item.second->nHeight, nHeight);
+        BOOST_CHECK(&item.first == vKeys[nHeight]);
+        BOOST_CHECK(*item.second->phashBlock == uint256(nHeight + 1));
+        nHeight++;
+    }
+    BOOST_CHECK_EQUAL(nHeight, 100000);
+    BOOST_CHECK_EQUAL(map.ref(uint256(777))->nHeight, 776);
+}
+
+BOOST_AUTO_TEST_CASE(blockindexmap_remove)
+{
+    CBlockIndexMap map;
+    for (int i = 0; i < 8; i++)
+        map.insert(CollidingHash(i), map.allocate());
+    map.insert(uint256(0x5556), map.allocate());
+
+    BOOST_CHECK(map.remove(CollidingHash(3)));
+    BOOST_CHECK(!map.remove(CollidingHash(3)));
+    BOOST_CHECK(map.remove(CollidingHash(0)));
+    BOOST_CHECK_EQUAL(map.size(), 7U);
+    for (int i = 0; i < 8; i++)
+        BOOST_CHECK_EQUAL(map.count(CollidingHash(i)), (i == 0 || i == 3) ? 0U : 1U);
+    BOOST_CHECK_EQUAL(map.count(uint256(0x5556)), 1U);
+    BOOST_CHECK_EQUAL(std::distance(map.begin(), map.end()), 7);
+
+    // removals mixed with inserts agree with std::map
+    std::map<uint256, CBlockIndex*> mapCheck;
+    for (const CBlockIndexMap::value_type& item : map)
+        mapCheck.insert(item);
+    for (int i = 0; i < 20000; i++) {
+        uint256 hash = (insecure_rand() % 3 == 0) ? CollidingHash(insecure_rand() % 64)
+                                                   : uint256(insecure_rand() % 4096);
+        if (insecure_rand() % 2) {
+            CBlockIndex* pindex = map.allocate();
+            bool fInserted = mapCheck.insert(std::make_pair(hash, pindex)).second;
+            BOOST_CHECK_EQUAL(map.insert(hash, pindex).second, fInserted);
+        } else {
+            BOOST_CHECK_EQUAL(map.remove(hash), mapCheck.erase(hash) > 0);
+        }
+    }
+    BOOST_CHECK_EQUAL(map.size(), mapCheck.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapCheck)
+        BOOST_CHECK(map.ref(item.first) == item.second);
+    BOOST_CHECK_EQUAL(std::distance(map.begin(), map.end()), (long)mapCheck.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
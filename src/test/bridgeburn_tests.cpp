@@ -0,0 +1,127 @@
+#include <boost/test/unit_test.hpp>
+
+#include <ethc/abi.h>
+#include <ethc/hex.h>
+#include <ethc/keccak256.h>
+
+#include "peg.h"
+#include "pegdata.h"
+#include "utilstrencodings.h"
+
+#include <cstring>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(bridgeburn_tests)
+
+// leaf as computed over eth_abi_* and the hex round trip
+static string AbiBurnLeafHex(const string& addr, const CCompressedFractions& fc, const string& txoutid)
+{
+    vector<char> addr_buf(addr.begin(), addr.end());
+    addr_buf.push_back(0);
+    vector<char> txid_buf(txoutid.begin(), txoutid.end());
+    txid_buf.push_back(0);
+    char* addr_cstr = addr_buf.data();
+    char* txid_cstr = txid_buf.data();
+    size_t txid_len = txoutid.size();
+
+    struct eth_abi abi;
+    eth_abi_init(&abi, ETH_ABI_ENCODE);
+    eth_abi_address(&abi, &addr_cstr);
+    for (int i = 0; i < fc.nPegSteps; i++) {
+        uint64_t v = fc.fps[i];
+        eth_abi_uint64(&abi, &v);
+    }
+    for (int i = 0; i < fc.nMicroSteps; i++) {
+        uint64_t v = fc.fms[i];
+        eth_abi_uint64(&abi, &v);
+    }
+    eth_abi_bytes(&abi, (uint8_t**)(&txid_cstr), &txid_len);
+    char* abi_hex = NULL;
+    size_t abi_hexlen;
+    eth_abi_to_hex(&abi, &abi_hex, &abi_hexlen);
+    eth_abi_free(&abi);
+
+    uint8_t* abi_bin;
+    int len_abi_bin = eth_hex_to_bytes(&abi_bin, abi_hex, abi_hexlen);
+    uint8_t keccak[32];
+    eth_keccak256(keccak, abi_bin, len_abi_bin);
+    free(abi_hex);
+    free(abi_bin);
+    return HexStr(keccak, keccak + 32);
+}
+
+BOOST_AUTO_TEST_CASE(bridgeburn_leaf)
+{
+    vector<int64_t> sections;
+    for (int i = 0; i < 6 + 4; i++)
+        sections.push_back(i % 3 == 0 ? 0 : 1000000007LL * i);
+    CCompressedFractions fc(sections, 2, 6, 4);
+
+    string txoutid = uint256(12345).GetHex() + ":3";
+    const char* addrs[] = {
+        "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed",
+        "0x0000000000000000000000000000000000000001",
+        "5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed00",
+        "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAeZ",  // skipped by abi
+        "0x5aAeb",                                     // skipped by abi
+    };
+    for (const char* addr : addrs) {
+        CBridgeBurn::Hash leaf;
+        BOOST_CHECK(ComputeBridgeBurnLeaf(addr, fc, txoutid, leaf));
+        BOOST_CHECK_EQUAL(HexStr(leaf.begin(), leaf.end()), AbiBurnLeafHex(addr, fc, txoutid));
+    }
+
+    // bytes of txoutid padded to the words of abi
+    for (size_t len : {size_t(0), size_t(32), size_t(33), txoutid.size()}) {
+        string id = txoutid.substr(0, len);
+        CBridgeBurn::Hash leaf;
+        BOOST_CHECK(ComputeBridgeBurnLeaf(addrs[0], fc, id, leaf));
+        BOOST_CHECK_EQUAL(HexStr(leaf.begin(), leaf.end()), AbiBurnLeafHex(addrs[0], fc, id));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bridgeburn_records)
+{
+    CBridgeBurn burn;
+    burn.txhash = uint256(777);
+    burn.nout = 2;
+    burn.address = "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed";
+    burn.leaf.fill(0xab);
+    burn.reserve = {0, 1, uint64_t(-5), 1234567890123ULL};
+    CBridgeBurn::Hash h1, h2;
+    h1.fill(0x01);
+    h2.fill(0xfe);
+    burn.proof = {h1, h2};
+
+    // binary record
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(burn.Pack(ss));
+    CBridgeBurn burn2;
+    BOOST_CHECK(burn2.Unpack(ss));
+    BOOST_CHECK(burn2.ToString() == burn.ToString());
+    BOOST_CHECK(burn2.proof == burn.proof);
+    BOOST_CHECK(burn2.reserve == burn.reserve);
+
+    // truncated record
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    burn.Pack(ss2);
+    ss2.resize(ss2.size() - 1);
+    CBridgeBurn burn3;
+    BOOST_CHECK(!burn3.Unpack(ss2));
+
+    // colon-joined records of older versions
+    string legacy = burn.txhash.GetHex() + ":2:" + burn.address + ":" + burn.LeafHex() +
+                    ":4:0:1:18446744073709551611:1234567890123:2:" +
+                    HexStr(h1.begin(), h1.end()) + ":" + HexStr(h2.begin(), h2.end());
+    BOOST_CHECK_EQUAL(burn.ToString(), legacy);
+    CBridgeBurn burn4;
+    BOOST_CHECK(burn4.FromString(legacy));
+    BOOST_CHECK_EQUAL(burn4.ToString(), legacy);
+    BOOST_CHECK(burn4.txhash == burn.txhash);
+    BOOST_CHECK_EQUAL(burn4.nout, 2);
+    BOOST_CHECK(!burn4.FromString(legacy + ":00"));
+    BOOST_CHECK(!burn4.FromString("abc:1:addr"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
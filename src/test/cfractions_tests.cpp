@@ -5,6 +5,7 @@
 #include "json/json_spirit_writer_template.h"
 
 #include "pegdata.h"
+#include "pegkernels.h"
 
 BOOST_AUTO_TEST_SUITE(cfractions_tests)
 
@@ -21,7 +22,7 @@ BOOST_AUTO_TEST_CASE(cfractions_equality)
     int i =0;
     for(const auto & jf : jarray) {
         int64_t f = jf.get_int64();
-        f1.f[i] = f;
+        f1.f.Set(i, f);
         i++;
     }
     
@@ -50,7 +51,7 @@ BOOST_AUTO_TEST_CASE(ccompressedfractions_leaf1)
         int i =0;
         for(const auto & jf : jarray) {
             int64_t f = jf.get_int64();
-            f1.f[i] = f;
+            f1.f.Set(i, f);
             i++;
         }
     }
@@ -84,7 +85,7 @@ BOOST_AUTO_TEST_CASE(ccompressedfractions_leaf2)
         int i =0;
         for(const auto & jf : jarray) {
             int64_t f = jf.get_int64();
-            f2.f[i] = f;
+            f2.f.Set(i, f);
             i++;
         }
     }
@@ -105,4 +106,171 @@ BOOST_AUTO_TEST_CASE(ccompressedfractions_leaf2)
     }
 }
 
+BOOST_AUTO_TEST_CASE(cfractions_compact_slots)
+{
+    CFractions fv(1000000, CFractions::VALUE);
+    BOOST_CHECK(fv.f.IsInline());
+    CFractions fv_copy = fv;
+    BOOST_CHECK(fv_copy.f.IsInline());
+    BOOST_CHECK(fv_copy.Total() == 1000000);
+
+    CFractions fz(0, CFractions::STD);
+    BOOST_CHECK(fz.f.IsInline());
+    BOOST_CHECK(fz.Total() == 0);
+
+    CFractions fstd = fv.Std();
+    BOOST_CHECK(fstd.f.From() == 0);
+    BOOST_CHECK(fstd.f.To() == PEG_SIZE);
+
+    // low part keeps only non-zero extent in copies
+    CFractions flow = fstd.LowPart(100, nullptr);
+    BOOST_CHECK(flow.f.To() <= 100);
+    BOOST_CHECK(flow.f.DynamicUsage() <= 100 * sizeof(int64_t));
+    CFractions fhigh = fstd.HighPart(100, nullptr);
+    BOOST_CHECK(fhigh.f.From() >= 100);
+    BOOST_CHECK(flow.Total() + fhigh.Total() == fstd.Total());
+    BOOST_CHECK((flow + fhigh).Total() == fstd.Total());
+    for (int i=0; i<PEG_SIZE; i++) {
+        BOOST_CHECK((flow + fhigh).f[i] == fstd.f[i]);
+    }
+
+    // reads out of window do not expand, set out of window expands
+    CFractions fexp = flow;
+    BOOST_CHECK(fexp.f[PEG_SIZE-1] == 0);
+    BOOST_CHECK(fexp.f.To() <= 100);
+    fexp.f.Set(PEG_SIZE-1, 1);
+    BOOST_CHECK(fexp.f.From() == 0);
+    BOOST_CHECK(fexp.f.To() == PEG_SIZE);
+    BOOST_CHECK(fexp.Total() == flow.Total() + 1);
+
+    // value read from a slot out of window is taken before the expansion
+    CFractions fneg = flow;
+    fneg.f.Set(PEG_SIZE-1, -fneg.f[0]);
+    BOOST_CHECK(fneg.f[PEG_SIZE-1] == -flow.f[0]);
+    BOOST_CHECK(fneg.f[0] == flow.f[0]);
+
+    // pack of compact fractions reads back same slots
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    fhigh.Pack(ss);
+    CFractions funpack;
+    BOOST_CHECK(funpack.Unpack(ss));
+    for (int i=0; i<PEG_SIZE; i++) {
+        BOOST_CHECK(funpack.f[i] == fhigh.f[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(cfractions_kernels)
+{
+    // every kernel available on this cpu matches the scalar one
+    const CPegKernels& scalar = PegKernelsScalar();
+    std::vector<int64_t> a(PEG_SIZE), b(PEG_SIZE);
+    uint64_t seed = 1;
+    for (int i=0; i<PEG_SIZE; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        a[i] = int64_t(seed >> 33) - (int64_t(1) << 30);
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        b[i] = int64_t(seed >> 33) - (int64_t(1) << 30);
+    }
+    for (const CPegKernels* k : PegKernelsAvailable()) {
+        // odd lengths check the tails after vector lanes
+        for (int n : {0, 1, 3, 7, int(PEG_SIZE)-1, int(PEG_SIZE)}) {
+            BOOST_CHECK(k->sum(a.data(), n) == scalar.sum(a.data(), n));
+            BOOST_CHECK(k->sum_positive(a.data(), n) == scalar.sum_positive(a.data(), n));
+            BOOST_CHECK(k->sum_negative(a.data(), n) == scalar.sum_negative(a.data(), n));
+            BOOST_CHECK(k->diff_positive(a.data(), b.data(), n) ==
+                        scalar.diff_positive(a.data(), b.data(), n));
+            BOOST_CHECK(k->no_negative(a.data(), n) == scalar.no_negative(a.data(), n));
+            BOOST_CHECK(k->no_positive(a.data(), n) == scalar.no_positive(a.data(), n));
+
+            std::vector<int64_t> x1 = a, x2 = a;
+            k->add(x1.data(), b.data(), n);
+            scalar.add(x2.data(), b.data(), n);
+            BOOST_CHECK(x1 == x2);
+            k->sub(x1.data(), b.data(), n);
+            scalar.sub(x2.data(), b.data(), n);
+            BOOST_CHECK(x1 == x2);
+            k->neg(x1.data(), n);
+            scalar.neg(x2.data(), n);
+            BOOST_CHECK(x1 == x2);
+            k->intersect(x1.data(), b.data(), n);
+            scalar.intersect(x2.data(), b.data(), n);
+            BOOST_CHECK(x1 == x2);
+
+            x1 = a; x2 = a;
+            BOOST_CHECK(k->keep_positive(x1.data(), n) == scalar.keep_positive(x2.data(), n));
+            BOOST_CHECK(x1 == x2);
+            x1 = a; x2 = a;
+            BOOST_CHECK(k->keep_negative(x1.data(), n) == scalar.keep_negative(x2.data(), n));
+            BOOST_CHECK(x1 == x2);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(cfractions_vdelta_codec)
+{
+    CFractions fstd(int64_t(123456789012), CFractions::STD);
+    CFractions fmix = fstd.HighPart(300, nullptr) + CFractions(1000, CFractions::STD).RatioPart(7);
+    fmix.f.Set(PEG_SIZE-1, -5);
+    fmix.f.Set(700, 1LL << 40);
+
+    for (const CFractions& fr : {fstd, fmix, fstd.LowPart(10, nullptr)}) {
+        CDataStream sv(SER_DISK, CLIENT_VERSION);
+        CDataStream sz(SER_DISK, CLIENT_VERSION);
+        fr.Pack(sv, nullptr, CFractions::SER_VDELTA);
+        fr.Pack(sz, nullptr, CFractions::SER_ZDELTA);
+        BOOST_CHECK(sv.size() < sz.size());
+
+        // both codecs are readable
+        CFractions fv, fz;
+        BOOST_CHECK(fv.Unpack(sv));
+        BOOST_CHECK(fz.Unpack(sz));
+        BOOST_CHECK(sv.empty());
+        BOOST_CHECK(fv.nFlags == fr.nFlags);
+        for (int i=0; i<PEG_SIZE; i++) {
+            BOOST_CHECK(fv.f[i] == fr.f[i]);
+            BOOST_CHECK(fz.f[i] == fr.f[i]);
+        }
+    }
+
+    // runs out of slots are rejected
+    CDataStream sb(SER_DISK, CLIENT_VERSION);
+    sb << uint8_t(1) << uint32_t(CFractions::STD | CFractions::SER_VDELTA) << uint64_t(0);
+    sb << std::string();
+    for (int i=0; i<PEG_SIZE/64+1; i++)
+        sb << uint8_t(0x80 | 63);
+    CFractions fb;
+    BOOST_CHECK(!fb.Unpack(sb));
+}
+
+BOOST_AUTO_TEST_CASE(cfractions_lowhigh)
+{
+    CFractions fvalue(int64_t(123456789012), CFractions::VALUE);
+    CFractions fstd = fvalue.Std();
+    const CFractions& cstd = fstd;  // reads out of the window
+    CFractions fmix = fstd.HighPart(300, nullptr);
+    fmix.f.Set(700, -(1LL << 40));
+
+    CPegLevel level(1, 0, 0, 0, 0, 0);
+    level.nShiftLastPart = 3;
+    level.nShiftLastTotal = 7;
+    for (int nSupply = -1; nSupply <= PEG_SIZE + 1; nSupply++) {
+        // value fractions answer as their standard form
+        BOOST_CHECK(fvalue.Low(nSupply) == fstd.Low(nSupply));
+        BOOST_CHECK(fvalue.High(nSupply) == fstd.High(nSupply));
+        BOOST_CHECK(fvalue.Slot(nSupply) == cstd.f[nSupply]);
+
+        // the kernels give the sums of the slots read one by one
+        int64_t nLow = 0;
+        for (int i = 0; i < nSupply && i < PEG_SIZE; i++)
+            nLow += fmix.f[i];
+        BOOST_CHECK(fmix.Low(nSupply) == nLow);
+        BOOST_CHECK(fmix.High(nSupply) == fmix.Total() - nLow);
+
+        level.nSupply = nSupply;
+        level.nShift = nSupply % 5;
+        BOOST_CHECK(fvalue.Low(level) == fstd.Low(level));
+        BOOST_CHECK(fvalue.High(level) == fstd.High(level));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
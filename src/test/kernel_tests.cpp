@@ -0,0 +1,142 @@
+#include <boost/test/unit_test.hpp>
+
+#include "crypto/kernelhash.h"
+#include "kernel.h"
+
+BOOST_AUTO_TEST_SUITE(kernel_tests)
+
+static void CheckCandidateMatchesKernelHash(uint32_t nTimeTxPrev, uint32_t nBits)
+{
+    CBlockIndex indexPrev;
+    indexPrev.nHeight = 30000;
+    indexPrev.nStakeModifier = 0x0123456789abcdefULL;
+    indexPrev.bnStakeModifierV2 = Hash(BEGIN(nBits), END(nBits));
+
+    CBlock blockFrom;
+    blockFrom.nTime = nTimeTxPrev;
+    CTransaction txPrev;
+    txPrev.nTime = nTimeTxPrev;
+    txPrev.vout.resize(2);
+    txPrev.vout[1].nValue = 5000 * COIN;
+    COutPoint prevout(txPrev.GetHash(), 1);
+
+    CStakeCandidate coin;
+    coin.prevout = prevout;
+    coin.nValue = txPrev.vout[1].nValue;
+    coin.nTimeTxPrev = txPrev.nTime;
+    coin.nTimeBlockFrom = blockFrom.GetBlockTime();
+    coin.nHeight = indexPrev.nHeight - 1000;
+
+    CStakeKernelContext context(&indexPrev, nBits);
+    uint256 target = GetStakeKernelTarget(nBits, coin.nValue);
+
+    int nPass = 0;
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t nTime = nTimeTxPrev + nStakeMinAge + n * 16;
+        uint256 hashKernel, targetKernel, hashCandidate;
+        bool fKernel = CheckStakeKernelHash(&indexPrev, nBits, blockFrom, 0, txPrev, prevout,
+                                            nTime, hashKernel, targetKernel);
+        bool fCandidate = CheckStakeCandidate(context, coin, target, nTime, hashCandidate);
+        BOOST_CHECK_EQUAL(fKernel, fCandidate);
+        BOOST_CHECK(hashKernel == hashCandidate);
+        nPass += fCandidate;
+    }
+    BOOST_CHECK(nPass > 0);
+
+    // a stake before the coin or within the min depth is never a kernel
+    uint256 hash;
+    BOOST_CHECK(!CheckStakeCandidate(context, coin, target, nTimeTxPrev - 1, hash));
+    coin.nHeight = indexPrev.nHeight;
+    BOOST_CHECK(!CheckStakeCandidate(context, coin, target,
+                                     nTimeTxPrev + nStakeMinAge + 0x10000000, hash));
+}
+
+BOOST_AUTO_TEST_CASE(stake_candidate_matches_kernel_hash)
+{
+    // before and after protocol v3, about every second stake passes
+    CheckCandidateMatchesKernelHash(1480000000, 0x1c00ffff);
+    CheckCandidateMatchesKernelHash(1600000000, 0x1c00ffff);
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_target)
+{
+    CBigNum bnTarget;
+    bnTarget.SetCompact(0x1c00ffff);
+    BOOST_CHECK(GetStakeKernelTarget(0x1c00ffff, 5000 * COIN) ==
+                (bnTarget * CBigNum(5000 * COIN)).getuint256());
+
+    // a weighted target over 256 bits is met by any hash
+    BOOST_CHECK(GetStakeKernelTarget(0x2100ffff, 5000 * COIN) == ~uint256(0));
+}
+
+BOOST_AUTO_TEST_CASE(kernel_hashers)
+{
+    // 76 byte messages, hashed from the midstate of their first 64 bytes
+    const int n = 19;
+    std::vector<unsigned char> vMessages(n * 76);
+    for (size_t i = 0; i < vMessages.size(); i++)
+        vMessages[i] = (i * 7 + 3) & 0xff;
+    std::vector<uint32_t> vMidstates(n * 8);
+    std::vector<unsigned char> vTails(n * 12);
+    for (int i = 0; i < n; i++) {
+        KernelHashMidstate(&vMessages[i * 76], &vMidstates[i * 8]);
+        memcpy(&vTails[i * 12], &vMessages[i * 76 + 64], 12);
+    }
+    for (const CKernelHasher* hasher : KernelHashersAvailable()) {
+        std::vector<unsigned char> vHashes(n * 32);
+        hasher->hash(vMidstates.data(), vTails.data(), n, vHashes.data());
+        for (int i = 0; i < n; i++) {
+            uint256 hash = Hash(&vMessages[i * 76], &vMessages[i * 76 + 76]);
+            BOOST_CHECK_MESSAGE(memcmp(&hash, &vHashes[i * 32], 32) == 0, hasher->name);
+        }
+    }
+}
+
+static void CheckSearchMatchesCandidates(uint32_t nTimeStakeTx, int nThreads)
+{
+    CBlockIndex indexPrev;
+    indexPrev.nHeight = 30000;
+    indexPrev.nStakeModifier = 0x0123456789abcdefULL;
+    indexPrev.bnStakeModifierV2 = uint256(12345);
+    uint32_t nBits = 0x1b00ffff;
+    CStakeKernelContext context(&indexPrev, nBits);
+
+    std::vector<CStakeCandidate> vCandidates;
+    for (int i = 0; i < 64; i++) {
+        CStakeCandidate coin;
+        coin.prevout = COutPoint(uint256(i * 1000 + 7), i % 3);
+        coin.nValue = (1000 + i * 100) * COIN;
+        // some coins get mature within the window, some are too young
+        coin.nTimeTxPrev = nTimeStakeTx - 2000 + i * 32;
+        coin.nTimeBlockFrom = coin.nTimeTxPrev - nStakeMinAge;
+        coin.nHeight = indexPrev.nHeight - (i % 8 == 0 ? 10 : 1000);
+        vCandidates.push_back(coin);
+    }
+
+    const uint32_t nSearchSpan = 1024;
+    std::map<COutPoint, uint32_t> mapExpected;
+    for (const CStakeCandidate& coin : vCandidates) {
+        uint256 target = GetStakeKernelTarget(nBits, coin.nValue);
+        for (uint32_t n = 0; n < nSearchSpan; n++) {
+            uint256 hash;
+            if (CheckStakeCandidate(context, coin, target, nTimeStakeTx - n, hash)) {
+                mapExpected[coin.prevout] = n;
+                break;
+            }
+        }
+    }
+    BOOST_CHECK(!mapExpected.empty());
+
+    std::map<COutPoint, uint32_t> mapKernels;
+    SearchStakeKernels(context, vCandidates, nTimeStakeTx, nSearchSpan, mapKernels, nThreads);
+    BOOST_CHECK(mapKernels == mapExpected);
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_search)
+{
+    CheckSearchMatchesCandidates(1482000000, 1);
+    CheckSearchMatchesCandidates(1600000000, 1);
+    CheckSearchMatchesCandidates(1600000000, 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
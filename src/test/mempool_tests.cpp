@@ -0,0 +1,163 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+#include "txmempool.h"
+
+BOOST_AUTO_TEST_SUITE(mempool_tests)
+
+static CTransaction SpendingTx(const std::vector<COutPoint>& vPrevouts, int nOutputs)
+{
+    static int nCount = 0;
+    CTransaction tx;
+    tx.nTime = ++nCount;
+    for (const COutPoint& prevout : vPrevouts)
+        tx.vin.push_back(CTxIn(prevout));
+    tx.vout.resize(nOutputs);
+    for (CTxOut& txout : tx.vout)
+        txout.nValue = COIN;
+    return tx;
+}
+
+static void AddTx(CTxMemPool& pool, CTransaction& tx, int64_t nFee = 0, uint32_t nTxSize = 200)
+{
+    MapPrevOut mapInputs;
+    MapFractions mapFractions;
+    pool.addUnchecked(tx.GetHash(), tx, mapInputs, mapFractions, CTxMemPoolEntry(nFee, nTxSize));
+}
+
+static std::set<uint256> Roots(CTxMemPool& pool)
+{
+    std::vector<uint256> vRoots;
+    pool.queryRoots(vRoots);
+    return std::set<uint256>(vRoots.begin(), vRoots.end());
+}
+
+BOOST_AUTO_TEST_CASE(mempool_dependency_graph)
+{
+    CTxMemPool pool;
+
+    // a and b spend chain outputs, c spends both, d spends c twice
+    CTransaction a = SpendingTx({COutPoint(uint256(1), 0)}, 2);
+    CTransaction b = SpendingTx({COutPoint(uint256(2), 0)}, 1);
+    CTransaction c = SpendingTx({COutPoint(a.GetHash(), 0), COutPoint(b.GetHash(), 0)}, 2);
+    CTransaction d = SpendingTx({COutPoint(c.GetHash(), 0), COutPoint(c.GetHash(), 1)}, 1);
+    AddTx(pool, a);
+    AddTx(pool, b);
+    AddTx(pool, c);
+    AddTx(pool, d);
+
+    BOOST_CHECK(Roots(pool) == std::set<uint256>({a.GetHash(), b.GetHash()}));
+    BOOST_CHECK(pool.mapPoolParents[c.GetHash()] == std::set<uint256>({a.GetHash(), b.GetHash()}));
+    BOOST_CHECK(pool.mapPoolParents[d.GetHash()] == std::set<uint256>({c.GetHash()}));
+    BOOST_CHECK(pool.mapPoolChildren[a.GetHash()] == std::set<uint256>({c.GetHash()}));
+
+    // a mined: c still waits for b
+    pool.remove(a);
+    BOOST_CHECK(Roots(pool) == std::set<uint256>({b.GetHash()}));
+    BOOST_CHECK(pool.mapPoolParents[c.GetHash()] == std::set<uint256>({b.GetHash()}));
+    BOOST_CHECK(!pool.mapPoolChildren.count(a.GetHash()));
+
+    // a back from a disconnected block gets its pool child again
+    AddTx(pool, a);
+    BOOST_CHECK(pool.mapPoolParents[c.GetHash()] == std::set<uint256>({a.GetHash(), b.GetHash()}));
+    BOOST_CHECK(Roots(pool) == std::set<uint256>({a.GetHash(), b.GetHash()}));
+
+    // recursive removal leaves no links behind
+    pool.remove(b, true);
+    BOOST_CHECK(Roots(pool) == std::set<uint256>({a.GetHash()}));
+    BOOST_CHECK(pool.mapPoolParents.empty());
+    BOOST_CHECK(pool.mapPoolChildren.empty());
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_entry_priority)
+{
+    // 10 coins confirmed at 100 and 5 coins at 150, 250 bytes, tip at 199
+    CTxMemPoolEntry entry(10000, 250);
+    entry.AddChainInput(10 * COIN, 100);
+    entry.AddChainInput(5 * COIN, 150);
+    double dPriority = (10.0 * COIN * 100 + 5.0 * COIN * 50) / 250;
+    BOOST_CHECK_CLOSE(entry.GetPriority(199), dPriority, 1e-9);
+    BOOST_CHECK_CLOSE(entry.GetFeePerKb(), 40000, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_entry_priority_depth)
+{
+    // inputs indexed with heights, as by SetTxIndexesV1, read back from txdb
+    CBlockIndex blockA, blockB, blockTip;
+    blockA.nHeight = 120;
+    blockB.nHeight = 197;
+    blockTip.nHeight = 199;
+    std::vector<CTxIndex> vTxIndexes;
+    for (const CBlockIndex* pindex : {&blockA, &blockB}) {
+        CTxIndex txindexV1(CDiskTxPos(1, 2, 3), 2, pindex->nHeight, 1);
+        txindexV1.nHeight = pindex->nHeight;
+        txindexV1.nIndex = 1;
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << txindexV1;
+        CTxIndex txindex;
+        ss >> txindex;
+        vTxIndexes.push_back(txindex);
+    }
+    BOOST_CHECK_EQUAL(vTxIndexes[0].nHeight, blockA.nHeight);
+    BOOST_CHECK_EQUAL(vTxIndexes[0].nIndex, 1);
+
+    CTxMemPoolEntry entry(0, 400);
+    entry.AddChainInput(3 * COIN, vTxIndexes[0].nHeight);
+    entry.AddChainInput(7 * COIN, vTxIndexes[1].nHeight);
+
+    // confirmations as of CTxIndex::GetDepthInMainChain
+    int nDepthA = 1 + blockTip.nHeight - blockA.nHeight;
+    int nDepthB = 1 + blockTip.nHeight - blockB.nHeight;
+    BOOST_CHECK_EQUAL(nDepthA, 80);
+    BOOST_CHECK_EQUAL(nDepthB, 3);
+    double dPriority = (3.0 * COIN * nDepthA + 7.0 * COIN * nDepthB) / 400;
+    BOOST_CHECK_CLOSE(entry.GetPriority(blockTip.nHeight), dPriority, 1e-9);
+
+    // one block later every input has one more confirmation
+    BOOST_CHECK_CLOSE(entry.GetPriority(blockTip.nHeight + 1),
+                      dPriority + 10.0 * COIN / 400, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_ancestor_score)
+{
+    CTxMemPool pool;
+
+    // a pays little, its child b pays for both, c pays little from b
+    CTransaction a = SpendingTx({COutPoint(uint256(11), 0)}, 1);
+    CTransaction b = SpendingTx({COutPoint(a.GetHash(), 0)}, 1);
+    CTransaction c = SpendingTx({COutPoint(b.GetHash(), 0)}, 1);
+    CTransaction d = SpendingTx({COutPoint(uint256(12), 0)}, 1);
+    AddTx(pool, a, 1000, 200);
+    AddTx(pool, b, 40000, 200);
+    AddTx(pool, c, 1000, 200);
+    AddTx(pool, d, 10000, 200);
+
+    const CTxMemPoolEntry& entryB = pool.mapEntries[b.GetHash()];
+    BOOST_CHECK_EQUAL(entryB.nAncestors, 2);
+    BOOST_CHECK_EQUAL(entryB.nAncestorSize, 400U);
+    BOOST_CHECK_EQUAL(entryB.nAncestorFee, 41000);
+    BOOST_CHECK_EQUAL(pool.mapEntries[c.GetHash()].nAncestors, 3);
+
+    // b with its parent goes first, a cheap child is not lifted by b
+    std::vector<uint256> vOrder;
+    for (const auto& item : pool.setByScore)
+        vOrder.push_back(item.second);
+    BOOST_CHECK_EQUAL(vOrder.size(), 4U);
+    BOOST_CHECK(vOrder[0] == b.GetHash());
+    BOOST_CHECK(vOrder[1] == d.GetHash());
+    BOOST_CHECK_EQUAL(pool.setByScore.size(), pool.mapEntries.size());
+
+    // a mined: b stands alone
+    pool.remove(a);
+    BOOST_CHECK_EQUAL(pool.mapEntries[b.GetHash()].nAncestors, 1);
+    BOOST_CHECK_EQUAL(pool.mapEntries[c.GetHash()].nAncestorFee, 41000);
+    BOOST_CHECK_EQUAL(pool.setByScore.size(), 3U);
+    BOOST_CHECK(pool.setByScore.begin()->second == b.GetHash());
+
+    pool.remove(b, true);
+    BOOST_CHECK_EQUAL(pool.mapEntries.size(), 1U);
+    BOOST_CHECK_EQUAL(pool.setByScore.size(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,47 @@
+#include <boost/test/unit_test.hpp>
+
+#include "pegcache.h"
+
+BOOST_AUTO_TEST_SUITE(pegcache_tests)
+
+BOOST_AUTO_TEST_CASE(pegcache_lru)
+{
+    CPegFractionsCache cache(CPegFractionsCache::NUM_SHARDS * 64 * 1024);
+    CFractions fstd(int64_t(123456789012), CFractions::STD);
+
+    uint320 key1(uint256(1), 0);
+    CFractions f;
+    BOOST_CHECK(!cache.Get(key1, f));
+    cache.Put(key1, fstd, cache.Generation(key1));
+    BOOST_CHECK(cache.Get(key1, f));
+    BOOST_CHECK(f.Total() == fstd.Total());
+    for (int i=0; i<PEG_SIZE; i++) {
+        BOOST_CHECK(f.f[i] == fstd.f[i]);
+    }
+
+    // put after invalidation of key is ignored
+    uint64_t nGeneration = cache.Generation(key1);
+    cache.Invalidate(key1);
+    BOOST_CHECK(!cache.Get(key1, f));
+    cache.Put(key1, fstd, nGeneration);
+    BOOST_CHECK(!cache.Get(key1, f));
+
+    // memory budget is respected by evictions
+    for (uint64_t i=0; i<1000; i++) {
+        uint320 key(uint256(i), i);
+        cache.Put(key, fstd, cache.Generation(key));
+    }
+    CPegCacheStats stats = cache.Stats();
+    BOOST_CHECK(stats.nBytes <= stats.nMaxBytes);
+    BOOST_CHECK(stats.nEvictions > 0);
+    BOOST_CHECK(stats.nEntries > 0);
+    BOOST_CHECK(stats.nEntries < 1000);
+    BOOST_CHECK(stats.nHits == 1);
+    BOOST_CHECK(stats.nInvalidations == 1);
+
+    cache.Clear();
+    BOOST_CHECK(cache.Stats().nEntries == 0);
+    BOOST_CHECK(cache.Stats().nBytes == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,58 @@
+#include <boost/test/unit_test.hpp>
+
+#include "pegcycle.h"
+
+BOOST_AUTO_TEST_SUITE(pegcycle_tests)
+
+static CPegCycleStateRef CycleState(uint64_t nCycle, bool fPrePeg = false)
+{
+    std::shared_ptr<CPegCycleState> state = std::make_shared<CPegCycleState>();
+    state->hashCycleBlock = uint256(nCycle);
+    state->fPrePeg = fPrePeg;
+    state->fBridges = true;
+    state->timelockpasses.insert("pubkey" + std::to_string(nCycle));
+    return state;
+}
+
+BOOST_AUTO_TEST_CASE(pegcycle_snapshots)
+{
+    CPegCycleStates states;
+    BOOST_CHECK(!states.Find(uint256(1), false));
+
+    CPegCycleStateRef state1 = CycleState(1);
+    states.Put(state1, states.Generation());
+    BOOST_CHECK(states.Find(uint256(1), false) == state1);
+    BOOST_CHECK(!states.Find(uint256(1), true));
+
+    // pre-peg blocks of the same cycle have own snapshot
+    CPegCycleStateRef state1pre = CycleState(1, true);
+    states.Put(state1pre, states.Generation());
+    BOOST_CHECK(states.Find(uint256(1), true) == state1pre);
+    BOOST_CHECK(states.Find(uint256(1), false) == state1);
+
+    // put after a write of cycle states is ignored
+    uint64_t nGeneration = states.Generation();
+    states.Invalidate();
+    BOOST_CHECK(!states.Find(uint256(1), false));
+    states.Put(CycleState(2), nGeneration);
+    BOOST_CHECK(!states.Find(uint256(2), false));
+
+    // the least recently used cycle goes first
+    for (uint64_t i = 1; i <= CPegCycleStates::MAX_ENTRIES; i++)
+        states.Put(CycleState(i), states.Generation());
+    BOOST_CHECK(states.Find(uint256(1), false));
+    states.Put(CycleState(100), states.Generation());
+    BOOST_CHECK(states.Find(uint256(1), false));
+    BOOST_CHECK(!states.Find(uint256(2), false));
+
+    CPegCycleCacheStats stats = states.Stats();
+    BOOST_CHECK_EQUAL(stats.nEntries, size_t(CPegCycleStates::MAX_ENTRIES));
+    BOOST_CHECK_EQUAL(stats.nInvalidations, 1U);
+
+    // a snapshot held by a reader outlives its invalidation
+    CPegCycleStateRef state100 = states.Find(uint256(100), false);
+    states.Invalidate();
+    BOOST_CHECK(state100->timelockpasses.count("pubkey100"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
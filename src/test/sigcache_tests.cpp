@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+
+#include "sigcache.h"
+
+BOOST_AUTO_TEST_SUITE(sigcache_tests)
+
+static CPubKey TestPubKey(unsigned char n)
+{
+    std::vector<unsigned char> vch(33, n);
+    vch[0] = 0x02;
+    return CPubKey(vch);
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_get_set)
+{
+    CSignatureCache cache(1000);
+    std::vector<unsigned char> vchSig(72, 0x30);
+    CPubKey pubkey = TestPubKey(1);
+
+    BOOST_CHECK(!cache.Get(uint256(1), vchSig, pubkey));
+    cache.Set(uint256(1), vchSig, pubkey);
+    BOOST_CHECK(cache.Get(uint256(1), vchSig, pubkey));
+
+    // any part of the key differs
+    BOOST_CHECK(!cache.Get(uint256(2), vchSig, pubkey));
+    BOOST_CHECK(!cache.Get(uint256(1), vchSig, TestPubKey(2)));
+    vchSig[10] = 0x31;
+    BOOST_CHECK(!cache.Get(uint256(1), vchSig, pubkey));
+    vchSig[10] = 0x30;
+
+    // repeated set is not a new entry
+    cache.Set(uint256(1), vchSig, pubkey);
+    CSigCacheStats stats = cache.Stats();
+    BOOST_CHECK(stats.nEntries == 1);
+    BOOST_CHECK(stats.nInserts == 1);
+    BOOST_CHECK(stats.nHits == 1);
+    BOOST_CHECK(stats.nMisses == 4);
+
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(uint256(1), vchSig, pubkey));
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_eviction)
+{
+    CSignatureCache cache(1000);
+    std::vector<unsigned char> vchSig(72, 0x30);
+    CPubKey pubkey = TestPubKey(1);
+
+    // table size is fixed, full groups evict
+    for (uint64_t i=0; i<10000; i++) {
+        cache.Set(uint256(i), vchSig, pubkey);
+    }
+    CSigCacheStats stats = cache.Stats();
+    BOOST_CHECK(stats.nSlots >= 1000);
+    BOOST_CHECK(stats.nSlots < 4000);
+    BOOST_CHECK(stats.nEntries <= stats.nSlots);
+    BOOST_CHECK(stats.nEvictions > 0);
+    BOOST_CHECK(stats.nInserts == 10000);
+    BOOST_CHECK(cache.Get(uint256(9999), vchSig, pubkey));
+
+    // disabled cache stores nothing
+    cache.SetMaxEntries(0);
+    cache.Set(uint256(1), vchSig, pubkey);
+    BOOST_CHECK(!cache.Get(uint256(1), vchSig, pubkey));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
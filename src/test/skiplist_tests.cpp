@@ -0,0 +1,69 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+
+#include <vector>
+
+#define SKIPLIST_LENGTH 300000
+
+BOOST_AUTO_TEST_SUITE(skiplist_tests)
+
+BOOST_AUTO_TEST_CASE(skiplist_test)
+{
+    std::vector<CBlockIndex> vIndex(SKIPLIST_LENGTH);
+
+    for (int i=0; i<SKIPLIST_LENGTH; i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].SetPrev((i == 0) ? NULL : &vIndex[i - 1]);
+        vIndex[i].BuildSkip();
+    }
+
+    for (int i=0; i<1000; i++) {
+        int from = insecure_rand() % (SKIPLIST_LENGTH - 1);
+        int to = insecure_rand() % (from + 1);
+
+        BOOST_CHECK(vIndex[from].GetAncestor(from) == &vIndex[from]);
+        BOOST_CHECK(vIndex[from].GetAncestor(to) == &vIndex[to]);
+        BOOST_CHECK(vIndex[from].GetAncestor(0) == &vIndex[0]);
+        BOOST_CHECK(vIndex[from].GetAncestor(from + 1) == NULL);
+        BOOST_CHECK(vIndex[from].GetAncestor(-1) == NULL);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(chain_test)
+{
+    std::vector<CBlockIndex> vMain(1000);
+    std::vector<CBlockIndex> vFork(100);
+
+    for (size_t i=0; i<vMain.size(); i++) {
+        vMain[i].nHeight = i;
+        vMain[i].SetPrev((i == 0) ? NULL : &vMain[i - 1]);
+        vMain[i].BuildSkip();
+    }
+    // fork of 100 blocks after block 899
+    for (size_t i=0; i<vFork.size(); i++) {
+        vFork[i].nHeight = 900 + i;
+        vFork[i].SetPrev((i == 0) ? &vMain[899] : &vFork[i - 1]);
+        vFork[i].BuildSkip();
+    }
+
+    CChain chain;
+    BOOST_CHECK(chain.Tip() == NULL);
+    chain.SetTip(&vMain[999]);
+    BOOST_CHECK(chain.Height() == 999);
+    BOOST_CHECK(chain.Genesis() == &vMain[0]);
+    BOOST_CHECK(chain[500] == &vMain[500]);
+    BOOST_CHECK(chain[1000] == NULL);
+    BOOST_CHECK(chain[-1] == NULL);
+
+    // only blocks above the fork are replaced
+    chain.SetTip(&vFork[49]);
+    BOOST_CHECK(chain.Height() == 949);
+    BOOST_CHECK(chain[899] == &vMain[899]);
+    BOOST_CHECK(chain[900] == &vFork[0]);
+    BOOST_CHECK(chain.Contains(&vFork[49]));
+    BOOST_CHECK(!chain.Contains(&vMain[900]));
+    BOOST_CHECK(vFork[49].GetAncestor(899) == &vMain[899]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
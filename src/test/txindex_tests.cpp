@@ -0,0 +1,112 @@
+#include <boost/test/unit_test.hpp>
+
+#include "chainparams.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(txindex_tests)
+
+// Mines a proof-of-work block of vtx on the best chain, the block is
+// connected by AddToBlockIndex as a received one is
+static CBlock MineBlock(const vector<CTransaction>& vtx, const CScript& scriptPubKey)
+{
+    int nHeight = pindexBest->nHeight + 1;
+    CBlock block;
+    block.nVersion = CBlock::CURRENT_VERSION;
+    block.hashPrevBlock = pindexBest->GetBlockHash();
+    block.nTime = pindexBest->GetBlockTime() + 64;
+    block.nBits = Params().ProofOfWorkLimit().GetCompact();
+
+    CTransaction coinbase;
+    coinbase.nTime = block.nTime;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    // subsidy is only paid at height 2, fees are 0
+    coinbase.vout.push_back(CTxOut(nHeight == 2 ? GetProofOfWorkReward(0) : 0, scriptPubKey));
+    block.vtx.push_back(coinbase);
+    block.vtx.insert(block.vtx.end(), vtx.begin(), vtx.end());
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    CBigNum bnTarget;
+    bnTarget.SetCompact(block.nBits);
+    while (CBigNum(block.GetPoWHash()) > bnTarget)
+        block.nNonce++;
+
+    uint32_t nFile;
+    uint32_t nBlockPos;
+    BOOST_REQUIRE(block.WriteToDisk(nFile, nBlockPos));
+    BOOST_REQUIRE(block.AddToBlockIndex(nFile, nBlockPos, block.GetPoWHash()));
+    BOOST_REQUIRE(pindexBest->GetBlockHash() == block.GetHash());
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(txindex_connectblock)
+{
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() /
+                                   boost::filesystem::unique_path("bitbay-test-%%%%-%%%%");
+    boost::filesystem::create_directories(path);
+    mapArgs["-datadir"] = path.string();
+    ClearDatadirCache();
+    SelectParams(CChainParams::REGTEST);
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(LoadBlockIndex([](const string&) {}));
+
+        CBasicKeyStore keystore;
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        CScript scriptPubKey;
+        scriptPubKey.SetDestination(key.GetPubKey().GetID());
+
+        // the subsidy of height 2 and blocks up to its maturity
+        vector<CBlock> vBlocks;
+        while (nBestHeight < 2 + Params().CoinbaseMaturity())
+            vBlocks.push_back(MineBlock({}, scriptPubKey));
+        const CTransaction& txPrev = vBlocks[1].vtx[0];
+        CTransaction tx;
+        tx.nTime = pindexBest->GetBlockTime() + 64;
+        tx.vin.push_back(CTxIn(COutPoint(txPrev.GetHash(), 0)));
+        tx.vout.push_back(CTxOut(txPrev.vout[0].nValue, scriptPubKey));
+        BOOST_REQUIRE(SignSignature(keystore, txPrev, tx, 0));
+        vBlocks.push_back(MineBlock({tx}, scriptPubKey));
+
+        // height and position in the block as written by ConnectBlock
+        CTxDB txdb("r");
+        for (const CBlock& block : vBlocks) {
+            CBlockIndex* pindex = mapBlockIndex.find(block.GetHash())->second;
+            for (size_t i = 0; i < block.vtx.size(); i++) {
+                CTxIndex txindex;
+                BOOST_REQUIRE(txdb.ReadTxIndex(block.vtx[i].GetHash(), txindex));
+                BOOST_CHECK_EQUAL(txindex.nVersion, CTxIndex::CURRENT_VERSION);
+                BOOST_CHECK_EQUAL(txindex.nHeight, pindex->nHeight);
+                BOOST_CHECK_EQUAL(txindex.nIndex, i);
+                BOOST_CHECK_EQUAL(txindex.GetHeightInMainChain(), pindex->nHeight);
+                BOOST_CHECK_EQUAL(txindex.vSpent.size(), block.vtx[i].vout.size());
+            }
+        }
+
+        // the spent output is marked, the index keeps its height
+        CTxIndex txindexPrev;
+        BOOST_REQUIRE(txdb.ReadTxIndex(txPrev.GetHash(), txindexPrev));
+        BOOST_CHECK_EQUAL(txindexPrev.nHeight, 2);
+        BOOST_CHECK(!txindexPrev.vSpent[0].IsNull());
+        txdb.Close();
+        CPegDB pegdb("r");
+        pegdb.Close();
+    }
+    SelectParams(CChainParams::MAIN);
+    mapArgs.erase("-datadir");
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(path, ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
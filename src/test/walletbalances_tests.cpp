@@ -0,0 +1,118 @@
+#include <boost/test/unit_test.hpp>
+
+#include "pegdata.h"
+#include "wallet.h"
+
+BOOST_AUTO_TEST_SUITE(walletbalances_tests)
+
+static CWalletBalances::COutputPart OutputPart(uint32_t n,
+                                               int64_t nValue,
+                                               uint32_t nFlags = 0,
+                                               uint64_t nLockTime = 0)
+{
+    CWalletBalances::COutputPart out;
+    out.n = n;
+    out.nValue = nValue;
+    out.nFlags = nFlags;
+    out.nLockTime = nLockTime;
+    out.SetFractions(CFractions(nValue, CFractions::VALUE));
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(walletbalances_prefix_sums)
+{
+    CFractions fstd = CFractions(1000000, CFractions::VALUE).Std();
+    CFractions fhigh = fstd.HighPart(300, nullptr);
+
+    CWalletBalances::COutputPart out;
+    out.SetFractions(fstd);
+    CWalletBalances::COutputPart outHigh;
+    outHigh.SetFractions(fhigh);
+    for (int nSupply = -1; nSupply <= PEG_SIZE + 1; nSupply++) {
+        BOOST_CHECK_EQUAL(out.Low(nSupply), fstd.Low(nSupply));
+        BOOST_CHECK_EQUAL(out.High(nSupply), fstd.High(nSupply));
+        BOOST_CHECK_EQUAL(outHigh.Low(nSupply), fhigh.Low(nSupply));
+        BOOST_CHECK_EQUAL(outHigh.High(nSupply), fhigh.High(nSupply));
+    }
+
+    // value fractions are summed in their standard form
+    CWalletBalances::COutputPart outValue = OutputPart(0, 1000000);
+    BOOST_CHECK_EQUAL(outValue.Low(500), fstd.Low(500));
+}
+
+BOOST_AUTO_TEST_CASE(walletbalances_totals)
+{
+    CWalletBalances balances;
+    balances.SetTip(uint256(1), 100, 1000);
+
+    CWalletBalances::CTxPart a;
+    a.fAvailable = true;
+    a.fConfirmed = true;
+    a.nCredit = 3000000;
+    a.vOutputs.push_back(OutputPart(0, 1000000));
+    a.vOutputs.push_back(OutputPart(1, 2000000, CFractions::NOTARY_F, 1500));
+    balances.Insert(uint256(10), a);
+
+    CWalletBalances::CTxPart b;
+    b.fUnconfirmed = true;
+    b.fPending = true;
+    b.nUnconfirmed = 500000;
+    balances.Insert(uint256(11), b);
+
+    CFractions fstd = CFractions(1000000, CFractions::VALUE).Std();
+    BOOST_CHECK_EQUAL(balances.nCredit, 3000000);
+    BOOST_CHECK_EQUAL(balances.nUnconfirmed, 500000);
+    BOOST_CHECK_EQUAL(balances.nFrozen, 2000000);
+    BOOST_CHECK_EQUAL(balances.nReserve, fstd.Low(100));
+    BOOST_CHECK_EQUAL(balances.nLiquidity, fstd.High(100));
+    BOOST_CHECK_EQUAL(balances.vRewards[PEG_REWARD_20].count, 1);
+    BOOST_CHECK_EQUAL(balances.vRewards[PEG_REWARD_20].amount, 2000000);
+    BOOST_CHECK_EQUAL(balances.mapUnlocks.size(), 1U);
+    BOOST_CHECK(balances.setPending.count(uint256(11)));
+
+    // a new supply index reprices the outputs
+    balances.SetTip(uint256(2), 400, 1200);
+    BOOST_CHECK_EQUAL(balances.nReserve, fstd.Low(400));
+    BOOST_CHECK_EQUAL(balances.nLiquidity, fstd.High(400));
+    BOOST_CHECK_EQUAL(balances.nFrozen, 2000000);
+
+    // the notary output unlocks once the block time passes its lock time
+    balances.SetTip(uint256(3), 400, 1501);
+    CFractions fstd2 = CFractions(2000000, CFractions::VALUE).Std();
+    BOOST_CHECK_EQUAL(balances.nFrozen, 0);
+    BOOST_CHECK(balances.mapUnlocks.empty());
+    BOOST_CHECK_EQUAL(balances.nReserve, fstd.Low(400) + fstd2.Low(400));
+    BOOST_CHECK_EQUAL(balances.nLiquidity, fstd.High(400) + fstd2.High(400));
+
+    // an earlier block time freezes it again
+    balances.SetTip(uint256(4), 400, 1400);
+    BOOST_CHECK_EQUAL(balances.nFrozen, 2000000);
+    BOOST_CHECK_EQUAL(balances.nReserve, fstd.Low(400));
+
+    balances.Erase(uint256(10));
+    balances.Erase(uint256(11));
+    BOOST_CHECK_EQUAL(balances.nCredit, 0);
+    BOOST_CHECK_EQUAL(balances.nUnconfirmed, 0);
+    BOOST_CHECK_EQUAL(balances.nReserve, 0);
+    BOOST_CHECK_EQUAL(balances.nLiquidity, 0);
+    BOOST_CHECK_EQUAL(balances.nFrozen, 0);
+    BOOST_CHECK_EQUAL(balances.vRewards[PEG_REWARD_20].count, 0);
+    BOOST_CHECK(balances.mapParts.empty());
+    BOOST_CHECK(balances.setPending.empty());
+    BOOST_CHECK(balances.mapUnlocks.empty());
+}
+
+BOOST_AUTO_TEST_CASE(walletbalances_dirty_marks)
+{
+    CWalletBalances balances;
+    balances.SetDirty(uint256(1));
+    BOOST_CHECK(balances.setDirty.empty());  // a rebuild is due anyway
+
+    balances.fValid = true;
+    balances.SetDirty(uint256(1));
+    BOOST_CHECK(balances.setDirty.count(uint256(1)));
+    balances.SetDirty();
+    BOOST_CHECK(!balances.fValid);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -32,16 +32,72 @@ using namespace std;
 using namespace boost;
 namespace fs = boost::filesystem;
 
-leveldb::DB* txdb;  // global pointer for LevelDB object instance
+leveldb::DB* txdb;    // global pointer for LevelDB object instance
+leveldb::DB* addrdb;  // global pointer for the address index instance
+
+CDbTuning GetDbTuning(const std::string& sName) {
+	int64_t nDefaultCacheMB = GetArg("-dbcache", DEFAULT_DB_CACHE_SIZE);
+	if (sName == "addr")
+		nDefaultCacheMB = DEFAULT_ADDRDB_CACHE_SIZE;
+
+	std::string sPrefix = "-" + sName + "db";
+	CDbTuning   tuning;
+	tuning.nCacheBytes   = GetArg(sPrefix + "cache", nDefaultCacheMB) * 1048576;
+	tuning.nWriteBuffer  = GetArg(sPrefix + "writebuffer", DEFAULT_DB_WRITE_BUFFER) * 1048576;
+	tuning.nBloomBits    = GetArg(sPrefix + "bloombits", DEFAULT_DB_BLOOM_BITS);
+	tuning.fCompression  = GetBoolArg(sPrefix + "compression", true);
+	tuning.nMaxOpenFiles = GetArg(sPrefix + "maxopenfiles", DEFAULT_DB_MAX_OPEN_FILES);
+	return tuning;
+}
 
-static leveldb::Options GetOptions() {
+leveldb::Options GetDbOptions(const CDbTuning& tuning) {
 	leveldb::Options options;
-	int              nCacheSizeMB = GetArg("-dbcache", 50);
-	options.block_cache           = leveldb::NewLRUCache(nCacheSizeMB * 1048576);
-	options.filter_policy         = leveldb::NewBloomFilterPolicy(10);
+	options.block_cache       = leveldb::NewLRUCache(tuning.nCacheBytes);
+	options.write_buffer_size = tuning.nWriteBuffer;
+	options.max_open_files    = tuning.nMaxOpenFiles;
+	options.compression =
+	    tuning.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+	if (tuning.nBloomBits > 0)
+		options.filter_policy = leveldb::NewBloomFilterPolicy(tuning.nBloomBits);
 	return options;
 }
 
+leveldb::ReadOptions ScanReadOptions() {
+	leveldb::ReadOptions options;
+	options.fill_cache = false;
+	return options;
+}
+
+CDbStats GetDbStats(leveldb::DB* pdb) {
+	CDbStats stats;
+	// past the longest keys of the databases
+	std::string    sLimit(64, '\xff');
+	leveldb::Range range(leveldb::Slice(), sLimit);
+	pdb->GetApproximateSizes(&range, 1, &stats.nApproxSize);
+	for (int nLevel = 0;; nLevel++) {
+		std::string sFiles;
+		if (!pdb->GetProperty("leveldb.num-files-at-level" + std::to_string(nLevel), &sFiles))
+			break;
+		stats.vFilesAtLevel.push_back(atoi(sFiles));
+	}
+	pdb->GetProperty("leveldb.stats", &stats.sStats);
+	return stats;
+}
+
+static void init_addrindex(leveldb::Options& options, bool fRemoveOld = false) {
+	fs::path directory = GetDataDir() / "addrleveldb";
+	if (fRemoveOld)
+		fs::remove_all(directory);
+
+	fs::create_directory(directory);
+	LogPrintf("Opening LevelDB in %s\n", directory.string());
+	leveldb::Status status = leveldb::DB::Open(options, directory.string(), &addrdb);
+	if (!status.ok()) {
+		throw runtime_error(strprintf("init_addrindex(): error opening database environment %s",
+		                              status.ToString()));
+	}
+}
+
 static void init_blockindex(leveldb::Options& options,
                             bool              fRemoveOld       = false,
                             bool              fCreateBootstrap = false) {
@@ -87,19 +143,26 @@ CTxDB::CTxDB(const char* pszMode) {
 	fReadOnly   = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
 
 	if (txdb) {
-		pdb = txdb;
+		pdb     = txdb;
+		paddrdb = addrdb;
 		return;
 	}
 
 	bool fCreate = strchr(pszMode, 'c');
 
-	options                   = GetOptions();
+	options                   = GetDbOptions(GetDbTuning("tx"));
 	options.create_if_missing = fCreate;
-	options.filter_policy     = leveldb::NewBloomFilterPolicy(10);
 
 	init_blockindex(options);  // Init directory
 	pdb = txdb;
 
+	addrOptions                   = GetDbOptions(GetDbTuning("addr"));
+	addrOptions.create_if_missing = true;
+	init_addrindex(addrOptions);
+	paddrdb = addrdb;
+
+	AddrIndexCache().SetMaxBytes(GetArg("-addrindexcache", DEFAULT_ADDRINDEX_CACHE_SIZE) * 1048576);
+
 	if (Exists(string("version"))) {
 		ReadVersion(nVersion);
 		LogPrintf("Transaction index version is %d\n", nVersion);
@@ -116,12 +179,24 @@ CTxDB::CTxDB(const char* pszMode) {
 			init_blockindex(options, true, true);  // Remove directory and create new database
 			pdb = txdb;
 
+			delete addrdb;
+			addrdb = paddrdb = NULL;
+			init_addrindex(addrOptions, true);
+			paddrdb = addrdb;
+
 			bool fTmp = fReadOnly;
 			fReadOnly = false;
 			WriteVersion(DATABASE_VERSION);  // Save transaction index version
 			fReadOnly = fTmp;
 		}
 	} else if (fCreate) {
+		// New txdb, the address index left from an older one is rebuilt
+		AddrIndexCache().Clear();
+		delete addrdb;
+		addrdb = paddrdb = NULL;
+		init_addrindex(addrOptions, true);
+		paddrdb = addrdb;
+
 		bool fTmp = fReadOnly;
 		fReadOnly = false;
 		WriteVersion(DATABASE_VERSION);
@@ -132,6 +207,14 @@ CTxDB::CTxDB(const char* pszMode) {
 }
 
 void CTxDB::Close() {
+	if (addrdb)
+		AddrIndexCache().Flush(addrdb);
+	delete addrdb;
+	addrdb = paddrdb = NULL;
+	delete addrOptions.filter_policy;
+	addrOptions.filter_policy = NULL;
+	delete addrOptions.block_cache;
+	addrOptions.block_cache = NULL;
 	delete txdb;
 	txdb = pdb = NULL;
 	delete options.filter_policy;
@@ -140,6 +223,7 @@ void CTxDB::Close() {
 	options.block_cache = NULL;
 	delete activeBatch;
 	activeBatch = NULL;
+	mapBatchChanges.clear();
 }
 
 bool CTxDB::TxnBegin() {
@@ -150,132 +234,143 @@ bool CTxDB::TxnBegin() {
 
 bool CTxDB::TxnCommit() {
 	assert(activeBatch);
-	leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
+	bool fOk = AddrIndexCache().Commit(paddrdb, mapAddrIndexPending, pdb, activeBatch);
 	delete activeBatch;
 	activeBatch = NULL;
+	mapBatchChanges.clear();
+	mapAddrIndexPending.clear();
+	return fOk;
+}
+
+bool CTxDB::FlushAddrIndex() {
+	return AddrIndexCache().Flush(paddrdb);
+}
+
+bool CTxDB::ReadAddrIndexRaw(const std::string& key, std::string& rawvalue) {
+	if (activeBatch) {
+		auto it = mapAddrIndexPending.find(key);
+		if (it != mapAddrIndexPending.end()) {
+			if (it->second.fErased)
+				return false;
+			rawvalue = it->second.value;
+			return true;
+		}
+	}
+	CDbChange change;
+	if (AddrIndexCache().Get(key, change)) {
+		if (change.fErased)
+			return false;
+		rawvalue = change.value;
+		return true;
+	}
+	leveldb::Status status = paddrdb->Get(leveldb::ReadOptions(), key, &rawvalue);
 	if (!status.ok()) {
-		LogPrintf("LevelDB batch commit failure: %s\n", status.ToString());
+		if (!status.IsNotFound())
+			LogPrintf("LevelDB read failure: %s\n", status.ToString());
 		return false;
 	}
 	return true;
 }
 
-class CBatchScanner : public leveldb::WriteBatch::Handler {
-public:
-	std::string  needle;
-	bool*        deleted;
-	std::string* foundValue;
-	bool         foundEntry;
-
-	CBatchScanner() : foundEntry(false) {}
-
-	virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value) {
-		if (key.ToString() == needle) {
-			foundEntry  = true;
-			*deleted    = false;
-			*foundValue = value.ToString();
-		}
-	}
+bool CTxDB::WriteAddrIndexRaw(const std::string& key, const std::string& rawvalue) {
+	if (fReadOnly)
+		assert(!"Write called on database in read-only mode");
 
-	virtual void Delete(const leveldb::Slice& key) {
-		if (key.ToString() == needle) {
-			foundEntry = true;
-			*deleted   = true;
-		}
-	}
-};
+	DbChanges  changes;
+	CDbChange& change = activeBatch ? mapAddrIndexPending[key] : changes[key];
+	change.fErased = false;
+	change.value   = rawvalue;
+	if (activeBatch)
+		return true;
+	return AddrIndexCache().Commit(paddrdb, changes);
+}
 
-class CBatchSeeker : public leveldb::WriteBatch::Handler {
-public:
-	std::string                                            needle;
-	std::string                                            stople;
-	std::map<std::string, std::string, CTxDB::cmpBySlice>* seekmap;
-	std::set<std::string>*                                 erased;
-
-	CBatchSeeker() {}
-
-	virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value) {
-		leveldb::Slice sneedle(needle);
-		leveldb::Slice sstople(stople);
-		if (key.compare(sneedle) >= 0) {
-			if (stople.empty() || key.compare(sstople) <= 0) {
-				(*seekmap)[key.ToString()] = value.ToString();
-			}
-		}
-		erased->erase(key.ToString());
-	}
+bool CTxDB::EraseAddrIndex(const std::string& key) {
+	if (!paddrdb)
+		return false;
+	if (fReadOnly)
+		assert(!"Erase called on database in read-only mode");
+
+	DbChanges  changes;
+	CDbChange& change = activeBatch ? mapAddrIndexPending[key] : changes[key];
+	change.fErased = true;
+	change.value.clear();
+	if (activeBatch)
+		return true;
+	return AddrIndexCache().Commit(paddrdb, changes);
+}
 
-	virtual void Delete(const leveldb::Slice& key) {
-		seekmap->erase(key.ToString());
-		erased->insert(key.ToString());
+void CTxDB::RangeAddrIndex(const std::string&                                fromkey,
+                           const std::string&                                tokey,
+                           std::vector<std::pair<std::string, std::string>>& records,
+                           size_t                                            nLimit) {
+	// cached changes overlaid with pending ones, over disk as it was when
+	// the cache was copied
+	DbChanges                changes;
+	const leveldb::Snapshot* snapshot = nullptr;
+	AddrIndexCache().GetRange(fromkey, tokey, changes, paddrdb, &snapshot);
+	if (activeBatch) {
+		auto it = mapAddrIndexPending.lower_bound(fromkey);
+		for (; it != mapAddrIndexPending.end() && it->first <= tokey; it++)
+			changes[it->first] = it->second;
 	}
-};
+
+	leveldb::ReadOptions readOptions;
+	readOptions.snapshot = snapshot;
+	MergeRange(paddrdb, readOptions, fromkey, tokey, changes, records, nLimit);
+	paddrdb->ReleaseSnapshot(snapshot);
+}
 
 // When performing a read, if we have an active batch we need to check it first
 // before reading from the database, as the rest of the code assumes that once
-// a database transaction begins reads are consistent with it. It would be good
-// to change that assumption in future and avoid the performance hit, though in
-// practice it does not appear to be large.
+// a database transaction begins reads are consistent with it. The changes of
+// the batch are mirrored in a sorted map, so this is a lookup, not a scan.
 bool CTxDB::ScanBatch(const CDataStream& key, string* value, bool* deleted) const {
 	assert(activeBatch);
 	*deleted = false;
-	CBatchScanner scanner;
-	scanner.needle         = key.str();
-	scanner.deleted        = deleted;
-	scanner.foundValue     = value;
-	leveldb::Status status = activeBatch->Iterate(&scanner);
-	if (!status.ok()) {
-		throw runtime_error(status.ToString());
-	}
-	return scanner.foundEntry;
-}
-
-// When performing a seek, if we have an active batch we need to check it first
-// before reading from the database, as the rest of the code assumes that once
-// a database transaction begins reads are consistent with it. It would be good
-// to change that assumption in future and avoid the performance hit, though in
-// practice it does not appear to be large.
-bool CTxDB::SeekBatch(const CDataStream&                                     fromkey,
-                      string*                                                key,
-                      string*                                                value,
-                      std::map<std::string, std::string, CTxDB::cmpBySlice>* seekmap,
-                      std::set<std::string>*                                 erased) const {
-	assert(activeBatch);
-	CBatchSeeker scanner;
-	scanner.needle         = fromkey.str();
-	scanner.erased         = erased;
-	scanner.seekmap        = seekmap;
-	leveldb::Status status = activeBatch->Iterate(&scanner);
-	if (!status.ok()) {
-		throw runtime_error(status.ToString());
-	}
-	if (scanner.seekmap->empty())
+	auto it  = mapBatchChanges.find(key.str());
+	if (it == mapBatchChanges.end())
 		return false;
-	*key   = scanner.seekmap->begin()->first;
-	*value = scanner.seekmap->begin()->second;
+	if (it->second.fErased)
+		*deleted = true;
+	else
+		*value = it->second.value;
 	return true;
 }
 
-// When performing a seek, if we have an active batch we need to check it first
-// before reading from the database, as the rest of the code assumes that once
-// a database transaction begins reads are consistent with it. It would be good
-// to change that assumption in future and avoid the performance hit, though in
-// practice it does not appear to be large.
-bool CTxDB::SeekBatch(const CDataStream&                                     fromkey,
-                      const CDataStream&                                     tokey,
-                      std::map<std::string, std::string, CTxDB::cmpBySlice>* seekmap,
-                      std::set<std::string>*                                 erased) const {
-	assert(activeBatch);
-	CBatchSeeker scanner;
-	scanner.needle         = fromkey.str();
-	scanner.stople         = tokey.str();
-	scanner.erased         = erased;
-	scanner.seekmap        = seekmap;
-	leveldb::Status status = activeBatch->Iterate(&scanner);
-	if (!status.ok()) {
-		throw runtime_error(status.ToString());
+void CTxDB::MergeRange(leveldb::DB*                                      pdbIn,
+                       const leveldb::ReadOptions&                       readOptions,
+                       const std::string&                                fromkey,
+                       const std::string&                                tokey,
+                       const DbChanges&                                  changes,
+                       std::vector<std::pair<std::string, std::string>>& records,
+                       size_t                                            nLimit) {
+	leveldb::Slice     sliceTo(tokey);
+	leveldb::Iterator* iterator = pdbIn->NewIterator(readOptions);
+	iterator->Seek(fromkey);
+	auto itChange = changes.lower_bound(fromkey);
+	auto itEnd    = tokey.empty() ? changes.end() : changes.upper_bound(tokey);
+	while (nLimit == 0 || records.size() < nLimit) {
+		bool fDisk = iterator->Valid() &&
+		             (tokey.empty() || iterator->key().compare(sliceTo) <= 0);
+		bool fChange = itChange != itEnd;
+		if (!fDisk && !fChange)
+			break;
+		int cmp = !fDisk     ? 1
+		          : !fChange ? -1
+		                     : iterator->key().compare(leveldb::Slice(itChange->first));
+		if (cmp < 0) {
+			records.push_back(make_pair(iterator->key().ToString(), iterator->value().ToString()));
+			iterator->Next();
+			continue;
+		}
+		if (cmp == 0)
+			iterator->Next();  // changed, the change wins
+		if (!itChange->second.fErased)
+			records.push_back(make_pair(itChange->first, itChange->second.value));
+		itChange++;
 	}
-	return !scanner.seekmap->empty();
+	delete iterator;
 }
 
 bool CTxDB::ReadTxIndex(uint256 hash, CTxIndex& txindex) {
@@ -283,6 +378,47 @@ bool CTxDB::ReadTxIndex(uint256 hash, CTxIndex& txindex) {
 	return Read(make_pair(string("tx"), hash), txindex);
 }
 
+// Reads txindexes of several transactions in one pass: pending changes are
+// taken from the batch changes, the rest is read with one iterator moving
+// forward over the sorted keys.
+bool CTxDB::ReadTxIndexes(const std::vector<uint256>& vHashes,
+                          std::map<uint256, CTxIndex>& mapTxIndexRet) {
+	std::map<std::string, uint256, CTxDB::cmpBySlice> mapKeys;
+	for (const uint256& hash : vHashes) {
+		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+		ssKey << make_pair(string("tx"), hash);
+		mapKeys[ssKey.str()] = hash;
+	}
+
+	leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+	for (const auto& item : mapKeys) {
+		std::string strValue;
+		auto        mi = mapBatchChanges.find(item.first);
+		if (mi != mapBatchChanges.end()) {
+			if (mi->second.fErased)
+				continue;  // deleted
+			strValue = mi->second.value;
+		} else {
+			iterator->Seek(item.first);
+			if (!iterator->Valid() || iterator->key().compare(item.first) != 0)
+				continue;  // not found
+			strValue = iterator->value().ToString();
+		}
+		try {
+			CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK,
+			                    CLIENT_VERSION);
+			CTxIndex    txindex;
+			ssValue >> txindex;
+			mapTxIndexRet[item.second] = txindex;
+		} catch (std::exception& e) {
+			continue;
+		}
+	}
+	bool fOk = iterator->status().ok();
+	delete iterator;
+	return fOk;
+}
+
 bool CTxDB::UpdateTxIndex(uint256 hash, const CTxIndex& txindex) {
 	return Write(make_pair(string("tx"), hash), txindex);
 }
@@ -310,7 +446,7 @@ static bool SetTxIndexesV1(CTxDB& ctxdb, LoadMsg load_msg) {
 	if (!ctxdb.TxnBegin())
 		return error("SetTxIndexesV1() : TxnBegin failed");
 
-	leveldb::Iterator* iterator = txdb->NewIterator(leveldb::ReadOptions());
+	leveldb::Iterator* iterator = txdb->NewIterator(ScanReadOptions());
 	// Seek to start key.
 	CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
 	ssStartKey << make_pair(string("tx"), uint256(0));
@@ -472,21 +608,175 @@ bool CTxDB::WriteBestInvalidTrust(CBigNum bnBestInvalidTrust) {
 	return Write(string("bnBestInvalidTrust"), bnBestInvalidTrust);
 }
 
+// Reads serialized data in place, without copying it into a stream
+class CSliceReader {
+private:
+	const char* pbegin;
+	const char* pend;
+	int         nType;
+	int         nVersion;
+
+public:
+	CSliceReader(const char* pbeginIn, const char* pendIn, int nTypeIn, int nVersionIn)
+	    : pbegin(pbeginIn), pend(pendIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+	int GetType() const { return nType; }
+	int GetVersion() const { return nVersion; }
+
+	CSliceReader& read(char* pch, size_t nSize) {
+		if (nSize > size_t(pend - pbegin))
+			throw std::ios_base::failure("CSliceReader::read() : end of data");
+		memcpy(pch, pbegin, nSize);
+		pbegin += nSize;
+		return *this;
+	}
+
+	template <typename T>
+	CSliceReader& operator>>(T& obj) {
+		::Unserialize(*this, obj, nType, nVersion);
+		return *this;
+	}
+};
+
+// Part of the blockindex keyspace: values copied into one buffer, decoded
+// into vIndexes by the workers
+struct CBlockIndexChunk {
+	std::string                  strData;
+	std::vector<size_t>          vOffsets;  // entry i is [vOffsets[i], vOffsets[i+1])
+	std::vector<CDiskBlockIndex> vIndexes;
+	std::vector<uint256>         vHashes;
+	std::vector<char>            vDecoded;
+
+	size_t size() const { return vOffsets.empty() ? 0 : vOffsets.size() - 1; }
+	void   clear() {
+		strData.clear();
+		vOffsets.clear();
+	}
+};
+
+static const size_t BLOCK_INDEX_CHUNK = 16384;
+
+// Copies up to BLOCK_INDEX_CHUNK values, false once past the blockindex keys
+static bool ReadBlockIndexChunk(leveldb::Iterator* iterator, CBlockIndexChunk& chunk) {
+	static const std::string strPrefix = [] {
+		CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+		ssPrefix << string("blockindex");
+		return ssPrefix.str();
+	}();
+
+	chunk.clear();
+	chunk.vOffsets.push_back(0);
+	while (iterator->Valid() && chunk.size() < BLOCK_INDEX_CHUNK) {
+		boost::this_thread::interruption_point();
+		if (!iterator->key().starts_with(strPrefix))
+			return false;
+		leveldb::Slice value = iterator->value();
+		chunk.strData.append(value.data(), value.size());
+		chunk.vOffsets.push_back(chunk.strData.size());
+		iterator->Next();
+	}
+	return iterator->Valid();
+}
+
+static void DecodeBlockIndexChunk(CBlockIndexChunk& chunk, size_t nBegin, size_t nEnd) {
+	for (size_t i = nBegin; i < nEnd; i++) {
+		const char* pbegin = chunk.strData.data() + chunk.vOffsets[i];
+		const char* pend   = chunk.strData.data() + chunk.vOffsets[i + 1];
+		try {
+			CSliceReader reader(pbegin, pend, SER_DISK, CLIENT_VERSION);
+			reader >> chunk.vIndexes[i];
+		} catch (std::exception& e) {
+			continue;
+		}
+		chunk.vHashes[i]  = chunk.vIndexes[i].GetBlockHash();
+		chunk.vDecoded[i] = chunk.vIndexes[i].CheckIndex();
+	}
+}
+
+bool CTxDB::ScanBlockIndex(std::function<bool(CDiskBlockIndex&, const uint256&)> fnEntry,
+                           CBlockIndexScanTimes*                                 pTimes) {
+	CBlockIndexScanTimes times;
+	times.nThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+
+	leveldb::Iterator* iterator = pdb->NewIterator(ScanReadOptions());
+	// Seek to start key.
+	CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+	ssStartKey << make_pair(string("blockindex"), uint256(0));
+	iterator->Seek(ssStartKey.str());
+
+	// two chunks: one read while the other is decoded
+	CBlockIndexChunk chunks[2];
+	int64_t          nStart = GetTimeMicros();
+	bool             fMore  = ReadBlockIndexChunk(iterator, chunks[0]);
+	times.nReadMicros += GetTimeMicros() - nStart;
+
+	bool fOk = true;
+	for (int nCur = 0; fOk && chunks[nCur].size() > 0; nCur = 1 - nCur) {
+		CBlockIndexChunk& chunk = chunks[nCur];
+		size_t            n     = chunk.size();
+		chunk.vIndexes.assign(n, CDiskBlockIndex());
+		chunk.vHashes.assign(n, uint256(0));
+		chunk.vDecoded.assign(n, 0);
+
+		boost::thread_group decoders;
+		size_t              nPerThread = (n + times.nThreads - 1) / times.nThreads;
+		for (size_t nBegin = 0; nBegin < n; nBegin += nPerThread) {
+			size_t nEnd = std::min(n, nBegin + nPerThread);
+			decoders.create_thread(
+			    [&chunk, nBegin, nEnd] { DecodeBlockIndexChunk(chunk, nBegin, nEnd); });
+		}
+
+		nStart = GetTimeMicros();
+		chunks[1 - nCur].clear();
+		try {
+			if (fMore)
+				fMore = ReadBlockIndexChunk(iterator, chunks[1 - nCur]);
+		} catch (...) {
+			decoders.join_all();
+			delete iterator;
+			throw;
+		}
+		times.nReadMicros += GetTimeMicros() - nStart;
+
+		nStart = GetTimeMicros();
+		decoders.join_all();
+		times.nDecodeMicros += GetTimeMicros() - nStart;
+
+		nStart = GetTimeMicros();
+		for (size_t i = 0; i < n; i++) {
+			if (!chunk.vDecoded[i]) {
+				fOk = error("ScanBlockIndex() : bad blockindex entry %s at %d",
+				            chunk.vHashes[i].ToString(), chunk.vIndexes[i].nHeight);
+				break;
+			}
+			times.nEntries++;
+			if (!fnEntry(chunk.vIndexes[i], chunk.vHashes[i])) {
+				fOk = false;
+				break;
+			}
+		}
+		times.nHandleMicros += GetTimeMicros() - nStart;
+	}
+	delete iterator;
+
+	if (pTimes)
+		*pTimes = times;
+	return fOk;
+}
+
 CBlockIndex* CTxDB::InsertBlockIndex(uint256 hash) {
 	if (hash == 0)
 		return NULL;
 
 	// Return existing
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(hash);
 	if (mi != mapBlockIndex.end())
 		return (*mi).second;
 
 	// Create new
-	CBlockIndex* pindexNew = new CBlockIndex();
-	if (!pindexNew)
-		throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
-	mi                    = mapBlockIndex.insert(hash, pindexNew).first;
-	pindexNew->phashBlock = &((*mi).first);
+	CBlockIndex* pindexNew = mapBlockIndex.allocate();
+	mi                     = mapBlockIndex.insert(hash, pindexNew).first;
+	pindexNew->phashBlock  = &((*mi).first);
 
 	return pindexNew;
 }
@@ -500,29 +790,10 @@ bool CTxDB::LoadBlockIndex(LoadMsg load_msg) {
 	// The block index is an in-memory structure that maps hashes to on-disk
 	// locations where the contents of the block can be found. Here, we scan it
 	// out of the DB and into mapBlockIndex.
-	leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-	// Seek to start key.
-	CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
-	ssStartKey << make_pair(string("blockindex"), uint256(0));
-	iterator->Seek(ssStartKey.str());
-	// Now read each entry.
-	int indexCount = 0;
-	while (iterator->Valid()) {
-		boost::this_thread::interruption_point();
-		// Unpack keys and values.
-		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-		ssKey.write(iterator->key().data(), iterator->key().size());
-		CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-		ssValue.write(iterator->value().data(), iterator->value().size());
-		string strType;
-		ssKey >> strType;
-		// Did we reach the end of the data to read?
-		if (strType != "blockindex")
-			break;
-		CDiskBlockIndex diskindex;
-		ssValue >> diskindex;
-
-		uint256 blockHash = diskindex.GetBlockHash();
+	int64_t              nStart     = GetTimeMicros();
+	int                  indexCount = 0;
+	CBlockIndexScanTimes times;
+	auto                 fnEntry = [&](CDiskBlockIndex& diskindex, const uint256& blockHash) {
 		// Construct block index object
 		CBlockIndex* pindexNew = InsertBlockIndex(blockHash);
 		pindexNew->SetPrev(InsertBlockIndex(diskindex.hashPrev));
@@ -552,38 +823,52 @@ bool CTxDB::LoadBlockIndex(LoadMsg load_msg) {
 		if (pindexGenesisBlock == NULL && blockHash == Params().HashGenesisBlock())
 			pindexGenesisBlock = pindexNew;
 
-		if (!pindexNew->CheckIndex()) {
-			delete iterator;
-			return error("LoadBlockIndex() : CheckIndex failed at %d", pindexNew->nHeight);
-		}
-
 		// NovaCoin: build setStakeSeen
 		if (pindexNew->IsProofOfStake())
 			setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
 
-		iterator->Next();
 		indexCount++;
 		if (indexCount % 10000 == 0) {
 			load_msg(std::to_string(indexCount));
 		}
-	}
-	delete iterator;
+		return true;
+	};
+	if (!ScanBlockIndex(fnEntry, &times))
+		return error("LoadBlockIndex() : block index scan failed");
 
 	boost::this_thread::interruption_point();
 
-	// Calculate nChainTrust
-	vector<pair<int, CBlockIndex*> > vSortedByHeight;
-	vSortedByHeight.reserve(mapBlockIndex.size());
-	for (const std::pair<uint256, CBlockIndex*>& item : mapBlockIndex) {
+	int64_t nTrustStart = GetTimeMicros();
+
+	// Calculate nChainTrust, heights are dense so they are counted out
+	// instead of sorted
+	int nMaxHeight = 0;
+	for (const auto& item : mapBlockIndex)
+		nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+	vector<size_t> vHeightStart(nMaxHeight + 2, 0);
+	for (const auto& item : mapBlockIndex)
+		vHeightStart[item.second->nHeight + 1]++;
+	for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+		vHeightStart[nHeight] += vHeightStart[nHeight - 1];
+	vector<pair<int, CBlockIndex*> > vSortedByHeight(mapBlockIndex.size());
+	for (const auto& item : mapBlockIndex) {
 		CBlockIndex* pindex = item.second;
-		vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
+		vSortedByHeight[vHeightStart[pindex->nHeight]++] = make_pair(pindex->nHeight, pindex);
 	}
-	sort(vSortedByHeight.begin(), vSortedByHeight.end());
 	for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight) {
 		CBlockIndex* pindex = item.second;
 		pindex->nChainTrust =
 		    (pindex->Prev() ? pindex->Prev()->nChainTrust : 0) + pindex->GetBlockTrust();
+		pindex->BuildSkip();
 	}
+	int64_t nTrustMicros = GetTimeMicros() - nTrustStart;
+
+	LogPrintf(
+	    "LoadBlockIndex(): %u entries in %dms: read %dms, decode %dms more on %d threads, "
+	    "link %dms, chain trust %dms\n",
+	    times.nEntries, (GetTimeMicros() - nStart) / 1000, times.nReadMicros / 1000,
+	    times.nDecodeMicros / 1000, times.nThreads, times.nHandleMicros / 1000,
+	    nTrustMicros / 1000);
 
 	// Load hashBestChain pointer to end of best chain
 	if (!ReadHashBestChain(hashBestChain)) {
@@ -601,6 +886,7 @@ bool CTxDB::LoadBlockIndex(LoadMsg load_msg) {
 	pindexBest      = mapBlockIndex.ref(hashBestChain);
 	nBestHeight     = pindexBest->nHeight;
 	nBestChainTrust = pindexBest->nChainTrust;
+	chainActive.SetTip(pindexBest);
 
 	// cleanup all over nBestHeight
 	for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight) {
@@ -792,6 +1078,7 @@ bool CTxDB::LoadBlockIndex(LoadMsg load_msg) {
 		pindexBest      = pindexFork;
 		nBestHeight     = pindexBest->nHeight;
 		nBestChainTrust = pindexBest->nChainTrust;
+		chainActive.SetTip(pindexBest);
 		WriteHashBestChain(pindexBest->GetBlockHash());
 		// end tmp replace regrouping
 	}
@@ -805,335 +1092,416 @@ bool CTxDB::LoadBlockIndex(LoadMsg load_msg) {
 	return true;
 }
 
+// Offsets of the fields following the type and the address
+static const size_t ADDRINDEX_ADDRESS_END = 1 + CAddressKey::SIZE;
+static const size_t ADDRINDEX_TXOUTID_LEN = 40;
+
+// Numbers are big endian so that keys sort as the numbers do
+static void AppendBE64(std::string& key, uint64_t n) {
+	for (int i = 7; i >= 0; i--)
+		key.push_back(char((n >> (i * 8)) & 0xff));
+}
+
+static uint64_t ReadBE64(const char* p) {
+	uint64_t n = 0;
+	for (int i = 0; i < 8; i++)
+		n = (n << 8) | (unsigned char)p[i];
+	return n;
+}
+
+// Most significant byte first, the order of the former hex keys
+static void AppendTxoutId(std::string& key, uint320 txoutid) {
+	const unsigned char* p = txoutid.begin();
+	for (size_t i = ADDRINDEX_TXOUTID_LEN; i > 0; i--)
+		key.push_back(char(p[i - 1]));
+}
+
+static uint320 ReadTxoutId(const char* p) {
+	uint320        txoutid;
+	unsigned char* pOut = txoutid.begin();
+	for (size_t i = 0; i < ADDRINDEX_TXOUTID_LEN; i++)
+		pOut[ADDRINDEX_TXOUTID_LEN - 1 - i] = (unsigned char)p[i];
+	return txoutid;
+}
+
+std::string AddrIndexAddressKey(char nType, const CAddressKey& address) {
+	std::string key;
+	key.reserve(ADDRINDEX_ADDRESS_END + ADDRINDEX_TXOUTID_LEN);
+	key.push_back(nType);
+	address.Append(key);
+	return key;
+}
+
+std::string AddrIndexTxoutKey(char nType, const CAddressKey& address, uint320 txoutid) {
+	std::string key = AddrIndexAddressKey(nType, address);
+	AppendTxoutId(key, txoutid);
+	return key;
+}
+
+std::string AddrIndexBalanceKey(const CAddressKey& address, uint64_t nRIndex) {
+	std::string key = AddrIndexAddressKey(ADDRINDEX_BALANCE, address);
+	AppendBE64(key, nRIndex);
+	return key;
+}
+
+std::string AddrIndexQueueKey(uint64_t nLockTime, uint320 txoutid) {
+	std::string key(1, char(ADDRINDEX_QUEUE));
+	AppendBE64(key, nLockTime);
+	AppendTxoutId(key, txoutid);
+	return key;
+}
+
+// Flags of the address index db are written past the cache
+static std::string AddrIndexFlagKey(const std::string& sName) {
+	CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+	ssKey << sName;
+	return ssKey.str();
+}
+
+static bool ReadAddrIndexFlag(leveldb::DB* pdbIn, const std::string& key) {
+	std::string strValue;
+	if (!pdbIn->Get(leveldb::ReadOptions(), key, &strValue).ok())
+		return false;
+	return !strValue.empty() && strValue[0] != 0;
+}
+
 bool CTxDB::ReadUtxoDbIsReady(bool& bReady) {
-	return Read(string("utxoDbIsReady"), bReady);
+	bReady = ReadAddrIndexFlag(paddrdb, AddrIndexFlagKey("utxoDbIsReady"));
+	return true;
 }
 
 bool CTxDB::WriteUtxoDbIsReady(bool bReady) {
-	return Write(string("utxoDbIsReady"), bReady);
+	if (fReadOnly)
+		assert(!"Write called on database in read-only mode");
+
+	CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+	ssValue << bReady;
+	leveldb::Status status =
+	    paddrdb->Put(leveldb::WriteOptions(), AddrIndexFlagKey("utxoDbIsReady"), ssValue.str());
+	if (!status.ok()) {
+		LogPrintf("LevelDB write failure: %s\n", status.ToString());
+		return false;
+	}
+	return true;
+}
+
+bool CTxDB::AddUnspent(const CAddressKey& address, uint320 txoutid, const CAddressUnspent& utxo) {
+	return WriteAddrIndex(AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, txoutid), utxo);
+}
+
+bool CTxDB::ReadUnspent(const CAddressKey& address, uint320 txoutid, CAddressUnspent& utxo) {
+	return ReadAddrIndex(AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, txoutid), utxo);
+}
+
+bool CTxDB::EraseUnspent(const CAddressKey& address, uint320 txoutid) {
+	return EraseAddrIndex(AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, txoutid));
+}
+
+bool CTxDB::AddFrozen(const CAddressKey& address, uint320 txoutid, const CAddressUnspent& ftxo) {
+	return WriteAddrIndex(AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, txoutid), ftxo);
+}
+
+bool CTxDB::ReadFrozen(const CAddressKey& address, uint320 txoutid, CAddressUnspent& ftxo) {
+	return ReadAddrIndex(AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, txoutid), ftxo);
+}
+
+bool CTxDB::EraseFrozen(const CAddressKey& address, uint320 txoutid) {
+	return EraseAddrIndex(AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, txoutid));
+}
+
+bool CTxDB::AddBalance(const CAddressKey& address, int64_t nIndex, const CAddressBalance& balance) {
+	return WriteAddrIndex(AddrIndexBalanceKey(address, INT64_MAX - nIndex), balance);
+}
+
+bool CTxDB::EraseBalance(const CAddressKey& address, int64_t nIndex) {
+	return EraseAddrIndex(AddrIndexBalanceKey(address, INT64_MAX - nIndex));
+}
+
+bool CTxDB::AddToFrozenQueue(uint64_t nLockTime, uint320 txoutid, const CFrozenQueued& record) {
+	return WriteAddrIndex(AddrIndexQueueKey(nLockTime, txoutid), record);
+}
+
+bool CTxDB::EraseFromFrozenQueue(uint64_t nLockTime, uint320 txoutid) {
+	return EraseAddrIndex(AddrIndexQueueKey(nLockTime, txoutid));
 }
 
-bool CTxDB::ReadAddressLastBalance(string sAddress, CAddressBalance& balance, int64_t& nIdx) {
-	nIdx             = -1;
-	string sNum      = strprintf("%016x", 0);
-	string sStartKey = "addr" + sAddress + sNum;
-	string sRawKey;
-	string sRawValue;
-	if (!Seek(sStartKey, sRawKey, sRawValue))
+bool CTxDB::ReadAddressLastBalance(const CAddressKey& address,
+                                   CAddressBalance&   balance,
+                                   int64_t&           nIdx) {
+	nIdx = -1;
+	vector<pair<string, string>> records;
+	RangeAddrIndex(AddrIndexBalanceKey(address, 0), AddrIndexBalanceKey(address, INT64_MAX),
+	               records, 1 /*limit*/);
+	if (records.empty())
 		return false;
 
-	bool        fFound = false;
-	CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-	ssKey.write(sRawKey.data(), sRawKey.size());
-	string sKey;
-	ssKey >> sKey;
-	if (boost::starts_with(sKey, "addr" + sAddress)) {
-		sNum = sKey.substr(4 + 34);
-		std::istringstream(sNum) >> std::hex >> nIdx;
-		nIdx = INT64_MAX - nIdx;
-		CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-		ssValue.write(sRawValue.data(), sRawValue.size());
-		ssValue >> balance;
-		fFound = true;
-	}
-	return fFound;
+	nIdx = INT64_MAX - ReadBE64(records[0].first.data() + ADDRINDEX_ADDRESS_END);
+	CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+	ssValue.write(records[0].second.data(), records[0].second.size());
+	ssValue >> balance;
+	return true;
 }
 
-// warning: this method use disk Seek and ignores current batch
-bool CTxDB::ReadAddressBalanceRecords(string sAddress, vector<CAddressBalance>& vRecords) {
-	bool               fFound   = false;
-	leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-	string             sNum     = strprintf("%016x", 0);
-	CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-	ssStartKey << "addr" + sAddress + sNum;
-	iterator->Seek(ssStartKey.str());
-	while (iterator->Valid()) {
-		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-		ssKey.write(iterator->key().data(), iterator->key().size());
-		string sKey;
-		ssKey >> sKey;
-		if (boost::starts_with(sKey, "addr" + sAddress)) {
-			CAddressBalance balance;
-			CDataStream     ssValue(SER_DISK, CLIENT_VERSION);
-			ssValue.write(iterator->value().data(), iterator->value().size());
-			ssValue >> balance;
-			vRecords.push_back(balance);
-			fFound = true;
-		} else {
-			break;
-		}
-		iterator->Next();
+bool CTxDB::ReadAddressBalanceRecords(const CAddressKey&       address,
+                                      vector<CAddressBalance>& vRecords) {
+	vector<pair<string, string>> records;
+	RangeAddrIndex(AddrIndexBalanceKey(address, 0), AddrIndexBalanceKey(address, INT64_MAX),
+	               records);
+	for (const pair<string, string>& record : records) {
+		CAddressBalance balance;
+		CDataStream     ssValue(SER_DISK, CLIENT_VERSION);
+		ssValue.write(record.second.data(), record.second.size());
+		ssValue >> balance;
+		vRecords.push_back(balance);
 	}
-	delete iterator;
-	return fFound;
+	return !records.empty();
 }
 
-// warning: this method use disk Seek and ignores current batch
-bool CTxDB::ReadAddressUnspent(string sAddress, vector<CAddressUnspent>& vRecords) {
-	bool               fFound   = false;
-	leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-	string             sNum     = strprintf("%080x", 0);
-	CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-	ssStartKey << "utxo" + sAddress + sNum;
-	iterator->Seek(ssStartKey.str());
-	while (iterator->Valid()) {
-		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-		ssKey.write(iterator->key().data(), iterator->key().size());
-		string sKey;
-		ssKey >> sKey;
-		if (boost::starts_with(sKey, "utxo" + sAddress)) {
-			CAddressUnspent utxo;
-			CDataStream     ssValue(SER_DISK, CLIENT_VERSION);
-			ssValue.write(iterator->value().data(), iterator->value().size());
-			ssValue >> utxo;
-			string txoutidhex = sKey.substr(4 + 34, 80);
-			utxo.txoutid      = uint320(txoutidhex);
-			vRecords.push_back(utxo);
-			fFound = true;
-		} else {
-			break;
-		}
-		iterator->Next();
+bool CTxDB::ReadAddressUnspent(const CAddressKey& address, vector<CAddressUnspent>& vRecords) {
+	vector<pair<string, string>> records;
+	RangeAddrIndex(AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, uint320()),
+	               AddrIndexTxoutKey(ADDRINDEX_UNSPENT, address, uint320_MAX), records);
+	for (const pair<string, string>& record : records) {
+		CAddressUnspent utxo;
+		CDataStream     ssValue(SER_DISK, CLIENT_VERSION);
+		ssValue.write(record.second.data(), record.second.size());
+		ssValue >> utxo;
+		utxo.txoutid = ReadTxoutId(record.first.data() + ADDRINDEX_ADDRESS_END);
+		vRecords.push_back(utxo);
 	}
-	delete iterator;
-	return fFound;
+	return !records.empty();
 }
 
-// warning: this method use disk Seek and ignores current batch
-bool CTxDB::ReadAddressFrozen(string sAddress, vector<CAddressUnspent>& vRecords) {
-	bool               fFound   = false;
-	leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-	string             sNum     = strprintf("%080x", 0);
-	CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-	ssStartKey << "ftxo" + sAddress + sNum;
-	iterator->Seek(ssStartKey.str());
-	while (iterator->Valid()) {
-		CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-		ssKey.write(iterator->key().data(), iterator->key().size());
-		string sKey;
-		ssKey >> sKey;
-		if (boost::starts_with(sKey, "ftxo" + sAddress)) {
-			CAddressUnspent utxo;
-			CDataStream     ssValue(SER_DISK, CLIENT_VERSION);
-			ssValue.write(iterator->value().data(), iterator->value().size());
-			ssValue >> utxo;
-			string txoutidhex = sKey.substr(4 + 34, 80);
-			utxo.txoutid      = uint320(txoutidhex);
-			vRecords.push_back(utxo);
-			fFound = true;
-		} else {
-			break;
-		}
-		iterator->Next();
+bool CTxDB::ReadAddressFrozen(const CAddressKey& address, vector<CAddressUnspent>& vRecords) {
+	vector<pair<string, string>> records;
+	RangeAddrIndex(AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, uint320()),
+	               AddrIndexTxoutKey(ADDRINDEX_FROZEN, address, uint320_MAX), records);
+	for (const pair<string, string>& record : records) {
+		CAddressUnspent utxo;
+		CDataStream     ssValue(SER_DISK, CLIENT_VERSION);
+		ssValue.write(record.second.data(), record.second.size());
+		ssValue >> utxo;
+		utxo.txoutid = ReadTxoutId(record.first.data() + ADDRINDEX_ADDRESS_END);
+		vRecords.push_back(utxo);
 	}
-	delete iterator;
-	return fFound;
+	return !records.empty();
 }
 
 bool CTxDB::ReadFrozenQueue(uint64_t nLockTime, vector<CFrozenQueued>& records) {
-	string                                    sMinTime  = strprintf("%016x", 0);
-	string                                    sMaxTime  = strprintf("%016x", nLockTime);
-	string                                    sMinTxout = uint320().GetHex();
-	string                                    sMaxTxout = uint320_MAX.GetHex();
-	vector<std::pair<string, CFrozenQueued> > values;
-	string                                    sMinKey = "fqueue" + sMinTime + sMinTxout;
-	string                                    sMaxKey = "fqueue" + sMaxTime + sMaxTxout;
-	bool                                      fFound  = Range(sMinKey, sMaxKey, values);
+	vector<pair<string, string>> values;
+	RangeAddrIndex(AddrIndexQueueKey(0, uint320()), AddrIndexQueueKey(nLockTime, uint320_MAX),
+	               values);
 	records.resize(values.size());
 	for (size_t i = 0; i < values.size(); i++) {
-		string sLockTimeHex = values[i].first.substr(6, 16);
-		string sTxoutidHex  = values[i].first.substr(6 + 16, 80);
-		records[i].sAddress = values[i].second.sAddress;
-		records[i].nAmount  = values[i].second.nAmount;
-		records[i].txoutid  = uint320(sTxoutidHex);
-		std::istringstream(sLockTimeHex) >> std::hex >> records[i].nLockTime;
+		CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+		ssValue.write(values[i].second.data(), values[i].second.size());
+		ssValue >> records[i];
+		records[i].nLockTime = ReadBE64(values[i].first.data() + 1);
+		records[i].txoutid   = ReadTxoutId(values[i].first.data() + 1 + 8);
 	}
-	return fFound;
+	return !values.empty();
 }
 
 bool CTxDB::ReadFrozenQueued(uint64_t nLockTime, uint320 txoutid, CFrozenQueued& record) {
-	string sTime  = strprintf("%016x", nLockTime);
-	string sTxout = txoutid.GetHex();
-	string sKey   = "fqueue" + sTime + sTxout;
-	return Read(sKey, record);
+	return ReadAddrIndex(AddrIndexQueueKey(nLockTime, txoutid), record);
 }
 
-bool CTxDB::CleanupUtxoData(LoadMsg load_msg) {
-	// remove old balance records
-	{
-		leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-		string             sNum     = strprintf("%016x", 0);
-		CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-		string             sStart = strprintf("%034x", 0);
-		ssStartKey << "addr" + sStart + sNum;
-		iterator->Seek(ssStartKey.str());
-		int n = 0;
-		while (iterator->Valid()) {
-			if (n % 10000 == 0) {
-				load_msg(std::string(" cleanup #1: ") + std::to_string(n));
-			}
-			CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-			ssKey.write(iterator->key().data(), iterator->key().size());
-			string sKey;
-			ssKey >> sKey;
-			if (boost::starts_with(sKey, "addr")) {
-				string sDeleteKey = iterator->key().ToString();
-				iterator->Next();
-				pdb->Delete(leveldb::WriteOptions(), sDeleteKey);
-				n++;
-				continue;
-			} else {
-				break;
-			}
-			iterator->Next();
-			n++;
+// Erases the records of keys starting with prefix, all of them if it is empty
+static bool ErasePrefix(leveldb::DB*       pdbIn,
+                        const std::string& prefix,
+                        LoadMsg            load_msg,
+                        const std::string& sMsg) {
+	leveldb::Iterator*  iterator = pdbIn->NewIterator(ScanReadOptions());
+	leveldb::WriteBatch batch;
+	bool                fOk = true;
+	int                 n   = 0;
+	for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix);
+	     iterator->Next()) {
+		batch.Delete(iterator->key());
+		if (++n % 10000 == 0) {
+			load_msg(sMsg + std::to_string(n));
+			fOk = fOk && pdbIn->Write(leveldb::WriteOptions(), &batch).ok();
+			batch.Clear();
 		}
-		delete iterator;
 	}
-	// remove old utxo records
-	{
-		leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-		string             sTxout   = strprintf("%080x", 0);  // 256+64
-		CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-		string             sStart = strprintf("%034x", 0);
-		ssStartKey << "utxo" + sStart + sTxout;
-		iterator->Seek(ssStartKey.str());
-		int n = 0;
-		while (iterator->Valid()) {
-			if (n % 10000 == 0) {
-				load_msg(std::string(" cleanup #2: ") + std::to_string(n));
-			}
-			CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-			ssKey.write(iterator->key().data(), iterator->key().size());
-			string sKey;
-			ssKey >> sKey;
-			if (boost::starts_with(sKey, "utxo")) {
-				string sDeleteKey = iterator->key().ToString();
-				iterator->Next();
-				pdb->Delete(leveldb::WriteOptions(), sDeleteKey);
-				n++;
-				continue;
-			} else {
-				break;
-			}
-			iterator->Next();
-			n++;
-		}
-		delete iterator;
+	delete iterator;
+	return pdbIn->Write(leveldb::WriteOptions(), &batch).ok() && fOk;
+}
+
+// The address index of txdb before the address index db: serialized strings
+// of a tag, the base58 address and hex numbers, by tag and string length
+static const struct {
+	const char* pszTag;
+	size_t      nLength;
+} vLegacyAddrIndex[] = {
+    {"addr", 4 + 34 + 16},  {"utxo", 4 + 34 + 80},       {"ftxo", 4 + 34 + 80},
+    {"fqueue", 6 + 16 + 80}, {"pegbalance", 10 + 34},
+};
+
+static std::string LegacyAddrIndexPrefix(const char* pszTag, size_t nLength) {
+	// compact size of strings shorter than 253 is a single byte
+	return std::string(1, char(nLength)) + pszTag;
+}
+
+static bool ParseHex64(const std::string& sHex, uint64_t& n) {
+	if (sHex.size() != 16 || !IsHex(sHex))
+		return false;
+	n = ReadBE64((const char*)ParseHex(sHex).data());
+	return true;
+}
+
+static bool ParseTxoutId(const std::string& sHex, uint320& txoutid) {
+	if (sHex.size() != 2 * ADDRINDEX_TXOUTID_LEN || !IsHex(sHex))
+		return false;
+	txoutid.SetHex(sHex);
+	return true;
+}
+
+bool MigrateAddrIndexKey(const std::string& sKey, std::string& key) {
+	CAddressKey address;
+	uint320     txoutid;
+	uint64_t    n = 0;
+	if (boost::starts_with(sKey, "addr")) {
+		if (!address.SetString(sKey.substr(4, 34)) || !ParseHex64(sKey.substr(4 + 34), n))
+			return false;
+		key = AddrIndexBalanceKey(address, n);
+		return true;
 	}
-	// remove old frozen records
-	{
-		leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-		string             sTxout   = strprintf("%080x", 0);  // 256+64
-		CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-		string             sStart = strprintf("%034x", 0);
-		ssStartKey << "ftxo" + sStart + sTxout;
-		iterator->Seek(ssStartKey.str());
-		int n = 0;
-		while (iterator->Valid()) {
-			if (n % 10000 == 0) {
-				load_msg(std::string(" cleanup #3: ") + std::to_string(n));
-			}
-			CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-			ssKey.write(iterator->key().data(), iterator->key().size());
-			string sKey;
-			ssKey >> sKey;
-			if (boost::starts_with(sKey, "ftxo")) {
-				string sDeleteKey = iterator->key().ToString();
-				iterator->Next();
-				pdb->Delete(leveldb::WriteOptions(), sDeleteKey);
-				n++;
-				continue;
-			} else {
-				break;
-			}
-			iterator->Next();
-			n++;
-		}
-		delete iterator;
+	if (boost::starts_with(sKey, "utxo") || boost::starts_with(sKey, "ftxo")) {
+		if (!address.SetString(sKey.substr(4, 34)) || !ParseTxoutId(sKey.substr(4 + 34), txoutid))
+			return false;
+		char nType = sKey[0] == 'u' ? ADDRINDEX_UNSPENT : ADDRINDEX_FROZEN;
+		key        = AddrIndexTxoutKey(nType, address, txoutid);
+		return true;
 	}
-	// remove old frozen queue records
-	{
-		leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-		string             sTime    = strprintf("%016x", 0);
-		string             sTxout   = strprintf("%080x", 0);  // 256+64
-		CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-		ssStartKey << "fqueue" + sTime + sTxout;
-		iterator->Seek(ssStartKey.str());
-		int n = 0;
-		while (iterator->Valid()) {
-			if (n % 10000 == 0) {
-				load_msg(std::string(" cleanup #4: ") + std::to_string(n));
-			}
-			CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-			ssKey.write(iterator->key().data(), iterator->key().size());
-			string sKey;
-			ssKey >> sKey;
-			if (boost::starts_with(sKey, "fqueue")) {
-				string sDeleteKey = iterator->key().ToString();
-				iterator->Next();
-				pdb->Delete(leveldb::WriteOptions(), sDeleteKey);
-				n++;
-				continue;
-			} else {
-				break;
-			}
-			iterator->Next();
-			n++;
-		}
-		delete iterator;
+	if (boost::starts_with(sKey, "fqueue")) {
+		if (!ParseHex64(sKey.substr(6, 16), n) || !ParseTxoutId(sKey.substr(6 + 16), txoutid))
+			return false;
+		key = AddrIndexQueueKey(n, txoutid);
+		return true;
 	}
-	CleanupPegBalances(load_msg);
-	return true;
+	if (boost::starts_with(sKey, "pegbalance")) {
+		if (!address.SetString(sKey.substr(10)))
+			return false;
+		key = AddrIndexAddressKey(ADDRINDEX_PEGBALANCE, address);
+		return true;
+	}
+	return false;
 }
 
-bool CTxDB::CleanupPegBalances(LoadMsg load_msg) {
-	// remove old pegbalance records
-	{
-		leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-		string             sStart   = strprintf("%034x", 0);
-		CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-		ssStartKey << "pegbalance" + sStart;
-		iterator->Seek(ssStartKey.str());
-		int n = 0;
-		while (iterator->Valid()) {
-			if (n % 10000 == 0) {
-				load_msg(std::string(" cleanup #5: ") + std::to_string(n));
+static bool EraseLegacyAddrIndex(leveldb::DB* pdbIn, LoadMsg load_msg) {
+	bool fOk = true;
+	for (const auto& legacy : vLegacyAddrIndex) {
+		string prefix = LegacyAddrIndexPrefix(legacy.pszTag, legacy.nLength);
+		fOk = ErasePrefix(pdbIn, prefix, load_msg, " cleanup legacy: ") && fOk;
+	}
+	fOk = pdbIn->Delete(leveldb::WriteOptions(), AddrIndexFlagKey("utxoDbIsReady")).ok() && fOk;
+	fOk = pdbIn->Delete(leveldb::WriteOptions(), CAddrIndexCache::DirtyKey()).ok() && fOk;
+	return fOk;
+}
+
+bool MigrateAddrIndexRecords(leveldb::DB* pdbFrom, leveldb::DB* pdbTo, LoadMsg load_msg, int& n) {
+	// values are kept, only the keys change
+	leveldb::WriteBatch batch;
+	n = 0;
+	for (const auto& legacy : vLegacyAddrIndex) {
+		string             prefix   = LegacyAddrIndexPrefix(legacy.pszTag, legacy.nLength);
+		leveldb::Iterator* iterator = pdbFrom->NewIterator(ScanReadOptions());
+		for (iterator->Seek(prefix); iterator->Valid() && iterator->key().starts_with(prefix);
+		     iterator->Next()) {
+			string sKey(iterator->key().data() + 1, iterator->key().size() - 1);
+			string key;
+			if (!MigrateAddrIndexKey(sKey, key)) {
+				delete iterator;
+				return error("MigrateAddrIndexRecords() : bad record %s", sKey);
 			}
-			CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-			ssKey.write(iterator->key().data(), iterator->key().size());
-			string sKey;
-			ssKey >> sKey;
-			if (boost::starts_with(sKey, "pegbalance")) {
-				string sDeleteKey = iterator->key().ToString();
-				iterator->Next();
-				pdb->Delete(leveldb::WriteOptions(), sDeleteKey);
-				n++;
-				continue;
-			} else {
-				break;
+			batch.Put(key, iterator->value());
+			if (++n % 10000 == 0) {
+				load_msg(std::string(" migrate address index: ") + std::to_string(n));
+				if (!pdbTo->Write(leveldb::WriteOptions(), &batch).ok()) {
+					delete iterator;
+					return error("MigrateAddrIndexRecords() : address index write failed");
+				}
+				batch.Clear();
 			}
-			iterator->Next();
-			n++;
 		}
 		delete iterator;
 	}
+	if (!pdbTo->Write(leveldb::WriteOptions(), &batch).ok())
+		return error("MigrateAddrIndexRecords() : address index write failed");
+	return true;
+}
+
+bool CTxDB::MigrateAddrIndex(LoadMsg load_msg) {
+	AddrIndexCache().Clear();
+	if (!ErasePrefix(paddrdb, std::string(), load_msg, " cleanup: "))
+		return error("MigrateAddrIndex() : address index cleanup failed");
+
+	int n = 0;
+	if (!MigrateAddrIndexRecords(pdb, paddrdb, load_msg, n))
+		return false;
+	if (!WriteUtxoDbIsReady(true))
+		return false;
+
+	// leftovers of an interrupted erase only take space
+	EraseLegacyAddrIndex(pdb, load_msg);
+	LogPrintf("MigrateAddrIndex() : %d records moved to the address index db\n", n);
+	return true;
+}
+
+bool CTxDB::CleanupUtxoData(LoadMsg load_msg) {
+	// records are removed on disk, cached changes are dropped
+	AddrIndexCache().Clear();
+	ErasePrefix(paddrdb, std::string(), load_msg, " cleanup: ");
+	EraseLegacyAddrIndex(pdb, load_msg);
 	return true;
 }
 
+bool CTxDB::CleanupPegBalances(LoadMsg load_msg) {
+	// records are removed on disk, have all of them there
+	if (!FlushAddrIndex())
+		return error("CleanupPegBalances() : address index flush failed");
+	string prefix(1, char(ADDRINDEX_PEGBALANCE));
+	return ErasePrefix(paddrdb, prefix, load_msg, " cleanup pegbalances: ");
+}
+
 bool CTxDB::LoadUtxoData(LoadMsg load_msg) {
 	bool fIsReady = false;
 	bool fEnabled = true;  // default
 
 	ReadUtxoDbIsReady(fIsReady);
 
+	// address index cache was not flushed, the index on disk is incomplete
+	bool fIsDirty = ReadAddrIndexFlag(paddrdb, CAddrIndexCache::DirtyKey());
+	if (fIsReady && fIsDirty) {
+		LogPrintf("LoadUtxoData() : address index was not flushed, rebuilding\n");
+		fIsReady = false;
+	}
+
+	// a complete index of txdb string keys is moved over, testnet p2sh
+	// addresses did not fit its keys and were not indexed
+	if (!fIsReady && fEnabled && !TestNet()) {
+		bool fLegacyReady = false;
+		bool fLegacyDirty = false;
+		Read(string("utxoDbIsReady"), fLegacyReady);
+		Read(string("utxoDbDirty"), fLegacyDirty);
+		if (fLegacyReady && !fLegacyDirty) {
+			fIsReady = MigrateAddrIndex(load_msg);
+			if (!fIsReady)
+				LogPrintf("LoadUtxoData() : address index migration failed, rebuilding\n");
+		}
+	}
+
 	//    fIsReady = false;
 	//    fEnabled = true;
 
-	set<string> setSkipAddresses;
-	setSkipAddresses.insert(Params().PegInflateAddr());
-	setSkipAddresses.insert(Params().PegDeflateAddr());
-	setSkipAddresses.insert(Params().PegNochangeAddr());
+	set<CAddressKey> setSkipAddresses;
+	for (const string& sAddress :
+	     {Params().PegInflateAddr(), Params().PegDeflateAddr(), Params().PegNochangeAddr()}) {
+		CAddressKey address;
+		if (address.SetString(sAddress))
+			setSkipAddresses.insert(address);
+	}
 
 	if (!fIsReady && fEnabled) {
 		// remove all first
@@ -1208,92 +1576,59 @@ bool CTxDB::LoadUtxoData(LoadMsg load_msg) {
 			// two passes:
 			// first pass to collect and add all non-peg unspents without counting peg fractions
 			// secod pass to collect and add all peg-based unspent with peg append/deduct
+			string prefix(1, char(ADDRINDEX_UNSPENT));
 			{
-				leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-				string             sTxout   = strprintf("%080x", 0);  // 256+64
-				CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-				string             sStart = strprintf("%034x", 0);
-				ssStartKey << "utxo" + sStart + sTxout;
-				iterator->Seek(ssStartKey.str());
-				int n = 0;
-				while (iterator->Valid()) {
+				leveldb::Iterator* iterator = paddrdb->NewIterator(ScanReadOptions());
+				int                n        = 0;
+				for (iterator->Seek(prefix);
+				     iterator->Valid() && iterator->key().starts_with(prefix);
+				     iterator->Next(), n++) {
 					if (n % 10000 == 0) {
 						load_msg(std::string(" balances: ") + std::to_string(n));
 					}
-					CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-					ssKey.write(iterator->key().data(), iterator->key().size());
-					string sKey;
-					ssKey >> sKey;
-					if (boost::starts_with(sKey, "utxo")) {
-						CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-						ssValue.write(iterator->value().data(), iterator->value().size());
-						CAddressUnspent unspent;
-						ssValue >> unspent;
-						string sAddress = sKey.substr(4, 34);
-
-						CFractions fractions(unspent.nAmount, CFractions::VALUE);
-						bool       peg_on = unspent.nHeight >= nPegStartHeight;
-						if (!peg_on) {
-							if (!AppendUnspent(sAddress, fractions,
-							                   true /*still sumup as pegbased*/))
-								return error("LoadUtxoData() : AppendUnspent failed");
-						}
-
-						iterator->Next();
-						n++;
-						continue;
-					} else {
-						break;
+					CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+					ssValue.write(iterator->value().data(), iterator->value().size());
+					CAddressUnspent unspent;
+					ssValue >> unspent;
+					CAddressKey address;
+					address.Read(iterator->key().data() + 1);
+
+					CFractions fractions(unspent.nAmount, CFractions::VALUE);
+					bool       peg_on = unspent.nHeight >= nPegStartHeight;
+					if (!peg_on) {
+						if (!AppendUnspent(address, fractions, true /*still sumup as pegbased*/))
+							return error("LoadUtxoData() : AppendUnspent failed");
 					}
-					iterator->Next();
-					n++;
 				}
 				delete iterator;
 			}
 			// peg-based
 			{
-				leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-				string             sTxout   = strprintf("%080x", 0);  // 256+64
-				CDataStream        ssStartKey(SER_DISK, CLIENT_VERSION);
-				string             sStart = strprintf("%034x", 0);
-				ssStartKey << "utxo" + sStart + sTxout;
-				iterator->Seek(ssStartKey.str());
-				int n = 0;
-				while (iterator->Valid()) {
+				leveldb::Iterator* iterator = paddrdb->NewIterator(ScanReadOptions());
+				int                n        = 0;
+				for (iterator->Seek(prefix);
+				     iterator->Valid() && iterator->key().starts_with(prefix);
+				     iterator->Next(), n++) {
 					if (n % 10000 == 0) {
 						load_msg(std::string(" balances: ") + std::to_string(n));
 					}
-					CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-					ssKey.write(iterator->key().data(), iterator->key().size());
-					string sKey;
-					ssKey >> sKey;
-					if (boost::starts_with(sKey, "utxo")) {
-						CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-						ssValue.write(iterator->value().data(), iterator->value().size());
-						CAddressUnspent unspent;
-						ssValue >> unspent;
-						string  sAddress    = sKey.substr(4, 34);
-						string  sTxoutidHex = sKey.substr(4 + 34, 80);
-						uint320 txoutid(sTxoutidHex);
-
-						CFractions fractions(unspent.nAmount, CFractions::VALUE);
-						bool       peg_on = unspent.nHeight >= nPegStartHeight;
-						if (peg_on) {
-							if (!setSkipAddresses.count(sAddress))
-								if (!pegdb.ReadFractions(txoutid, fractions, true /*must_have*/))
-									return error("LoadUtxoData() : ReadFractions failed");
-							if (!AppendUnspent(sAddress, fractions, peg_on))
-								return error("LoadUtxoData() : AppendUnspent failed");
-						}
-
-						iterator->Next();
-						n++;
-						continue;
-					} else {
-						break;
+					CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+					ssValue.write(iterator->value().data(), iterator->value().size());
+					CAddressUnspent unspent;
+					ssValue >> unspent;
+					CAddressKey address;
+					address.Read(iterator->key().data() + 1);
+					uint320 txoutid = ReadTxoutId(iterator->key().data() + ADDRINDEX_ADDRESS_END);
+
+					CFractions fractions(unspent.nAmount, CFractions::VALUE);
+					bool       peg_on = unspent.nHeight >= nPegStartHeight;
+					if (peg_on) {
+						if (!setSkipAddresses.count(address))
+							if (!pegdb.ReadFractions(txoutid, fractions, true /*must_have*/))
+								return error("LoadUtxoData() : ReadFractions failed");
+						if (!AppendUnspent(address, fractions, peg_on))
+							return error("LoadUtxoData() : AppendUnspent failed");
 					}
-					iterator->Next();
-					n++;
 				}
 				delete iterator;
 			}
@@ -1302,6 +1637,8 @@ bool CTxDB::LoadUtxoData(LoadMsg load_msg) {
 		boost::this_thread::interruption_point();
 
 		// utxo db is ready for use
+		if (!FlushAddrIndex())
+			return error("LoadUtxoData() : address index flush failed");
 		WriteUtxoDbIsReady(true);
 	}
 
@@ -1314,10 +1651,11 @@ bool CTxDB::LoadUtxoData(LoadMsg load_msg) {
 	return true;
 }
 
-bool CTxDB::DeductSpent(std::string sAddress, const CFractions& fractions, bool peg_on) {
+bool CTxDB::DeductSpent(const CAddressKey& address, const CFractions& fractions, bool peg_on) {
 	CFractions  base(0, CFractions::VALUE);
+	std::string key = AddrIndexAddressKey(ADDRINDEX_PEGBALANCE, address);
 	std::string strValue;
-	if (ReadStr("pegbalance" + sAddress, strValue)) {
+	if (ReadAddrIndexRaw(key, strValue)) {
 		CDataStream finp(strValue.data(), strValue.data() + strValue.size(), SER_DISK,
 		                 CLIENT_VERSION);
 		if (!base.Unpack(finp))
@@ -1329,14 +1667,15 @@ bool CTxDB::DeductSpent(std::string sAddress, const CFractions& fractions, bool
 		base -= fractions;
 	}
 	CDataStream fout(SER_DISK, CLIENT_VERSION);
-	base.Pack(fout, nullptr, false /*compress*/);
-	return Write("pegbalance" + sAddress, fout);
+	base.Pack(fout, nullptr, CFractions::SER_RAW);
+	return WriteAddrIndexRaw(key, fout.str());
 }
 
-bool CTxDB::AppendUnspent(std::string sAddress, const CFractions& fractions, bool peg_on) {
+bool CTxDB::AppendUnspent(const CAddressKey& address, const CFractions& fractions, bool peg_on) {
 	CFractions  base(0, CFractions::VALUE);
+	std::string key = AddrIndexAddressKey(ADDRINDEX_PEGBALANCE, address);
 	std::string strValue;
-	if (ReadStr("pegbalance" + sAddress, strValue)) {
+	if (ReadAddrIndexRaw(key, strValue)) {
 		CDataStream finp(strValue.data(), strValue.data() + strValue.size(), SER_DISK,
 		                 CLIENT_VERSION);
 		if (!base.Unpack(finp))
@@ -1348,14 +1687,14 @@ bool CTxDB::AppendUnspent(std::string sAddress, const CFractions& fractions, boo
 		base += fractions;
 	}
 	CDataStream fout(SER_DISK, CLIENT_VERSION);
-	base.Pack(fout, nullptr, false /*compress*/);
-	return Write("pegbalance" + sAddress, fout);
+	base.Pack(fout, nullptr, CFractions::SER_RAW);
+	return WriteAddrIndexRaw(key, fout.str());
 }
 
-bool CTxDB::ReadPegBalance(std::string sAddress, CFractions& fractions) {
+bool CTxDB::ReadPegBalance(const CAddressKey& address, CFractions& fractions) {
 	fractions = CFractions(0, CFractions::VALUE);
 	std::string strValue;
-	if (ReadStr("pegbalance" + sAddress, strValue)) {
+	if (ReadAddrIndexRaw(AddrIndexAddressKey(ADDRINDEX_PEGBALANCE, address), strValue)) {
 		CDataStream finp(strValue.data(), strValue.data() + strValue.size(), SER_DISK,
 		                 CLIENT_VERSION);
 		if (!fractions.Unpack(finp))
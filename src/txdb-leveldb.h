@@ -7,6 +7,7 @@
 #ifndef BITCOIN_LEVELDB_H
 #define BITCOIN_LEVELDB_H
 
+#include "addrindexcache.h"
 #include "main.h"
 
 #include <map>
@@ -16,6 +17,61 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+/** -dbcache default, block cache of txdb and pegdb (megabytes) */
+static const int64_t DEFAULT_DB_CACHE_SIZE = 50;
+/** -<name>dbwritebuffer default (megabytes) */
+static const int64_t DEFAULT_DB_WRITE_BUFFER = 4;
+/** -<name>dbbloombits default, bits per key of the bloom filter */
+static const int DEFAULT_DB_BLOOM_BITS = 10;
+/** -<name>dbmaxopenfiles default */
+static const int DEFAULT_DB_MAX_OPEN_FILES = 1000;
+
+// LevelDB tuning of a database, read from -<name>dbcache, -<name>dbwritebuffer,
+// -<name>dbbloombits, -<name>dbcompression and -<name>dbmaxopenfiles with
+// name tx, peg or addr
+struct CDbTuning {
+	int64_t nCacheBytes   = 0;
+	int64_t nWriteBuffer  = 0;
+	int     nBloomBits    = 0;  // no filter if 0
+	bool    fCompression  = true;
+	int     nMaxOpenFiles = 0;
+};
+
+CDbTuning GetDbTuning(const std::string& sName);
+// The block cache and filter policy of the options are owned by the caller
+leveldb::Options GetDbOptions(const CDbTuning& tuning);
+// Bulk scans read blocks once, they do not replace the cached ones
+leveldb::ReadOptions ScanReadOptions();
+
+struct CDbStats {
+	uint64_t         nApproxSize = 0;
+	std::vector<int> vFilesAtLevel;
+	std::string      sStats;  // leveldb.stats property
+};
+
+CDbStats GetDbStats(leveldb::DB* pdb);
+
+// Address index record types, the first byte of the address index db keys
+enum {
+	ADDRINDEX_BALANCE    = 'a',  // address, INT64_MAX - index: CAddressBalance
+	ADDRINDEX_FROZEN     = 'f',  // address, txoutid: CAddressUnspent
+	ADDRINDEX_PEGBALANCE = 'p',  // address: packed CFractions
+	ADDRINDEX_QUEUE      = 'q',  // lock time, txoutid: CFrozenQueued
+	ADDRINDEX_UNSPENT    = 'u',  // address, txoutid: CAddressUnspent
+};
+
+// Keys of the address index db, numbers and txoutids are most significant
+// byte first so that keys sort as the former hex strings did
+std::string AddrIndexAddressKey(char nType, const CAddressKey& address);
+std::string AddrIndexTxoutKey(char nType, const CAddressKey& address, uint320 txoutid);
+std::string AddrIndexBalanceKey(const CAddressKey& address, uint64_t nRIndex);
+std::string AddrIndexQueueKey(uint64_t nLockTime, uint320 txoutid);
+// The key of a legacy record in the address index db, false if it is not valid
+bool MigrateAddrIndexKey(const std::string& sKey, std::string& key);
+// Writes the legacy address index records of pdbFrom to pdbTo under their new
+// keys, n is the number of records
+bool MigrateAddrIndexRecords(leveldb::DB* pdbFrom, leveldb::DB* pdbTo, LoadMsg load_msg, int& n);
+
 // Class that provides access to a LevelDB. Note that this class is frequently
 // instantiated on the stack and then destroyed again, so instantiation has to
 // be very cheap. Unfortunately that means, a CTxDB instance is actually just a
@@ -50,12 +106,20 @@ public:
 	};
 
 private:
-	leveldb::DB* pdb;  // Points to the global instance.
+	leveldb::DB* pdb;      // Points to the global instance.
+	leveldb::DB* paddrdb;  // Points to the global address index instance.
 
 	// A batch stores up writes and deletes for atomic application. When this
 	// field is non-NULL, writes/deletes go there instead of directly to disk.
 	leveldb::WriteBatch* activeBatch;
+	// Sorted copy of the changes of activeBatch, reads consult it instead of
+	// scanning the batch.
+	DbChanges            mapBatchChanges;
+	// Address index changes of the active batch, they are kept aside of
+	// the batch and go to the address index cache on commit.
+	DbChanges            mapAddrIndexPending;
 	leveldb::Options     options;
+	leveldb::Options     addrOptions;
 	bool                 fReadOnly;
 	int                  nVersion;
 
@@ -64,15 +128,16 @@ protected:
 	// or leaves value alone and sets deleted = true if activeBatch contains a
 	// delete for it.
 	bool ScanBatch(const CDataStream& key, std::string* value, bool* deleted) const;
-	bool SeekBatch(const CDataStream&                                     fromkey,
-	               std::string*                                           key,
-	               std::string*                                           value,
-	               std::map<std::string, std::string, CTxDB::cmpBySlice>* seekmap,
-	               std::set<std::string>*                                 erased) const;
-	bool SeekBatch(const CDataStream&                                     fromkey,
-	               const CDataStream&                                     tokey,
-	               std::map<std::string, std::string, CTxDB::cmpBySlice>* seekmap,
-	               std::set<std::string>*                                 erased) const;
+	// Reads records of pdbIn with keys in [fromkey, tokey] (no upper bound if
+	// tokey is empty) in key order, changes are merged over disk records.
+	// Stops after nLimit records if it is not 0.
+	void MergeRange(leveldb::DB*                                      pdbIn,
+	                const leveldb::ReadOptions&                       readOptions,
+	                const std::string&                                fromkey,
+	                const std::string&                                tokey,
+	                const DbChanges&                                  changes,
+	                std::vector<std::pair<std::string, std::string>>& records,
+	                size_t                                            nLimit = 0);
 
 	template <typename K>
 	bool Seek(const K& fromkey, std::string& rawkey, std::string& rawvalue) {
@@ -80,60 +145,13 @@ protected:
 		ssFromKey.reserve(1000);
 		ssFromKey << fromkey;
 
-		std::string                                           strBKey;
-		std::string                                           strBValue;
-		bool                                                  foundInBatch = false;
-		std::set<std::string>                                 erasedKeys;
-		std::map<std::string, std::string, CTxDB::cmpBySlice> seekmap;
-		// First we must search for it in the currently pending set of
-		// changes to the db. Then go on to read disk and compare which is to use.
-		if (activeBatch) {
-			foundInBatch = SeekBatch(ssFromKey, &strBKey, &strBValue, &seekmap, &erasedKeys);
-		}
-
-		std::string        strDKey;
-		std::string        strDValue;
-		bool               foundOnDisk = false;
-		leveldb::Iterator* iterator    = pdb->NewIterator(leveldb::ReadOptions());
-		iterator->Seek(ssFromKey.str());
-		if (!iterator->Valid()) {
-			if (!foundInBatch) {
-				delete iterator;
-				return false;  // not found
-			}
-		}
-		while (iterator->Valid()) {
-			strDKey   = iterator->key().ToString();
-			strDValue = iterator->value().ToString();
-			if (!erasedKeys.count(strDKey)) {
-				foundOnDisk = true;
-				break;
-			}
-			iterator->Next();
-		}
-		delete iterator;
-
-		if (foundInBatch && !foundOnDisk) {
-			rawkey   = strBKey;
-			rawvalue = strBValue;
-		} else if (!foundInBatch && foundOnDisk) {
-			rawkey   = strDKey;
-			rawvalue = strDValue;
-		} else if (!foundInBatch && !foundOnDisk) {
+		std::vector<std::pair<std::string, std::string>> records;
+		MergeRange(pdb, leveldb::ReadOptions(), ssFromKey.str(), std::string(), mapBatchChanges,
+		           records, 1 /*limit*/);
+		if (records.empty())
 			return false;  // not found
-		} else if (foundInBatch && foundOnDisk) {
-			leveldb::Slice sbkey(strBKey);
-			leveldb::Slice sdkey(strDKey);
-			if (sbkey.compare(sdkey) <= 0) {
-				// ==, batch has fresh value
-				rawkey   = strBKey;
-				rawvalue = strBValue;
-			} else {
-				rawkey   = strDKey;
-				rawvalue = strDValue;
-			}
-		}
-
+		rawkey   = records[0].first;
+		rawvalue = records[0].second;
 		return true;
 	}
 
@@ -147,73 +165,19 @@ protected:
 		ssToKey.reserve(1000);
 		ssToKey << tokey;
 
-		auto push_back = [&](std::string rawkey, std::string rawvalue) {
-			values.resize(values.size() + 1);
+		std::vector<std::pair<std::string, std::string>> records;
+		MergeRange(pdb, leveldb::ReadOptions(), ssFromKey.str(), ssToKey.str(), mapBatchChanges,
+		           records);
+		values.resize(records.size());
+		for (size_t i = 0; i < records.size(); i++) {
+			const std::string& rawkey   = records[i].first;
+			const std::string& rawvalue = records[i].second;
 			CDataStream ssKey(rawkey.data(), rawkey.data() + rawkey.size(), SER_DISK,
 			                  CLIENT_VERSION);
-			ssKey >> values.back().first;
+			ssKey >> values[i].first;
 			CDataStream ssValue(rawvalue.data(), rawvalue.data() + rawvalue.size(), SER_DISK,
 			                    CLIENT_VERSION);
-			ssValue >> values.back().second;
-		};
-
-		bool                                                  foundInBatch = false;
-		std::set<std::string>                                 erasedKeys;
-		std::map<std::string, std::string, CTxDB::cmpBySlice> seekmap;
-		// First we must search for it in the currently pending set of
-		// changes to the db. Then go on to read disk and compare which is to use.
-		if (activeBatch) {
-			foundInBatch = SeekBatch(ssFromKey, ssToKey, &seekmap, &erasedKeys);
-		}
-
-		leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
-		iterator->Seek(ssFromKey.str());
-		if (!iterator->Valid()) {
-			if (!foundInBatch) {
-				delete iterator;
-				return false;  // not found
-			}
-		}
-		// to merge with batch
-		while (iterator->Valid()) {
-			string strDKey = iterator->key().ToString();
-			if (erasedKeys.count(strDKey)) {
-				iterator->Next();
-				continue;
-			}
-			if (leveldb::Slice(strDKey).compare(leveldb::Slice(ssToKey.str())) > 0) {
-				break;
-			}
-			// first add lower keys from batch
-			bool skipDValue = false;
-			if (!seekmap.empty()) {
-				string strBKey = seekmap.begin()->first;
-				while (leveldb::Slice(strBKey).compare(leveldb::Slice(strDKey)) <= 0) {
-					if (strBKey == strDKey)
-						skipDValue = true;
-					string strBValue = seekmap.begin()->second;
-					push_back(strBKey, strBValue);
-					// next
-					seekmap.erase(strBKey);
-					if (seekmap.empty())
-						break;
-					strBKey = seekmap.begin()->first;
-				}
-			}
-			// add disk value if not in batch
-			if (!skipDValue) {
-				string strDValue = iterator->value().ToString();
-				push_back(strDKey, strDValue);
-			}
-			iterator->Next();
-		}
-		delete iterator;
-		// remains upper keys in batch
-		while (!seekmap.empty()) {
-			string strBKey   = seekmap.begin()->first;
-			string strBValue = seekmap.begin()->second;
-			push_back(strBKey, strBValue);
-			seekmap.erase(strBKey);
+			ssValue >> values[i].second;
 		}
 
 		return !values.empty();
@@ -299,6 +263,9 @@ protected:
 
 		if (activeBatch) {
 			activeBatch->Put(ssKey.str(), ssValue.str());
+			CDbChange& change = mapBatchChanges[ssKey.str()];
+			change.fErased    = false;
+			change.value      = ssValue.str();
 			return true;
 		}
 		leveldb::Status status = pdb->Put(leveldb::WriteOptions(), ssKey.str(), ssValue.str());
@@ -321,6 +288,9 @@ protected:
 		ssKey << key;
 		if (activeBatch) {
 			activeBatch->Delete(ssKey.str());
+			CDbChange& change = mapBatchChanges[ssKey.str()];
+			change.fErased    = true;
+			change.value.clear();
 			return true;
 		}
 		leveldb::Status status = pdb->Delete(leveldb::WriteOptions(), ssKey.str());
@@ -345,14 +315,54 @@ protected:
 		return status.IsNotFound() == false;
 	}
 
+	// Address index records live in their own db under binary keys, see the
+	// ADDRINDEX_ record types above. They are read through pending changes of
+	// the batch, then the address index cache, then disk.
+	bool ReadAddrIndexRaw(const std::string& key, std::string& rawvalue);
+	bool WriteAddrIndexRaw(const std::string& key, const std::string& rawvalue);
+	bool EraseAddrIndex(const std::string& key);
+	// Reads records with keys in [fromkey, tokey] in key order, up to nLimit if not 0.
+	// Disk is read from a snapshot taken with the copy of cached changes.
+	void RangeAddrIndex(const std::string&                                fromkey,
+	                    const std::string&                                tokey,
+	                    std::vector<std::pair<std::string, std::string>>& records,
+	                    size_t                                            nLimit = 0);
+
+	template <typename T>
+	bool ReadAddrIndex(const std::string& key, T& value) {
+		std::string strValue;
+		if (!ReadAddrIndexRaw(key, strValue))
+			return false;
+		try {
+			CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK,
+			                    CLIENT_VERSION);
+			ssValue >> value;
+		} catch (std::exception& e) {
+			return false;
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool WriteAddrIndex(const std::string& key, const T& value) {
+		CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+		ssValue.reserve(10000);
+		ssValue << value;
+		return WriteAddrIndexRaw(key, ssValue.str());
+	}
+
 public:
 	bool TxnBegin();
 	bool TxnCommit();
 	bool TxnAbort() {
 		delete activeBatch;
 		activeBatch = NULL;
+		mapBatchChanges.clear();
+		mapAddrIndexPending.clear();
 		return true;
 	}
+	// Writes cached address index changes to disk
+	bool FlushAddrIndex();
 
 	bool ReadVersion(int& nVersion) {
 		nVersion = 0;
@@ -364,6 +374,8 @@ public:
 	static CBlockIndex* InsertBlockIndex(uint256 hash);
 
 	bool ReadTxIndex(uint256 hash, CTxIndex& txindex);
+	bool ReadTxIndexes(const std::vector<uint256>&  vHashes,
+	                   std::map<uint256, CTxIndex>& mapTxIndex);
 	bool UpdateTxIndex(uint256 hash, const CTxIndex& txindex);
 	bool AddTxIndex(const CTransaction& tx,
 	                const CDiskTxPos&   pos,
@@ -381,6 +393,20 @@ public:
 	bool ReadBestInvalidTrust(CBigNum& bnBestInvalidTrust);
 	bool WriteBestInvalidTrust(CBigNum bnBestInvalidTrust);
 	bool LoadBlockIndex(LoadMsg load_msg);
+
+	struct CBlockIndexScanTimes {
+		size_t  nEntries      = 0;
+		int     nThreads      = 0;
+		int64_t nReadMicros   = 0;  // copying values out of the database
+		int64_t nDecodeMicros = 0;  // waiting for decoders after reading
+		int64_t nHandleMicros = 0;  // in fnEntry
+	};
+	// Reads the blockindex entries in chunks, a chunk is decoded and hashed
+	// in place by worker threads while the next one is read. fnEntry gets
+	// the entries in key order on the calling thread, scanning stops when it
+	// returns false.
+	bool ScanBlockIndex(std::function<bool(CDiskBlockIndex&, const uint256&)> fnEntry,
+	                    CBlockIndexScanTimes*                                 pTimes = nullptr);
 	bool LoadUtxoData(LoadMsg load_msg);
 	bool CleanupUtxoData(LoadMsg load_msg);
 	bool CleanupPegBalances(LoadMsg load_msg);
@@ -404,64 +430,35 @@ public:
 	bool ReadUtxoDbIsReady(bool& bReady);
 	bool WriteUtxoDbIsReady(bool bReady);
 
-	bool ReadAddressLastBalance(string addr, CAddressBalance& balance, int64_t& nIdx);
+	// Moves address index records of txdb string keys to the address index db
+	bool MigrateAddrIndex(LoadMsg load_msg);
+
+	bool ReadAddressLastBalance(const CAddressKey& address,
+	                            CAddressBalance&   balance,
+	                            int64_t&           nIdx);
 	bool ReadFrozenQueue(uint64_t nLockTime, std::vector<CFrozenQueued>&);
 	bool ReadFrozenQueued(uint64_t nLockTime, uint320 txoutid, CFrozenQueued&);
 
-	bool AddUnspent(std::string sAddress, uint320 txoutid, const CAddressUnspent& utxo) {
-		string sTxout = txoutid.GetHex();
-		return Write("utxo" + sAddress + sTxout, utxo);
-	}
-	bool ReadUnspent(std::string sAddress, uint320 txoutid, CAddressUnspent& utxo) {
-		string sTxout = txoutid.GetHex();
-		return Read("utxo" + sAddress + sTxout, utxo);
-	}
-	bool EraseUnspent(std::string sAddress, uint320 txoutid) {
-		string sTxout = txoutid.GetHex();
-		return Erase("utxo" + sAddress + sTxout);
-	}
-	bool AddFrozen(std::string sAddress, uint320 txoutid, const CAddressUnspent& ftxo) {
-		string sTxout = txoutid.GetHex();
-		return Write("ftxo" + sAddress + sTxout, ftxo);
-	}
-	bool ReadFrozen(std::string sAddress, uint320 txoutid, CAddressUnspent& ftxo) {
-		string sTxout = txoutid.GetHex();
-		return Read("ftxo" + sAddress + sTxout, ftxo);
-	}
-	bool EraseFrozen(std::string sAddress, uint320 txoutid) {
-		string sTxout = txoutid.GetHex();
-		return Erase("ftxo" + sAddress + sTxout);
-	}
-	bool AddBalance(std::string sAddress, int64_t nIndex, const CAddressBalance& balance) {
-		string sRIndex = strprintf("%016x", INT64_MAX - nIndex);
-		return Write("addr" + sAddress + sRIndex, balance);
-	}
-	bool EraseBalance(std::string sAddress, int64_t nIndex) {
-		string sRIndex = strprintf("%016x", INT64_MAX - nIndex);
-		return Erase("addr" + sAddress + sRIndex);
-	}
-	bool AddToFrozenQueue(uint64_t nLockTime, uint320 txoutid, const CFrozenQueued& record) {
-		string sTime  = strprintf("%016x", nLockTime);
-		string sTxout = txoutid.GetHex();
-		return Write("fqueue" + sTime + sTxout, record);
-	}
-	bool EraseFromFrozenQueue(uint64_t nLockTime, uint320 txoutid) {
-		string sTime  = strprintf("%016x", nLockTime);
-		string sTxout = txoutid.GetHex();
-		return Erase("fqueue" + sTime + sTxout);
-	}
-	bool DeductSpent(std::string sAddress, const CFractions& fractions, bool peg_on);
-	bool AppendUnspent(std::string sAddress, const CFractions& fractions, bool peg_on);
-	bool ReadPegBalance(std::string sAddress, CFractions& fractions);
-
-	// warning: this method use disk Seek and ignores current batch
-	bool ReadAddressBalanceRecords(string addr, vector<CAddressBalance>& records);
-	// warning: this method use disk Seek and ignores current batch
-	bool ReadAddressUnspent(string addr, vector<CAddressUnspent>& records);
-	// warning: this method use disk Seek and ignores current batch
-	bool ReadAddressFrozen(string addr, vector<CAddressUnspent>& records);
+	bool AddUnspent(const CAddressKey& address, uint320 txoutid, const CAddressUnspent& utxo);
+	bool ReadUnspent(const CAddressKey& address, uint320 txoutid, CAddressUnspent& utxo);
+	bool EraseUnspent(const CAddressKey& address, uint320 txoutid);
+	bool AddFrozen(const CAddressKey& address, uint320 txoutid, const CAddressUnspent& ftxo);
+	bool ReadFrozen(const CAddressKey& address, uint320 txoutid, CAddressUnspent& ftxo);
+	bool EraseFrozen(const CAddressKey& address, uint320 txoutid);
+	bool AddBalance(const CAddressKey& address, int64_t nIndex, const CAddressBalance& balance);
+	bool EraseBalance(const CAddressKey& address, int64_t nIndex);
+	bool AddToFrozenQueue(uint64_t nLockTime, uint320 txoutid, const CFrozenQueued& record);
+	bool EraseFromFrozenQueue(uint64_t nLockTime, uint320 txoutid);
+	bool DeductSpent(const CAddressKey& address, const CFractions& fractions, bool peg_on);
+	bool AppendUnspent(const CAddressKey& address, const CFractions& fractions, bool peg_on);
+	bool ReadPegBalance(const CAddressKey& address, CFractions& fractions);
+
+	bool ReadAddressBalanceRecords(const CAddressKey& address, vector<CAddressBalance>& records);
+	bool ReadAddressUnspent(const CAddressKey& address, vector<CAddressUnspent>& records);
+	bool ReadAddressFrozen(const CAddressKey& address, vector<CAddressUnspent>& records);
 };
 
-extern leveldb::DB* txdb;  // global pointer for LevelDB object instance
+extern leveldb::DB* txdb;     // global pointer for LevelDB object instance
+extern leveldb::DB* addrdb;  // global pointer for the address index instance
 
 #endif  // BITCOIN_DB_H
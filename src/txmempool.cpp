@@ -4,12 +4,116 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "txmempool.h"
+#include "checkqueue.h"
 #include "core.h"
 #include "main.h"  // for CTransaction
+#include "pegcycle.h"
 #include "txdb.h"
+#include "util.h"
 
 using namespace std;
 
+// Tip state shared by the checks of one peg review
+struct CPegReviewContext {
+	CTxDB*                   ptxdb           = nullptr;
+	CPegDB*                  ppegdb          = nullptr;
+	const CBlockIndex*       pindex          = nullptr;
+	int                      nBridgePoolNout = 0;
+	uint32_t                 nVirtBlockTime  = 0;
+	CPegCycleStateRef        cycle;
+};
+
+struct CPegReviewResult {
+	bool                          fOk = false;
+	vector<pair<uint320, string>> vPackedFractions;
+};
+
+/** Peg check of one pool transaction against the new peg supply index. Its
+ *  pool parents are reviewed before, so lookups see their new fractions.
+ *  Returns true always, the outcome goes to the result slot.
+ */
+class CPegReviewCheck {
+private:
+	CTransaction*            ptx;
+	const CPegReviewContext* pcontext;
+	CPegReviewResult*        presult;
+
+public:
+	CPegReviewCheck() : ptx(nullptr), pcontext(nullptr), presult(nullptr) {}
+	CPegReviewCheck(CTransaction*            ptxIn,
+	                const CPegReviewContext* pcontextIn,
+	                CPegReviewResult*        presultIn)
+	    : ptx(ptxIn), pcontext(pcontextIn), presult(presultIn) {}
+
+	bool operator()();
+
+	void swap(CPegReviewCheck& check) {
+		std::swap(ptx, check.ptx);
+		std::swap(pcontext, check.pcontext);
+		std::swap(presult, check.presult);
+	}
+};
+
+static CCheckQueue<CPegReviewCheck> pegreviewqueue(16);
+
+void ThreadPegReviewCheck() {
+	RenameThread("bitbay-pegrevw");
+	pegreviewqueue.Thread();
+}
+
+bool CPegReviewCheck::operator()() {
+	CTransaction&            tx      = *ptx;
+	const CPegReviewContext& context = *pcontext;
+	const CBlockIndex*       pindex  = context.pindex;
+	CPegDB&                  pegdb   = *context.ppegdb;
+
+	MapPrevTx              mapInputs;
+	MapFractions           mapInputsFractions;
+	map<uint256, CTxIndex> mapUnused;
+	MapFractions           mapOutputsFractions;
+	CFractions             feesFractions;
+
+	auto fnMerkleIn = [&](string hash) { return context.cycle->MerkleIn(pegdb, hash); };
+
+	try {
+		bool fInvalid = false;
+		if (!tx.FetchInputs(*context.ptxdb, pegdb, context.nBridgePoolNout, false /*to read*/,
+		                    context.cycle->bridges, fnMerkleIn, mapUnused, mapOutputsFractions,
+		                    false /*is block*/, false /*is miner*/, context.nVirtBlockTime,
+		                    false /*skip pruned*/, mapInputs, mapInputsFractions, fInvalid)) {
+			if (fInvalid)
+				return true;
+		}
+
+		string sPegFailCause;
+		if (tx.IsCoinMint()) {
+			if (!CalculateCoinMintFractions(tx, pindex->nPegSupplyIndex, pindex->nTime,
+			                                context.cycle->bridges, fnMerkleIn,
+			                                context.nBridgePoolNout, mapInputs, mapInputsFractions,
+			                                mapOutputsFractions, feesFractions, sPegFailCause))
+				return true;
+		} else {
+			set<uint32_t> sTimeLockPassInputs;
+			if (!CalculateStandardFractions(tx, pindex->nPegSupplyIndex, pindex->nTime, mapInputs,
+			                                mapInputsFractions, sTimeLockPassInputs,
+			                                mapOutputsFractions, feesFractions, sPegFailCause))
+				return true;
+		}
+
+		// pack here, in parallel, the pool keeps only the changed ones
+		for (MapFractions::iterator mi = mapOutputsFractions.begin();
+		     mi != mapOutputsFractions.end(); ++mi) {
+			CDataStream fout(SER_DISK, CLIENT_VERSION);
+			(*mi).second.Pack(fout, nullptr, CFractions::SER_VDELTA);
+			presult->vPackedFractions.push_back(make_pair((*mi).first, fout.str()));
+		}
+		presult->fOk = true;
+	} catch (std::exception& e) {
+		LogPrintf("CPegReviewCheck() : %s %s\n", tx.GetHash().ToString(), e.what());
+	}
+	return true;
+}
+
 CTxMemPool::CTxMemPool() {}
 
 uint32_t CTxMemPool::GetTransactionsUpdated() const {
@@ -22,27 +126,34 @@ void CTxMemPool::AddTransactionsUpdated(uint32_t n) {
 	nTransactionsUpdated += n;
 }
 
-bool CTxMemPool::addUnchecked(const uint256&    hash,
-                              CTransaction&     tx,
-                              const MapPrevOut& mapInputs,
-                              MapFractions&     mapFractions) {
+bool CTxMemPool::addUnchecked(const uint256&         hash,
+                              CTransaction&          tx,
+                              const MapPrevOut&      mapInputs,
+                              MapFractions&          mapFractions,
+                              const CTxMemPoolEntry& entry) {
 	// Add to memory pool without checking anything.
 	// Used by main.cpp AcceptToMemoryPool(), which DOES do
 	// all the appropriate checks.
 	LOCK(cs);
 	{
 		mapTx[hash]       = tx;
+		mapTx[hash].CacheHash();
 		mapPrevOuts[hash] = mapInputs;
 		for (uint32_t i = 0; i < tx.vin.size(); i++) {
 			if (!tx.vin[i].prevout.IsNull() && tx.vin[i].prevout.hash != 0) {
 				mapNextTx[tx.vin[i].prevout] = CInPoint(&mapTx[hash], i);
 			}
 		}
+		addLinks(hash, tx);
+		mapEntries[hash] = entry;
+		updateAncestorState(hash);
+		if (mapPoolChildren.count(hash))
+			updateDescendantsState(mapPoolChildren[hash]);
 		nTransactionsUpdated++;
 		// store fractions
 		for (MapFractions::iterator mi = mapFractions.begin(); mi != mapFractions.end(); ++mi) {
 			CDataStream fout(SER_DISK, CLIENT_VERSION);
-			(*mi).second.Pack(fout);
+			(*mi).second.Pack(fout, nullptr, CFractions::SER_VDELTA);
 			mapPackedFractions[(*mi).first] = fout.str();
 		}
 		mapPrevOuts[hash] = mapInputs;
@@ -70,8 +181,20 @@ bool CTxMemPool::remove(const CTransaction& tx, bool fRecursive) {
 				auto fkey = uint320(hash, i);
 				mapPackedFractions.erase(fkey);
 			}
+			set<uint256> setChildren;
+			if (mapPoolChildren.count(hash))
+				setChildren = mapPoolChildren[hash];
+			map<uint256, CTxMemPoolEntry>::iterator ite = mapEntries.find(hash);
+			if (ite != mapEntries.end()) {
+				setByScore.erase(make_pair(ite->second.GetScore(), hash));
+				mapEntries.erase(ite);
+			}
+			removeLinks(hash);
 			mapTx.erase(hash);
 			mapPrevOuts.erase(hash);
+			// children left in pool lose an ancestor
+			if (!setChildren.empty())
+				updateDescendantsState(setChildren);
 			nTransactionsUpdated++;
 		}
 	}
@@ -92,122 +215,211 @@ bool CTxMemPool::removeConflicts(const CTransaction& tx) {
 	return true;
 }
 
-void CTxMemPool::reviewOnPegChange() {
-	LOCK(cs);
-	vector<uint256> vRemove;
-
-	// build reverse map in->out to find roots
-	map<CInPoint, COutPoint> mapPrevTx;
-	for (map<uint256, CTransaction>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi) {
-		CTransaction& tx   = (*mi).second;
-		uint256       hash = tx.GetHash();
-		for (uint32_t i = 0; i < tx.vout.size(); i++) {
-			std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, i));
-			if (it != mapNextTx.end()) {
-				mapPrevTx[it->second] = COutPoint(hash, i);
+void CTxMemPool::addLinks(const uint256& hash, const CTransaction& tx) {
+	for (const CTxIn& txin : tx.vin) {
+		if (txin.prevout.hash != hash && mapTx.count(txin.prevout.hash)) {
+			mapPoolParents[hash].insert(txin.prevout.hash);
+			mapPoolChildren[txin.prevout.hash].insert(hash);
+		}
+	}
+	// pool transactions may already spend it when it is back from a disconnected block
+	for (uint32_t i = 0; i < tx.vout.size(); i++) {
+		map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, i));
+		if (it != mapNextTx.end()) {
+			uint256 hashChild = it->second.ptx->GetHash();
+			if (hashChild != hash) {
+				mapPoolChildren[hash].insert(hashChild);
+				mapPoolParents[hashChild].insert(hash);
 			}
 		}
 	}
+}
 
-	// start peg checks from tx non-dependent on other tx
-	for (map<uint256, CTransaction>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi) {
-		CTransaction& tx         = (*mi).second;
-		bool          fDependent = false;
-		for (uint32_t i = 0; i < tx.vin.size(); i++) {
-			std::map<CInPoint, COutPoint>::iterator it = mapPrevTx.find(CInPoint(&tx, i));
-			if (it != mapPrevTx.end()) {
-				fDependent = true;
-			}
+void CTxMemPool::removeLinks(const uint256& hash) {
+	map<uint256, set<uint256>>::iterator it = mapPoolParents.find(hash);
+	if (it != mapPoolParents.end()) {
+		for (const uint256& hashParent : it->second) {
+			set<uint256>& children = mapPoolChildren[hashParent];
+			children.erase(hash);
+			if (children.empty())
+				mapPoolChildren.erase(hashParent);
 		}
-		if (!fDependent) {
-			reviewOnPegChange(tx, vRemove);
+		mapPoolParents.erase(it);
+	}
+	it = mapPoolChildren.find(hash);
+	if (it != mapPoolChildren.end()) {
+		for (const uint256& hashChild : it->second) {
+			set<uint256>& parents = mapPoolParents[hashChild];
+			parents.erase(hash);
+			if (parents.empty())
+				mapPoolParents.erase(hashChild);
 		}
+		mapPoolChildren.erase(it);
 	}
+}
 
-	// remove collected and all dependent
-	for (uint256 hash : vRemove) {
-		std::map<uint256, CTransaction>::const_iterator it = mapTx.find(hash);
-		if (it == mapTx.end())
+void CTxMemPool::queryAncestors(const uint256& hash, set<uint256>& setAncestors) const {
+	LOCK(cs);
+	vector<uint256> vStack(1, hash);
+	while (!vStack.empty()) {
+		uint256 hashTx = vStack.back();
+		vStack.pop_back();
+		map<uint256, set<uint256>>::const_iterator it = mapPoolParents.find(hashTx);
+		if (it == mapPoolParents.end())
 			continue;
-		const CTransaction& tx = (*it).second;
-		remove(tx, true /*recursive*/);
+		for (const uint256& hashParent : it->second) {
+			if (setAncestors.insert(hashParent).second)
+				vStack.push_back(hashParent);
+		}
 	}
 }
 
-void CTxMemPool::reviewOnPegChange(CTransaction& tx, vector<uint256>& vRemove) {
-	uint256 hash = tx.GetHash();
+void CTxMemPool::updateAncestorState(const uint256& hash) {
+	map<uint256, CTxMemPoolEntry>::iterator it = mapEntries.find(hash);
+	if (it == mapEntries.end())
+		return;
+	CTxMemPoolEntry& entry = it->second;
+	setByScore.erase(make_pair(entry.GetScore(), hash));
 
-	MapPrevTx              mapInputs;
-	MapFractions           mapInputsFractions;
-	map<uint256, CTxIndex> mapUnused;
-	MapFractions           mapOutputsFractions;
-	CFractions             feesFractions;
-	int                    nBridgePoolNout = pindexBest->nHeight;
-	int64_t                nVirtBlockTime  = GetAdjustedTime();
-
-	{
-		CTxDB  txdb("r");
-		CPegDB pegdb("r");
+	set<uint256> setAncestors;
+	queryAncestors(hash, setAncestors);
+	entry.nAncestors    = 1;
+	entry.nAncestorSize = entry.nTxSize;
+	entry.nAncestorFee  = entry.nFee;
+	for (const uint256& hashAncestor : setAncestors) {
+		map<uint256, CTxMemPoolEntry>::const_iterator ita = mapEntries.find(hashAncestor);
+		if (ita == mapEntries.end())
+			continue;
+		entry.nAncestors++;
+		entry.nAncestorSize += ita->second.nTxSize;
+		entry.nAncestorFee += ita->second.nFee;
+	}
+	setByScore.insert(make_pair(entry.GetScore(), hash));
+}
 
-		map<string, CBridgeInfo> bridges;
-		if (!pindexBest->ReadBridges(pegdb, bridges)) {
-			vRemove.push_back(hash);
-			return;
+void CTxMemPool::updateDescendantsState(const set<uint256>& setFrom) {
+	set<uint256>    setDescendants(setFrom);
+	vector<uint256> vStack(setFrom.begin(), setFrom.end());
+	while (!vStack.empty()) {
+		uint256 hashTx = vStack.back();
+		vStack.pop_back();
+		map<uint256, set<uint256>>::const_iterator it = mapPoolChildren.find(hashTx);
+		if (it == mapPoolChildren.end())
+			continue;
+		for (const uint256& hashChild : it->second) {
+			if (setDescendants.insert(hashChild).second)
+				vStack.push_back(hashChild);
 		}
-		auto fnMerkleIn = [&](string hash) { return pindexBest->ReadMerkleIn(pegdb, hash); };
+	}
+	for (const uint256& hashTx : setDescendants)
+		updateAncestorState(hashTx);
+}
 
-		bool fInvalid = false;
-		if (!tx.FetchInputs(txdb, pegdb, nBridgePoolNout, false /*to read*/, bridges, fnMerkleIn,
-							mapUnused, mapOutputsFractions, false /*is block*/, false /*is miner*/,
-							nVirtBlockTime, false /*skip pruned*/, mapInputs, mapInputsFractions,
-							fInvalid)) {
-			if (fInvalid) {
-				vRemove.push_back(hash);
-				return;
-			}
-		}
+// Peg checks go in waves over the dependency graph: the roots first, then
+// transactions whose pool parents all passed, so each is checked once. A
+// wave runs on the peg review queue with mempool unlocked, the pool is
+// locked to take the wave and to store its results.
+void CTxMemPool::reviewOnPegChange() {
+	vector<uint256> vRemove;
 
-		bool peg_ok = false;
+	CTxDB             txdb("r");
+	CPegDB            pegdb("r");
+	CPegReviewContext context;
+	context.ptxdb           = &txdb;
+	context.ppegdb          = &pegdb;
+	context.pindex          = pindexBest;
+	context.nBridgePoolNout = pindexBest->nHeight;
+	context.nVirtBlockTime  = GetAdjustedTime();
 
-		if (tx.IsCoinMint()) {
-			string sPegFailCause;
-			peg_ok = CalculateCoinMintFractions(tx, pindexBest->nPegSupplyIndex, pindexBest->nTime,
-												bridges, fnMerkleIn, nBridgePoolNout, mapInputs,
-			                                    mapInputsFractions, mapOutputsFractions,
-			                                    feesFractions, sPegFailCause);
-			if (!peg_ok) {
-				vRemove.push_back(hash);
-				return;
-			}
-		} else {
-			string        sPegFailCause;
-			set<uint32_t> sTimeLockPassInputs;
-			peg_ok = CalculateStandardFractions(tx, pindexBest->nPegSupplyIndex, pindexBest->nTime,
-			                                    mapInputs, mapInputsFractions, sTimeLockPassInputs,
-			                                    mapOutputsFractions, feesFractions, sPegFailCause);
-			if (!peg_ok) {
-				vRemove.push_back(hash);
-				return;
+	vector<uint256> vWave;
+	queryRoots(vWave);
+
+	context.cycle = GetPegCycleState(pegdb, context.pindex);
+	if (!context.cycle->fBridges) {
+		// no root can be checked
+		vRemove = vWave;
+		vWave.clear();
+	}
+
+	map<uint256, size_t> mapParentsLeft;
+	size_t               nReviewed = 0;
+	size_t               nRepacked = 0;
+	while (!vWave.empty()) {
+		vector<CTransaction> vTx;
+		{
+			LOCK(cs);
+			vTx.reserve(vWave.size());
+			for (const uint256& hash : vWave) {
+				map<uint256, CTransaction>::const_iterator it = mapTx.find(hash);
+				if (it != mapTx.end())
+					vTx.push_back(it->second);
 			}
 		}
 
-		if (peg_ok) {
-			// overwrite fractions (changed due to new peg supply index)
-			for (MapFractions::iterator mi = mapOutputsFractions.begin();
-			     mi != mapOutputsFractions.end(); ++mi) {
-				CDataStream fout(SER_DISK, CLIENT_VERSION);
-				(*mi).second.Pack(fout);
-				mapPackedFractions[(*mi).first] = fout.str();
+		vector<CPegReviewResult> vResults(vTx.size());
+		{
+			vector<CPegReviewCheck> vChecks;
+			for (size_t i = 0; i < vTx.size(); i++)
+				vChecks.push_back(CPegReviewCheck(&vTx[i], &context, &vResults[i]));
+			if (nScriptCheckThreads && vChecks.size() > 1) {
+				CCheckQueueControl<CPegReviewCheck> control(&pegreviewqueue);
+				control.Add(vChecks);
+				control.Wait();
+			} else {
+				for (CPegReviewCheck& check : vChecks)
+					check();
 			}
-			// check dependent transactions
-			for (uint32_t i = 0; i < tx.vout.size(); i++) {
-				map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, i));
-				if (it != mapNextTx.end()) {
-					reviewOnPegChange(*it->second.ptx, vRemove);
+		}
+		nReviewed += vTx.size();
+
+		vector<uint256> vNext;
+		{
+			LOCK(cs);
+			for (size_t i = 0; i < vTx.size(); i++) {
+				uint256 hash = vTx[i].GetHash();
+				if (!mapTx.count(hash))
+					continue;
+				if (!vResults[i].fOk) {
+					vRemove.push_back(hash);
+					continue;
+				}
+				// overwrite fractions changed due to new peg supply index
+				for (auto& packed : vResults[i].vPackedFractions) {
+					string& strStored = mapPackedFractions[packed.first];
+					if (strStored != packed.second) {
+						strStored.swap(packed.second);
+						nRepacked++;
+					}
+				}
+				// children are checked once all their pool parents passed
+				map<uint256, set<uint256>>::const_iterator it = mapPoolChildren.find(hash);
+				if (it == mapPoolChildren.end())
+					continue;
+				for (const uint256& hashChild : it->second) {
+					auto itLeft = mapParentsLeft.find(hashChild);
+					if (itLeft == mapParentsLeft.end())
+						itLeft = mapParentsLeft
+						             .insert(make_pair(hashChild, mapPoolParents[hashChild].size()))
+						             .first;
+					if (--itLeft->second == 0)
+						vNext.push_back(hashChild);
 				}
 			}
 		}
+		vWave.swap(vNext);
+	}
+
+	// remove collected and all dependent
+	LOCK(cs);
+	for (uint256 hash : vRemove) {
+		std::map<uint256, CTransaction>::const_iterator it = mapTx.find(hash);
+		if (it == mapTx.end())
+			continue;
+		const CTransaction& tx = (*it).second;
+		remove(tx, true /*recursive*/);
 	}
+	LogPrint("mempool", "reviewOnPegChange : %u reviewed, %u fractions repacked, %u removed\n",
+	         nReviewed, nRepacked, vRemove.size());
 }
 
 void CTxMemPool::clear() {
@@ -215,6 +427,10 @@ void CTxMemPool::clear() {
 	mapTx.clear();
 	mapPrevOuts.clear();
 	mapNextTx.clear();
+	mapPoolParents.clear();
+	mapPoolChildren.clear();
+	mapEntries.clear();
+	setByScore.clear();
 	++nTransactionsUpdated;
 }
 
@@ -227,6 +443,15 @@ void CTxMemPool::queryHashes(std::vector<uint256>& vtxid) {
 		vtxid.push_back((*mi).first);
 }
 
+void CTxMemPool::queryRoots(std::vector<uint256>& vtxid) {
+	vtxid.clear();
+
+	LOCK(cs);
+	for (map<uint256, CTransaction>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
+		if (!mapPoolParents.count((*mi).first))
+			vtxid.push_back((*mi).first);
+}
+
 bool CTxMemPool::lookup(uint256 hash, CTransaction& result, MapFractions& mapFractions) const {
 	LOCK(cs);
 	std::map<uint256, CTransaction>::const_iterator it = mapTx.find(hash);
@@ -9,6 +9,45 @@
 #include "peg.h"
 #include "sync.h"
 
+/** Mining data of a pool transaction, taken when it is accepted so that
+ *  block assembly needs no input reads. Inputs from the chain are summed
+ *  for the priority, the ancestor package (the transaction with all its
+ *  unconfirmed ancestors) is kept by the pool.
+ */
+class CTxMemPoolEntry {
+public:
+	uint32_t nTxSize         = 0;
+	int64_t  nFee            = 0;
+	int64_t  nChainValueIn   = 0;
+	double   dChainValueAges = 0;  // sum of value * height of chain inputs
+
+	int      nAncestors    = 1;  // counts the transaction itself
+	uint64_t nAncestorSize = 0;
+	int64_t  nAncestorFee  = 0;
+
+	CTxMemPoolEntry() {}
+	CTxMemPoolEntry(int64_t nFeeIn, uint32_t nTxSizeIn)
+	    : nTxSize(nTxSizeIn), nFee(nFeeIn), nAncestorSize(nTxSizeIn), nAncestorFee(nFeeIn) {}
+
+	// An input confirmed at nHeight, it has depth 1 at the tip of nHeight
+	void AddChainInput(int64_t nValue, int64_t nHeight) {
+		nChainValueIn += nValue;
+		dChainValueAges += double(nValue) * nHeight;
+	}
+
+	// sum(valuein * depth) / txsize with the tip at nTipHeight
+	double GetPriority(int nTipHeight) const {
+		return (double(nChainValueIn) * (nTipHeight + 1) - dChainValueAges) / nTxSize;
+	}
+	double GetFeePerKb() const { return double(nFee) / (double(nTxSize) / 1000.0); }
+	double GetAncestorFeePerKb() const {
+		return double(nAncestorFee) / (double(nAncestorSize) / 1000.0);
+	}
+	// Lower of own and ancestor package fee rates: a child paying for its
+	// parents lifts the package, a cheap child of a rich parent is not lifted
+	double GetScore() const { return std::min(GetFeePerKb(), GetAncestorFeePerKb()); }
+};
+
 /*
  * CTxMemPool stores valid-according-to-the-current-best-chain
  * transactions that may be included in the next block.
@@ -23,6 +62,11 @@ class CTxMemPool {
 private:
 	uint32_t nTransactionsUpdated;
 
+	void addLinks(const uint256& hash, const CTransaction& tx);
+	void removeLinks(const uint256& hash);
+	void updateAncestorState(const uint256& hash);
+	void updateDescendantsState(const std::set<uint256>& setFrom);
+
 public:
 	mutable CCriticalSection        cs;
 	std::map<uint256, CTransaction> mapTx;
@@ -30,18 +74,37 @@ public:
 	std::map<COutPoint, CInPoint>   mapNextTx;
 	std::map<uint320, std::string>  mapPackedFractions;  // #NOTE3
 
+	// Pool transactions spent by and spending each pool transaction, kept on
+	// add and remove. Transactions without pool parents are the roots.
+	std::map<uint256, std::set<uint256>> mapPoolParents;
+	std::map<uint256, std::set<uint256>> mapPoolChildren;
+
+	// Entries ordered by score, the best first, for block assembly
+	struct CompareByScore {
+		bool operator()(const std::pair<double, uint256>& a,
+		                const std::pair<double, uint256>& b) const {
+			if (a.first != b.first)
+				return a.first > b.first;
+			return a.second < b.second;
+		}
+	};
+	std::map<uint256, CTxMemPoolEntry>                   mapEntries;
+	std::set<std::pair<double, uint256>, CompareByScore> setByScore;
+
 	CTxMemPool();
 
-	bool     addUnchecked(const uint256&    hash,
-	                      CTransaction&     tx,
-	                      const MapPrevOut& mapPrevOuts,
-	                      MapFractions&     mapOutputsFractions);
+	bool     addUnchecked(const uint256&         hash,
+	                      CTransaction&          tx,
+	                      const MapPrevOut&      mapPrevOuts,
+	                      MapFractions&          mapOutputsFractions,
+	                      const CTxMemPoolEntry& entry);
 	bool     remove(const CTransaction& tx, bool fRecursive = false);
 	bool     removeConflicts(const CTransaction& tx);
 	void     reviewOnPegChange();
-	void     reviewOnPegChange(CTransaction&, std::vector<uint256>& vRemove);
 	void     clear();
 	void     queryHashes(std::vector<uint256>& vtxid);
+	void     queryRoots(std::vector<uint256>& vtxid);
+	void     queryAncestors(const uint256& hash, std::set<uint256>& setAncestors) const;
 	uint32_t GetTransactionsUpdated() const;
 	void     AddTransactionsUpdated(uint32_t n);
 
@@ -59,4 +122,7 @@ public:
 	bool lookup(uint256 hash, size_t n, CFractions&) const;
 };
 
+/** Worker of the peg review queue, -par threads run it */
+void ThreadPegReviewCheck();
+
 #endif /* BITCOIN_TXMEMPOOL_H */
@@ -150,6 +150,7 @@ void                    FileCommit(FILE* fileout);
 bool                    RenameOver(boost::filesystem::path src, boost::filesystem::path dest);
 boost::filesystem::path GetDefaultDataDir();
 const boost::filesystem::path& GetDataDir(bool fNetSpecific = true);
+void                           ClearDatadirCache();
 boost::filesystem::path        GetConfigFile();
 boost::filesystem::path        GetPidFile();
 #ifndef WIN32
@@ -6,6 +6,7 @@
 
 #include "miner.h"
 #include "kernel.h"
+#include "pegcycle.h"
 #include "txdb.h"
 
 using namespace std;
@@ -51,26 +52,17 @@ void SHA256Transform(void* pstate, void* pinput, const void* pinit) {
 		((uint32_t*)pstate)[i] = ctx.h[i];
 }
 
-// Some explaining would be appreciated
-class COrphan {
-public:
-	CTransaction* ptx;
-	set<uint256>  setDependsOn;
-	double        dPriority;
-	double        dFeePerKb;
-
-	COrphan(CTransaction* ptxIn) {
-		ptx       = ptxIn;
-		dPriority = dFeePerKb = 0;
-	}
-};
-
 uint64_t nLastBlockTx                 = 0;
 uint64_t nLastBlockSize               = 0;
 int64_t  nLastCoinStakeSearchInterval = 0;
+uint64_t nStakeTemplateRebuilds       = 0;
+uint64_t nStakeTemplateReuses         = 0;
+
+// Seconds a staking template is reused at most, time locks may expire meanwhile
+static const int64_t STAKE_TEMPLATE_MAX_AGE = 60;
 
 // We want to sort transactions by priority and fee, so:
-typedef boost::tuple<double, double, CTransaction*> TxPriority;
+typedef boost::tuple<double, double, const uint256*> TxPriority;
 class TxPriorityCompare {
 	bool byFee;
 
@@ -155,125 +147,52 @@ unique_ptr<CBlock> CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, i
 		CTxDB  txdb("r");
 		CPegDB pegdb("r");
 
-		// Priority order to process transactions
-		list<COrphan>                   vOrphan;  // list memory doesn't move
-		map<uint256, vector<COrphan*> > mapDependers;
-
-		// This vector will be sorted into a priority queue:
-		vector<TxPriority> vecPriority;
-		vecPriority.reserve(mempool.mapTx.size() + 1);
-		for (map<uint256, CTransaction>::iterator mi = mempool.mapTx.begin();
-		     mi != mempool.mapTx.end(); ++mi) {
-			CTransaction& tx = (*mi).second;
-			if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
-				continue;
-
-			COrphan* porphan        = NULL;
-			double   dPriority      = 0;
-			int64_t  nTotalIn       = 0;
-			bool     fMissingInputs = false;
-			for (const CTxIn& txin : tx.vin) {
-				int     nConf    = 0;
-				int64_t nValueIn = 0;
-				if (tx.IsCoinMint()) {
-					nConf = pindexBest->nHeight -
-					        tx.nTime /*for CoinMint nTime is set as merkle height +1*/;
-					if (txin.prevout.hash != 0) {
-						nValueIn = tx.vout[0].nValue + MINT_TX_FEE;
-					}
-
-				} else {
-					// Read prev transaction
-					CTransaction txPrev;
-					CTxIndex     txindex;
-					if (!txPrev.ReadFromDisk(txdb, txin.prevout, txindex)) {
-						// This should never happen; all transactions in the memory
-						// pool should connect to either transactions in the chain
-						// or other transactions in the memory pool.
-						if (!mempool.mapTx.count(txin.prevout.hash)) {
-							LogPrintf("ERROR: mempool transaction missing input\n");
-							if (fDebug)
-								assert("mempool transaction missing input" == 0);
-							fMissingInputs = true;
-							if (porphan)
-								vOrphan.pop_back();
-							break;
-						}
-
-						// Has to wait for dependencies
-						if (!porphan) {
-							// Use list for automatic deletion
-							vOrphan.push_back(COrphan(&tx));
-							porphan = &vOrphan.back();
-						}
-						mapDependers[txin.prevout.hash].push_back(porphan);
-						porphan->setDependsOn.insert(txin.prevout.hash);
-						nTotalIn += mempool.mapTx[txin.prevout.hash].vout[txin.prevout.n].nValue;
-						continue;
-					}
-					nConf    = txindex.GetDepthInMainChain();
-					nValueIn = txPrev.vout[txin.prevout.n].nValue;
-				}
-
-				nTotalIn += nValueIn;
-				dPriority += (double)nValueIn * nConf;
-			}
-			if (fMissingInputs)
-				continue;
-
-			// Priority is sum(valuein * age) / txsize
-			uint32_t nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-			dPriority /= nTxSize;
-
-			// This is a more accurate fee-per-kilobyte than is used by the client code, because the
-			// client code rounds up the size to the nearest 1K. That's good, because it gives an
-			// incentive to create smaller transactions.
-			double dFeePerKb = double(nTotalIn - tx.GetValueOut()) / (double(nTxSize) / 1000.0);
-
-			if (porphan) {
-				porphan->dPriority = dPriority;
-				porphan->dFeePerKb = dFeePerKb;
-			} else
-				vecPriority.push_back(TxPriority(dPriority, dFeePerKb, &(*mi).second));
-		}
-
-		// Collect transactions into block
 		map<uint256, CTxIndex> mapTestPool;
 		MapFractions           mapTestFractionsPool;
 		CFractions             feesFractions;
 		uint64_t               nBlockSize      = 1000;
 		uint64_t               nBlockTx        = 0;
 		int                    nBlockSigOps    = 100;
-		bool                   fSortedByFee    = (nBlockPrioritySize <= 0);
 		int64_t                nBlockDraftTime = GetAdjustedTime();
 
-		map<string, CBridgeInfo> bridges;
-		pindexBest->ReadBridges(pegdb, bridges);
-		auto        fnMerkleIn = [&](string hash) { return pindexBest->ReadMerkleIn(pegdb, hash); };
-		set<string> timelockpasses;
-		pindexBest->ReadTimeLockPasses(pegdb, timelockpasses);
-
-		TxPriorityCompare comparer(fSortedByFee);
-		std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-		while (!vecPriority.empty()) {
-			// Take highest priority transaction off the priority queue:
-			double        dPriority = vecPriority.front().get<0>();
-			double        dFeePerKb = vecPriority.front().get<1>();
-			CTransaction& tx        = *(vecPriority.front().get<2>());
+		CPegCycleStateRef               cycle          = GetPegCycleState(pegdb, pindexBest);
+		const map<string, CBridgeInfo>& bridges        = cycle->bridges;
+		const set<string>&              timelockpasses = cycle->timelockpasses;
+
+		auto fnMerkleIn = [&](string hash) { return cycle->MerkleIn(pegdb, hash); };
+
+		// Pool transactions taken into the block or dropped; a dropped one
+		// is not tried again, nor are its descendants
+		set<uint256> setIncluded;
+		set<uint256> setDropped;
+
+		// Pool parents of hash are all in the block
+		auto fnParentsIncluded = [&](const uint256& hash) {
+			auto it = mempool.mapPoolParents.find(hash);
+			if (it == mempool.mapPoolParents.end())
+				return true;
+			for (const uint256& hashParent : it->second) {
+				if (!setIncluded.count(hashParent))
+					return false;
+			}
+			return true;
+		};
 
-			std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-			vecPriority.pop_back();
+		auto fnAddTx = [&](const uint256& hash, const CTxMemPoolEntry& entry, double dPriority,
+		                   bool fSortedByFee) {
+			CTransaction& tx = mempool.mapTx[hash];
+			if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
+				return false;
 
 			// Size limits
-			uint32_t nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+			uint32_t nTxSize = entry.nTxSize;
 			if (nBlockSize + nTxSize >= nBlockMaxSize)
-				continue;
+				return false;
 
 			// Legacy limits on sigOps:
 			uint32_t nTxSigOps = GetLegacySigOpCount(tx);
 			if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-				continue;
+				return false;
 
 			tx.nTimeFetched = tx.nTime;
 			if (tx.nTimeFetched == 0)
@@ -281,23 +200,15 @@ unique_ptr<CBlock> CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, i
 
 			// Timestamp limit
 			if (tx.nTime > nBlockDraftTime || (fProofOfStake && tx.nTime > pblock->vtx[0].nTime))
-				continue;
+				return false;
 
 			// Transaction fee
 			int64_t nMinFee = GetMinFee(tx, nHeight, nBlockSize, GMF_BLOCK);
 
 			// Skip free transactions if we're past the minimum block size:
-			if (fSortedByFee && (dFeePerKb < nMinTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-				continue;
-
-			// Prioritize by fee once past the priority size or we run out of high-priority
-			// transactions:
-			if (!fSortedByFee &&
-			    ((nBlockSize + nTxSize >= nBlockPrioritySize) || (dPriority < COIN * 144 / 250))) {
-				fSortedByFee = true;
-				comparer     = TxPriorityCompare(fSortedByFee);
-				std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-			}
+			if (fSortedByFee && (entry.GetScore() < nMinTxFee) &&
+			    (nBlockSize + nTxSize >= nBlockMinSize))
+				return false;
 
 			// Connecting shouldn't fail due to dependency on other memory pool transactions
 			// because we're already processing them in order of dependency
@@ -313,15 +224,15 @@ unique_ptr<CBlock> CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, i
 								fnMerkleIn, mapTestPoolTmp, mapTestFractionsPoolTmp,
 			                    false /*is block*/, true /*is miner*/, nBlockDraftTime,
 			                    false /*skip pruned*/, mapInputs, mapInputsFractions, fInvalid))
-				continue;
+				return false;
 
 			int64_t nTxFees = tx.GetValueIn(mapInputs) - tx.GetValueOut();
 			if (nTxFees < nMinFee)
-				continue;
+				return false;
 
 			nTxSigOps += GetP2SHSigOpCount(tx, mapInputs);
 			if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-				continue;
+				return false;
 
 			// Note that flags: we don't want to set mempool/IsStandard()
 			// policy here, but we still have to ensure that the block we
@@ -331,10 +242,9 @@ unique_ptr<CBlock> CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, i
 			                      timelockpasses, feesFractions, CDiskTxPos(1, 1, 1), pindexPrev,
 			                      false /*is ConnectBlock*/, true /*is CreateNewBlock*/,
 			                      MANDATORY_SCRIPT_VERIFY_FLAGS))
-				continue;
-			mapTestPoolTmp[tx.GetHash()] =
-			    CTxIndex(CDiskTxPos(1, 1, 1), tx.vout.size(), 0 /*nHeight*/,
-			             nBlockTx + 2 /*coinbase+coinstake*/);
+				return false;
+			mapTestPoolTmp[hash] = CTxIndex(CDiskTxPos(1, 1, 1), tx.vout.size(), 0 /*nHeight*/,
+			                                nBlockTx + 2 /*coinbase+coinstake*/);
 			swap(mapTestPool, mapTestPoolTmp);
 
 			// Added
@@ -343,24 +253,99 @@ unique_ptr<CBlock> CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, i
 			++nBlockTx;
 			nBlockSigOps += nTxSigOps;
 			nFees += nTxFees;
+			setIncluded.insert(hash);
 
 			if (fDebug && GetBoolArg("-printpriority", false)) {
-				LogPrintf("priority %.1f feeperkb %.1f txid %s\n", dPriority, dFeePerKb,
-				          tx.GetHash().ToString());
+				LogPrintf("priority %.1f feeperkb %.1f txid %s\n", dPriority, entry.GetScore(),
+				          hash.ToString());
+			}
+			return true;
+		};
+
+		// High priority transactions first, regardless of the fees they pay.
+		// Priority comes from the inputs cached in the pool entries.
+		if (nBlockPrioritySize > 0) {
+			TxPriorityCompare  comparer(false /*by fee*/);
+			vector<TxPriority> vecPriority;
+			for (const auto& item : mempool.mapEntries) {
+				if (mempool.mapPoolParents.count(item.first))
+					continue;  // has to wait for dependencies
+				vecPriority.push_back(TxPriority(item.second.GetPriority(pindexPrev->nHeight),
+				                                 item.second.GetScore(), &item.first));
+			}
+			std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+
+			while (!vecPriority.empty()) {
+				double         dPriority = vecPriority.front().get<0>();
+				const uint256& hash      = *vecPriority.front().get<2>();
+				std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
+				vecPriority.pop_back();
+
+				// Fees decide once past the priority size or out of high-priority
+				// transactions, the rest is taken by score
+				const CTxMemPoolEntry& entry = mempool.mapEntries[hash];
+				if ((nBlockSize + entry.nTxSize >= nBlockPrioritySize) ||
+				    (dPriority < COIN * 144 / 250))
+					break;
+
+				if (!fnAddTx(hash, entry, dPriority, false /*by fee*/)) {
+					setDropped.insert(hash);
+					continue;
+				}
+
+				// Add transactions that depend on this one to the priority queue
+				auto it = mempool.mapPoolChildren.find(hash);
+				if (it == mempool.mapPoolChildren.end())
+					continue;
+				for (const uint256& hashChild : it->second) {
+					if (!fnParentsIncluded(hashChild))
+						continue;
+					const CTxMemPoolEntry& entryChild = mempool.mapEntries[hashChild];
+					vecPriority.push_back(TxPriority(entryChild.GetPriority(pindexPrev->nHeight),
+					                                 entryChild.GetScore(),
+					                                 &mempool.mapEntries.find(hashChild)->first));
+					std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
+				}
 			}
+		}
 
-			// Add transactions that depend on this one to the priority queue
-			uint256 hash = tx.GetHash();
-			if (mapDependers.count(hash)) {
-				for (COrphan* porphan : mapDependers[hash]) {
-					if (!porphan->setDependsOn.empty()) {
-						porphan->setDependsOn.erase(hash);
-						if (porphan->setDependsOn.empty()) {
-							vecPriority.push_back(
-							    TxPriority(porphan->dPriority, porphan->dFeePerKb, porphan->ptx));
-							std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-						}
-					}
+		// Then by score, each transaction with its ancestors not in the block
+		// yet, the ancestors first. Scores are not lowered for ancestors taken
+		// meanwhile, every transaction is still checked on its own.
+		for (const auto& item : mempool.setByScore) {
+			const uint256& hash = item.second;
+			if (setIncluded.count(hash) || setDropped.count(hash))
+				continue;
+
+			set<uint256> setAncestors;
+			mempool.queryAncestors(hash, setAncestors);
+			vector<pair<int, uint256>> vPackage;
+			bool                       fDropped = false;
+			for (const uint256& hashAncestor : setAncestors) {
+				if (setIncluded.count(hashAncestor))
+					continue;
+				if (setDropped.count(hashAncestor)) {
+					fDropped = true;
+					break;
+				}
+				// fewer ancestors go first, parents always have fewer
+				vPackage.push_back(
+				    make_pair(mempool.mapEntries[hashAncestor].nAncestors, hashAncestor));
+			}
+			if (fDropped) {
+				setDropped.insert(hash);
+				continue;
+			}
+			sort(vPackage.begin(), vPackage.end());
+			vPackage.push_back(make_pair(0, hash));
+
+			for (const auto& member : vPackage) {
+				const CTxMemPoolEntry& entry = mempool.mapEntries[member.second];
+				if (!fnAddTx(member.second, entry, entry.GetPriority(pindexPrev->nHeight),
+				             true /*by fee*/)) {
+					setDropped.insert(member.second);
+					setDropped.insert(hash);
+					break;
 				}
 			}
 		}
@@ -536,6 +521,13 @@ void ThreadStakeMiner(CWallet* pwallet) {
 
 	bool fTryToSync = true;
 
+	// Last assembled block, the kernel search takes a copy of it while
+	// neither the tip nor the memory pool changed
+	unique_ptr<CBlock> ptemplate;
+	int64_t            nTemplateFees      = 0;
+	uint32_t           nTemplateTxUpdated = 0;
+	int64_t            nTemplateTime      = 0;
+
 	while (true) {
 		while (pwallet->IsLocked()) {
 			nLastCoinStakeSearchInterval = 0;
@@ -565,9 +557,23 @@ void ThreadStakeMiner(CWallet* pwallet) {
 		// Create new block
 		//
 		int64_t            nFees;
-		unique_ptr<CBlock> pblock(CreateNewBlock(reservekey, true, &nFees));
-		if (!pblock.get())
-			return;
+		unique_ptr<CBlock> pblock;
+		uint32_t           nTxUpdated = mempool.GetTransactionsUpdated();
+		if (ptemplate && ptemplate->hashPrevBlock == hashBestChain &&
+		    nTxUpdated == nTemplateTxUpdated && GetTime() - nTemplateTime < STAKE_TEMPLATE_MAX_AGE) {
+			pblock.reset(new CBlock(*ptemplate));
+			nFees = nTemplateFees;
+			nStakeTemplateReuses++;
+		} else {
+			pblock = CreateNewBlock(reservekey, true, &nFees);
+			if (!pblock.get())
+				return;
+			ptemplate.reset(new CBlock(*pblock));
+			nTemplateFees      = nFees;
+			nTemplateTxUpdated = nTxUpdated;
+			nTemplateTime      = GetTime();
+			nStakeTemplateRebuilds++;
+		}
 
 		// Trying to sign a block
 		if (pblock->SignBlock(*pwallet, nFees)) {
@@ -160,6 +160,8 @@ Value getstakinginfo(const Array& params, bool fHelp) {
 	obj.push_back(Pair("netstakeweight", (uint64_t)nNetworkWeight));
 
 	obj.push_back(Pair("expectedtime", nExpectedTime));
+	obj.push_back(Pair("templaterebuilds", nStakeTemplateRebuilds));
+	obj.push_back(Pair("templatereuses", nStakeTemplateReuses));
 
 	return obj;
 }
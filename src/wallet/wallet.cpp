@@ -9,12 +9,15 @@
 #include "coincontrol.h"
 #include "kernel.h"
 #include "net.h"
+#include "pegcycle.h"
 #include "proposals.h"
 #include "timedata.h"
 #include "txdb.h"
 #include "ui_interface.h"
 #include "walletdb.h"
 
+#include <atomic>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -255,9 +258,9 @@ void CWallet::SetBestChain(const CBlockLocator& loc) {
 		LOCK(cs_main);
 		CBlockIndex* pblockindex = mapBlockIndex.ref(hashBestChain);
 		if (pblockindex && pblockindex->nPegSupplyIndex != nLastPegSupplyIndexToRecalc) {
+			// the balance totals follow the supply index on the next query
 			nLastPegSupplyIndexToRecalc = pblockindex->nPegSupplyIndex;
 			nLastBlockTime              = pblockindex->nTime;
-			MarkDirty();
 		}
 	}
 }
@@ -457,6 +460,7 @@ void CWallet::WalletUpdateSpent(const CTransaction& tx, bool fBlock) {
 void CWallet::MarkDirty() {
 	{
 		LOCK(cs_wallet);
+		balances.SetDirty();
 		for (std::pair<const uint256, CWalletTx>& item : mapWallet) {
 			item.second.MarkDirty();
 		}
@@ -524,6 +528,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn) {
 			if (wtxIn.hashBlock != 0 && wtxIn.hashBlock != wtx.hashBlock) {
 				wtx.hashBlock = wtxIn.hashBlock;
 				fUpdated      = true;
+				EraseStakeCandidates(hash);
 			}
 			if (wtxIn.nIndex != -1 &&
 			    (wtxIn.vMerkleBranch != wtx.vMerkleBranch || wtxIn.nIndex != wtx.nIndex)) {
@@ -621,7 +626,7 @@ void CWallet::CleanFractionsOfSpentTxouts(const CBlock* pBlockRef) {
 		return;
 	uint256 hashBlock = pBlockRef->GetHash();
 	LOCK(cs_main);
-	unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+	CBlockIndexMap::iterator mi = mapBlockIndex.find(hashBlock);
 	if (mi == mapBlockIndex.end())
 		return;
 	CBlockIndex* pblockindex = (*mi).second;
@@ -686,6 +691,8 @@ void CWallet::EraseFromWallet(const uint256& hash) {
 		LOCK(cs_wallet);
 		if (mapWallet.erase(hash))
 			CWalletDB(strWalletFile).EraseTx(hash);
+		EraseStakeCandidates(hash);
+		balances.SetDirty(hash);
 	}
 	return;
 }
@@ -769,123 +776,6 @@ int CWallet::GetPegSupplyNNIndex() const {
 	return nLastPegSupplyNNIndex;
 }
 
-int64_t CWallet::GetFrozen(uint256                       txhash,
-                           long                          n,
-                           const CTxOut&                 txout,
-                           std::vector<CFrozenCoinInfo>* pFrozenCoins) const {
-	if (!MoneyRange(txout.nValue))
-		throw std::runtime_error("CWallet::GetReserve() : value out of range");
-	if (!IsMine(txout))
-		return 0;
-
-	{
-		LOCK(cs_wallet);
-		if (nLastHashBestChain != hashBestChain) {
-			LOCK(cs_main);
-			nLastPegCycle       = pindexBest->nHeight / Params().PegInterval();
-			nLastPegSupplyIndex = pindexBest->nPegSupplyIndex;
-			nLastBlockTime      = pindexBest->nTime;
-			nLastHashBestChain  = hashBestChain;
-		}
-		map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txhash);
-		if (mi != mapWallet.end()) {
-			const CWalletTx& wtx = (*mi).second;
-			if (0 <= n && size_t(n) < wtx.vOutFractions.size()) {
-				bool fF = wtx.vOutFractions[n].nFlags() & CFractions::NOTARY_F;
-				bool fV = wtx.vOutFractions[n].nFlags() & CFractions::NOTARY_V;
-				fF &= wtx.vOutFractions[n].nLockTime() >= nLastBlockTime;
-				fV &= wtx.vOutFractions[n].nLockTime() >= nLastBlockTime;
-				if (fF || fV) {
-					if (pFrozenCoins) {
-						CFrozenCoinInfo fcoin;
-						fcoin.txhash    = wtx.GetHash();
-						fcoin.n         = n;
-						fcoin.nValue    = wtx.vout[n].nValue;
-						fcoin.nFlags    = wtx.vOutFractions[n].nFlags();
-						fcoin.nLockTime = wtx.vOutFractions[n].nLockTime();
-						pFrozenCoins->push_back(fcoin);
-					}
-					return wtx.vout[n].nValue;
-				}
-			}
-		}
-	}
-
-	return 0;
-}
-
-int64_t CWallet::GetReserve(uint256 txhash, long n, const CTxOut& txout) const {
-	if (!MoneyRange(txout.nValue))
-		throw std::runtime_error("CWallet::GetReserve() : value out of range");
-	if (!IsMine(txout))
-		return 0;
-
-	{
-		LOCK(cs_wallet);
-		if (nLastHashBestChain != hashBestChain) {
-			LOCK(cs_main);
-			nLastPegCycle       = pindexBest->nHeight / Params().PegInterval();
-			nLastPegSupplyIndex = pindexBest->nPegSupplyIndex;
-			nLastBlockTime      = pindexBest->nTime;
-			nLastHashBestChain  = hashBestChain;
-		}
-		map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txhash);
-		if (mi != mapWallet.end()) {
-			const CWalletTx& wtx = (*mi).second;
-			if (0 <= n && size_t(n) < wtx.vOutFractions.size()) {
-				bool fF = wtx.vOutFractions[n].nFlags() & CFractions::NOTARY_F;
-				bool fV = wtx.vOutFractions[n].nFlags() & CFractions::NOTARY_V;
-				fF &= wtx.vOutFractions[n].nLockTime() >= nLastBlockTime;
-				fV &= wtx.vOutFractions[n].nLockTime() >= nLastBlockTime;
-				if (fF || fV)
-					return 0;
-
-				int64_t nReserve = 0;
-				wtx.vOutFractions[n].Ref().LowPart(nLastPegSupplyIndex, &nReserve);
-				return nReserve;
-			}
-		}
-	}
-
-	return 0;
-}
-
-int64_t CWallet::GetLiquidity(uint256 txhash, long n, const CTxOut& txout) const {
-	if (!MoneyRange(txout.nValue))
-		throw std::runtime_error("CWallet::GetLiquidity() : value out of range");
-	if (!IsMine(txout))
-		return 0;
-
-	{
-		LOCK(cs_wallet);
-		if (nLastHashBestChain != hashBestChain) {
-			LOCK(cs_main);
-			nLastPegCycle       = pindexBest->nHeight / Params().PegInterval();
-			nLastPegSupplyIndex = pindexBest->nPegSupplyIndex;
-			nLastBlockTime      = pindexBest->nTime;
-			nLastHashBestChain  = hashBestChain;
-		}
-		map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txhash);
-		if (mi != mapWallet.end()) {
-			const CWalletTx& wtx = (*mi).second;
-			if (0 <= n && size_t(n) < wtx.vOutFractions.size()) {
-				bool fF = wtx.vOutFractions[n].nFlags() & CFractions::NOTARY_F;
-				bool fV = wtx.vOutFractions[n].nFlags() & CFractions::NOTARY_V;
-				fF &= wtx.vOutFractions[n].nLockTime() >= nLastBlockTime;
-				fV &= wtx.vOutFractions[n].nLockTime() >= nLastBlockTime;
-				if (fF || fV)
-					return 0;
-
-				int64_t nLiquidity = 0;
-				wtx.vOutFractions[n].Ref().HighPart(nLastPegSupplyIndex, &nLiquidity);
-				return nLiquidity;
-			}
-		}
-	}
-
-	return 0;
-}
-
 bool CWallet::IsChange(const CTxOut& txout) const {
 	CTxDestination address;
 
@@ -1086,39 +976,162 @@ bool CWalletTx::WriteToDisk() {
 // Scan the block chain (starting in pindexStart) for transactions
 // from or to us. If fUpdate is true, found transactions that already
 // exist in the wallet will be updated.
-int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate) {
-	int ret = 0;
+// Blocks read ahead by the rescan while the previous ones are merged
+static const size_t RESCAN_WINDOW_BLOCKS = 500;
+
+// A block of the rescan, read and filtered by the reader threads
+struct CRescanBlock {
+	CBlockIndex*         pindex = nullptr;
+	bool                 fRead  = false;
+	CBlock               block;
+	std::vector<uint256> vHashes;
+	std::vector<bool>    vPaysMe;             // an output of the tx is mine
+	MapFractions         mapOutputFractions;  // of the txs paying to the wallet
+};
 
-	CBlockIndex* pindex = pindexStart;
-	{
-		LOCK2(cs_main, cs_wallet);
-		CPegDB pegdb("r");
-		while (pindex) {
-			// no need to read and scan block, if block was created before
-			// our wallet birthday (as adjusted for block time variability)
-			if (nTimeFirstKey && (pindex->nTime < (nTimeFirstKey - 7200))) {
-				pindex = pindex->Next();
-				continue;
+// Fractions of the outputs of tx, pruned ones keep nValue as they are spent
+static void ReadOutputFractions(CPegDB&             pegdb,
+                                const CTransaction& tx,
+                                const uint256&      hash,
+                                MapFractions&       mapOutputFractions) {
+	std::vector<uint320> vTxOuts;
+	for (size_t i = 0; i < tx.vout.size(); i++)
+		vTxOuts.push_back(uint320(hash, i));
+	MapFractions mapFound;
+	pegdb.ReadFractions(vTxOuts, mapFound);
+	for (size_t i = 0; i < tx.vout.size(); i++) {
+		auto it = mapFound.find(vTxOuts[i]);
+		if (it != mapFound.end())
+			mapOutputFractions[vTxOuts[i]] = it->second;
+		else
+			mapOutputFractions[vTxOuts[i]] = CFractions(tx.vout[i].nValue, CFractions::STD);
+	}
+}
+
+// Reads blocks of vBlocks taken by nNext, no lock is held: outputs are
+// checked against the key store which has its own lock
+static void ReadRescanBlocks(const CWallet*             pwallet,
+                             std::vector<CRescanBlock>& vBlocks,
+                             std::atomic<size_t>&       nNext) {
+	CPegDB pegdb("r");
+	for (size_t n = nNext++; n < vBlocks.size(); n = nNext++) {
+		CRescanBlock& item = vBlocks[n];
+		item.fRead         = item.block.ReadFromDisk(item.pindex, true);
+		if (!item.fRead)
+			continue;
+		const vector<CTransaction>& vtx = item.block.vtx;
+		item.vHashes.resize(vtx.size());
+		item.vPaysMe.assign(vtx.size(), false);
+		for (size_t i = 0; i < vtx.size(); i++) {
+			item.vHashes[i] = vtx[i].GetHash();
+			for (const CTxOut& txout : vtx[i].vout) {
+				if (pwallet->IsMine(txout)) {
+					item.vPaysMe[i] = true;
+					break;
+				}
 			}
+			if (item.vPaysMe[i])
+				ReadOutputFractions(pegdb, vtx[i], item.vHashes[i], item.mapOutputFractions);
+		}
+	}
+}
 
-			CBlock       block;
-			MapFractions mapOutputFractions;
-			block.ReadFromDisk(pindex, true);
-			for (const CTransaction& tx : block.vtx) {
-				auto hash = tx.GetHash();
-				for (size_t i = 0; i < tx.vout.size(); i++) {
-					auto        fkey      = uint320(hash, i);
-					CFractions& fractions = mapOutputFractions[fkey];
-					fractions             = CFractions(tx.vout[i].nValue, CFractions::STD);
-					pegdb.ReadFractions(fkey, fractions);
-					// if pruned, it is ok to use nValue dafault as it is spent
+// Next window of main chain blocks after the wallet birthday, the scan
+// continues past the fork when the last window was reorganized away
+static void GatherRescanBlocks(CBlockIndex*&              pindexNext,
+                               int64_t                    nTimeFirstKey,
+                               std::vector<CRescanBlock>& vBlocks) {
+	vBlocks.clear();
+	LOCK(cs_main);
+	bool fForked = false;
+	while (pindexNext && !pindexNext->IsInMainChain()) {
+		pindexNext = pindexNext->Prev();
+		fForked    = true;
+	}
+	if (fForked && pindexNext)
+		pindexNext = pindexNext->Next();
+	while (pindexNext && vBlocks.size() < RESCAN_WINDOW_BLOCKS) {
+		// no need to read and scan block, if block was created before
+		// our wallet birthday (as adjusted for block time variability)
+		if (!nTimeFirstKey || pindexNext->nTime >= (nTimeFirstKey - 7200)) {
+			vBlocks.emplace_back();
+			vBlocks.back().pindex = pindexNext;
+		}
+		pindexNext = pindexNext->Next();
+	}
+}
+
+static void StartRescanReaders(const CWallet*             pwallet,
+                               std::vector<CRescanBlock>& vBlocks,
+                               std::atomic<size_t>&       nNext,
+                               boost::thread_group&       readers) {
+	int nThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+	nNext        = 0;
+	for (int i = 0; i < nThreads; i++)
+		readers.create_thread([pwallet, &vBlocks, &nNext] {
+			ReadRescanBlocks(pwallet, vBlocks, nNext);
+		});
+}
+
+int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, LoadMsg load_msg) {
+	int     ret     = 0;
+	int     nBlocks = 0;
+	int64_t nStart  = GetTimeMillis();
+	int64_t nLogged = nStart;
+
+	// a window is read while the one before is merged into the wallet
+	CBlockIndex*              pindexNext = pindexStart;
+	std::vector<CRescanBlock> vWindows[2];
+	std::atomic<size_t>       vNext[2];
+	GatherRescanBlocks(pindexNext, nTimeFirstKey, vWindows[0]);
+	{
+		boost::thread_group readers;
+		StartRescanReaders(this, vWindows[0], vNext[0], readers);
+		readers.join_all();
+	}
+	for (int nCur = 0; !vWindows[nCur].empty(); nCur = 1 - nCur) {
+		boost::thread_group readers;
+		GatherRescanBlocks(pindexNext, nTimeFirstKey, vWindows[1 - nCur]);
+		StartRescanReaders(this, vWindows[1 - nCur], vNext[1 - nCur], readers);
+		{
+			LOCK2(cs_main, cs_wallet);
+			CPegDB pegdb("r");
+			for (CRescanBlock& item : vWindows[nCur]) {
+				if (!item.fRead || !item.pindex->IsInMainChain())
+					continue;
+				for (size_t i = 0; i < item.block.vtx.size(); i++) {
+					// txs neither paying to nor spending from the wallet are skipped,
+					// spends of coins found earlier in the scan are seen here
+					const CTransaction& tx        = item.block.vtx[i];
+					const uint256&      hash      = item.vHashes[i];
+					bool                fInvolved = item.vPaysMe[i] || mapWallet.count(hash);
+					for (size_t j = 0; !fInvolved && j < tx.vin.size(); j++)
+						fInvolved = mapWallet.count(tx.vin[j].prevout.hash);
+					if (!fInvolved)
+						continue;
+					if (!item.vPaysMe[i])
+						ReadOutputFractions(pegdb, tx, hash, item.mapOutputFractions);
+					if (AddToWalletIfInvolvingMe(tx, &item.block, fUpdate, item.mapOutputFractions))
+						ret++;
 				}
-				if (AddToWalletIfInvolvingMe(tx, &block, fUpdate, mapOutputFractions))
-					ret++;
 			}
-			pindex = pindex->Next();
+		}
+		readers.join_all();
+
+		nBlocks += vWindows[nCur].size();
+		int64_t nNow = GetTimeMillis();
+		if (nNow - nLogged >= 10000 || vWindows[1 - nCur].empty()) {
+			nLogged        = nNow;
+			int    nHeight = vWindows[nCur].back().pindex->nHeight;
+			double dPerSec = nBlocks * 1000.0 / std::max<int64_t>(1, nNow - nStart);
+			LogPrintf("ScanForWalletTransactions() : height %d of %d, %.1f blocks/s\n", nHeight,
+			          nBestHeight, dPerSec);
+			if (load_msg)
+				load_msg(strprintf(" %d/%d, %.1f blocks/s", nHeight, nBestHeight, dPerSec));
 		}
 	}
+	LogPrintf("ScanForWalletTransactions() : %d blocks in %dms, %d transactions added\n", nBlocks,
+	          GetTimeMillis() - nStart, ret);
 	return ret;
 }
 
@@ -1275,13 +1288,10 @@ void CWallet::ResendWalletTransactions(bool fForce) {
 			CFractions             feesFractions;
 
 			{
-				CTxDB                    txdb("r");
-				CPegDB                   pegdb("r");
-				map<string, CBridgeInfo> bridges;
-				pindexBest->ReadBridges(pegdb, bridges);
-				auto fnMerkleIn = [&](string hash) {
-					return pindexBest->ReadMerkleIn(pegdb, hash);
-				};
+				CTxDB             txdb("r");
+				CPegDB            pegdb("r");
+				CPegCycleStateRef cycle = GetPegCycleState(pegdb, pindexBest);
+				auto fnMerkleIn = [&](string hash) { return cycle->MerkleIn(pegdb, hash); };
 
 				uint256 hash = wtx.GetHash();
 				if (txdb.ContainsTx(hash)) {
@@ -1289,8 +1299,8 @@ void CWallet::ResendWalletTransactions(bool fForce) {
 				}
 
 				bool fInvalid = false;
-				if (!wtx.FetchInputs(txdb, pegdb, pindexBest->nHeight, false, bridges, fnMerkleIn,
-				                     mapUnused, mapOutputsFractions, false /*is block*/,
+				if (!wtx.FetchInputs(txdb, pegdb, pindexBest->nHeight, false, cycle->bridges,
+				                     fnMerkleIn, mapUnused, mapOutputsFractions, false /*is block*/,
 				                     false /*is miner*/, nVirtBlockTime, false /*skip pruned*/,
 				                     mapInputs, mapInputsFractions, fInvalid)) {
 					LogPrintf(
@@ -1323,108 +1333,337 @@ void CWallet::ResendWalletTransactions(bool fForce) {
 // Actions
 //
 
-int64_t CWallet::GetBalance() const {
-	int64_t nTotal = 0;
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsTrusted())
-				nTotal += pcoin->GetAvailableCredit();
-		}
+void CWalletBalances::COutputPart::SetFractions(const CFractions& fractions) {
+	if ((fractions.nFlags & CFractions::STD) == 0) {
+		SetFractions(fractions.Std());
+		return;
 	}
+	nFrom   = fractions.f.From();
+	int nTo = std::max(fractions.f.To(), nFrom);
+	vLowSums.assign(nTo - nFrom + 1, 0);
+	for (int i = nFrom; i < nTo; i++)
+		vLowSums[i - nFrom + 1] = vLowSums[i - nFrom] + fractions.f[i];
+}
 
-	return nTotal;
+int64_t CWalletBalances::COutputPart::Low(int nSupply) const {
+	if (vLowSums.empty())
+		return 0;
+	int i = std::min(std::max(nSupply - nFrom, 0), int(vLowSums.size()) - 1);
+	return vLowSums[i];
 }
 
-int64_t CWallet::GetReserve() const {
-	int64_t nTotal = 0;
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsTrusted())
-				nTotal += pcoin->GetAvailableReserve();
+int64_t CWalletBalances::COutputPart::High(int nSupply) const {
+	if (vLowSums.empty())
+		return 0;
+	return vLowSums.back() - Low(nSupply);
+}
+
+bool CWalletBalances::COutputPart::IsFrozen(uint32_t nBlockTime) const {
+	if ((nFlags & (CFractions::NOTARY_F | CFractions::NOTARY_V)) == 0)
+		return false;
+	return nLockTime >= nBlockTime;
+}
+
+void CWalletBalances::SetDirty() {
+	LOCK(cs);
+	fValid = false;
+}
+
+void CWalletBalances::SetDirty(const uint256& hash) {
+	LOCK(cs);
+	if (fValid)
+		setDirty.insert(hash);
+}
+
+void CWalletBalances::SetDirty(const CTransaction& tx) {
+	LOCK(cs);
+	if (fValid)
+		setDirty.insert(tx.GetHash());
+}
+
+void CWalletBalances::Clear() {
+	nCredit      = 0;
+	nUnconfirmed = 0;
+	nImmature    = 0;
+	nReserve     = 0;
+	nLiquidity   = 0;
+	nFrozen      = 0;
+	for (RewardInfo& info : vRewards)
+		info = RewardInfo();
+	mapParts.clear();
+	setDirty.clear();
+	setPending.clear();
+	setUnconfirmed.clear();
+	mapUnlocks.clear();
+}
+
+void CWalletBalances::Insert(const uint256& hash, CTxPart part) {
+	Erase(hash);
+	Price(part);
+	Add(part, 1);
+	if (part.fPending)
+		setPending.insert(hash);
+	if (part.fUnconfirmed)
+		setUnconfirmed.insert(hash);
+	if (part.nFrozen)
+		mapUnlocks.insert(make_pair(part.nUnlockTime, hash));
+	mapParts[hash] = std::move(part);
+}
+
+void CWalletBalances::Erase(const uint256& hash) {
+	auto it = mapParts.find(hash);
+	if (it == mapParts.end())
+		return;
+	Add(it->second, -1);
+	EraseUnlock(it->second, hash);
+	setPending.erase(hash);
+	setUnconfirmed.erase(hash);
+	mapParts.erase(it);
+}
+
+void CWalletBalances::Reprice(const uint256& hash) {
+	auto it = mapParts.find(hash);
+	if (it == mapParts.end())
+		return;
+	CTxPart& part = it->second;
+	Add(part, -1);
+	EraseUnlock(part, hash);
+	Price(part);
+	Add(part, 1);
+	if (part.nFrozen)
+		mapUnlocks.insert(make_pair(part.nUnlockTime, hash));
+}
+
+void CWalletBalances::SetTip(const uint256& hash, int nSupplyIn, uint32_t nBlockTimeIn) {
+	bool fReprice = nSupplyIn != nSupply || nBlockTimeIn < nBlockTime;
+	hashBlock     = hash;
+	nSupply       = nSupplyIn;
+	nBlockTime    = nBlockTimeIn;
+	if (fReprice) {
+		for (const auto& item : mapParts)
+			Reprice(item.first);
+		return;
+	}
+	// only the outputs unlocked by the new block time move out of the frozen total
+	while (!mapUnlocks.empty() && mapUnlocks.begin()->first < nBlockTime)
+		Reprice(mapUnlocks.begin()->second);
+}
+
+void CWalletBalances::Price(CTxPart& part) const {
+	part.nReserve    = 0;
+	part.nLiquidity  = 0;
+	part.nFrozen     = 0;
+	part.nUnlockTime = 0;
+	for (RewardInfo& info : part.vRewards)
+		info = RewardInfo();
+
+	for (const COutputPart& out : part.vOutputs) {
+		int64_t nOutReserve   = out.Low(nSupply);
+		int64_t nOutLiquidity = out.High(nSupply);
+		if (part.fAvailable) {
+			if (out.IsFrozen(nBlockTime)) {
+				part.nFrozen += out.nValue;
+				if (!part.nUnlockTime || out.nLockTime < part.nUnlockTime)
+					part.nUnlockTime = out.nLockTime;
+			} else {
+				part.nReserve += nOutReserve;
+				part.nLiquidity += nOutLiquidity;
+			}
 		}
+		if (!part.fStake && !part.fConfirmed)
+			continue;
+
+		PegRewardType type = PEG_REWARD_5;
+		if (out.nFlags & CFractions::NOTARY_V)
+			type = PEG_REWARD_40;
+		else if (out.nFlags & CFractions::NOTARY_F)
+			type = PEG_REWARD_20;
+		else if (nOutLiquidity < nOutReserve)
+			type = PEG_REWARD_10;
+		part.vRewards[type].count++;
+		part.vRewards[type].amount += out.nValue;
+		if (part.fStake)
+			part.vRewards[type].stake++;
 	}
+}
 
-	return nTotal;
+void CWalletBalances::Add(const CTxPart& part, int nSign) {
+	nCredit += nSign * part.nCredit;
+	nUnconfirmed += nSign * part.nUnconfirmed;
+	nImmature += nSign * part.nImmature;
+	nReserve += nSign * part.nReserve;
+	nLiquidity += nSign * part.nLiquidity;
+	nFrozen += nSign * part.nFrozen;
+	for (int i = 0; i < PEG_REWARD_LAST; i++) {
+		vRewards[i].count += nSign * part.vRewards[i].count;
+		vRewards[i].stake += nSign * part.vRewards[i].stake;
+		vRewards[i].amount += nSign * part.vRewards[i].amount;
+	}
 }
 
-int64_t CWallet::GetLiquidity() const {
-	int64_t nTotal = 0;
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsTrusted())
-				nTotal += pcoin->GetAvailableLiquidity();
+void CWalletBalances::EraseUnlock(const CTxPart& part, const uint256& hash) {
+	if (!part.nFrozen)
+		return;
+	auto range = mapUnlocks.equal_range(part.nUnlockTime);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == hash) {
+			mapUnlocks.erase(it);
+			return;
 		}
 	}
-
-	return nTotal;
 }
 
-int64_t CWallet::GetFrozen(vector<CFrozenCoinInfo>* pFrozenCoins) const {
-	int64_t nTotal = 0;
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsTrusted()) {
-				nTotal += pcoin->GetAvailableFrozen(true, pFrozenCoins);
-			}
+// the share of a wallet transaction in the balance totals, before the peg supply index and the
+// block time are applied
+void CWallet::GetBalancePart(const CWalletTx& wtx, CWalletBalances::CTxPart& part) const {
+	int  nDepth         = wtx.GetDepthInMainChain();
+	int  nConfirmations = Params().MinStakeConfirmations(wtx.GetBlockNumInMainChain());
+	bool fTrusted       = wtx.IsTrusted();
+	// Must wait until coinbase is safely deep enough in the chain before valuing it
+	bool fMaturing = wtx.GetBlocksToMaturity() > 0;
+
+	part.fAvailable   = fTrusted && !fMaturing;
+	part.fConfirmed   = nDepth >= nConfirmations;
+	part.fStake       = wtx.IsCoinStake() && fMaturing && nDepth > 0;
+	part.fPending     = fMaturing || nDepth < std::max(nConfirmations, 1);
+	part.fUnconfirmed = nDepth < 1;
+
+	if (wtx.IsCoinBase() && fMaturing && wtx.IsInMainChain())
+		part.nImmature = GetCredit(wtx);
+
+	int64_t nCredit = 0;
+	for (uint32_t i = 0; i < wtx.vout.size(); i++) {
+		if (wtx.IsSpent(i))
+			continue;
+		const CTxOut& txout = wtx.vout[i];
+		nCredit += GetCredit(txout);
+		if (!MoneyRange(nCredit))
+			throw std::runtime_error("CWallet::GetBalancePart() : value out of range");
+		if (!fTrusted || i >= wtx.vOutFractions.size() || !IsMine(txout))
+			continue;
+
+		const CFractionsRef& fractions = wtx.vOutFractions[i];
+		if (part.fAvailable)
+			fractions.Ref();
+		if (!fractions.ptr)
+			continue;
+		CWalletBalances::COutputPart out;
+		out.n         = i;
+		out.nValue    = txout.nValue;
+		out.nFlags    = fractions.nFlags();
+		out.nLockTime = fractions.nLockTime();
+		out.SetFractions(*fractions.ptr);
+		part.vOutputs.push_back(std::move(out));
+	}
+	if (fMaturing)
+		nCredit = 0;
+
+	if (fTrusted)
+		part.nCredit = nCredit;
+	if (!IsFinalTx(wtx) || (!fTrusted && nDepth == 0))
+		part.nUnconfirmed = nCredit;
+}
+
+// bring the balance totals up to the current tip and the changed transactions
+void CWallet::SyncBalances() const {
+	AssertLockHeld(cs_main);
+	AssertLockHeld(cs_wallet);
+	LOCK(balances.cs);
+
+	std::set<uint256> setUpdate;
+	CBlockIndex*      pindexLast = mapBlockIndex.ref(balances.hashBlock);
+	if (!balances.fValid || !pindexLast || !chainActive.Contains(pindexLast)) {
+		balances.Clear();
+		for (const std::pair<const uint256, CWalletTx>& item : mapWallet)
+			setUpdate.insert(item.first);
+	} else {
+		if (balances.hashBlock != hashBestChain)
+			setUpdate = balances.setPending;
+		setUpdate.insert(balances.setUnconfirmed.begin(), balances.setUnconfirmed.end());
+		setUpdate.insert(balances.setDirty.begin(), balances.setDirty.end());
+	}
+	balances.setDirty.clear();
+	balances.fValid = true;
+	if (pindexBest)
+		balances.SetTip(hashBestChain, pindexBest->nPegSupplyIndex, pindexBest->nTime);
+
+	for (const uint256& hash : setUpdate) {
+		map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+		if (mi == mapWallet.end()) {
+			balances.Erase(hash);
+			continue;
 		}
+		CWalletBalances::CTxPart part;
+		GetBalancePart(mi->second, part);
+		balances.Insert(hash, std::move(part));
 	}
+}
 
-	return nTotal;
+int64_t CWallet::GetBalance() const {
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	return balances.nCredit;
 }
 
-bool CWallet::GetRewardInfo(std::vector<RewardInfo>& rewardsInfo) const {
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx* pcoin = &(*it).second;
-			if (pcoin->IsTrusted()) {
-				pcoin->GetRewardInfo(rewardsInfo);
+int64_t CWallet::GetReserve() const {
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	return balances.nReserve;
+}
+
+int64_t CWallet::GetLiquidity() const {
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	return balances.nLiquidity;
+}
+
+int64_t CWallet::GetFrozen(vector<CFrozenCoinInfo>* pFrozenCoins) const {
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	if (pFrozenCoins) {
+		std::set<uint256> setFrozen;
+		for (const std::pair<const uint64_t, uint256>& item : balances.mapUnlocks)
+			setFrozen.insert(item.second);
+		for (const uint256& hash : setFrozen) {
+			for (const CWalletBalances::COutputPart& out : balances.mapParts.at(hash).vOutputs) {
+				if (!out.IsFrozen(balances.nBlockTime))
+					continue;
+				CFrozenCoinInfo fcoin;
+				fcoin.txhash    = hash;
+				fcoin.n         = out.n;
+				fcoin.nValue    = out.nValue;
+				fcoin.nFlags    = out.nFlags;
+				fcoin.nLockTime = out.nLockTime;
+				pFrozenCoins->push_back(fcoin);
 			}
 		}
 	}
+	return balances.nFrozen;
+}
 
+bool CWallet::GetRewardInfo(std::vector<RewardInfo>& rewardsInfo) const {
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	if (rewardsInfo.size() != PEG_REWARD_LAST)
+		return true;
+	for (int i = 0; i < PEG_REWARD_LAST; i++) {
+		rewardsInfo[i].count += balances.vRewards[i].count;
+		rewardsInfo[i].stake += balances.vRewards[i].stake;
+		rewardsInfo[i].amount += balances.vRewards[i].amount;
+	}
 	return true;
 }
 
 int64_t CWallet::GetUnconfirmedBalance() const {
-	int64_t nTotal = 0;
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx* pcoin = &(*it).second;
-			if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-				nTotal += pcoin->GetAvailableCredit();
-		}
-	}
-	return nTotal;
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	return balances.nUnconfirmed;
 }
 
 int64_t CWallet::GetImmatureBalance() const {
-	int64_t nTotal = 0;
-	{
-		LOCK2(cs_main, cs_wallet);
-		for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-		     ++it) {
-			const CWalletTx& pcoin = (*it).second;
-			if (pcoin.IsCoinBase() && pcoin.GetBlocksToMaturity() > 0 && pcoin.IsInMainChain())
-				nTotal += GetCredit(pcoin);
-		}
-	}
-	return nTotal;
+	LOCK2(cs_main, cs_wallet);
+	SyncBalances();
+	return balances.nImmature;
 }
 
 // populate vCoins with vector of available COutputs.
@@ -1913,6 +2152,49 @@ bool CWallet::SelectCoinsForStaking(int64_t                                nTarg
 	return true;
 }
 
+// Kernel inputs of the selected coins. Table entries are made once per coin
+// from wallet and block index data, entries of coins no longer selected or
+// no longer in the best chain are dropped
+void CWallet::GetStakeCandidates(const set<pair<const CWalletTx*, uint32_t>>& setCoins,
+                                 vector<CStakeCandidate>&                    vCandidates) {
+	AssertLockHeld(cs_main);
+	AssertLockHeld(cs_wallet);
+	vCandidates.clear();
+
+	map<COutPoint, CStakeCandidate> mapSelected;
+	for (const pair<const CWalletTx*, uint32_t>& pcoin : setCoins) {
+		COutPoint prevout(pcoin.first->GetHash(), pcoin.second);
+		auto      mi = mapStakeCandidates.find(prevout);
+		if (mi != mapStakeCandidates.end() && chainActive.Contains(mi->second.pindexFrom)) {
+			vCandidates.push_back(mi->second);
+			mapSelected.insert(*mi);
+			continue;
+		}
+
+		CBlockIndex* pindexFrom = nullptr;
+		if (pcoin.first->GetDepthInMainChain(pindexFrom) < 1 || !pindexFrom)
+			continue;
+
+		CStakeCandidate coin;
+		coin.prevout        = prevout;
+		coin.nValue         = pcoin.first->vout[pcoin.second].nValue;
+		coin.nTimeTxPrev    = pcoin.first->nTime;
+		coin.nTimeBlockFrom = pindexFrom->GetBlockTime();
+		coin.nHeight        = pindexFrom->nHeight;
+		coin.pindexFrom     = pindexFrom;
+		vCandidates.push_back(coin);
+		mapSelected.insert(make_pair(prevout, coin));
+	}
+	mapStakeCandidates.swap(mapSelected);
+}
+
+void CWallet::EraseStakeCandidates(const uint256& hashTx) {
+	AssertLockHeld(cs_wallet);
+	auto it = mapStakeCandidates.lower_bound(COutPoint(hashTx, 0));
+	while (it != mapStakeCandidates.end() && it->first.hash == hashTx)
+		it = mapStakeCandidates.erase(it);
+}
+
 static bool sortByAddress(const CSelectedCoin& lhs, const CSelectedCoin& rhs) {
 	CScript lhs_script = lhs.tx->vout[lhs.i].scriptPubKey;
 	CScript rhs_script = rhs.tx->vout[rhs.i].scriptPubKey;
@@ -2421,7 +2703,7 @@ uint64_t CWallet::GetStakeWeight() const {
 			uint256 blockhash;
 			if (txindex.GetHeightInMainChain(nullptr, uint256(0), &blockhash) == 0)
 				continue;
-			unordered_map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(blockhash);
+			CBlockIndexMap::iterator mi = mapBlockIndex.find(blockhash);
 			if (mi == mapBlockIndex.end())
 				continue;
 			CBlockIndex* pindex = (*mi).second;
@@ -2436,6 +2718,52 @@ uint64_t CWallet::GetStakeWeight() const {
 	return nWeight;
 }
 
+// Output script of a coinstake staking the kernel, pay to public key
+static bool GetKernelScriptPubKey(const CKeyStore& keystore,
+                                  const CScript&   scriptPubKeyKernel,
+                                  CScript&         scriptPubKeyOut,
+                                  CKey&            key) {
+	vector<vchtype> vSolutions;
+	txnouttype      whichType;
+	if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
+		LogPrint("coinstake", "CreateCoinStake : failed to parse kernel\n");
+		return false;
+	}
+	LogPrint("coinstake", "CreateCoinStake : parsed kernel type=%d\n", whichType);
+	if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
+		LogPrint("coinstake", "CreateCoinStake : no support for kernel type=%d\n", whichType);
+		return false;  // only support pay to public key and pay to address
+	}
+	if (whichType == TX_PUBKEYHASH)  // pay to address type
+	{
+		// convert to pay to public key type
+		if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
+			LogPrint("coinstake", "CreateCoinStake : failed to get key for kernel type=%d\n",
+			         whichType);
+			return false;  // unable to find corresponding public key
+		}
+		scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
+	}
+	if (whichType == TX_PUBKEY) {
+		vchtype& vchPubKey = vSolutions[0];
+		if (!keystore.GetKey(Hash160(vchPubKey), key)) {
+			LogPrint("coinstake", "CreateCoinStake : failed to get key for kernel type=%d\n",
+			         whichType);
+			return false;  // unable to find corresponding public key
+		}
+
+		if (key.GetPubKey() != vchPubKey) {
+			LogPrint("coinstake", "CreateCoinStake : invalid key for kernel type=%d\n",
+			         whichType);
+			return false;  // keys mismatch
+		}
+
+		scriptPubKeyOut = scriptPubKeyKernel;
+	}
+	LogPrint("coinstake", "CreateCoinStake : added kernel type=%d\n", whichType);
+	return true;
+}
+
 bool CWallet::CreateCoinStake(const CKeyStore& keystore,
                               uint32_t         nBits,
                               int64_t          nSearchInterval,
@@ -2444,10 +2772,14 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore,
                               CTransaction&    txConsolidate,
                               CKey&            key,
                               PegVoteType      voteType) {
-	LOCK2(cs_main, cs_wallet);
-	CBlockIndex* pindexPrev = pindexBest;
-	CBigNum      bnTargetPerCoinDay;
-	bnTargetPerCoinDay.SetCompact(nBits);
+	static int nMaxStakeSearchInterval = 60;
+	uint32_t   nSearchSpan             = min(nSearchInterval, (int64_t)nMaxStakeSearchInterval);
+
+	CBlockIndex*             pindexPrev = nullptr;
+	vector<COutPoint>        vStakeCoins;
+	vector<CStakeCandidate>  vCandidates;
+	CStakeKernelContext      kernelContext;
+	map<COutPoint, uint32_t> mapKernels;  // coin -> search offset of its kernel
 
 	txCoinStake.vin.clear();
 	txCoinStake.vout.clear();
@@ -2457,24 +2789,74 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore,
 	scriptEmpty.clear();
 	txCoinStake.vout.push_back(CTxOut(0, scriptEmpty));
 
-	// Choose coins to use
-	int64_t nBalance = GetBalance();
+	{
+		LOCK2(cs_main, cs_wallet);
+		pindexPrev = pindexBest;
 
-	if (nBalance <= nNoStakeBalance)
-		return false;
+		// Choose coins to use
+		int64_t nBalance = GetBalance();
 
-	vector<const CWalletTx*> vwtxPrev;
+		if (nBalance <= nNoStakeBalance)
+			return false;
 
-	set<pair<const CWalletTx*, uint32_t>> setCoins;
-	int64_t                               nValueIn = 0;
+		set<pair<const CWalletTx*, uint32_t>> setCoins;
+		int64_t                               nValueIn = 0;
 
-	// Select coins with suitable depth
-	if (!SelectCoinsForStaking(nBalance - nNoStakeBalance, GetAdjustedTime(), setCoins, nValueIn))
-		return false;
+		// Select coins with suitable depth
+		if (!SelectCoinsForStaking(nBalance - nNoStakeBalance, GetAdjustedTime(), setCoins,
+		                           nValueIn))
+			return false;
 
-	if (setCoins.empty())
+		if (setCoins.empty())
+			return false;
+
+		for (const pair<const CWalletTx*, uint32_t>& pcoin : setCoins)
+			vStakeCoins.push_back(COutPoint(pcoin.first->GetHash(), pcoin.second));
+
+		GetStakeCandidates(setCoins, vCandidates);
+		kernelContext = CStakeKernelContext(pindexPrev, nBits);
+
+		if (!IsProtocolV2(pindexPrev->nHeight + 1)) {
+			// v1 kernels hash the stake modifier of the coin block, search on disk
+			for (const CStakeCandidate& coin : vCandidates) {
+				for (uint32_t n = 0; n < nSearchSpan; n++) {
+					boost::this_thread::interruption_point();
+					if (CheckKernel(pindexPrev, nBits, txCoinStake.nTime - n, coin.prevout)) {
+						mapKernels[coin.prevout] = n;
+						break;
+					}
+				}
+			}
+			vCandidates.clear();
+		}
+	}
+
+	// Search backward in time from the given txNew timestamp
+	// Search nSearchInterval seconds back up to nMaxStakeSearchInterval
+	// Candidates are in memory, no locks are held while hashing
+	SearchStakeKernels(kernelContext, vCandidates, txCoinStake.nTime, nSearchSpan, mapKernels,
+	                   nStakeSearchThreads);
+
+	if (mapKernels.empty())
 		return false;
 
+	LOCK2(cs_main, cs_wallet);
+	if (pindexPrev != pindexBest)
+		return false;  // new best block while searching
+
+	int64_t nBalance = GetBalance();
+
+	// Coins may have been spent while searching
+	set<pair<const CWalletTx*, uint32_t>> setCoins;
+	for (const COutPoint& prevout : vStakeCoins) {
+		map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(prevout.hash);
+		if (mi == mapWallet.end() || mi->second.IsSpent(prevout.n))
+			continue;
+		setCoins.insert(make_pair(&mi->second, prevout.n));
+	}
+
+	vector<const CWalletTx*> vwtxPrev;
+
 	int64_t nCredit = 0;
 	CScript scriptPubKeyKernel;
 
@@ -2483,77 +2865,23 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore,
 
 	bool fKernelFound = false;
 	for (const pair<const CWalletTx*, uint32_t>& pcoin : setCoins) {
-		COutPoint  prevoutStake            = COutPoint(pcoin.first->GetHash(), pcoin.second);
-		static int nMaxStakeSearchInterval = 60;
+		COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
 
 		bool fKernelFoundForCoin = false;
-		if (!fKernelFound) {
-			for (uint32_t n = 0; n < min(nSearchInterval, (int64_t)nMaxStakeSearchInterval) &&
-			                     !fKernelFound && pindexPrev == pindexBest;
-			     n++) {
-				boost::this_thread::interruption_point();
-				// Search backward in time from the given txNew timestamp
-				// Search nSearchInterval seconds back up to nMaxStakeSearchInterval
-				int64_t nBlockTime;
-				if (CheckKernel(pindexPrev, nBits, txCoinStake.nTime - n, prevoutStake,
-				                &nBlockTime)) {
-					// Found a kernel
-					LogPrint("coinstake", "CreateCoinStake : kernel found\n");
-					vector<vchtype> vSolutions;
-					txnouttype      whichType;
-					CScript         scriptPubKeyOut;
-					scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
-					if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
-						LogPrint("coinstake", "CreateCoinStake : failed to parse kernel\n");
-						break;
-					}
-					LogPrint("coinstake", "CreateCoinStake : parsed kernel type=%d\n", whichType);
-					if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
-						LogPrint("coinstake", "CreateCoinStake : no support for kernel type=%d\n",
-						         whichType);
-						break;  // only support pay to public key and pay to address
-					}
-					if (whichType == TX_PUBKEYHASH)  // pay to address type
-					{
-						// convert to pay to public key type
-						if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
-							LogPrint("coinstake",
-							         "CreateCoinStake : failed to get key for kernel type=%d\n",
-							         whichType);
-							break;  // unable to find corresponding public key
-						}
-						scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
-					}
-					if (whichType == TX_PUBKEY) {
-						vchtype& vchPubKey = vSolutions[0];
-						if (!keystore.GetKey(Hash160(vchPubKey), key)) {
-							LogPrint("coinstake",
-							         "CreateCoinStake : failed to get key for kernel type=%d\n",
-							         whichType);
-							break;  // unable to find corresponding public key
-						}
-
-						if (key.GetPubKey() != vchPubKey) {
-							LogPrint("coinstake",
-							         "CreateCoinStake : invalid key for kernel type=%d\n",
-							         whichType);
-							break;  // keys mismatch
-						}
-
-						scriptPubKeyOut = scriptPubKeyKernel;
-					}
-
-					txCoinStake.nTime -= n;
-					txCoinStake.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
-					nCredit += pcoin.first->vout[pcoin.second].nValue;
-					vwtxPrev.push_back(pcoin.first);
-					txCoinStake.vout.push_back(CTxOut(0, scriptPubKeyOut));
-
-					LogPrint("coinstake", "CreateCoinStake : added kernel type=%d\n", whichType);
-					fKernelFoundForCoin = true;
-					fKernelFound        = true;
-					break;
-				}
+		if (!fKernelFound && mapKernels.count(prevoutStake)) {
+			// Found a kernel
+			LogPrint("coinstake", "CreateCoinStake : kernel found\n");
+			CScript scriptPubKeyOut;
+			scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
+			if (GetKernelScriptPubKey(keystore, scriptPubKeyKernel, scriptPubKeyOut, key)) {
+				txCoinStake.nTime -= mapKernels[prevoutStake];
+				txCoinStake.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
+				nCredit += pcoin.first->vout[pcoin.second].nValue;
+				vwtxPrev.push_back(pcoin.first);
+				txCoinStake.vout.push_back(CTxOut(0, scriptPubKeyOut));
+
+				fKernelFoundForCoin = true;
+				fKernelFound        = true;
 			}
 		}
 
@@ -3369,9 +3697,8 @@ void CWallet::GetKeyBirthTimes(std::map<CKeyID, int64_t>& mapKeyBirth) const {
 	for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
 	     it++) {
 		// iterate over all wallet transactions...
-		const CWalletTx&                                          wtx = (*it).second;
-		std::unordered_map<uint256, CBlockIndex*>::const_iterator blit =
-		    mapBlockIndex.find(wtx.hashBlock);
+		const CWalletTx&               wtx  = (*it).second;
+		CBlockIndexMap::const_iterator blit = mapBlockIndex.find(wtx.hashBlock);
 		if (blit != mapBlockIndex.end() && blit->second->IsInMainChain()) {
 			// ... which are already in a block
 			int nHeight = blit->second->nHeight;
@@ -14,6 +14,7 @@
 
 #include "crypter.h"
 #include "key.h"
+#include "kernel.h"
 #include "keystore.h"
 #include "main.h"
 #include "peg.h"
@@ -84,6 +85,82 @@ public:
 	}
 };
 
+/** Running totals behind the wallet balance queries. Each wallet transaction keeps its share
+ * of the totals and the low part prefix sums of its unspent own outputs: a query is O(1), a new
+ * tip recomputes only the transactions not deep enough yet and a peg supply index change costs
+ * one lookup per output. The totals and parts change in CWallet::SyncBalances under cs_wallet,
+ * cs guards the marks of the transactions to recompute.
+ */
+class CWalletBalances {
+public:
+	struct COutputPart {
+		uint32_t             n         = 0;
+		int64_t              nValue    = 0;
+		uint32_t             nFlags    = 0;
+		uint64_t             nLockTime = 0;
+		int                  nFrom     = 0;
+		std::vector<int64_t> vLowSums;  // vLowSums[i] is Low(nFrom + i)
+
+		void    SetFractions(const CFractions& fractions);
+		int64_t Low(int nSupply) const;
+		int64_t High(int nSupply) const;
+		bool    IsFrozen(uint32_t nBlockTime) const;
+	};
+
+	struct CTxPart {
+		bool       fAvailable   = false;  // trusted and mature
+		bool       fConfirmed   = false;  // deep enough to count for the rewards
+		bool       fStake       = false;  // immature stake in the main chain
+		bool       fPending     = false;  // a new tip can change the part
+		bool       fUnconfirmed = false;  // trust can change without a new tip
+		int64_t    nCredit      = 0;
+		int64_t    nUnconfirmed = 0;
+		int64_t    nImmature    = 0;
+		int64_t    nReserve     = 0;
+		int64_t    nLiquidity   = 0;
+		int64_t    nFrozen      = 0;
+		uint64_t   nUnlockTime  = 0;  // earliest lock time of the frozen outputs
+		RewardInfo vRewards[PEG_REWARD_LAST] = {};
+
+		std::vector<COutputPart> vOutputs;  // unspent own outputs of a trusted transaction
+	};
+
+	CCriticalSection cs;
+	bool             fValid = false;
+	uint256          hashBlock;
+	int              nSupply    = 0;
+	uint32_t         nBlockTime = 0;
+
+	int64_t    nCredit      = 0;
+	int64_t    nUnconfirmed = 0;
+	int64_t    nImmature    = 0;
+	int64_t    nReserve     = 0;
+	int64_t    nLiquidity   = 0;
+	int64_t    nFrozen      = 0;
+	RewardInfo vRewards[PEG_REWARD_LAST] = {};
+
+	std::map<uint256, CTxPart>       mapParts;
+	std::set<uint256>                setDirty;
+	std::set<uint256>                setPending;
+	std::set<uint256>                setUnconfirmed;
+	std::multimap<uint64_t, uint256> mapUnlocks;
+
+	void SetDirty();
+	void SetDirty(const uint256& hash);
+	void SetDirty(const CTransaction& tx);
+
+	void Clear();
+	void Insert(const uint256& hash, CTxPart part);
+	void Erase(const uint256& hash);
+	void Reprice(const uint256& hash);
+	void SetTip(const uint256& hash, int nSupply, uint32_t nBlockTime);
+
+private:
+	void Price(CTxPart& part) const;
+	void Add(const CTxPart& part, int nSign);
+	void EraseUnlock(const CTxPart& part, const uint256& hash);
+};
+
 /** A CWallet is an extension of a keystore, which also maintains a set of transactions and
  * balances, and provides the ability to create new transactions.
  */
@@ -100,6 +177,11 @@ private:
 	                 int64_t&                 nValueRet,
 	                 bool                     fUseFrozenUnlocked,
 	                 const CCoinControl*      coinControl) const;
+	void GetStakeCandidates(const std::set<std::pair<const CWalletTx*, uint32_t> >& setCoins,
+	                        std::vector<CStakeCandidate>&                          vCandidates);
+	void EraseStakeCandidates(const uint256& hashTx);
+	void GetBalancePart(const CWalletTx& wtx, CWalletBalances::CTxPart& part) const;
+	void SyncBalances() const;
 
 	CWalletDB* pwalletdbEncryption;
 
@@ -129,6 +211,9 @@ private:
 	int         nConsolidateMax       = 50;
 	int64_t     nConsolidateMaxAmount = 10000000000000;
 
+	// kernel inputs of the coins selected for staking, kept between attempts
+	std::map<COutPoint, CStakeCandidate> mapStakeCandidates;
+
 public:
 	/// Main wallet lock.
 	/// This lock protects all the fields added by CWallet
@@ -180,6 +265,9 @@ public:
 	mutable int      nLastPegSupplyIndexToRecalc = 0;
 	mutable uint32_t nLastBlockTime              = 0;
 
+	// balance totals, brought up to date by the balance queries
+	mutable CWalletBalances balances;
+
 	// check whether we are allowed to upgrade (or already support) to the named feature
 	bool CanSupportFeature(enum WalletFeature wf) {
 		AssertLockHeld(cs_wallet);
@@ -275,7 +363,9 @@ public:
 	void    CleanFractionsOfSpentTxouts(const CBlock* pblock);
 	void    EraseFromWallet(const uint256& hash);
 	void    WalletUpdateSpent(const CTransaction& prevout, bool fBlock = false);
-	int     ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+	int     ScanForWalletTransactions(CBlockIndex* pindexStart,
+	                                  bool         fUpdate  = false,
+	                                  LoadMsg      load_msg = LoadMsg());
 	void    ReacceptWalletTransactions();
 	void    ResendWalletTransactions(bool fForce = false);
 	int64_t GetBalance() const;
@@ -344,12 +434,6 @@ public:
             throw std::runtime_error("CWallet::GetCredit() : value out of range");
         return (IsMine(txout) ? txout.nValue : 0);
 	}
-	int64_t GetFrozen(uint256                       txhash,
-	                  long                          nOut,
-	                  const CTxOut&                 txout,
-	                  std::vector<CFrozenCoinInfo>* pFrozenCoins = NULL) const;
-	int64_t GetReserve(uint256 txhash, long nOut, const CTxOut& txout) const;
-	int64_t GetLiquidity(uint256 txhash, long nOut, const CTxOut& txout) const;
 	bool    IsChange(const CTxOut& txout) const;
 	int64_t GetChange(const CTxOut& txout) const {
 		if (!MoneyRange(txout.nValue))
@@ -532,18 +616,16 @@ class CFractionsRef {
 public:
 	CFractionsRef() {}
 	CFractionsRef(const CFractionsRef& cp) {
-		if (cp.ptr) {
+		if (cp.ptr)
 			ptr = std::unique_ptr<CFractions>(new CFractions(*cp.ptr));
-		}
 	}
 	void Init(int64_t value) {
 		nValue = value;
 		ptr.reset();
 	}
 	CFractions& Ref() const {
-		if (!ptr) {
+		if (!ptr)
 			ptr = std::unique_ptr<CFractions>(new CFractions(nValue, CFractions::STD));
-		}
 		return *ptr;
 	}
 	void UnRef() const {
@@ -587,23 +669,14 @@ public:
 	int64_t nOrderPos;  // position in ordered transaction list
 
 	// memory only
-	mutable bool                         fDebitCached                   = false;
-	mutable bool                         fCreditCached                  = false;
-	mutable bool                         fAvailableCreditCached         = false;
-	mutable uint64_t                     nLastTimeAvailableFrozenCached = 0;
-	mutable bool                         fAvailableReserveCached        = false;
-	mutable bool                         fAvailableLiquidityCached      = false;
-	mutable bool                         fChangeCached                  = false;
-	mutable bool                         fRewardsInfoCached             = false;
-	mutable int64_t                      nDebitCached                   = 0;
-	mutable int64_t                      nCreditCached                  = 0;
-	mutable int64_t                      nAvailableCreditCached         = 0;
-	mutable int64_t                      nAvailableFrozenCached         = 0;
-	mutable int64_t                      nAvailableReserveCached        = 0;
-	mutable int64_t                      nAvailableLiquidityCached      = 0;
-	mutable int64_t                      nChangeCached                  = 0;
-	mutable std::vector<RewardInfo>      vRewardsInfoCached;
-	mutable std::vector<CFrozenCoinInfo> vFrozenCoinInfoCached;
+	mutable bool    fDebitCached           = false;
+	mutable bool    fCreditCached          = false;
+	mutable bool    fAvailableCreditCached = false;
+	mutable bool    fChangeCached          = false;
+	mutable int64_t nDebitCached           = 0;
+	mutable int64_t nCreditCached          = 0;
+	mutable int64_t nAvailableCreditCached = 0;
+	mutable int64_t nChangeCached          = 0;
 
 	CWalletTx() { Init(NULL); }
 
@@ -629,12 +702,6 @@ public:
 		strFromAccount.clear();
 		vfSpent.clear();
 		nOrderPos = -1;
-		vRewardsInfoCached.clear();
-		vRewardsInfoCached.push_back({PEG_REWARD_5, 0, 0, 0});
-		vRewardsInfoCached.push_back({PEG_REWARD_10, 0, 0, 0});
-		vRewardsInfoCached.push_back({PEG_REWARD_20, 0, 0, 0});
-		vRewardsInfoCached.push_back({PEG_REWARD_40, 0, 0, 0});
-		vFrozenCoinInfoCached.clear();
 	}
 
 	IMPLEMENT_SERIALIZE(
@@ -698,28 +765,24 @@ public:
 				break;
 
 			if (vfNewSpent[i] && !vfSpent[i]) {
-				vfSpent[i]                     = true;
-				fReturn                        = true;
-				fAvailableCreditCached         = false;
-				nLastTimeAvailableFrozenCached = 0;
-				fAvailableReserveCached        = false;
-				fAvailableLiquidityCached      = false;
-				fRewardsInfoCached             = false;
+				vfSpent[i]             = true;
+				fReturn                = true;
+				fAvailableCreditCached = false;
 			}
 		}
+		if (fReturn && pwallet)
+			pwallet->balances.SetDirty(*this);
 		return fReturn;
 	}
 
 	// make sure balances are recalculated
 	void MarkDirty() {
-		fCreditCached                  = false;
-		fAvailableCreditCached         = false;
-		nLastTimeAvailableFrozenCached = 0;
-		fAvailableReserveCached        = false;
-		fAvailableLiquidityCached      = false;
-		fDebitCached                   = false;
-		fChangeCached                  = false;
-		fRewardsInfoCached             = false;
+		fCreditCached          = false;
+		fAvailableCreditCached = false;
+		fDebitCached           = false;
+		fChangeCached          = false;
+		if (pwallet)
+			pwallet->balances.SetDirty(*this);
 	}
 
 	void BindWallet(CWallet* pwalletIn) {
@@ -732,12 +795,10 @@ public:
 			throw std::runtime_error("CWalletTx::MarkSpent() : nOut out of range");
 		vfSpent.resize(vout.size());
 		if (!vfSpent[nOut]) {
-			vfSpent[nOut]                  = true;
-			fAvailableCreditCached         = false;
-			nLastTimeAvailableFrozenCached = 0;
-			fAvailableReserveCached        = false;
-			fAvailableLiquidityCached      = false;
-			fRewardsInfoCached             = false;
+			vfSpent[nOut]          = true;
+			fAvailableCreditCached = false;
+			if (pwallet)
+				pwallet->balances.SetDirty(*this);
 		}
 	}
 
@@ -746,12 +807,10 @@ public:
 			throw std::runtime_error("CWalletTx::MarkUnspent() : nOut out of range");
 		vfSpent.resize(vout.size());
 		if (vfSpent[nOut]) {
-			vfSpent[nOut]                  = false;
-			fAvailableCreditCached         = false;
-			nLastTimeAvailableFrozenCached = 0;
-			fAvailableReserveCached        = false;
-			fAvailableLiquidityCached      = false;
-			fRewardsInfoCached             = false;
+			vfSpent[nOut]          = false;
+			fAvailableCreditCached = false;
+			if (pwallet)
+				pwallet->balances.SetDirty(*this);
 		}
 	}
 
@@ -810,193 +869,6 @@ public:
 		return nCredit;
 	}
 
-	int64_t GetAvailableReserve(bool fUseCache = true) const {
-		// Must wait until coinbase is safely deep enough in the chain before valuing it
-		if ((IsCoinBase() || IsCoinStake()) && GetBlocksToMaturity() > 0)
-			return 0;
-
-		if (fUseCache && fAvailableReserveCached)
-			return nAvailableReserveCached;
-
-		int64_t nReserve = 0;
-		for (uint32_t i = 0; i < vout.size(); i++) {
-			if (!IsSpent(i)) {
-				const CTxOut& txout = vout[i];
-				if (pwallet->IsMine(txout)) {
-					nReserve += pwallet->GetReserve(GetHash(), i, txout);
-					if (!MoneyRange(nReserve))
-						throw std::runtime_error(
-						    "CWalletTx::GetAvailableReserve() : value out of range");
-				}
-			}
-		}
-
-		nAvailableReserveCached = nReserve;
-		fAvailableReserveCached = true;
-		return nReserve;
-	}
-
-	int64_t GetAvailableLiquidity(bool fUseCache = true) const {
-		// Must wait until coinbase is safely deep enough in the chain before valuing it
-		if ((IsCoinBase() || IsCoinStake()) && GetBlocksToMaturity() > 0)
-			return 0;
-
-		if (fUseCache && fAvailableLiquidityCached)
-			return nAvailableLiquidityCached;
-
-		int64_t nLiquidity = 0;
-		for (uint32_t i = 0; i < vout.size(); i++) {
-			if (!IsSpent(i)) {
-				const CTxOut& txout = vout[i];
-				if (pwallet->IsMine(txout)) {
-					nLiquidity += pwallet->GetLiquidity(GetHash(), i, txout);
-					if (!MoneyRange(nLiquidity))
-						throw std::runtime_error(
-						    "CWalletTx::GetAvailableLiquidity() : value out of range");
-				}
-			}
-		}
-
-		nAvailableLiquidityCached = nLiquidity;
-		fAvailableLiquidityCached = true;
-		return nLiquidity;
-	}
-
-	int64_t GetAvailableFrozen(bool                          fUseCache    = true,
-	                           std::vector<CFrozenCoinInfo>* pFrozenCoins = NULL) const {
-		// Must wait until coinbase is safely deep enough in the chain before valuing it
-		if ((IsCoinBase() || IsCoinStake()) && GetBlocksToMaturity() > 0)
-			return 0;
-
-		uint64_t nLastTime = pindexBest ? pindexBest->nTime : 0;
-		if (fUseCache &&
-		    (nLastTimeAvailableFrozenCached > 0 && nLastTime < nLastTimeAvailableFrozenCached)) {
-			if (pFrozenCoins) {
-				for (auto fcoin : vFrozenCoinInfoCached) {
-					pFrozenCoins->push_back(fcoin);
-				}
-			}
-			return nAvailableFrozenCached;
-		}
-
-		int64_t                      nFrozen      = 0;
-		uint64_t                     nMinLockTime = 0;
-		std::vector<CFrozenCoinInfo> vFrozenCoinInfo;
-		for (uint32_t i = 0; i < vout.size(); i++) {
-			if (!IsSpent(i)) {
-				const CTxOut& txout = vout[i];
-				if (pwallet->IsMine(txout)) {
-					nFrozen += pwallet->GetFrozen(GetHash(), i, txout, &vFrozenCoinInfo);
-					if (!MoneyRange(nFrozen))
-						throw std::runtime_error(
-						    "CWalletTx::GetAvailableFrozen() : value out of range");
-				}
-			}
-		}
-
-		if (!vFrozenCoinInfo.empty()) {
-			nMinLockTime = vFrozenCoinInfo.front().nLockTime;
-		}
-		for (auto fcoin : vFrozenCoinInfo) {
-			if (fcoin.nLockTime < nMinLockTime) {
-				nMinLockTime = fcoin.nLockTime;
-			}
-		}
-
-		if (pFrozenCoins) {
-			for (auto fcoin : vFrozenCoinInfo) {
-				pFrozenCoins->push_back(fcoin);
-			}
-		}
-		vFrozenCoinInfoCached          = vFrozenCoinInfo;
-		nAvailableFrozenCached         = nFrozen;
-		nLastTimeAvailableFrozenCached = nMinLockTime;
-		return nFrozen;
-	}
-
-	bool GetRewardInfo(std::vector<RewardInfo>& vRewardsInfo, bool fUseCache = true) const {
-		if (vRewardsInfo.size() != PEG_REWARD_LAST)
-			return false;
-
-		if (fUseCache && fRewardsInfoCached) {
-			for (int i = 0; i < PEG_REWARD_LAST; i++) {
-				vRewardsInfo[i].count += vRewardsInfoCached[i].count;
-				vRewardsInfo[i].stake += vRewardsInfoCached[i].stake;
-				vRewardsInfo[i].amount += vRewardsInfoCached[i].amount;
-			}
-			return true;
-		}
-
-		// clean-up
-		for (int i = 0; i < PEG_REWARD_LAST; i++) {
-			vRewardsInfoCached[i].count  = 0;
-			vRewardsInfoCached[i].stake  = 0;
-			vRewardsInfoCached[i].amount = 0;
-		}
-		int nSupply = pwallet->nLastPegSupplyIndex;
-		for (uint32_t i = 0; i < vout.size(); i++) {
-			if (!IsSpent(i) && vOutFractions[i].ptr) {
-				const CTxOut& txout = vout[i];
-				if (pwallet->IsMine(txout)) {
-					bool fConfirmed = GetDepthInMainChain() >=
-									  Params().MinStakeConfirmations(GetBlockNumInMainChain());
-					bool fStake =
-					    IsCoinStake() && GetBlocksToMaturity() > 0 && GetDepthInMainChain() > 0;
-
-					if (vOutFractions[i].ptr->nFlags & CFractions::NOTARY_V) {
-						if (fStake) {
-							vRewardsInfoCached[PEG_REWARD_40].count++;
-							vRewardsInfoCached[PEG_REWARD_40].amount += txout.nValue;
-							vRewardsInfoCached[PEG_REWARD_40].stake++;
-						} else if (fConfirmed) {
-							vRewardsInfoCached[PEG_REWARD_40].count++;
-							vRewardsInfoCached[PEG_REWARD_40].amount += txout.nValue;
-						}
-					} else if (vOutFractions[i].ptr->nFlags & CFractions::NOTARY_F) {
-						if (fStake) {
-							vRewardsInfoCached[PEG_REWARD_20].count++;
-							vRewardsInfoCached[PEG_REWARD_20].amount += txout.nValue;
-							vRewardsInfoCached[PEG_REWARD_20].stake++;
-						} else if (fConfirmed) {
-							vRewardsInfoCached[PEG_REWARD_20].count++;
-							vRewardsInfoCached[PEG_REWARD_20].amount += txout.nValue;
-						}
-					} else {
-						int64_t reserve   = vOutFractions[i].ptr->Low(nSupply);
-						int64_t liquidity = vOutFractions[i].ptr->High(nSupply);
-						if (liquidity < reserve) {
-							if (fStake) {
-								vRewardsInfoCached[PEG_REWARD_10].count++;
-								vRewardsInfoCached[PEG_REWARD_10].amount += txout.nValue;
-								vRewardsInfoCached[PEG_REWARD_10].stake++;
-							} else if (fConfirmed) {
-								vRewardsInfoCached[PEG_REWARD_10].count++;
-								vRewardsInfoCached[PEG_REWARD_10].amount += txout.nValue;
-							}
-						} else {
-							if (fStake) {
-								vRewardsInfoCached[PEG_REWARD_5].count++;
-								vRewardsInfoCached[PEG_REWARD_5].amount += txout.nValue;
-								vRewardsInfoCached[PEG_REWARD_5].stake++;
-							} else if (fConfirmed) {
-								vRewardsInfoCached[PEG_REWARD_5].count++;
-								vRewardsInfoCached[PEG_REWARD_5].amount += txout.nValue;
-							}
-						}
-					}
-				}
-			}
-		}
-
-		// ready
-		for (int i = 0; i < PEG_REWARD_LAST; i++) {
-			vRewardsInfo[i].count += vRewardsInfoCached[i].count;
-			vRewardsInfo[i].stake += vRewardsInfoCached[i].stake;
-			vRewardsInfo[i].amount += vRewardsInfoCached[i].amount;
-		}
-		return true;
-	}
-
 	int64_t GetChange() const {
 		if (fChangeCached)
 			return nChangeCached;